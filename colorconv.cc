@@ -0,0 +1,367 @@
+// nacl264 - x264 on Google Native Client
+// 2014.06 Satoshi Ueyama
+// distributed under GPL
+
+#include "colorconv.h"
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__) && !defined(__native_client__)
+#define COLORCONV_X86 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#else
+#define COLORCONV_X86 0
+#endif
+
+#define COLOR_Y_SHIFT 15
+#define COLOR_C_SHIFT 17
+
+static inline uint8_t clipPixel(int v) {
+	return (v < 0) ? 0 : (v > 255) ? 255 : v;
+}
+
+static inline int16_t roundCoefficient(double v) {
+	return (int16_t)((v < 0) ? (v * 32768.0 - 0.5) : (v * 32768.0 + 0.5));
+}
+
+static void computeCoefficients(ColorMatrix matrix, ColorRange range, ColorCoefficients* k) {
+	const double kr = (matrix == kColorMatrixBT709) ? 0.2126 : 0.299;
+	const double kb = (matrix == kColorMatrixBT709) ? 0.0722 : 0.114;
+	const bool full = (range == kColorRangeFull);
+	const double yScale = full ? 1.0 : (219.0 / 255.0);
+	const double cScale = full ? 1.0 : (224.0 / 255.0);
+
+	// Each row of coefficients is forced to sum to its exact target,
+	// so that greys map to Y=16..235 (or 0..255) and Cb=Cr=128 exactly.
+	const int yOne = (int)(yScale * 32768.0 + 0.5);
+	k->yR = roundCoefficient(kr * yScale);
+	k->yB = roundCoefficient(kb * yScale);
+	k->yG = (int16_t)(yOne - k->yR - k->yB);
+
+	const double uDiv = 2.0 * (1.0 - kb);
+	k->uB = roundCoefficient(0.5 * cScale);
+	k->uR = roundCoefficient(-kr / uDiv * cScale);
+	k->uG = (int16_t)(-k->uB - k->uR);
+
+	const double vDiv = 2.0 * (1.0 - kr);
+	k->vR = roundCoefficient(0.5 * cScale);
+	k->vB = roundCoefficient(-kb / vDiv * cScale);
+	k->vG = (int16_t)(-k->vR - k->vB);
+
+	k->yBias = ((full ? 0 : 16) << COLOR_Y_SHIFT) + (1 << (COLOR_Y_SHIFT - 1));
+	k->cBias = (128 << COLOR_C_SHIFT) + (1 << (COLOR_C_SHIFT - 1));
+}
+
+// Reference kernel - - - - - - - -
+// BPP: bytes per source pixel, RO/GO/BO: byte offset of each channel
+template <int BPP, int RO, int GO, int BO>
+static void convertRowPair_C(const uint8_t* src0, const uint8_t* src1,
+                             uint8_t* dstY0, uint8_t* dstY1, uint8_t* dstU, uint8_t* dstV,
+                             int width, const ColorCoefficients* k) {
+	for (int x = 0;x < width;x += 2) {
+		const uint8_t* a = src0 + x * BPP;
+		const uint8_t* b = src1 + x * BPP;
+
+		dstY0[x]   = clipPixel((k->yR*a[RO]     + k->yG*a[GO]     + k->yB*a[BO]     + k->yBias) >> COLOR_Y_SHIFT);
+		dstY0[x+1] = clipPixel((k->yR*a[BPP+RO] + k->yG*a[BPP+GO] + k->yB*a[BPP+BO] + k->yBias) >> COLOR_Y_SHIFT);
+		dstY1[x]   = clipPixel((k->yR*b[RO]     + k->yG*b[GO]     + k->yB*b[BO]     + k->yBias) >> COLOR_Y_SHIFT);
+		dstY1[x+1] = clipPixel((k->yR*b[BPP+RO] + k->yG*b[BPP+GO] + k->yB*b[BPP+BO] + k->yBias) >> COLOR_Y_SHIFT);
+
+		const int sR = a[RO] + a[BPP+RO] + b[RO] + b[BPP+RO];
+		const int sG = a[GO] + a[BPP+GO] + b[GO] + b[BPP+GO];
+		const int sB = a[BO] + a[BPP+BO] + b[BO] + b[BPP+BO];
+		dstU[x>>1] = clipPixel((k->uR*sR + k->uG*sG + k->uB*sB + k->cBias) >> COLOR_C_SHIFT);
+		dstV[x>>1] = clipPixel((k->vR*sR + k->vG*sG + k->vB*sB + k->cBias) >> COLOR_C_SHIFT);
+	}
+}
+
+#if COLORCONV_X86
+// SSE2 kernel - - - - - - - -
+// Pixels are handled as 32-bit lanes with G in byte 1 and R/B in bytes 0 and 2.
+// One mask splits a lane into a (byte0 | byte2<<16) word pair and one shift+mask
+// isolates G, so pmaddwd evaluates the whole matrix row in two instructions.
+// RO is the byte offset of R (0 for RGB order, 2 for BGR order).
+
+// Loads 4 pixels into 32-bit lanes (the 4th byte of a 24-bit pixel is garbage)
+template <int BPP>
+static inline __m128i loadPixels4_SSE2(const uint8_t* p) {
+	const __m128i a = _mm_loadu_si128((const __m128i*)p);
+	if (BPP == 4) {
+		return a;
+	}
+
+	const __m128i lo = _mm_unpacklo_epi32(a, _mm_srli_si128(a, 3));
+	const __m128i hi = _mm_unpacklo_epi32(_mm_srli_si128(a, 6), _mm_srli_si128(a, 9));
+	return _mm_unpacklo_epi64(lo, hi);
+}
+
+static inline __m128i splitOuter_SSE2(__m128i px) {
+	return _mm_and_si128(px, _mm_set1_epi32(0x00ff00ff));
+}
+
+static inline __m128i splitG_SSE2(__m128i px) {
+	return _mm_and_si128(_mm_srli_epi32(px, 8), _mm_set1_epi32(0xff));
+}
+
+static inline __m128i applyMatrix_SSE2(__m128i outer, __m128i g, __m128i kOuter, __m128i kG, __m128i bias, int shift) {
+	const __m128i t = _mm_add_epi32(_mm_madd_epi16(outer, kOuter), _mm_madd_epi16(g, kG));
+	return _mm_srai_epi32(_mm_add_epi32(t, bias), shift);
+}
+
+// Adds horizontally adjacent lanes of (a, b): [a0+a1, a2+a3, b0+b1, b2+b3]
+static inline __m128i addPairs_SSE2(__m128i a, __m128i b) {
+	const __m128 fa = _mm_castsi128_ps(a);
+	const __m128 fb = _mm_castsi128_ps(b);
+	const __m128i even = _mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(2,0,2,0)));
+	const __m128i odd  = _mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(3,1,3,1)));
+	return _mm_add_epi32(even, odd);
+}
+
+static inline __m128i packCoefficients_SSE2(int16_t c0, int16_t c1) {
+	return _mm_set1_epi32((int32_t)(((uint32_t)(uint16_t)c1 << 16) | (uint16_t)c0));
+}
+
+// Coefficients for the (byte0, byte2) pair
+template <int RO>
+static inline __m128i outerCoefficients_SSE2(int16_t cR, int16_t cB) {
+	return (RO == 0) ? packCoefficients_SSE2(cR, cB) : packCoefficients_SSE2(cB, cR);
+}
+
+template <int BPP, int RO>
+static void convertRowPair_SSE2(const uint8_t* src0, const uint8_t* src1,
+                                uint8_t* dstY0, uint8_t* dstY1, uint8_t* dstU, uint8_t* dstV,
+                                int width, const ColorCoefficients* k) {
+	const __m128i kYO = outerCoefficients_SSE2<RO>(k->yR, k->yB);
+	const __m128i kYG = packCoefficients_SSE2(k->yG, 0);
+	const __m128i kUO = outerCoefficients_SSE2<RO>(k->uR, k->uB);
+	const __m128i kUG = packCoefficients_SSE2(k->uG, 0);
+	const __m128i kVO = outerCoefficients_SSE2<RO>(k->vR, k->vB);
+	const __m128i kVG = packCoefficients_SSE2(k->vG, 0);
+	const __m128i yBias = _mm_set1_epi32(k->yBias);
+	const __m128i cBias = _mm_set1_epi32(k->cBias);
+
+	// 24-bit loads read 4 bytes past the 8 pixels of an iteration
+	const int overread = (BPP == 3) ? 2 : 0;
+	int x = 0;
+	for (;x + 8 + overread <= width;x += 8) {
+		const uint8_t* a = src0 + x * BPP;
+		const uint8_t* b = src1 + x * BPP;
+		const __m128i a0 = loadPixels4_SSE2<BPP>(a);
+		const __m128i a1 = loadPixels4_SSE2<BPP>(a + 4*BPP);
+		const __m128i b0 = loadPixels4_SSE2<BPP>(b);
+		const __m128i b1 = loadPixels4_SSE2<BPP>(b + 4*BPP);
+
+		const __m128i oA0 = splitOuter_SSE2(a0), gA0 = splitG_SSE2(a0);
+		const __m128i oA1 = splitOuter_SSE2(a1), gA1 = splitG_SSE2(a1);
+		const __m128i oB0 = splitOuter_SSE2(b0), gB0 = splitG_SSE2(b0);
+		const __m128i oB1 = splitOuter_SSE2(b1), gB1 = splitG_SSE2(b1);
+
+		const __m128i y0 = _mm_packs_epi32(applyMatrix_SSE2(oA0, gA0, kYO, kYG, yBias, COLOR_Y_SHIFT),
+		                                   applyMatrix_SSE2(oA1, gA1, kYO, kYG, yBias, COLOR_Y_SHIFT));
+		const __m128i y1 = _mm_packs_epi32(applyMatrix_SSE2(oB0, gB0, kYO, kYG, yBias, COLOR_Y_SHIFT),
+		                                   applyMatrix_SSE2(oB1, gB1, kYO, kYG, yBias, COLOR_Y_SHIFT));
+		const __m128i y01 = _mm_packus_epi16(y0, y1);
+		_mm_storel_epi64((__m128i*)(dstY0 + x), y01);
+		_mm_storel_epi64((__m128i*)(dstY1 + x), _mm_srli_si128(y01, 8));
+
+		// 2x2 sums; channel sums stay below 1024 so they never carry between word halves
+		const __m128i sO = addPairs_SSE2(_mm_add_epi32(oA0, oB0), _mm_add_epi32(oA1, oB1));
+		const __m128i sG = addPairs_SSE2(_mm_add_epi32(gA0, gB0), _mm_add_epi32(gA1, gB1));
+		const __m128i u = applyMatrix_SSE2(sO, sG, kUO, kUG, cBias, COLOR_C_SHIFT);
+		const __m128i v = applyMatrix_SSE2(sO, sG, kVO, kVG, cBias, COLOR_C_SHIFT);
+		const __m128i uv = _mm_packus_epi16(_mm_packs_epi32(u, v), _mm_setzero_si128());
+		const int32_t u4 = _mm_cvtsi128_si32(uv);
+		const int32_t v4 = _mm_cvtsi128_si32(_mm_srli_si128(uv, 4));
+		memcpy(dstU + (x >> 1), &u4, 4);
+		memcpy(dstV + (x >> 1), &v4, 4);
+	}
+
+	if (x < width) {
+		convertRowPair_C<BPP,RO,1,2-RO>(src0 + x * BPP, src1 + x * BPP, dstY0 + x, dstY1 + x,
+		                                 dstU + (x >> 1), dstV + (x >> 1), width - x, k);
+	}
+}
+
+// AVX2 kernel - - - - - - - -
+// Same arithmetic as the SSE2 kernel on 8 pixels per register.
+// In-lane packs and shuffles leave quadwords in 0,2,1,3 order; vpermq restores it.
+#define COLORCONV_AVX2 __attribute__((target("avx2")))
+
+template <int BPP>
+static inline COLORCONV_AVX2 __m256i loadPixels8_AVX2(const uint8_t* p) {
+	const __m256i a = _mm256_loadu_si256((const __m256i*)p);
+	if (BPP == 4) {
+		return a;
+	}
+
+	// bytes 0-11 to the low lane, 12-23 to the high lane, then expand 3 -> 4 bytes per pixel
+	const __m256i spread = _mm256_permutevar8x32_epi32(a, _mm256_setr_epi32(0,1,2,0, 3,4,5,0));
+	const __m256i expand = _mm256_setr_epi8(0,1,2,-1, 3,4,5,-1, 6,7,8,-1, 9,10,11,-1,
+	                                        0,1,2,-1, 3,4,5,-1, 6,7,8,-1, 9,10,11,-1);
+	return _mm256_shuffle_epi8(spread, expand);
+}
+
+static inline COLORCONV_AVX2 __m256i splitOuter_AVX2(__m256i px) {
+	return _mm256_and_si256(px, _mm256_set1_epi32(0x00ff00ff));
+}
+
+static inline COLORCONV_AVX2 __m256i splitG_AVX2(__m256i px) {
+	return _mm256_and_si256(_mm256_srli_epi32(px, 8), _mm256_set1_epi32(0xff));
+}
+
+static inline COLORCONV_AVX2 __m256i applyMatrix_AVX2(__m256i outer, __m256i g, __m256i kOuter, __m256i kG, __m256i bias, int shift) {
+	const __m256i t = _mm256_add_epi32(_mm256_madd_epi16(outer, kOuter), _mm256_madd_epi16(g, kG));
+	return _mm256_srai_epi32(_mm256_add_epi32(t, bias), shift);
+}
+
+static inline COLORCONV_AVX2 __m256i addPairs_AVX2(__m256i a, __m256i b) {
+	const __m256 fa = _mm256_castsi256_ps(a);
+	const __m256 fb = _mm256_castsi256_ps(b);
+	const __m256i even = _mm256_castps_si256(_mm256_shuffle_ps(fa, fb, _MM_SHUFFLE(2,0,2,0)));
+	const __m256i odd  = _mm256_castps_si256(_mm256_shuffle_ps(fa, fb, _MM_SHUFFLE(3,1,3,1)));
+	return _mm256_permute4x64_epi64(_mm256_add_epi32(even, odd), _MM_SHUFFLE(3,1,2,0));
+}
+
+// Packs 2x8 dwords to 16 words in source order
+static inline COLORCONV_AVX2 __m128i packWords_AVX2(__m256i a, __m256i b) {
+	const __m256i t = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), _MM_SHUFFLE(3,1,2,0));
+	return _mm_packus_epi16(_mm256_castsi256_si128(t), _mm256_extracti128_si256(t, 1));
+}
+
+template <int BPP, int RO>
+static COLORCONV_AVX2 void convertRowPair_AVX2(const uint8_t* src0, const uint8_t* src1,
+                                               uint8_t* dstY0, uint8_t* dstY1, uint8_t* dstU, uint8_t* dstV,
+                                               int width, const ColorCoefficients* k) {
+	const __m256i kYO = _mm256_broadcastsi128_si256(outerCoefficients_SSE2<RO>(k->yR, k->yB));
+	const __m256i kYG = _mm256_broadcastsi128_si256(packCoefficients_SSE2(k->yG, 0));
+	const __m256i kUO = _mm256_broadcastsi128_si256(outerCoefficients_SSE2<RO>(k->uR, k->uB));
+	const __m256i kUG = _mm256_broadcastsi128_si256(packCoefficients_SSE2(k->uG, 0));
+	const __m256i kVO = _mm256_broadcastsi128_si256(outerCoefficients_SSE2<RO>(k->vR, k->vB));
+	const __m256i kVG = _mm256_broadcastsi128_si256(packCoefficients_SSE2(k->vG, 0));
+	const __m256i yBias = _mm256_set1_epi32(k->yBias);
+	const __m256i cBias = _mm256_set1_epi32(k->cBias);
+
+	// 24-bit loads read 8 bytes past the 16 pixels of an iteration
+	const int overread = (BPP == 3) ? 3 : 0;
+	int x = 0;
+	for (;x + 16 + overread <= width;x += 16) {
+		const uint8_t* a = src0 + x * BPP;
+		const uint8_t* b = src1 + x * BPP;
+		const __m256i a0 = loadPixels8_AVX2<BPP>(a);
+		const __m256i a1 = loadPixels8_AVX2<BPP>(a + 8*BPP);
+		const __m256i b0 = loadPixels8_AVX2<BPP>(b);
+		const __m256i b1 = loadPixels8_AVX2<BPP>(b + 8*BPP);
+
+		const __m256i oA0 = splitOuter_AVX2(a0), gA0 = splitG_AVX2(a0);
+		const __m256i oA1 = splitOuter_AVX2(a1), gA1 = splitG_AVX2(a1);
+		const __m256i oB0 = splitOuter_AVX2(b0), gB0 = splitG_AVX2(b0);
+		const __m256i oB1 = splitOuter_AVX2(b1), gB1 = splitG_AVX2(b1);
+
+		_mm_storeu_si128((__m128i*)(dstY0 + x),
+		                 packWords_AVX2(applyMatrix_AVX2(oA0, gA0, kYO, kYG, yBias, COLOR_Y_SHIFT),
+		                                applyMatrix_AVX2(oA1, gA1, kYO, kYG, yBias, COLOR_Y_SHIFT)));
+		_mm_storeu_si128((__m128i*)(dstY1 + x),
+		                 packWords_AVX2(applyMatrix_AVX2(oB0, gB0, kYO, kYG, yBias, COLOR_Y_SHIFT),
+		                                applyMatrix_AVX2(oB1, gB1, kYO, kYG, yBias, COLOR_Y_SHIFT)));
+
+		const __m256i sO = addPairs_AVX2(_mm256_add_epi32(oA0, oB0), _mm256_add_epi32(oA1, oB1));
+		const __m256i sG = addPairs_AVX2(_mm256_add_epi32(gA0, gB0), _mm256_add_epi32(gA1, gB1));
+		const __m128i uv = packWords_AVX2(applyMatrix_AVX2(sO, sG, kUO, kUG, cBias, COLOR_C_SHIFT),
+		                                  applyMatrix_AVX2(sO, sG, kVO, kVG, cBias, COLOR_C_SHIFT));
+		_mm_storel_epi64((__m128i*)(dstU + (x >> 1)), uv);
+		_mm_storel_epi64((__m128i*)(dstV + (x >> 1)), _mm_srli_si128(uv, 8));
+	}
+
+	if (x < width) {
+		convertRowPair_SSE2<BPP,RO>(src0 + x * BPP, src1 + x * BPP, dstY0 + x, dstY1 + x,
+		                            dstU + (x >> 1), dstV + (x >> 1), width - x, k);
+	}
+}
+#endif // COLORCONV_X86
+
+// Converter - - - - - - - -
+ColorConverter::ColorConverter() :
+	mMatrix(kColorMatrixBT601),
+	mRange(kColorRangeLimited),
+	mKernelLevel(kColorKernelC) {
+	setMatrix(kColorMatrixBT601, kColorRangeLimited);
+	setKernelLevel(kColorKernelAVX2);
+}
+
+void ColorConverter::setMatrix(ColorMatrix matrix, ColorRange range) {
+	mMatrix = matrix;
+	mRange = range;
+	computeCoefficients(matrix, range, &mCoefficients);
+}
+
+void ColorConverter::setKernelLevel(ColorKernelLevel maxLevel) {
+	const ColorKernelLevel detected = detectKernelLevel();
+	mKernelLevel = (maxLevel < detected) ? maxLevel : detected;
+
+	mRowPairProcs[kPixelFormatRGB]  = convertRowPair_C<3,0,1,2>;
+	mRowPairProcs[kPixelFormatRGBA] = convertRowPair_C<4,0,1,2>;
+	mRowPairProcs[kPixelFormatBGRA] = convertRowPair_C<4,2,1,0>;
+#if COLORCONV_X86
+	if (mKernelLevel >= kColorKernelSSE2) {
+		mRowPairProcs[kPixelFormatRGB]  = convertRowPair_SSE2<3,0>;
+		mRowPairProcs[kPixelFormatRGBA] = convertRowPair_SSE2<4,0>;
+		mRowPairProcs[kPixelFormatBGRA] = convertRowPair_SSE2<4,2>;
+	}
+
+	if (mKernelLevel >= kColorKernelAVX2) {
+		mRowPairProcs[kPixelFormatRGB]  = convertRowPair_AVX2<3,0>;
+		mRowPairProcs[kPixelFormatRGBA] = convertRowPair_AVX2<4,0>;
+		mRowPairProcs[kPixelFormatBGRA] = convertRowPair_AVX2<4,2>;
+	}
+#endif
+}
+
+void ColorConverter::convert(PixelFormat format, const uint8_t* src, int srcStride, int width, int height,
+                             uint8_t* const dstPlanes[3], const int dstStrides[3]) const {
+	const ColorRowPairProc proc = mRowPairProcs[format];
+	const int w = width & ~1;
+	for (int y = 0;y + 1 < height;y += 2) {
+		const uint8_t* src0 = src + srcStride * y;
+		proc(src0, src0 + srcStride,
+		     dstPlanes[0] + dstStrides[0] * y, dstPlanes[0] + dstStrides[0] * (y+1),
+		     dstPlanes[1] + dstStrides[1] * (y >> 1), dstPlanes[2] + dstStrides[2] * (y >> 1),
+		     w, &mCoefficients);
+	}
+}
+
+bool ColorConverter::parsePixelFormat(const char* name, PixelFormat* format) {
+	static const char* const kNames[] = {"rgb", "rgba", "bgra", "i420", "nv12"};
+	for (int i = 0;i < (int)(sizeof(kNames) / sizeof(kNames[0]));++i) {
+		if (strcmp(name, kNames[i]) == 0) {
+			*format = (PixelFormat)i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+int ColorConverter::bytesPerPixel(PixelFormat format) {
+	return (format == kPixelFormatRGB) ? 3 : 4;
+}
+
+ColorKernelLevel ColorConverter::detectKernelLevel() {
+#if COLORCONV_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		return kColorKernelAVX2;
+	}
+
+	return kColorKernelSSE2;
+#else
+	return kColorKernelC;
+#endif
+}
+
+const char* ColorConverter::kernelLevelName(ColorKernelLevel level) {
+	switch (level) {
+	case kColorKernelAVX2: return "avx2";
+	case kColorKernelSSE2: return "sse2";
+	default: return "c";
+	}
+}
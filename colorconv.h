@@ -0,0 +1,84 @@
+// nacl264 - x264 on Google Native Client
+// 2014.06 Satoshi Ueyama
+// distributed under GPL
+
+#ifndef COLORCONV_H_INCLUDED
+#define COLORCONV_H_INCLUDED
+
+#include <stdint.h>
+
+typedef enum {
+	kColorMatrixBT601 = 0,
+	kColorMatrixBT709 = 1
+} ColorMatrix;
+
+typedef enum {
+	kColorRangeLimited = 0,
+	kColorRangeFull    = 1
+} ColorRange;
+
+// Source frame layouts. Packed formats come first and go through ColorConverter::convert.
+typedef enum {
+	kPixelFormatRGB  = 0, // 24-bit R,G,B
+	kPixelFormatRGBA = 1, // 32-bit R,G,B,A (canvas ImageData)
+	kPixelFormatBGRA = 2, // 32-bit B,G,R,A
+	kPixelFormatI420 = 3, // planar YUV 4:2:0, passed to the encoder as-is
+	kPixelFormatNV12 = 4  // Y plane + interleaved UV plane, passed to the encoder as-is
+} PixelFormat;
+
+#define COLOR_PACKED_FORMAT_COUNT 3
+
+// Kernel implementations, ordered from slowest to fastest
+typedef enum {
+	kColorKernelC    = 0,
+	kColorKernelSSE2 = 1,
+	kColorKernelAVX2 = 2
+} ColorKernelLevel;
+
+// Fixed-point conversion coefficients.
+// Y  = (yR*R + yG*G + yB*B + yBias) >> 15
+// Cb = (uR*sR + uG*sG + uB*sB + cBias) >> 17  (sR/sG/sB: sum of a 2x2 block)
+typedef struct {
+	int16_t yR, yG, yB;
+	int16_t uR, uG, uB;
+	int16_t vR, vG, vB;
+	int32_t yBias;
+	int32_t cBias;
+} ColorCoefficients;
+
+// Converts two source rows into two luma rows and one row of each chroma plane.
+// width must be even.
+typedef void (*ColorRowPairProc)(const uint8_t* src0, const uint8_t* src1,
+                                 uint8_t* dstY0, uint8_t* dstY1, uint8_t* dstU, uint8_t* dstV,
+                                 int width, const ColorCoefficients* k);
+
+class ColorConverter {
+public:
+	ColorConverter();
+
+	void setMatrix(ColorMatrix matrix, ColorRange range);
+	ColorMatrix matrix() const { return mMatrix; }
+	ColorRange range() const { return mRange; }
+
+	// Select kernels up to maxLevel (clamped to what this CPU supports)
+	void setKernelLevel(ColorKernelLevel maxLevel);
+	ColorKernelLevel kernelLevel() const { return mKernelLevel; }
+
+	// Packed RGB -> I420. width and height must be even.
+	void convert(PixelFormat format, const uint8_t* src, int srcStride, int width, int height,
+	             uint8_t* const dstPlanes[3], const int dstStrides[3]) const;
+
+	static bool isPacked(PixelFormat format) { return format < COLOR_PACKED_FORMAT_COUNT; }
+	static int bytesPerPixel(PixelFormat format);
+	static bool parsePixelFormat(const char* name, PixelFormat* format);
+	static ColorKernelLevel detectKernelLevel();
+	static const char* kernelLevelName(ColorKernelLevel level);
+protected:
+	ColorMatrix mMatrix;
+	ColorRange mRange;
+	ColorKernelLevel mKernelLevel;
+	ColorCoefficients mCoefficients;
+	ColorRowPairProc mRowPairProcs[COLOR_PACKED_FORMAT_COUNT];
+};
+
+#endif
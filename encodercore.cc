@@ -0,0 +1,449 @@
+// nacl264 - x264 on Google Native Client
+// 2014.06 Satoshi Ueyama
+// distributed under GPL
+
+#include "encodercore.h"
+#include <stdio.h>
+#include <string.h>
+
+extern "C" {
+#include "output/matroska_ebml.h"
+int mk_set_buffer_writer(hnd_t handle, mk_flush_proc fp, mk_seek_proc sp, void* user_data);
+int mp4_set_buffer_writer(hnd_t handle, mp4CustomWriteFunction write_f, mp4CustomSeekFunction seek_f, void* opaque);
+}
+
+static size_t mkFlush(const void *buf, size_t size, void* user_data);
+static size_t mkSeek(long pos, void* user_data);
+static int mp4WriteBuffer(void *opaque, uint8_t *buf, int size);
+static int64_t mp4SeekBuffer(void *opaque, int64_t offset, int whence);
+
+// Tiny logger implementation
+extern "C" void x264_cli_log( const char *name, int i_level, const char *fmt, ... ) {
+	va_list arg;
+	va_start( arg, fmt );
+	vprintf(fmt, arg);
+	va_end( arg );
+}
+
+EncoderCore::EncoderCore() :
+	mX264(NULL),
+	mOutHandle(NULL),
+	mOutputType(kContainerTypeMKV),
+	mOutputOpen(false),
+	mLowLatency(false),
+	mSliceStreaming(false),
+	mCpuFlags(0),
+	mNextPTS(0),mMaxPTS(0),mSecondPTS(0),
+	mNextSliceMB(0) {
+	mCLIOutput = mkv_output;
+	pthread_mutex_init(&mSliceLock, NULL);
+	mOutputStore.setSink(&mOutputStaging);
+}
+
+EncoderCore::~EncoderCore() {
+	close();
+	pthread_mutex_destroy(&mSliceLock);
+}
+
+void EncoderCore::setDefaultParams(x264_param_t* params) {
+	//x264_param_default(params);
+	x264_param_default_preset(params, "fast", "grain");
+	
+	params->i_fps_num = 30;
+	params->i_fps_den = 1;
+	params->i_width = 320;
+	params->i_height = 240;
+	params->b_annexb = 0;
+	params->b_repeat_headers = 0;
+	params->i_keyint_max = 50;
+	
+	x264_param_apply_profile(params, "main");
+}
+
+// Tell the decoder which matrix and range the converted frames use
+void EncoderCore::applyColorSignalling(x264_param_t* params, ColorMatrix matrix, ColorRange range) {
+	if (matrix == kColorMatrixBT709) {
+		params->vui.i_colorprim  = 1; // bt709
+		params->vui.i_transfer   = 1;
+		params->vui.i_colmatrix  = 1;
+	} else {
+		params->vui.i_colorprim  = 6; // smpte170m
+		params->vui.i_transfer   = 6;
+		params->vui.i_colmatrix  = 6;
+	}
+
+	params->vui.b_fullrange = (range == kColorRangeFull) ? 1 : 0;
+}
+
+// Same settings as --tune zerolatency: every frame leaves the encoder
+// in the call that took it in
+void EncoderCore::applyLowLatency(x264_param_t* params) {
+	params->rc.i_lookahead = 0;
+	params->i_sync_lookahead = 0;
+	params->i_bframe = 0;
+	params->b_sliced_threads = 1;
+	params->b_vfr_input = 0;
+	params->rc.b_mb_tree = 0;
+
+	// Packet-sized slices unless the caller chose otherwise
+	if (!params->i_slice_max_size) {
+		params->i_slice_max_size = 1200;
+	}
+}
+
+bool EncoderCore::parseContainerType(const char* name, ContainerType* type) {
+	if (strcmp(name, "mkv") == 0) {
+		*type = kContainerTypeMKV;
+	} else if (strcmp(name, "mp4") == 0) {
+		*type = kContainerTypeMP4;
+	} else if (strcmp(name, "fmp4") == 0) {
+		*type = kContainerTypeFMP4;
+	} else if (strcmp(name, "h264") == 0) {
+		*type = kContainerTypeH264;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+bool EncoderCore::parseCpuMask(x264_param_t* params, const char* mask) {
+	const uint32_t cpu = params->cpu;
+	if (x264_param_parse(params, "asm", mask) != 0) {
+		params->cpu = cpu;
+		return false;
+	}
+
+	return true;
+}
+
+bool EncoderCore::parseOptions(x264_param_t* params, const char* options) {
+	std::string list(options);
+	size_t start = 0;
+	while (start < list.size()) {
+		size_t end = list.find(':', start);
+		if (end == std::string::npos) {
+			end = list.size();
+		}
+
+		const std::string option = list.substr(start, end - start);
+		const size_t eq = option.find('=');
+		const std::string name = option.substr(0, eq);
+		const char* value = (eq == std::string::npos) ? NULL : option.c_str() + eq + 1;
+		if (!name.empty() && x264_param_parse(params, name.c_str(), value) != 0) {
+			printf("Error: bad x264 option '%s'\n", option.c_str());
+			return false;
+		}
+
+		start = end + 1;
+	}
+
+	return true;
+}
+
+// Space separated names of the x264_cpu_names entries cpu covers in full
+std::string EncoderCore::describeCpu(uint32_t cpu) {
+	std::string names;
+	for (int i = 0;x264_cpu_names[i].flags;++i) {
+		if ((cpu & x264_cpu_names[i].flags) == x264_cpu_names[i].flags && x264_cpu_names[i].name[0]) {
+			if (!names.empty()) {
+				names += ' ';
+			}
+			names += x264_cpu_names[i].name;
+		}
+	}
+
+	return names.empty() ? std::string("none") : names;
+}
+
+void EncoderCore::setBatchProc(OutputBatchProc proc, void* user_data) {
+	mOutputStaging.setBatchProc(proc, user_data);
+}
+
+void EncoderCore::configureBatching(size_t maxBytes, int maxLatencyMs) {
+	mOutputStaging.configure(maxBytes, maxLatencyMs);
+}
+
+bool EncoderCore::open(x264_param_t* params, ContainerType type, bool lowLatency) {
+	close();
+	mOutputStore.reset();
+	mOutputStaging.reset();
+	mNextPTS = 0;
+	mMaxPTS = mSecondPTS = 0;
+	mOutputType = type;
+	mLowLatency = lowLatency;
+	mSliceStreaming = (type == kContainerTypeH264 && lowLatency);
+	mPendingSlices.clear();
+	mNextSliceMB = 0;
+
+	// Containers take length-prefixed NALs, the raw stream takes start codes
+	params->b_annexb = (type == kContainerTypeH264) ? 1 : 0;
+	params->nalu_process = mSliceStreaming ? naluProcessEntry : NULL;
+	mX264 = x264_encoder_open(params);
+	if (!mX264) {
+		puts("Error: failed to open encoder");
+		return false;
+	}
+
+	if (!openOutput()) {
+		puts("Error: failed to open output");
+		closeEncoder();
+		return false;
+	}
+
+    x264_encoder_parameters(mX264, params);
+	// x264 drops nalu_process when it runs frame threads
+	mSliceStreaming = (params->nalu_process != NULL);
+
+	// The tables don't change after open, so the report can be taken now
+	// and read from any thread
+	mCpuFlags = params->cpu;
+	const int nKernels = x264_cpu_kernel_report(mX264, NULL, 0);
+	mKernelReport.resize(nKernels > 0 ? nKernels : 0);
+	if (!mKernelReport.empty()) {
+		x264_cpu_kernel_report(mX264, &mKernelReport[0], mKernelReport.size());
+	}
+
+	mSpeedGovernor.start(params);
+
+	printf("CPU: %s\n", describeCpu(mCpuFlags).c_str());
+	printf("Encoder threads: %d%s, lookahead threads: %d%s\n", params->i_threads,
+	       params->b_sliced_threads ? " (sliced)" : "", params->i_lookahead_threads,
+	       params->b_deblock_thread ? ", deblock thread" : "");
+	if (mSpeedGovernor.isEnabled()) {
+		printf("Speed governor: target %.2f fps\n", mSpeedGovernor.targetFps());
+	}
+
+	if (mOutHandle) {
+		mCLIOutput.set_param(mOutHandle, params);
+	}
+	
+	{
+		// Write SPS/PPS/SEI
+		x264_nal_t *headers;
+		int i_nal;
+
+		const int headersSize = x264_encoder_headers(mX264, &headers, &i_nal);
+		if (mOutHandle) {
+			mCLIOutput.write_headers(mOutHandle, headers);
+		} else if (headersSize > 0) {
+			writeOutput(headers[0].p_payload, headersSize);
+		}
+	}
+
+	return true;
+}
+
+bool EncoderCore::openOutput() {
+	char outFilename[2] = "+";
+	mOutputOpen = true;
+
+	if (mOutputType == kContainerTypeH264) {
+		// No container; headers and frames are written as they are
+		return true;
+	}
+
+	mCLIOutput = (mOutputType == kContainerTypeMKV) ? mkv_output : mp4_output;
+
+	cli_output_opt_t output_opt;
+	output_opt.use_dts_compress = 0;
+	if (mCLIOutput.open_file(outFilename, &mOutHandle, &output_opt ) != 0) {
+		mOutHandle = NULL;
+		return false;
+	}
+
+	// The writers are bound to this encoder's handle
+	if (mOutputType == kContainerTypeMKV) {
+		mk_set_buffer_writer(mOutHandle, mkFlush, mkSeek, this);
+	} else {
+		// No seek function for fmp4: lsmash writes fragments without going back
+		mp4CustomSeekFunction seek_f = (mOutputType == kContainerTypeMP4) ? mp4SeekBuffer : NULL;
+		if (mp4_set_buffer_writer(mOutHandle, mp4WriteBuffer, seek_f, this) != 0) {
+			closeOutput();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void EncoderCore::stampFrame(x264_picture_t* picture) {
+	// Set PTS
+	picture->i_pts = mNextPTS++;
+	picture->opaque = this; // for nalu_process
+	
+	if (picture->i_pts > mMaxPTS) {
+		mSecondPTS = mMaxPTS;
+		mMaxPTS = picture->i_pts;
+	}
+}
+
+void EncoderCore::encodeFrame(x264_picture_t* picture) {
+	x264_picture_t out_pic;
+	x264_nal_t *nal;
+	int i_nal;
+	int i_frame_size = 0;
+	const int64_t startTime = x264_mdate();
+    
+	i_frame_size = x264_encoder_encode(mX264, &nal, &i_nal, picture, &out_pic );
+	if( i_frame_size > 0 ) {
+		writeEncodedFrame(nal, i_frame_size, &out_pic);
+	}
+
+	if (mLowLatency) {
+		mOutputStaging.flush();
+	} else {
+		mOutputStaging.flushIfDue();
+	}
+
+	mSpeedGovernor.update(mX264, x264_mdate() - startTime);
+}
+
+void EncoderCore::writeEncodedFrame(x264_nal_t* nal, int frameSize, x264_picture_t* picture) {
+	if (mOutputType == kContainerTypeH264) {
+		// Already written slice by slice when nalu_process is set
+		if (!mSliceStreaming) {
+			writeOutput(nal[0].p_payload, frameSize);
+		}
+	} else if (mOutHandle) {
+		mCLIOutput.write_frame(mOutHandle, nal[0].p_payload, frameSize, picture);
+	}
+}
+
+void EncoderCore::naluProcessEntry(x264_t* h, x264_nal_t* nal, void* opaque) {
+	static_cast<EncoderCore*>(opaque)->writeSlice(h, nal);
+}
+
+// Called from inside x264_encoder_encode for every finished NAL.
+// Sliced threads may call this concurrently and out of order; slices are
+// written in macroblock order, so a slice that finishes early is held
+// until the slices before it arrive.
+void EncoderCore::writeSlice(x264_t* h, x264_nal_t* nal) {
+	pthread_mutex_lock(&mSliceLock);
+
+	const size_t required = nal->i_payload * 3 / 2 + 5 + 64;
+	if (mSliceBuffer.size() < required) {
+		mSliceBuffer.resize(required);
+	}
+
+	x264_nal_encode(h, &mSliceBuffer[0], nal);
+
+	const bool isSlice = (nal->i_type == NAL_SLICE || nal->i_type == NAL_SLICE_IDR);
+	if (isSlice && nal->i_first_mb != mNextSliceMB) {
+		PendingSlice& pending = mPendingSlices[nal->i_first_mb];
+		pending.lastMB = nal->i_last_mb;
+		pending.bytes.assign(nal->p_payload, nal->p_payload + nal->i_payload);
+	} else {
+		writeOutput(nal->p_payload, nal->i_payload);
+		if (isSlice) {
+			advanceSlice(nal->i_last_mb, h->mb.i_mb_count);
+		}
+
+		PendingSliceMap::iterator it;
+		while ((it = mPendingSlices.find(mNextSliceMB)) != mPendingSlices.end()) {
+			writeOutput(&it->second.bytes[0], it->second.bytes.size());
+			advanceSlice(it->second.lastMB, h->mb.i_mb_count);
+			mPendingSlices.erase(it);
+		}
+
+		mOutputStaging.flush();
+	}
+
+	pthread_mutex_unlock(&mSliceLock);
+}
+
+void EncoderCore::advanceSlice(int lastMB, int mbCount) {
+	mNextSliceMB = (lastMB + 1 < mbCount) ? (lastMB + 1) : 0;
+}
+
+// Pull out the frames still held by lookahead and B-frame reordering
+void EncoderCore::flushEncoder() {
+	x264_picture_t out_pic;
+	x264_nal_t *nal;
+	int i_nal;
+
+	while (x264_encoder_delayed_frames(mX264)) {
+		const int i_frame_size = x264_encoder_encode(mX264, &nal, &i_nal, NULL, &out_pic);
+		if (i_frame_size < 0) {
+			break;
+		}
+
+		if (i_frame_size) {
+			writeEncodedFrame(nal, i_frame_size, &out_pic);
+		}
+	}
+}
+
+void EncoderCore::finish() {
+	if (mX264) {
+		flushEncoder();
+	}
+
+	close();
+}
+
+void EncoderCore::close() {
+	closeEncoder();
+	closeOutput();
+}
+
+void EncoderCore::closeOutput() {
+	if (mOutHandle) {
+		mCLIOutput.close_file(mOutHandle, mMaxPTS, mSecondPTS);
+		mOutHandle = NULL;
+	}
+
+	if (mOutputOpen) {
+		mOutputOpen = false;
+		mOutputStore.finish();
+		mOutputStaging.flush();
+	}
+}
+
+void EncoderCore::closeEncoder() {
+	if (mX264) {
+		x264_encoder_close(mX264);
+		mX264 = NULL;
+	}
+}
+
+// Container writers see the output store as their file. Finished chunks and,
+// at close, the header patches leave through the staging buffer.
+void EncoderCore::writeOutput(const void *buf, size_t size) {
+	if (isStreamingOutput()) {
+		// Fragments are final once written; stream them as they complete
+		mOutputStaging.write(buf, size);
+	} else {
+		mOutputStore.write(buf, size);
+	}
+}
+
+int EncoderCore::seekOutput(int64_t pos, int seek_origin) {
+	if (mOutputStore.seek(pos, seek_origin) != 0) {
+		puts("** WARNING! bad seek **");
+		return -1;
+	}
+	
+	return 0;
+}
+
+// bridge functions
+size_t mkFlush(const void *buf, size_t size, void* user_data) {
+	EncoderCore* that = static_cast<EncoderCore*>(user_data);
+	that->writeOutput(buf, size);
+	return size;
+}
+
+size_t mkSeek(long pos, void* user_data) {
+	EncoderCore* that = static_cast<EncoderCore*>(user_data);
+	return (size_t)that->seekOutput(pos, SEEK_SET);
+}
+
+int mp4WriteBuffer(void *opaque, uint8_t *buf, int size) {
+	return mkFlush(buf, size, opaque); 
+}
+
+int64_t mp4SeekBuffer(void *opaque, int64_t offset, int whence) {
+	EncoderCore* that = static_cast<EncoderCore*>(opaque);
+	return (int64_t)that->seekOutput(offset, whence);
+}
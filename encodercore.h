@@ -0,0 +1,125 @@
+// nacl264 - x264 on Google Native Client
+// 2014.06 Satoshi Ueyama
+// distributed under GPL
+
+#ifndef ENCODERCORE_H_INCLUDED
+#define ENCODERCORE_H_INCLUDED
+
+#include "colorconv.h"
+#include "outputstaging.h"
+#include "outputstore.h"
+#include "speedgovernor.h"
+#include <pthread.h>
+#include <map>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "common/common.h"
+#include "x264.h"
+#include "x264cli.h"
+#include "output/output.h"
+}
+
+typedef enum {
+	kContainerTypeMKV  = 0,
+	kContainerTypeMP4  = 1,
+	kContainerTypeFMP4 = 2, // fragmented MP4, written front to back
+	kContainerTypeH264 = 3  // raw Annex-B elementary stream
+} ContainerType;
+
+// The encode and mux path without any PPAPI dependency: an x264 encoder
+// and its container output. The output file leaves as write batches
+// through the batch proc (see OutputStagingBuffer).
+// open() and stampFrame() run on the thread that feeds frames; encodeFrame()
+// and finish() on the encoding thread.
+class EncoderCore {
+public:
+	EncoderCore();
+	~EncoderCore();
+
+	static void setDefaultParams(x264_param_t* params);
+	static void applyColorSignalling(x264_param_t* params, ColorMatrix matrix, ColorRange range);
+	static void applyLowLatency(x264_param_t* params);
+	static bool parseContainerType(const char* name, ContainerType* type);
+	// Applies a cpu mask in x264 --asm syntax: "auto", a number, or flag
+	// names such as "SSSE3" or "sse2,avx2". Returns false if it doesn't parse.
+	static bool parseCpuMask(x264_param_t* params, const char* mask);
+	static std::string describeCpu(uint32_t cpu);
+	// Applies x264 options given as "key=value:key=value", e.g.
+	// "me=lowres:subme=4". Returns false at the first one that doesn't parse.
+	static bool parseOptions(x264_param_t* params, const char* options);
+
+	void setBatchProc(OutputBatchProc proc, void* user_data);
+	void configureBatching(size_t maxBytes, int maxLatencyMs);
+	size_t batchBytes() const { return mOutputStaging.maxBytes(); }
+	int batchLatencyMs() const { return mOutputStaging.maxLatencyMs(); }
+
+	// Opens the encoder and writes the stream headers. params receives the
+	// values the encoder actually uses.
+	bool open(x264_param_t* params, ContainerType type, bool lowLatency);
+	bool isOpen() const { return mX264 != NULL; }
+	// The implementation each DSP table slot resolved to; taken at open()
+	const std::vector<x264_kernel_info_t>& kernelReport() const { return mKernelReport; }
+	uint32_t cpuFlags() const { return mCpuFlags; }
+	// Adapts the analysis settings to keep up with fps frames a second;
+	// 0 (the default) encodes with the opened settings throughout.
+	// Takes effect at the next open().
+	void setSpeedTarget(double fps) { mSpeedGovernor.setTargetFps(fps); }
+	const SpeedGovernor& speedGovernor() const { return mSpeedGovernor; }
+	void stampFrame(x264_picture_t* picture);
+	void encodeFrame(x264_picture_t* picture);
+	// Drains delayed frames, then closes the encoder and finishes the file
+	void finish();
+	// Closes without draining
+	void close();
+
+	// Container writer bridges
+	void writeOutput(const void *buf, size_t size);
+	int seekOutput(int64_t pos, int seek_origin);
+protected:
+	x264_t* mX264;
+	hnd_t mOutHandle;
+	cli_output_t mCLIOutput;
+	ContainerType mOutputType;
+	bool mOutputOpen;
+	bool mLowLatency;
+	bool mSliceStreaming; // nalu_process writes the stream
+
+	uint32_t mCpuFlags;
+	std::vector<x264_kernel_info_t> mKernelReport;
+	SpeedGovernor mSpeedGovernor;
+
+	int mNextPTS;
+	int mMaxPTS;
+	int mSecondPTS;
+
+	// Sliced threads finish slices in any order; a slice waits here until
+	// every slice before it in the frame has been written
+	typedef struct {
+		int lastMB;
+		std::vector<uint8_t> bytes;
+	} PendingSlice;
+	typedef std::map<int, PendingSlice> PendingSliceMap; // keyed by first MB
+	std::vector<uint8_t> mSliceBuffer;
+	PendingSliceMap mPendingSlices;
+	int mNextSliceMB;
+	pthread_mutex_t mSliceLock;
+
+	// The store resolves seeks, the staging buffer batches what the store
+	// exports before it leaves through the batch proc
+	OutputStore mOutputStore;
+	OutputStagingBuffer mOutputStaging;
+
+	bool openOutput();
+	void closeOutput();
+	void closeEncoder();
+	void flushEncoder();
+	bool isStreamingOutput() const { return mOutputType == kContainerTypeFMP4 || mOutputType == kContainerTypeH264; }
+	void writeEncodedFrame(x264_nal_t* nal, int frameSize, x264_picture_t* picture);
+	static void naluProcessEntry(x264_t* h, x264_nal_t* nal, void* opaque);
+	void writeSlice(x264_t* h, x264_nal_t* nal);
+	void advanceSlice(int lastMB, int mbCount);
+};
+
+#endif
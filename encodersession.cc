@@ -0,0 +1,518 @@
+// nacl264 - x264 on Google Native Client
+// 2014.06 Satoshi Ueyama
+// distributed under GPL
+
+#include "encodersession.h"
+
+static void postOutputBatch(const uint8_t* data, size_t size, const OutputPatch* patches, int nPatches, void* user_data);
+
+// x264 Binding - - - - - - - -
+EncoderSession::EncoderSession(pp::Instance* instance, int sessionId) : 
+	mInstance(instance),
+	mSessionId(sessionId),
+	mContainerType(kContainerTypeMKV),
+	mLowLatency(false),
+	mSpeedTarget(0),
+	mQueueDepth(4),
+	mEncoderThreadStarted(false),
+	mAcceptingFrames(false) {
+	EncoderCore::setDefaultParams(&mEncoderParams);
+	EncoderCore::applyColorSignalling(&mEncoderParams, mColorConverter.matrix(), mColorConverter.range());
+	mCore.setBatchProc(postOutputBatch, this);
+}
+		
+EncoderSession::~EncoderSession() {
+	if (mEncoderThreadStarted) {
+		mFrameQueue.pushEnd();
+	}
+
+	joinEncoderThread();
+	releaseHeldFrames();
+	mCore.close();
+}
+
+void EncoderSession::handleCommand(const std::string& cmdName, const pp::VarDictionary& msg_dic) {
+	if (cmdName.compare("set-params") == 0) {
+		if (msg_dic.HasKey("params")) {
+			pp::Var vParams = msg_dic.Get("params");
+			pp::VarDictionary dicParams(vParams);
+			
+			doSetParamsCommand(dicParams);
+		}
+	} else if (cmdName.compare("open-encoder") == 0) {
+		doOpenEncoderCommand();
+	} else if (cmdName.compare("close-encoder") == 0) {
+		doCloseEncoderCommand();
+	} else if (cmdName.compare("send-frame") == 0) {
+		pp::Var vFrame = msg_dic.Get("frame");
+		pp::Var vFormat = msg_dic.Get("format");
+		if (vFrame.is_array_buffer()) {
+			pp::VarArrayBuffer ab(vFrame);
+			doSendFrameCommand(ab, parsePixelFormat(vFormat), msg_dic);
+		}
+	} else if (cmdName.compare("get-kernels") == 0) {
+		doGetKernelsCommand();
+	} else if (cmdName.compare("set-output-type") == 0) {
+		pp::Var vType = msg_dic.Get("type");
+		if (vType.is_string()) {
+			doSetOutputTypeCommand(vType);
+		}
+	}
+}
+
+// Set encoder parameters (Overwrite default if entry exists)
+void EncoderSession::doSetParamsCommand(pp::VarDictionary& dicParams) {
+	puts("set-params");
+	if (dicParams.HasKey("fps")) {
+		pp::Var v = dicParams.Get("fps");
+		if (v.is_int()) {
+			mEncoderParams.i_fps_num = v.AsInt();
+			printf("  fps:%d\n", v.AsInt());
+		}
+	}
+
+	if (dicParams.HasKey("width")) {
+		pp::Var v = dicParams.Get("width");
+		if (v.is_int()) {
+			mEncoderParams.i_width = v.AsInt();
+			printf("  width:%d\n", v.AsInt());
+		}
+	}
+
+	if (dicParams.HasKey("height")) {
+		pp::Var v = dicParams.Get("height");
+		if (v.is_int()) {
+			mEncoderParams.i_height = v.AsInt();
+			printf("  height:%d\n", v.AsInt());
+		}
+	}
+
+	if (dicParams.HasKey("queueDepth")) {
+		pp::Var v = dicParams.Get("queueDepth");
+		if (v.is_int() && v.AsInt() > 0) {
+			mQueueDepth = v.AsInt();
+			printf("  queueDepth:%d\n", v.AsInt());
+		}
+	}
+
+	if (dicParams.HasKey("lowLatency")) {
+		pp::Var v = dicParams.Get("lowLatency");
+		if (v.is_bool()) {
+			mLowLatency = v.AsBool();
+			printf("  lowLatency:%d\n", mLowLatency ? 1 : 0);
+			if (mLowLatency) {
+				EncoderCore::applyLowLatency(&mEncoderParams);
+			}
+		}
+	}
+
+	if (dicParams.HasKey("sliceMaxSize")) {
+		pp::Var v = dicParams.Get("sliceMaxSize");
+		if (v.is_int() && v.AsInt() >= 0) {
+			mEncoderParams.i_slice_max_size = v.AsInt();
+			printf("  sliceMaxSize:%d\n", v.AsInt());
+		}
+	}
+
+	// 0 lets x264 pick from the processor count
+	if (dicParams.HasKey("threads")) {
+		pp::Var v = dicParams.Get("threads");
+		if (v.is_int() && v.AsInt() >= 0) {
+			mEncoderParams.i_threads = v.AsInt();
+			printf("  threads:%d\n", v.AsInt());
+		}
+	}
+
+	if (dicParams.HasKey("lookaheadThreads")) {
+		pp::Var v = dicParams.Get("lookaheadThreads");
+		if (v.is_int() && v.AsInt() >= 0) {
+			mEncoderParams.i_lookahead_threads = v.AsInt();
+			printf("  lookaheadThreads:%d\n", v.AsInt());
+		}
+	}
+
+	if (dicParams.HasKey("deblockThread")) {
+		pp::Var v = dicParams.Get("deblockThread");
+		if (v.is_bool()) {
+			mEncoderParams.b_deblock_thread = v.AsBool();
+			printf("  deblockThread:%d\n", v.AsBool());
+		}
+	}
+
+	// x264 --asm syntax ("auto", "SSSE3", "sse2,avx2") or a raw flag mask;
+	// 0 runs the C kernels only. Flags the cpu lacks are dropped at open.
+	if (dicParams.HasKey("cpu")) {
+		pp::Var v = dicParams.Get("cpu");
+		if (v.is_int() && v.AsInt() >= 0) {
+			mEncoderParams.cpu = v.AsInt();
+			printf("  cpu:0x%x\n", v.AsInt());
+		} else if (v.is_string()) {
+			if (EncoderCore::parseCpuMask(&mEncoderParams, v.AsString().c_str())) {
+				printf("  cpu:%s\n", v.AsString().c_str());
+			} else {
+				printf("  Error: bad cpu mask '%s'\n", v.AsString().c_str());
+			}
+		}
+	}
+
+	// x264 options as "key=value:key=value" ("me=lowres:subme=4"), applied
+	// over the preset and anything set before
+	if (dicParams.HasKey("x264opts")) {
+		pp::Var v = dicParams.Get("x264opts");
+		if (v.is_string() && EncoderCore::parseOptions(&mEncoderParams, v.AsString().c_str())) {
+			printf("  x264opts:%s\n", v.AsString().c_str());
+		}
+	}
+
+	// Frames a second the encode has to keep up with; the analysis settings
+	// are lowered while it falls behind. 0 turns it off. Takes effect at
+	// the next open-encoder.
+	if (dicParams.HasKey("speedTarget")) {
+		pp::Var v = dicParams.Get("speedTarget");
+		if (v.is_number() && v.AsDouble() >= 0) {
+			mSpeedTarget = v.AsDouble();
+			printf("  speedTarget:%.2f\n", v.AsDouble());
+		}
+	}
+
+	if (dicParams.HasKey("outputBatchBytes") || dicParams.HasKey("outputBatchMs")) {
+		size_t maxBytes = mCore.batchBytes();
+		int maxLatencyMs = mCore.batchLatencyMs();
+
+		pp::Var vBytes = dicParams.Get("outputBatchBytes");
+		if (vBytes.is_int() && vBytes.AsInt() > 0) {
+			maxBytes = (size_t)vBytes.AsInt();
+			printf("  outputBatchBytes:%d\n", vBytes.AsInt());
+		}
+
+		pp::Var vMs = dicParams.Get("outputBatchMs");
+		if (vMs.is_int() && vMs.AsInt() >= 0) {
+			maxLatencyMs = vMs.AsInt();
+			printf("  outputBatchMs:%d\n", vMs.AsInt());
+		}
+
+		mCore.configureBatching(maxBytes, maxLatencyMs);
+	}
+
+	if (dicParams.HasKey("colorMatrix") || dicParams.HasKey("colorRange")) {
+		ColorMatrix matrix = mColorConverter.matrix();
+		ColorRange range = mColorConverter.range();
+
+		pp::Var vMatrix = dicParams.Get("colorMatrix");
+		if (vMatrix.is_string()) {
+			matrix = (vMatrix.AsString().compare("bt709") == 0) ? kColorMatrixBT709 : kColorMatrixBT601;
+			printf("  colorMatrix:%s\n", vMatrix.AsString().c_str());
+		}
+
+		pp::Var vRange = dicParams.Get("colorRange");
+		if (vRange.is_string()) {
+			range = (vRange.AsString().compare("full") == 0) ? kColorRangeFull : kColorRangeLimited;
+			printf("  colorRange:%s\n", vRange.AsString().c_str());
+		}
+
+		mColorConverter.setMatrix(matrix, range);
+		EncoderCore::applyColorSignalling(&mEncoderParams, matrix, range);
+	}
+}
+
+// Posts 'kernels': the cpu flags the open encoder runs with and, for every
+// DSP table slot, the instruction set of the implementation it picked
+// ({"pixel.satd[0]": "sse2", ...}). Both are empty before the first open.
+void EncoderSession::doGetKernelsCommand() {
+	pp::VarDictionary kernels;
+	const std::vector<x264_kernel_info_t>& report = mCore.kernelReport();
+	for (size_t i = 0;i < report.size();++i) {
+		kernels.Set( pp::Var(report[i].name) , pp::Var(report[i].impl) );
+	}
+
+	pp::VarDictionary msg;
+	msg.Set( pp::Var("type") , pp::Var("kernels") );
+	msg.Set( pp::Var("cpu") , pp::Var(EncoderCore::describeCpu(mCore.cpuFlags())) );
+	msg.Set( pp::Var("kernels") , kernels );
+
+	postMessage(msg);
+}
+
+void EncoderSession::doSetOutputTypeCommand(const pp::Var& vstrType) {
+	const std::string& s = vstrType.AsString();
+	if (!EncoderCore::parseContainerType(s.c_str(), &mContainerType)) {
+		mContainerType = kContainerTypeMKV;
+	}
+
+	printf("Change container type to '%s'\n", s.c_str());
+}
+
+// Frame format of send-frame; 'rgb' when omitted
+PixelFormat EncoderSession::parsePixelFormat(const pp::Var& vstrFormat) {
+	PixelFormat format = kPixelFormatRGB;
+	if (vstrFormat.is_string()) {
+		ColorConverter::parsePixelFormat(vstrFormat.AsString().c_str(), &format);
+	}
+
+	return format;
+}
+
+static void readPlaneValues(const pp::Var& vArray, uint32_t* values) {
+	if (vArray.is_array()) {
+		pp::VarArray arr(vArray);
+		const uint32_t n = arr.GetLength();
+		for (uint32_t i = 0;i < n && i < 3;++i) {
+			pp::Var v = arr.Get(i);
+			if (v.is_int()) {
+				values[i] = v.AsInt();
+			}
+		}
+	}
+}
+
+// Tightly packed planes, in the order the format defines them
+void EncoderSession::makeDefaultPlaneLayout(PixelFormat format, FramePlaneLayout* layout) const {
+	const uint32_t w = mEncoderParams.i_width;
+	const uint32_t h = mEncoderParams.i_height;
+	memset(layout, 0, sizeof(FramePlaneLayout));
+
+	if (ColorConverter::isPacked(format)) {
+		layout->strides[0] = w * ColorConverter::bytesPerPixel(format);
+	} else if (format == kPixelFormatNV12) {
+		layout->strides[0] = w;
+		layout->strides[1] = w;
+		layout->offsets[1] = w * h;
+	} else {
+		layout->strides[0] = w;
+		layout->strides[1] = layout->strides[2] = w >> 1;
+		layout->offsets[1] = w * h;
+		layout->offsets[2] = w * h + (w >> 1) * (h >> 1);
+	}
+}
+
+bool EncoderSession::validatePlaneLayout(PixelFormat format, const FramePlaneLayout& layout, uint32_t byteLength) const {
+	const uint32_t w = mEncoderParams.i_width;
+	const uint32_t h = mEncoderParams.i_height;
+	const int nPlanes = ColorConverter::isPacked(format) ? 1 : (format == kPixelFormatNV12) ? 2 : 3;
+
+	for (int i = 0;i < nPlanes;++i) {
+		const uint32_t rowBytes = ColorConverter::isPacked(format) ? (w * ColorConverter::bytesPerPixel(format)) :
+		                          (i == 0 || format == kPixelFormatNV12) ? w : (w >> 1);
+		const uint32_t rows = i ? (h >> 1) : h;
+		if (layout.strides[i] < rowBytes) {
+			return false;
+		}
+
+		const uint64_t end = (uint64_t)layout.offsets[i] + (uint64_t)layout.strides[i] * (rows - 1) + rowBytes;
+		if (end > byteLength) {
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+// message may carry 'strides' and 'offsets' arrays (one entry per plane);
+// missing entries mean tightly packed planes.
+void EncoderSession::doSendFrameCommand(pp::VarArrayBuffer& abPictureFrame, PixelFormat format, const pp::VarDictionary& msg_dic) {
+	FramePlaneLayout layout;
+	makeDefaultPlaneLayout(format, &layout);
+	readPlaneValues(msg_dic.Get("strides"), layout.strides);
+	readPlaneValues(msg_dic.Get("offsets"), layout.offsets);
+
+	if (!validatePlaneLayout(format, layout, abPictureFrame.ByteLength())) {
+		puts("Error: frame buffer does not match its plane layout");
+		return;
+	}
+	
+	if (!mAcceptingFrames) {
+		puts("Error: encoder is not open");
+		return;
+	}
+	
+	// Blocks only if the page sends more frames than it has credits for
+	const int slot = mFrameQueue.acquire();
+	x264_picture_t* picture = mFrameQueue.picture(slot);
+	releaseHeldFrame(slot);
+
+	const unsigned char* p = (const unsigned char*) abPictureFrame.Map();
+	if (ColorConverter::isPacked(format)) {
+		puts("Convert RGB->YUV");
+		mFrameQueue.restoreOwnedPlanes(slot);
+		x264_image_t* outImage = &picture->img;
+		mColorConverter.convert(format, p + layout.offsets[0], layout.strides[0],
+		                        mEncoderParams.i_width, mEncoderParams.i_height,
+		                        outImage->plane, outImage->i_stride);
+		abPictureFrame.Unmap();
+	} else {
+		// Keep the buffer mapped until the slot comes back around
+		setExternalPlanes(picture, p, format, layout);
+		mHeldFrames[slot] = abPictureFrame;
+	}
+	
+	enqueueFrame(slot);
+}
+
+// YUV frames are referenced in place; x264_encoder_encode copies them into
+// its own frame exactly once.
+void EncoderSession::setExternalPlanes(x264_picture_t* picture, const unsigned char* p, PixelFormat format, const FramePlaneLayout& layout) {
+	picture->img.i_csp = (format == kPixelFormatNV12) ? X264_CSP_NV12 : X264_CSP_I420;
+	picture->img.i_plane = (format == kPixelFormatNV12) ? 2 : 3;
+	for (int i = 0;i < picture->img.i_plane;++i) {
+		picture->img.plane[i] = const_cast<uint8_t*>(p) + layout.offsets[i];
+		picture->img.i_stride[i] = layout.strides[i];
+	}
+}
+
+// A free slot is no longer read by the encoder thread, so its buffer can go
+void EncoderSession::releaseHeldFrame(int slot) {
+	pp::VarArrayBuffer& held = mHeldFrames[slot];
+	if (held.ByteLength()) {
+		held.Unmap();
+		held = pp::VarArrayBuffer();
+	}
+}
+
+void EncoderSession::releaseHeldFrames() {
+	for (size_t i = 0;i < mHeldFrames.size();++i) {
+		releaseHeldFrame(i);
+	}
+
+	mHeldFrames.clear();
+}
+
+void EncoderSession::enqueueFrame(int slot) {
+	mCore.stampFrame(mFrameQueue.picture(slot));
+	mFrameQueue.push(slot);
+}
+
+void* EncoderSession::encoderThreadEntry(void* session) {
+	static_cast<EncoderSession*>(session)->runEncoderThread();
+	return NULL;
+}
+
+// Drains the queue until close-encoder, then finishes the stream
+void EncoderSession::runEncoderThread() {
+	for (;;) {
+		const int slot = mFrameQueue.pop();
+		if (slot < 0) {
+			break;
+		}
+
+		mCore.encodeFrame(mFrameQueue.picture(slot));
+		mFrameQueue.recycle(slot);
+		notifyFrameDone();
+	}
+
+	mCore.finish();
+	notifyEncoderClosed();
+}
+
+void EncoderSession::joinEncoderThread() {
+	if (mEncoderThreadStarted) {
+		pthread_join(mEncoderThread, NULL);
+		mEncoderThreadStarted = false;
+	}
+}
+
+// Called from the module thread and the encoder thread
+void EncoderSession::postMessage(pp::VarDictionary& msg) {
+	msg.Set( pp::Var("session") , pp::Var(mSessionId) );
+	mInstance->PostMessage(msg);
+}
+
+// Each finished frame returns one credit to the page
+void EncoderSession::notifyFrameDone() {
+	pp::VarDictionary msg;
+	msg.Set( pp::Var("type") , pp::Var("encode-frame-done") );
+	msg.Set( pp::Var("credits") , pp::Var(1) );
+	if (mCore.speedGovernor().isEnabled()) {
+		msg.Set( pp::Var("speedLevel") , pp::Var(mCore.speedGovernor().level()) );
+	}
+	
+	postMessage(msg);
+}
+
+void EncoderSession::notifyEncoderOpened() {
+	pp::VarDictionary msg;
+	msg.Set( pp::Var("type") , pp::Var("encoder-opened") );
+	msg.Set( pp::Var("credits") , pp::Var(mFrameQueue.capacity()) );
+	
+	postMessage(msg);
+}
+
+void EncoderSession::notifyEncoderClosed() {
+	pp::VarDictionary msg;
+	msg.Set( pp::Var("type") , pp::Var("encoder-closed") );
+	
+	postMessage(msg);
+}
+
+void EncoderSession::doOpenEncoderCommand() {
+	mAcceptingFrames = false;
+
+	// Let a session that was never closed finish first
+	if (mEncoderThreadStarted) {
+		mFrameQueue.pushEnd();
+	}
+
+	joinEncoderThread();
+	releaseHeldFrames();
+
+	mCore.setSpeedTarget(mSpeedTarget);
+	if (!mCore.open(&mEncoderParams, mContainerType, mLowLatency)) {
+		return;
+	}
+
+	if (!mFrameQueue.allocate(mQueueDepth, mEncoderParams.i_width, mEncoderParams.i_height)) {
+		puts("Error: failed to allocate frame queue");
+		mCore.close();
+		return;
+	}
+
+	mHeldFrames.resize(mQueueDepth);
+
+	if (pthread_create(&mEncoderThread, NULL, encoderThreadEntry, this) != 0) {
+		puts("Error: failed to start encoder thread");
+		releaseHeldFrames();
+		mCore.close();
+		return;
+	}
+
+	mEncoderThreadStarted = true;
+	mAcceptingFrames = true;
+	notifyEncoderOpened();
+}
+
+// The encoder thread drains the queued frames, finishes the file and
+// posts encoder-closed.
+void EncoderSession::doCloseEncoderCommand() {
+	if (mAcceptingFrames) {
+		mAcceptingFrames = false;
+		mFrameQueue.pushEnd();
+	}
+}
+
+// One message per batch:
+//  content: the patches' bytes back to back
+//  patches: [position0, length0, position1, length1, ...]
+void EncoderSession::postBatch(const uint8_t* data, size_t size, const OutputPatch* patches, int nPatches) {
+	pp::VarArrayBuffer ab((uint32_t)size);
+	unsigned char* pWrite = static_cast<unsigned char*>(ab.Map());
+	memcpy(pWrite, data, size);
+	ab.Unmap();
+
+	pp::VarArray patchList;
+	patchList.SetLength(nPatches * 2);
+	for (int i = 0;i < nPatches;++i) {
+		// positions may exceed int32 range
+		patchList.Set(i*2    , pp::Var((double)patches[i].position) );
+		patchList.Set(i*2 + 1, pp::Var((int32_t)patches[i].length) );
+	}
+
+	pp::VarDictionary dic;
+	dic.Set( pp::Var("content"), ab );
+	dic.Set( pp::Var("patches"), patchList );
+	dic.Set( pp::Var("type"), pp::Var("write-batch") );
+	postMessage(dic);
+}
+
+void postOutputBatch(const uint8_t* data, size_t size, const OutputPatch* patches, int nPatches, void* user_data) {
+	EncoderSession* that = static_cast<EncoderSession*>(user_data);
+	that->postBatch(data, size, patches, nPatches);
+}
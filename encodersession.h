@@ -0,0 +1,87 @@
+// nacl264 - x264 on Google Native Client
+// 2014.06 Satoshi Ueyama
+// distributed under GPL
+
+#ifndef ENCODERSESSION_H_INCLUDED
+#define ENCODERSESSION_H_INCLUDED
+
+#include "ppapi/cpp/instance.h"
+#include "ppapi/cpp/var.h"
+#include "ppapi/cpp/var_dictionary.h"
+#include "ppapi/cpp/var_array.h"
+#include "ppapi/cpp/var_array_buffer.h"
+#include "colorconv.h"
+#include "encodercore.h"
+#include "framequeue.h"
+#include <pthread.h>
+#include <vector>
+
+// Where each plane of an incoming frame lives inside its ArrayBuffer
+typedef struct {
+	uint32_t offsets[3];
+	uint32_t strides[3];
+} FramePlaneLayout;
+
+// One encode: an EncoderCore fed by a frame queue and its encoder thread.
+// Commands arrive on the module thread; every message the session posts
+// carries its id.
+class EncoderSession {
+public:
+	EncoderSession(pp::Instance* instance, int sessionId);
+	~EncoderSession();
+
+	int sessionId() const { return mSessionId; }
+	void handleCommand(const std::string& cmdName, const pp::VarDictionary& msg_dic);
+	
+	void postBatch(const uint8_t* data, size_t size, const OutputPatch* patches, int nPatches);
+protected:
+	pp::Instance* mInstance;
+	const int mSessionId;
+	
+	ContainerType mContainerType;
+	bool mLowLatency;
+	// Handed to mCore at open-encoder, before the encoder thread starts
+	double mSpeedTarget;
+	x264_param_t mEncoderParams;
+	ColorConverter mColorConverter;
+	EncoderCore mCore;
+
+	// Frames are converted on the module thread and encoded on mEncoderThread.
+	// The page may keep up to mQueueDepth frames in flight (one credit each).
+	FrameQueue mFrameQueue;
+	int mQueueDepth;
+	pthread_t mEncoderThread;
+	bool mEncoderThreadStarted;
+	// Between open-encoder and close-encoder; the thread may still be
+	// draining after close, but takes no more frames
+	bool mAcceptingFrames;
+	// ArrayBuffers whose planes a queue slot points to (module thread only)
+	std::vector<pp::VarArrayBuffer> mHeldFrames;
+	
+	void doSetParamsCommand(pp::VarDictionary& dicParams);
+	void doOpenEncoderCommand();
+	void doCloseEncoderCommand();
+	void doSendFrameCommand(pp::VarArrayBuffer& abPictureFrame, PixelFormat format, const pp::VarDictionary& msg_dic);
+	void doSetOutputTypeCommand(const pp::Var& vstrType);
+	void doGetKernelsCommand();
+	static PixelFormat parsePixelFormat(const pp::Var& vstrFormat);
+	
+	void enqueueFrame(int slot);
+	void makeDefaultPlaneLayout(PixelFormat format, FramePlaneLayout* layout) const;
+	bool validatePlaneLayout(PixelFormat format, const FramePlaneLayout& layout, uint32_t byteLength) const;
+	void setExternalPlanes(x264_picture_t* picture, const unsigned char* p, PixelFormat format, const FramePlaneLayout& layout);
+	void releaseHeldFrame(int slot);
+	void releaseHeldFrames();
+
+	// Encoder thread
+	static void* encoderThreadEntry(void* session);
+	void runEncoderThread();
+	void joinEncoderThread();
+	
+	void postMessage(pp::VarDictionary& msg);
+	void notifyEncoderOpened();
+	void notifyFrameDone();
+	void notifyEncoderClosed();
+};
+
+#endif
@@ -0,0 +1,117 @@
+// nacl264 - x264 on Google Native Client
+// 2014.06 Satoshi Ueyama
+// distributed under GPL
+
+#include "framequeue.h"
+
+FrameQueue::FrameQueue() :
+	mFilledHead(0),
+	mFilledCount(0),
+	mEnded(false) {
+	pthread_mutex_init(&mMutex, NULL);
+	pthread_cond_init(&mCond, NULL);
+}
+
+FrameQueue::~FrameQueue() {
+	release();
+	pthread_cond_destroy(&mCond);
+	pthread_mutex_destroy(&mMutex);
+}
+
+bool FrameQueue::allocate(int capacity, int width, int height) {
+	release();
+
+	mSlots.resize(capacity);
+	for (int i = 0;i < capacity;++i) {
+		FrameSlot& slot = mSlots[i];
+		x264_picture_init(&slot.picture);
+		if (x264_picture_alloc(&slot.picture, X264_CSP_I420, width, height) < 0) {
+			mSlots.resize(i);
+			release();
+			return false;
+		}
+
+		slot.ownedImage = slot.picture.img;
+	}
+
+	mFreeSlots.clear();
+	for (int i = capacity - 1;i >= 0;--i) {
+		mFreeSlots.push_back(i);
+	}
+
+	mFilledRing.assign(capacity, -1);
+	mFilledHead = 0;
+	mFilledCount = 0;
+	mEnded = false;
+	return true;
+}
+
+void FrameQueue::release() {
+	for (size_t i = 0;i < mSlots.size();++i) {
+		restoreOwnedPlanes(i);
+		x264_picture_clean(&mSlots[i].picture);
+	}
+
+	mSlots.clear();
+	mFreeSlots.clear();
+	mFilledRing.clear();
+	mFilledHead = 0;
+	mFilledCount = 0;
+}
+
+void FrameQueue::restoreOwnedPlanes(int slot) {
+	mSlots[slot].picture.img = mSlots[slot].ownedImage;
+}
+
+// Blocks while every slot is in flight
+int FrameQueue::acquire() {
+	pthread_mutex_lock(&mMutex);
+	while (mFreeSlots.empty()) {
+		pthread_cond_wait(&mCond, &mMutex);
+	}
+
+	const int slot = mFreeSlots.back();
+	mFreeSlots.pop_back();
+	pthread_mutex_unlock(&mMutex);
+	return slot;
+}
+
+void FrameQueue::push(int slot) {
+	pthread_mutex_lock(&mMutex);
+	mFilledRing[(mFilledHead + mFilledCount) % mFilledRing.size()] = slot;
+	++mFilledCount;
+	pthread_cond_broadcast(&mCond);
+	pthread_mutex_unlock(&mMutex);
+}
+
+void FrameQueue::pushEnd() {
+	pthread_mutex_lock(&mMutex);
+	mEnded = true;
+	pthread_cond_broadcast(&mCond);
+	pthread_mutex_unlock(&mMutex);
+}
+
+// Frames queued before pushEnd() are still returned
+int FrameQueue::pop() {
+	pthread_mutex_lock(&mMutex);
+	while (mFilledCount == 0 && !mEnded) {
+		pthread_cond_wait(&mCond, &mMutex);
+	}
+
+	int slot = -1;
+	if (mFilledCount > 0) {
+		slot = mFilledRing[mFilledHead];
+		mFilledHead = (mFilledHead + 1) % mFilledRing.size();
+		--mFilledCount;
+	}
+
+	pthread_mutex_unlock(&mMutex);
+	return slot;
+}
+
+void FrameQueue::recycle(int slot) {
+	pthread_mutex_lock(&mMutex);
+	mFreeSlots.push_back(slot);
+	pthread_cond_broadcast(&mCond);
+	pthread_mutex_unlock(&mMutex);
+}
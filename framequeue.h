@@ -0,0 +1,58 @@
+// nacl264 - x264 on Google Native Client
+// 2014.06 Satoshi Ueyama
+// distributed under GPL
+
+#ifndef FRAMEQUEUE_H_INCLUDED
+#define FRAMEQUEUE_H_INCLUDED
+
+#include <pthread.h>
+#include <stdint.h>
+#include <vector>
+
+extern "C" {
+#include "x264.h"
+}
+
+// Bounded ring of preallocated pictures shared by the module thread (producer)
+// and the encoder thread (consumer).
+//
+//   producer: acquire() -> fill picture(slot) -> push(slot)
+//   consumer: pop() -> encode picture(slot) -> recycle(slot)
+class FrameQueue {
+public:
+	FrameQueue();
+	~FrameQueue();
+
+	bool allocate(int capacity, int width, int height);
+	void release();
+	int capacity() const { return (int)mSlots.size(); }
+
+	x264_picture_t* picture(int slot) { return &mSlots[slot].picture; }
+	// Point the slot back at its own I420 planes (after external planes were used)
+	void restoreOwnedPlanes(int slot);
+
+	// Producer side
+	int acquire();
+	void push(int slot);
+	void pushEnd();
+
+	// Consumer side. pop() returns -1 once the end marker is reached.
+	int pop();
+	void recycle(int slot);
+protected:
+	typedef struct {
+		x264_picture_t picture;
+		x264_image_t ownedImage;
+	} FrameSlot;
+
+	pthread_mutex_t mMutex;
+	pthread_cond_t mCond;
+	std::vector<FrameSlot> mSlots;
+	std::vector<int> mFreeSlots;
+	std::vector<int> mFilledRing;
+	int mFilledHead;
+	int mFilledCount;
+	bool mEnded;
+};
+
+#endif
@@ -0,0 +1,52 @@
+# Native host build of the encoder core (everything except the PPAPI
+# module glue) for running and profiling the encode path on Linux.
+#
+#   make -f host.mk          # out/host/libnacl264.a and the tools
+#   make -f host.mk clean
+#
+# out/host/nacl264_host feeds raw RGB/YUV files through the same
+# conversion, encode and mux path as the module. Unlike the NaCl build,
+# the host build encodes with x264 threads and picks SSE2/SSSE3/AVX2 DSP
+# kernels at runtime (see x264/config.h); out/host/checkasm checks them
+# against the C versions.
+
+include sources.mk
+
+OUTDIR = out/host
+OBJDIR = $(OUTDIR)/obj
+
+HOST_CFLAGS = -O2 -g -Wall -I. -I./x264 -I./lsmash -DLSMASH_DEMUXER_ENABLED
+HOST_LIBS = -lpthread -lm
+
+LIB = $(OUTDIR)/libnacl264.a
+TOOLS = $(OUTDIR)/nacl264_host \
+        $(OUTDIR)/colorconv_bench \
+        $(OUTDIR)/threadpool_bench \
+        $(OUTDIR)/checkasm
+
+LIB_OBJS = $(addprefix $(OBJDIR)/,$(patsubst %.cc,%.o,$(patsubst %.c,%.o,$(CORE_SRC) $(X264_SRC) $(X264_THREAD_SRC) $(X264_X86_SRC) $(LSMASH_SRC))))
+
+.PHONY: all clean
+# keep the tool objects make would treat as intermediate
+.SECONDARY:
+all: $(LIB) $(TOOLS)
+
+$(OBJDIR)/%.o: %.c
+	@mkdir -p $(dir $@)
+	$(CC) $(HOST_CFLAGS) -MMD -MP -c $< -o $@
+
+$(OBJDIR)/%.o: %.cc
+	@mkdir -p $(dir $@)
+	$(CXX) $(HOST_CFLAGS) -MMD -MP -c $< -o $@
+
+$(LIB): $(LIB_OBJS)
+	@mkdir -p $(dir $@)
+	$(AR) rcs $@ $^
+
+$(OUTDIR)/%: $(OBJDIR)/tools/%.o $(LIB)
+	$(CXX) $< $(LIB) $(HOST_LIBS) -o $@
+
+clean:
+	rm -rf $(OUTDIR)
+
+-include $(LIB_OBJS:.o=.d) $(patsubst $(OUTDIR)/%,$(OBJDIR)/tools/%.d,$(TOOLS))
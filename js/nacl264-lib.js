@@ -5,11 +5,20 @@
 (function(aGlobal) {
 	'use strict';
 
+	// encoder-opened and encode-frame-done carry 'credits':
+	// the number of additional frames the page may send. With the
+	// speedTarget param encode-frame-done also carries 'speedLevel',
+	// 0 (the opened settings) up to 4 (the cheapest analysis).
+	// write-batch carries 'content' and 'patches' ([position, length, ...]);
+	// see ExpandableBuffer.writeBatch.
+	// kernels answers get-kernels: 'cpu' (flag names) and 'kernels'
+	// ({"pixel.satd[0]": "sse2", ...}) for the last opened encoder.
 	var IncomingMessageTypes = {
+		EncoderOpened: 'encoder-opened',
 		EncodeFrameDone: 'encode-frame-done',
-		SendBufferedData: 'send-buffered-data',
-		SeekBuffer: 'seek-buffer',
-		EncoderClosed: 'encoder-closed'
+		WriteBatch: 'write-batch',
+		EncoderClosed: 'encoder-closed',
+		Kernels: 'kernels'
 	};
 
 	var OutgoingMessageTypes = {
@@ -17,55 +26,95 @@
 		OpenEncoder: 'open-encoder',
 		CloseEncoder: 'close-encoder',
 		SendFrame: 'send-frame',
-		SetOutputType: 'set-output-type'
+		SetOutputType: 'set-output-type',
+		GetKernels: 'get-kernels',
+		DestroySession: 'destroy-session'
+	};
+
+	// Containers accepted by set-output-type.
+	// FMP4 and H264 output is never rewritten: every write-batch appends to
+	// the file, so it can be fed to a MediaSource or uploaded while encoding.
+	// H264 is a raw Annex-B stream; with the lowLatency param each slice is
+	// posted in its own write-batch as soon as it is encoded.
+	var OutputTypes = {
+		MKV: 'mkv',
+		MP4: 'mp4',
+		FMP4: 'fmp4',
+		H264: 'h264'
+	};
+
+	// Frame layouts accepted by send-frame
+	var PixelFormats = {
+		RGB: 'rgb',
+		RGBA: 'rgba',
+		BGRA: 'bgra',
+		I420: 'i420',
+		NV12: 'nv12'
 	};
 
 
-	function nacl264_setEncoderParams(module, params) {
-		module.postMessage({
+	// Every function takes an optional session id (0 when omitted).
+	// One module runs any number of independent encodes; messages from the
+	// module carry the 'session' they belong to.
+	function postToSession(module, msg, session) {
+		if (session !== undefined) {
+			msg.session = session | 0;
+		}
+		
+		module.postMessage(msg);
+	}
+
+	function nacl264_setEncoderParams(module, params, session) {
+		postToSession(module, {
 			command: OutgoingMessageTypes.SetParams,
 			params: params
-		});
+		}, session);
+	}
+
+	function nacl264_setOutputType(module, typeString, session) {
+		postToSession(module, {command: OutgoingMessageTypes.SetOutputType, type: typeString}, session);
 	}
 
-	function nacl264_setOutputType(module, typeString) {
-		module.postMessage({command: OutgoingMessageTypes.SetOutputType, type: typeString});
+	function nacl264_getKernels(module, session) {
+		postToSession(module, {command: OutgoingMessageTypes.GetKernels}, session);
 	}
 
-	function nacl264_openEncoder(module) {
-		module.postMessage({command: OutgoingMessageTypes.OpenEncoder});
+	function nacl264_openEncoder(module, session) {
+		postToSession(module, {command: OutgoingMessageTypes.OpenEncoder}, session);
 	}
 
-	function nacl264_closeEncoder(module) {
-		module.postMessage({command: OutgoingMessageTypes.CloseEncoder});
+	function nacl264_closeEncoder(module, session) {
+		postToSession(module, {command: OutgoingMessageTypes.CloseEncoder}, session);
 	}
 	
-	function nacl264_sendFrameFromCanvas(module, canvas) {
+	function nacl264_destroySession(module, session) {
+		postToSession(module, {command: OutgoingMessageTypes.DestroySession}, session);
+	}
+	
+	// planeLayout (optional): {strides: [...], offsets: [...]} in bytes, one entry per plane
+	function nacl264_sendFrame(module, frameBuffer, format, planeLayout, session) {
+		var msg = {
+			command: OutgoingMessageTypes.SendFrame,
+			frame: frameBuffer,
+			format: format || PixelFormats.RGB
+		};
+		
+		if (planeLayout) {
+			if (planeLayout.strides) { msg.strides = planeLayout.strides; }
+			if (planeLayout.offsets) { msg.offsets = planeLayout.offsets; }
+		}
+		
+		postToSession(module, msg, session);
+	}
+	
+	function nacl264_sendFrameFromCanvas(module, canvas, session) {
 		var g = canvas.getContext('2d');
 		var w = canvas.width | 0;
 		var h = canvas.height | 0;
 		
+		// ImageData is already RGBA; the module strips alpha while converting
 		var idat = g.getImageData(0, 0, w, h);
-		var pixels = idat.data;
-		var len = w*3 * h;
-		
-		var ab = new ArrayBuffer(len);
-		var u8_array = new Uint8Array(ab);
-		var readPos = 0;
-		var writePos = 0;
-		for (var y = 0;y < h;++y) {
-			for (var x = 0;x < w;++x) {
-				u8_array[writePos++] = pixels[readPos++];
-				u8_array[writePos++] = pixels[readPos++];
-				u8_array[writePos++] = pixels[readPos++];
-				++readPos;
-			}
-		}
-		
-		module.postMessage({
-			command: OutgoingMessageTypes.SendFrame,
-			frame: ab
-		});
+		nacl264_sendFrame(module, idat.data.buffer, PixelFormats.RGBA, null, session);
 	}
 	
 	function ExpandableBuffer() {
@@ -76,24 +125,40 @@
 	
 	ExpandableBuffer.prototype = {
 		write: function(sourceArrayBuffer) {
-			var write_len = sourceArrayBuffer.byteLength;
+			this.writeBytes(new Uint8Array(sourceArrayBuffer));
+		},
+		
+		writeBytes: function(pRead) {
+			var write_len = pRead.length;
 		
 			var required = this.pos + write_len;
 			if (required > this.ab.byteLength) {
 				this.expand(required * 2);
 			}
 			
-			var pRead  = new Uint8Array(sourceArrayBuffer);
 			var pWrite = new Uint8Array(this.ab);
-			for (var i = 0;i < write_len;++i) {
-				pWrite[this.pos++] = pRead[i];
-			}
+			pWrite.set(pRead, this.pos);
+			this.pos += write_len;
 			
 			if (this.pos > this.maxPos) {
 				this.maxPos = this.pos;
 			}
 		},
 		
+		// Apply a write-batch message: the bytes of each patch are stored
+		// back to back in content, in the order the patches are listed.
+		writeBatch: function(content, patches) {
+			var pRead = new Uint8Array(content);
+			var readPos = 0;
+			
+			for (var i = 0;i < patches.length;i += 2) {
+				var len = patches[i+1] | 0;
+				this.seek(patches[i]);
+				this.writeBytes(pRead.subarray(readPos, readPos + len));
+				readPos += len;
+			}
+		},
+		
 		seek: function(pos) {
 			this.pos = pos | 0;
 		},
@@ -124,16 +189,77 @@
 		}
 	};
 
+	// Output file assembled from write-batch messages without copying.
+	// The module sends finished chunks in file order and only overwrites
+	// earlier bytes with the small header patches at close.
+	function ChunkedOutputBuffer() {
+		this.parts = [];
+		this.length = 0;
+	}
+	
+	ChunkedOutputBuffer.prototype = {
+		writeBatch: function(content, patches) {
+			var readPos = 0;
+			
+			for (var i = 0;i < patches.length;i += 2) {
+				var len = patches[i+1] | 0;
+				this.writeAt(patches[i], new Uint8Array(content, readPos, len));
+				readPos += len;
+			}
+		},
+		
+		writeAt: function(pos, bytes) {
+			if (pos > this.length) {
+				// skipped bytes read as zero
+				this.append(new Uint8Array(pos - this.length));
+			}
+			
+			// Overwrite the part that already exists
+			var partPos = 0;
+			for (var i = 0;i < this.parts.length && pos < this.length && bytes.length > 0;++i) {
+				var part = this.parts[i];
+				var partEnd = partPos + part.length;
+				if (pos < partEnd) {
+					var n = Math.min(partEnd - pos, bytes.length);
+					part.set(bytes.subarray(0, n), pos - partPos);
+					bytes = bytes.subarray(n);
+					pos += n;
+				}
+				
+				partPos = partEnd;
+			}
+			
+			if (bytes.length > 0) {
+				this.append(bytes);
+			}
+		},
+		
+		append: function(bytes) {
+			this.parts.push(bytes);
+			this.length += bytes.length;
+		},
+		
+		exportBlob: function(mime) {
+			return new Blob(this.parts, {type: mime || 'video/mp4'});
+		}
+	};
+
 	// export - - - - - - - - - - - - - - - - - - - - - - - - -
 	aGlobal.nacl264 = {
 		setEncoderParams:    nacl264_setEncoderParams,
 		openEncoder:         nacl264_openEncoder,
 		closeEncoder:        nacl264_closeEncoder,
+		destroySession:      nacl264_destroySession,
+		sendFrame:           nacl264_sendFrame,
 		sendFrameFromCanvas: nacl264_sendFrameFromCanvas,
 		setOutputType:       nacl264_setOutputType,
+		getKernels:          nacl264_getKernels,
 		
 		IncomingMessageTypes: IncomingMessageTypes,
 		OutgoingMessageTypes: OutgoingMessageTypes,
-		ExpandableBuffer: ExpandableBuffer
+		PixelFormats: PixelFormats,
+		OutputTypes: OutputTypes,
+		ExpandableBuffer: ExpandableBuffer,
+		ChunkedOutputBuffer: ChunkedOutputBuffer
 	};
 })(window);
@@ -1,11 +1,14 @@
 (function() {
 	var USE_MP4 = true;
 	
+	var MAX_FRAMES = 600;
 	var gFrameCount = 0;
+	var gCredits = 0;
+	var gClosing = false;
 	var gBallX  = -19;
 	var gBallY  = -90;
 	var gBallYa = 0;
-	var gOutBuffer = new nacl264.ExpandableBuffer();
+	var gOutBuffer = new nacl264.ChunkedOutputBuffer();
 	
 	function listenNaClEvents() {
 		var container = document.getElementById('nacl-container');
@@ -115,10 +118,24 @@
 			height: 480
 		});
 		
-		drawTestPicture();
-		nacl264.setOutputType(module, USE_MP4 ? 'mp4' : 'mkv');
+		nacl264.setOutputType(module, USE_MP4 ? nacl264.OutputTypes.MP4 : nacl264.OutputTypes.MKV);
 		nacl264.openEncoder(module);
-		nacl264.sendFrameFromCanvas(module, document.getElementById('cv1') );
+	}
+	
+	// Send frames while the module has free queue slots
+	function sendFrames(module) {
+		while (gCredits > 0 && gFrameCount < MAX_FRAMES) {
+			--gCredits;
+			drawTestPicture();
+			nacl264.sendFrameFromCanvas(module, document.getElementById('cv1') );
+			drawLabel(gFrameCount++);
+		}
+		
+		if (gFrameCount === MAX_FRAMES && !gClosing) {
+			// Queued frames are still encoded before the file is closed
+			gClosing = true;
+			nacl264.closeEncoder(module);
+		}
 	}
 	
 	function handleMessage(message_event) {
@@ -128,23 +145,14 @@
 		
 		var M = nacl264.IncomingMessageTypes;
 		switch(mtype) {
+		case M.EncoderOpened:
 		case M.EncodeFrameDone:
-			if (++gFrameCount <= 600) {
-				drawTestPicture();
-				nacl264.sendFrameFromCanvas(module, document.getElementById('cv1') );
-				drawLabel(gFrameCount-1);
-			} else {
-				nacl264.closeEncoder(module);
-			}
-			
-			break;
-
-		case M.SendBufferedData:
-			gOutBuffer.write(mbody.content);
+			gCredits += mbody.credits | 0;
+			sendFrames(module);
 			break;
 
-		case M.SeekBuffer:
-			gOutBuffer.seek(mbody.position);
+		case M.WriteBatch:
+			gOutBuffer.writeBatch(mbody.content, mbody.patches);
 			break;
 			
 		case M.EncoderClosed:
@@ -0,0 +1,86 @@
+// nacl264 - x264 on Google Native Client
+// 2014.06 Satoshi Ueyama
+// distributed under GPL
+
+#include "outputstaging.h"
+#include <string.h>
+
+extern "C" {
+#include "common/common.h"
+}
+
+OutputStagingBuffer::OutputStagingBuffer() :
+	mBatchProc(NULL),
+	mBatchUserData(NULL),
+	mMaxBytes(256 * 1024),
+	mMaxLatency(250 * 1000),
+	mPosition(0),
+	mFirstWriteTime(0) {
+}
+
+void OutputStagingBuffer::configure(size_t maxBytes, int maxLatencyMs) {
+	mMaxBytes = maxBytes;
+	mMaxLatency = (int64_t)maxLatencyMs * 1000;
+}
+
+void OutputStagingBuffer::setBatchProc(OutputBatchProc proc, void* user_data) {
+	mBatchProc = proc;
+	mBatchUserData = user_data;
+}
+
+void OutputStagingBuffer::reset() {
+	mData.clear();
+	mPatches.clear();
+	mPosition = 0;
+}
+
+void OutputStagingBuffer::write(const void* buf, size_t size) {
+	if (!size) {
+		return;
+	}
+
+	if (mData.empty()) {
+		mFirstWriteTime = x264_mdate();
+	}
+
+	if (mPatches.empty() || mPatches.back().position + mPatches.back().length != mPosition) {
+		OutputPatch patch;
+		patch.position = mPosition;
+		patch.length = 0;
+		mPatches.push_back(patch);
+	}
+
+	const size_t oldSize = mData.size();
+	mData.resize(oldSize + size);
+	memcpy(&mData[oldSize], buf, size);
+	mPatches.back().length += size;
+	mPosition += size;
+
+	if (mData.size() >= mMaxBytes) {
+		flush();
+	}
+}
+
+// Only moves the write position; no bytes are emitted for a seek itself
+void OutputStagingBuffer::seek(int64_t pos) {
+	mPosition = pos;
+}
+
+void OutputStagingBuffer::flushIfDue() {
+	if (!mData.empty() && (x264_mdate() - mFirstWriteTime) >= mMaxLatency) {
+		flush();
+	}
+}
+
+void OutputStagingBuffer::flush() {
+	if (mData.empty()) {
+		return;
+	}
+
+	if (mBatchProc) {
+		mBatchProc(&mData[0], mData.size(), &mPatches[0], (int)mPatches.size(), mBatchUserData);
+	}
+
+	mData.clear();
+	mPatches.clear();
+}
@@ -0,0 +1,55 @@
+// nacl264 - x264 on Google Native Client
+// 2014.06 Satoshi Ueyama
+// distributed under GPL
+
+#ifndef OUTPUTSTAGING_H_INCLUDED
+#define OUTPUTSTAGING_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// A run of bytes inside a batch that belongs at 'position' in the output file
+typedef struct {
+	int64_t position;
+	uint32_t length;
+} OutputPatch;
+
+// Receives one batch: the patches' bytes are stored back to back in data
+typedef void (*OutputBatchProc)(const uint8_t* data, size_t size, const OutputPatch* patches, int nPatches, void* user_data);
+
+// Collects the container writers' small writes and seeks into batches.
+// Contiguous writes extend the current patch, a seek starts a new one.
+// A batch is handed to the batch proc when it reaches maxBytes, or at the
+// first flushIfDue() after its oldest byte has waited maxLatencyMs.
+class OutputStagingBuffer {
+public:
+	OutputStagingBuffer();
+
+	void configure(size_t maxBytes, int maxLatencyMs);
+	void setBatchProc(OutputBatchProc proc, void* user_data);
+	size_t maxBytes() const { return mMaxBytes; }
+	int maxLatencyMs() const { return (int)(mMaxLatency / 1000); }
+
+	// Forget pending data and rewind to position 0
+	void reset();
+
+	void write(const void* buf, size_t size);
+	void seek(int64_t pos);
+	int64_t position() const { return mPosition; }
+
+	void flushIfDue();
+	void flush();
+protected:
+	OutputBatchProc mBatchProc;
+	void* mBatchUserData;
+	size_t mMaxBytes;
+	int64_t mMaxLatency; // us
+
+	std::vector<uint8_t> mData;
+	std::vector<OutputPatch> mPatches;
+	int64_t mPosition;
+	int64_t mFirstWriteTime;
+};
+
+#endif
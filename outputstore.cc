@@ -0,0 +1,152 @@
+// nacl264 - x264 on Google Native Client
+// 2014.06 Satoshi Ueyama
+// distributed under GPL
+
+#include "outputstore.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+OutputStore::OutputStore(size_t chunkSize) :
+	mSink(NULL),
+	mChunkSize(chunkSize),
+	mExportedChunks(0),
+	mPosition(0),
+	mEnd(0) {
+}
+
+OutputStore::~OutputStore() {
+	reset();
+}
+
+void OutputStore::reset() {
+	for (size_t i = 0;i < mChunks.size();++i) {
+		free(mChunks[i]);
+	}
+
+	mChunks.clear();
+	mPatches.clear();
+	mExportedChunks = 0;
+	mPosition = 0;
+	mEnd = 0;
+}
+
+// Bytes that were skipped over by a seek read as zero
+uint8_t* OutputStore::chunkAt(size_t index) {
+	if (index >= mChunks.size()) {
+		mChunks.resize(index + 1, NULL);
+	}
+
+	if (!mChunks[index]) {
+		mChunks[index] = static_cast<uint8_t*>(calloc(1, mChunkSize));
+	}
+
+	return mChunks[index];
+}
+
+void OutputStore::write(const void* buf, size_t size) {
+	const uint8_t* p = static_cast<const uint8_t*>(buf);
+	if (!size) {
+		return;
+	}
+
+	// The part that lands in exported bytes becomes a patch
+	if (mPosition < exportedEnd()) {
+		const size_t n = (size_t)((exportedEnd() - mPosition) < (int64_t)size ? (exportedEnd() - mPosition) : (int64_t)size);
+		addPatch(p, n);
+		p += n;
+		size -= n;
+		mPosition += n;
+	}
+
+	while (size) {
+		const size_t index = (size_t)(mPosition / mChunkSize);
+		const size_t offset = (size_t)(mPosition % mChunkSize);
+		const size_t n = (mChunkSize - offset) < size ? (mChunkSize - offset) : size;
+
+		uint8_t* chunk = chunkAt(index);
+		if (!chunk) {
+			puts("** WARNING! output store allocation failed **");
+			return;
+		}
+
+		memcpy(chunk + offset, p, n);
+		p += n;
+		size -= n;
+		mPosition += n;
+	}
+
+	if (mPosition > mEnd) {
+		mEnd = mPosition;
+	}
+
+	exportFinishedChunks();
+}
+
+int OutputStore::seek(int64_t offset, int whence) {
+	int64_t pos;
+	switch (whence) {
+	case SEEK_SET: pos = offset;             break;
+	case SEEK_CUR: pos = mPosition + offset; break;
+	case SEEK_END: pos = mEnd + offset;      break;
+	default:       return -1;
+	}
+
+	if (pos < 0) {
+		return -1;
+	}
+
+	mPosition = pos;
+	return 0;
+}
+
+void OutputStore::addPatch(const uint8_t* p, size_t size) {
+	// Extend the previous patch when the writer continues where it left off
+	if (!mPatches.empty()) {
+		StorePatch& last = mPatches.back();
+		if (last.position + (int64_t)last.bytes.size() == mPosition) {
+			last.bytes.insert(last.bytes.end(), p, p + size);
+			return;
+		}
+	}
+
+	StorePatch patch;
+	patch.position = mPosition;
+	patch.bytes.assign(p, p + size);
+	mPatches.push_back(patch);
+}
+
+void OutputStore::exportChunk(size_t length) {
+	uint8_t* chunk = chunkAt(mExportedChunks);
+	if (mSink && chunk) {
+		mSink->seek(exportedEnd());
+		mSink->write(chunk, length);
+	}
+
+	free(chunk);
+	mChunks[mExportedChunks] = NULL;
+	++mExportedChunks;
+}
+
+// Chunks behind the write position are considered final
+void OutputStore::exportFinishedChunks() {
+	while (exportedEnd() + (int64_t)mChunkSize <= mPosition) {
+		exportChunk(mChunkSize);
+	}
+}
+
+void OutputStore::finish() {
+	while (exportedEnd() < mEnd) {
+		const int64_t remaining = mEnd - exportedEnd();
+		exportChunk(remaining < (int64_t)mChunkSize ? (size_t)remaining : mChunkSize);
+	}
+
+	if (mSink) {
+		for (size_t i = 0;i < mPatches.size();++i) {
+			mSink->seek(mPatches[i].position);
+			mSink->write(&mPatches[i].bytes[0], mPatches[i].bytes.size());
+		}
+	}
+
+	mPatches.clear();
+}
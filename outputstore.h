@@ -0,0 +1,57 @@
+// nacl264 - x264 on Google Native Client
+// 2014.06 Satoshi Ueyama
+// distributed under GPL
+
+#ifndef OUTPUTSTORE_H_INCLUDED
+#define OUTPUTSTORE_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "outputstaging.h"
+
+// Random-access view of the output file for the container writers.
+// The file is held as fixed-size chunks; seeks and overwrites are resolved
+// here. Once the write position has moved past a chunk, the chunk is
+// exported to the sink and freed. Later writes into exported bytes are
+// kept as patches and exported by finish().
+class OutputStore {
+public:
+	explicit OutputStore(size_t chunkSize = 64 * 1024);
+	~OutputStore();
+
+	void setSink(OutputStagingBuffer* sink) { mSink = sink; }
+
+	// Drop everything and rewind to position 0
+	void reset();
+
+	void write(const void* buf, size_t size);
+	// Returns 0 on success, -1 for an invalid position (like fseek)
+	int seek(int64_t offset, int whence);
+	int64_t position() const { return mPosition; }
+	int64_t size() const { return mEnd; }
+
+	// Export the remaining chunks, then the patches
+	void finish();
+protected:
+	typedef struct {
+		int64_t position;
+		std::vector<uint8_t> bytes;
+	} StorePatch;
+
+	OutputStagingBuffer* mSink;
+	const size_t mChunkSize;
+	std::vector<uint8_t*> mChunks; // NULL once exported
+	size_t mExportedChunks;
+	std::vector<StorePatch> mPatches;
+	int64_t mPosition;
+	int64_t mEnd;
+
+	int64_t exportedEnd() const { return (int64_t)mExportedChunks * mChunkSize; }
+	uint8_t* chunkAt(size_t index);
+	void addPatch(const uint8_t* p, size_t size);
+	void exportChunk(size_t length);
+	void exportFinishedChunks();
+};
+
+#endif
@@ -0,0 +1,73 @@
+# Sources shared by the NaCl build (Makefile) and the native host build (host.mk)
+
+CORE_SRC = encodercore.cc \
+           speedgovernor.cc \
+           colorconv.cc \
+           framequeue.cc \
+           outputstaging.cc \
+           outputstore.cc
+
+X264_SRC = x264/common/bitstream.c \
+           x264/common/cabac.c \
+           x264/common/common.c \
+           x264/common/cpu.c \
+           x264/common/dct.c \
+           x264/common/deblock.c \
+           x264/common/frame.c \
+           x264/common/macroblock.c \
+           x264/common/mc.c \
+           x264/common/mvpred.c \
+           x264/common/osdep.c \
+           x264/common/pixel.c \
+           x264/common/predict.c \
+           x264/common/quant.c \
+           x264/common/rectangle.c \
+           x264/common/set.c \
+           x264/common/vlc.c \
+           x264/encoder/analyse.c \
+           x264/encoder/cabac.c \
+           x264/encoder/cavlc.c \
+           x264/encoder/encoder.c \
+           x264/encoder/lookahead.c \
+           x264/encoder/macroblock.c \
+           x264/encoder/me.c \
+           x264/encoder/ratecontrol.c \
+           x264/encoder/set.c \
+           x264/output/matroska.c \
+           x264/output/mp4_lsmash.c \
+           x264/output/matroska_ebml_b.c
+
+# Built only where x264/config.h enables HAVE_THREAD
+X264_THREAD_SRC = x264/common/threadpool.c
+
+# Built only where x264/config.h enables HAVE_X86_INTRIN
+X264_X86_SRC = x264/common/x86/pixel-intrin.c \
+               x264/common/x86/mc-intrin.c \
+               x264/common/x86/dct-intrin.c \
+               x264/common/x86/quant-intrin.c \
+               x264/common/x86/deblock-intrin.c \
+               x264/common/x86/predict-intrin.c
+
+LSMASH_SRC = lsmash/core/box.c      \
+             lsmash/core/chapter.c  \
+             lsmash/core/fragment.c \
+             lsmash/core/isom.c     \
+             lsmash/core/meta.c     \
+             lsmash/core/print.c    \
+             lsmash/core/read.c     \
+             lsmash/core/summary.c  \
+             lsmash/core/timeline.c \
+             lsmash/core/write.c    \
+             lsmash/codecs/a52.c         \
+             lsmash/codecs/description.c \
+             lsmash/codecs/h264.c        \
+             lsmash/codecs/mp4a.c        \
+             lsmash/codecs/vc1.c         \
+             lsmash/codecs/alac.c        \
+             lsmash/codecs/dts.c         \
+             lsmash/codecs/hevc.c        \
+             lsmash/codecs/mp4sys.c      \
+             lsmash/common/alloc.c   \
+             lsmash/common/bstream.c \
+             lsmash/common/list.c    \
+             lsmash/common/utils.c
@@ -0,0 +1,167 @@
+// nacl264 - x264 on Google Native Client
+// 2014.06 Satoshi Ueyama
+// distributed under GPL
+
+#include "speedgovernor.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+// Upper bounds on the opened settings, from slowest to fastest. The steps
+// follow the faster, veryfast, superfast and ultrafast presets, without the
+// options x264_encoder_reconfig can't change (weightp, b-frames, cabac).
+// subme stays above 0: the encoder can't leave subme 0 once it is there.
+typedef struct {
+	int subme;
+	int meMethod;
+	int refs;
+	unsigned int inter; // ANDed with the opened partition masks
+	unsigned int intra;
+	int trellis;
+	int mixedRefs;
+} SpeedLevel;
+
+static const unsigned int kAllPartitions = ~0u;
+static const unsigned int kIntraPartitions = X264_ANALYSE_I4x4 | X264_ANALYSE_I8x8;
+
+static const SpeedLevel kSpeedLevels[] = {
+	{ 11, X264_ME_TESA, 16, kAllPartitions,   kAllPartitions,   2, 1 }, // as opened
+	{  4, X264_ME_HEX,   2, kAllPartitions,   kAllPartitions,   1, 0 }, // faster
+	{  2, X264_ME_HEX,   1, kAllPartitions,   kAllPartitions,   0, 0 }, // veryfast
+	{  1, X264_ME_DIA,   1, kIntraPartitions, kIntraPartitions, 0, 0 }, // superfast
+	{  1, X264_ME_DIA,   1, 0,                0,                0, 0 }, // ultrafast
+};
+
+static const int kLevelCount = sizeof(kSpeedLevels) / sizeof(kSpeedLevels[0]);
+
+// X264_ME_* values aren't ordered by cost; this ranks them
+static int meMethodCost(int method) {
+	switch (method) {
+	case X264_ME_DIA:     return 0;
+	case X264_ME_LOWRES:  return 1; // a short refine around the lookahead's vector
+	case X264_ME_HEX:     return 2;
+	case X264_ME_EPZS:    return 2;
+	case X264_ME_PYRAMID: return 2; // a hexagon search from the lookahead's coarse-to-fine vector
+	case X264_ME_UMH:     return 3;
+	case X264_ME_ESA:     return 4;
+	default:              return 5;
+	}
+}
+
+// Frames to wait after a change before stepping faster again, so the new
+// level is measured before it is judged
+static const int kHoldFrames = 4;
+// Slower is only tried after this many frames (and at least a second)
+// with room to spare
+static const int kRelaxFrames = 15;
+// Backlog that calls for a cheaper level even while the current one keeps
+// up on average: a page sending with the default four credits is stalled
+static const int kMaxBacklogFrames = 4;
+
+SpeedGovernor::SpeedGovernor() :
+	mTargetFps(0),
+	mLevel(0),
+	mLevelChanges(0),
+	mFramesSinceChange(0),
+	mAverageUs(0),
+	mBudgetUs(0),
+	mBacklogUs(0),
+	mBacklogAtChangeUs(0),
+	mMaxBacklogUs(0) {
+	memset(&mBaseParams, 0, sizeof(mBaseParams));
+}
+
+int SpeedGovernor::levelCount() {
+	return kLevelCount;
+}
+
+void SpeedGovernor::start(const x264_param_t* params) {
+	mBaseParams = *params;
+	mLevel = 0;
+	mLevelChanges = 0;
+	mFramesSinceChange = 0;
+	mFramesAtLevel.assign(kLevelCount, 0);
+	mAverageUs = 0;
+	mLevelCostUs.assign(kLevelCount, 0);
+	mBudgetUs = mTargetFps > 0 ? (int64_t)(1000000.0 / mTargetFps) : 0;
+	mBacklogUs = 0;
+	mBacklogAtChangeUs = 0;
+	mMaxBacklogUs = 0;
+}
+
+void SpeedGovernor::update(x264_t* h, int64_t elapsedUs) {
+	// Off, or the target was set after start()
+	if (mBudgetUs <= 0) {
+		return;
+	}
+
+	++mFramesAtLevel[mLevel];
+	++mFramesSinceChange;
+	mAverageUs = mAverageUs ? mAverageUs + (elapsedUs - mAverageUs) / 8 : elapsedUs;
+
+	// Frames come in every mBudgetUs whether or not the last one is done
+	mBacklogUs += elapsedUs - mBudgetUs;
+	if (mBacklogUs < 0) {
+		mBacklogUs = 0;
+	}
+
+	if (mBacklogUs > mMaxBacklogUs) {
+		mMaxBacklogUs = mBacklogUs;
+	}
+
+	// A single slow frame (an I frame, the lookahead filling up) only adds
+	// backlog; the level is too slow if it can't keep up on average or the
+	// backlog grows past what a queue would hold and isn't shrinking
+	const bool behind = mAverageUs > mBudgetUs * 9 / 10 ||
+	                    (mBacklogUs > mBudgetUs * kMaxBacklogFrames && mBacklogUs >= mBacklogAtChangeUs);
+	if (behind) {
+		if (mLevel + 1 < kLevelCount && mFramesSinceChange >= kHoldFrames) {
+			setLevel(h, mLevel + 1);
+		}
+
+		return;
+	}
+
+	const int relaxFrames = mTargetFps > kRelaxFrames ? (int)mTargetFps : kRelaxFrames;
+	if (mLevel > 0 && mBacklogUs == 0 && mFramesSinceChange >= relaxFrames &&
+	    mAverageUs < mBudgetUs * 6 / 10) {
+		// A level that was too slow before gets retried only if it measured
+		// close to fitting; otherwise it would bounce straight back
+		const int64_t slowerCost = mLevelCostUs[mLevel - 1];
+		if (slowerCost == 0 || slowerCost < mBudgetUs * 17 / 20) {
+			setLevel(h, mLevel - 1);
+		}
+	}
+}
+
+bool SpeedGovernor::setLevel(x264_t* h, int level) {
+	x264_param_t params = mBaseParams;
+	applyLevel(&params, level);
+	if (x264_encoder_reconfig(h, &params) < 0) {
+		printf("Speed governor: failed to reconfigure for level %d\n", level);
+		return false;
+	}
+
+	printf("Speed governor: level %d -> %d (%.1f ms/frame, backlog %.1f ms)\n", mLevel, level,
+	       mAverageUs / 1000.0, mBacklogUs / 1000.0);
+	mLevelCostUs[mLevel] = mAverageUs;
+	mLevel = level;
+	++mLevelChanges;
+	mFramesSinceChange = 0;
+	mAverageUs = 0;
+	mBacklogAtChangeUs = mBacklogUs;
+	return true;
+}
+
+void SpeedGovernor::applyLevel(x264_param_t* params, int level) const {
+	const SpeedLevel& s = kSpeedLevels[level];
+	params->analyse.i_subpel_refine = std::min(params->analyse.i_subpel_refine, s.subme);
+	params->i_frame_reference = std::min(params->i_frame_reference, s.refs);
+	params->analyse.inter &= s.inter;
+	params->analyse.intra &= s.intra;
+	params->analyse.i_trellis = std::min(params->analyse.i_trellis, s.trellis);
+	params->analyse.b_mixed_references &= s.mixedRefs;
+	if (meMethodCost(params->analyse.i_me_method) > meMethodCost(s.meMethod)) {
+		params->analyse.i_me_method = s.meMethod;
+	}
+}
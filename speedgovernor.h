@@ -0,0 +1,73 @@
+// nacl264 - x264 on Google Native Client
+// 2014.06 Satoshi Ueyama
+// distributed under GPL
+
+#ifndef SPEEDGOVERNOR_H_INCLUDED
+#define SPEEDGOVERNOR_H_INCLUDED
+
+#include <stdint.h>
+#include <vector>
+
+extern "C" {
+#include "x264.h"
+}
+
+// Keeps a real-time encode from falling behind its source. Every encode
+// call is timed against the frame budget of the target rate; when frames
+// take too long the governor steps to a cheaper level of analysis settings
+// (subme, me method, refs, partitions, trellis, mixed refs) through
+// x264_encoder_reconfig, and steps back once there is room again.
+//
+// Frames are assumed to arrive at the target rate, so time spent over
+// budget accumulates as backlog, the frames a capture queue would be
+// holding. Stepping down reacts within a few frames; stepping back up
+// waits for an empty backlog, about a second of headroom, and a slower
+// level that was last measured to fit.
+//
+// Level 0 is the settings the encoder was opened with. Every level only
+// lowers them, so a preset faster than a level is left alone.
+// The target is set before start(); all other calls are made on the
+// encoding thread.
+class SpeedGovernor {
+public:
+	SpeedGovernor();
+
+	// 0 turns the governor off; takes effect at the next start()
+	void setTargetFps(double fps) { mTargetFps = fps > 0 ? fps : 0; }
+	double targetFps() const { return mTargetFps; }
+	bool isEnabled() const { return mTargetFps > 0; }
+
+	// Takes the parameters the encoder actually opened with as level 0
+	void start(const x264_param_t* params);
+	// Feeds the wall time of one encode call; may reconfigure h
+	void update(x264_t* h, int64_t elapsedUs);
+
+	static int levelCount();
+	int level() const { return mLevel; }
+	int levelChanges() const { return mLevelChanges; }
+	int framesAtLevel(int level) const { return mFramesAtLevel[level]; }
+	int64_t backlogUs() const { return mBacklogUs; }
+	int64_t maxBacklogUs() const { return mMaxBacklogUs; }
+protected:
+	double mTargetFps;
+	x264_param_t mBaseParams;
+
+	int mLevel;
+	int mLevelChanges;
+	int mFramesSinceChange;
+	std::vector<int> mFramesAtLevel;
+	// Smoothed encode time at the current level, and what each level cost
+	// when it was last left (0 if never measured)
+	int64_t mAverageUs;
+	std::vector<int64_t> mLevelCostUs;
+
+	int64_t mBudgetUs;
+	int64_t mBacklogUs;
+	int64_t mBacklogAtChangeUs;
+	int64_t mMaxBacklogUs;
+
+	bool setLevel(x264_t* h, int level);
+	void applyLevel(x264_param_t* params, int level) const;
+};
+
+#endif
@@ -0,0 +1,1299 @@
+// nacl264 - x264 on Google Native Client
+// 2014.06 Satoshi Ueyama
+// distributed under GPL
+//
+// Checks the x264 SIMD kernels (x264/common/x86/*-intrin.c) against the C
+// versions. Every cpu level the machine supports is compared with
+// x264_*_init(0) on random, flat and extreme input at random strides.
+// With --bench, every kernel is also timed against its C version (best of
+// several runs, in rdtsc ticks per call). A kernel in the encoder's tables
+// that none of the checks reach fails the coverage check.
+//
+//   make -f host.mk
+//   out/host/checkasm [--bench] [seed]
+
+extern "C" {
+#include "common/common.h"
+}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <x86intrin.h>
+#include <set>
+
+typedef struct {
+	const char* name;
+	uint32_t flags;
+} CpuLevel;
+
+static const CpuLevel kCpuLevels[] = {
+	{"SSE2", X264_CPU_MMX | X264_CPU_MMX2 | X264_CPU_SSE | X264_CPU_SSE2},
+	{"SSSE3", X264_CPU_MMX | X264_CPU_MMX2 | X264_CPU_SSE | X264_CPU_SSE2 | X264_CPU_SSE3 | X264_CPU_SSSE3},
+	{"AVX2", X264_CPU_MMX | X264_CPU_MMX2 | X264_CPU_SSE | X264_CPU_SSE2 | X264_CPU_SSE3 | X264_CPU_SSSE3 |
+	         X264_CPU_SSE4 | X264_CPU_SSE42 | X264_CPU_AVX | X264_CPU_AVX2}
+};
+
+static const int kIterations = 64;
+static const int kBufSize = 64 * 96;
+
+static const int kBenchRuns = 32;
+static const int kBenchCalls = 64;
+
+static int gFailures = 0;
+static bool gBench = false;
+// Every optimized function that went through a check; see checkCoverage
+static std::set<const void*> gTested;
+
+// pbuf1/pbuf2 hold the pixel input, fenc a FENC_STRIDE block
+ALIGNED_16(static pixel pbuf1[kBufSize]);
+ALIGNED_16(static pixel pbuf2[kBufSize]);
+ALIGNED_16(static pixel fenc[FENC_STRIDE * 16]);
+
+static void report(const char* level, const char* name, bool ok) {
+	printf("%s %-22s %s\n", level, name, ok ? "OK" : "FAILED");
+	if (!ok) {
+		++gFailures;
+	}
+}
+
+template <typename F>
+static void markTested(F fn) {
+	gTested.insert((const void*)fn);
+}
+
+static void reportBench(const char* level, const char* name, uint64_t refTicks, uint64_t optTicks) {
+	const double ref = (double)refTicks / kBenchCalls;
+	const double opt = (double)optTicks / kBenchCalls;
+	printf("%s %-26s %8.1f -> %8.1f  %5.2fx\n", level, name, ref, opt, ref / opt);
+}
+
+// Times `call`, which invokes `fn`, with fn = ref.name and fn = opt.name
+#define BENCH(label, name, ...) \
+	if (gBench && opt.name != ref.name) { \
+		uint64_t ticks[2]; \
+		for (int v = 0;v < 2;++v) { \
+			auto fn = v ? opt.name : ref.name; \
+			uint64_t best = UINT64_MAX; \
+			for (int run = 0;run < kBenchRuns;++run) { \
+				const uint64_t start = __rdtsc(); \
+				for (int call = 0;call < kBenchCalls;++call) { \
+					__VA_ARGS__; \
+				} \
+				const uint64_t t = __rdtsc() - start; \
+				if (t < best) { \
+					best = t; \
+				} \
+			} \
+			ticks[v] = best; \
+		} \
+		reportBench(level, label, ticks[0], ticks[1]); \
+	}
+
+// Pattern 0 is random, 1 all zero / all 255 (alternating buffers), 2 random 0/255
+static void fillBuffers(int pattern) {
+	for (int i = 0;i < kBufSize;++i) {
+		switch (pattern) {
+		case 0:
+			pbuf1[i] = rand() & 0xff;
+			pbuf2[i] = rand() & 0xff;
+			break;
+		case 1:
+			pbuf1[i] = 0;
+			pbuf2[i] = 0xff;
+			break;
+		default:
+			pbuf1[i] = (rand() & 1) ? 0xff : 0;
+			pbuf2[i] = (rand() & 1) ? 0xff : 0;
+			break;
+		}
+	}
+
+	for (int i = 0;i < FENC_STRIDE * 16;++i) {
+		fenc[i] = pattern == 0 ? rand() & 0xff : pbuf1[i];
+	}
+}
+
+static intptr_t randomStride() {
+	return 16 + (rand() % 49);
+}
+
+static int randomOffset() {
+	return rand() % 16;
+}
+
+static const char* const kPixelNames[] = {"16x16", "16x8", "8x16", "8x8", "8x4", "4x8", "4x4", "4x16"};
+
+static void checkPixel(const char* level, int cpu) {
+	x264_pixel_function_t ref, opt;
+	x264_pixel_init(0, &ref);
+	x264_pixel_init(cpu, &opt);
+
+#define CHECK_SIZES(name, count, ...) \
+	{ \
+		bool ok = true; \
+		for (int size = 0;size < (count);++size) { \
+			if (opt.name[size] == ref.name[size]) { \
+				continue; \
+			} \
+			markTested(opt.name[size]); \
+			for (int it = 0;it < kIterations && ok;++it) { \
+				fillBuffers(it % 3); \
+				const intptr_t stride1 = randomStride(); \
+				const intptr_t stride2 = randomStride(); \
+				pixel* pix1 = pbuf1 + randomOffset(); \
+				pixel* pix2 = pbuf2 + randomOffset(); \
+				(void)stride1; \
+				(void)stride2; \
+				(void)pix1; \
+				(void)pix2; \
+				__VA_ARGS__; \
+			} \
+			if (!ok) { \
+				fprintf(stderr, "  %s_%s mismatch\n", #name, kPixelNames[size]); \
+			} \
+		} \
+		report(level, #name, ok); \
+	}
+
+	CHECK_SIZES(sad, 8, ok = ref.sad[size](pix1, stride1, pix2, stride2) == opt.sad[size](pix1, stride1, pix2, stride2));
+	CHECK_SIZES(sad_aligned, 8, ok = ref.sad_aligned[size](pix1, stride1, pix2, stride2) == opt.sad_aligned[size](pix1, stride1, pix2, stride2));
+	CHECK_SIZES(ssd, 8, ok = ref.ssd[size](pix1, stride1, pix2, stride2) == opt.ssd[size](pix1, stride1, pix2, stride2));
+	CHECK_SIZES(satd, 8, ok = ref.satd[size](pix1, stride1, pix2, stride2) == opt.satd[size](pix1, stride1, pix2, stride2));
+	CHECK_SIZES(sa8d, 4, ok = ref.sa8d[size](pix1, stride1, pix2, stride2) == opt.sa8d[size](pix1, stride1, pix2, stride2));
+	CHECK_SIZES(hadamard_ac, 4, ok = ref.hadamard_ac[size](pix1, stride1) == opt.hadamard_ac[size](pix1, stride1));
+	CHECK_SIZES(var, 4, ok = ref.var[size](pix1, stride1) == opt.var[size](pix1, stride1));
+	CHECK_SIZES(var2, 4, {
+		int ssdRef = 0, ssdOpt = 1;
+		ok = ref.var2[size](pix1, stride1, pix2, stride2, &ssdRef) == opt.var2[size](pix1, stride1, pix2, stride2, &ssdOpt)
+		     && ssdRef == ssdOpt;
+	});
+
+#define CHECK_X(name) \
+	CHECK_SIZES(name##_x3, 7, { \
+		int scoresRef[3], scoresOpt[3]; \
+		ref.name##_x3[size](fenc, pix2, pix2 + 1, pix2 + 2 * stride2, stride2, scoresRef); \
+		opt.name##_x3[size](fenc, pix2, pix2 + 1, pix2 + 2 * stride2, stride2, scoresOpt); \
+		ok = !memcmp(scoresRef, scoresOpt, sizeof(scoresRef)); \
+	}); \
+	CHECK_SIZES(name##_x4, 7, { \
+		int scoresRef[4], scoresOpt[4]; \
+		ref.name##_x4[size](fenc, pix2, pix2 + 1, pix2 + 2 * stride2, pix2 + 3, stride2, scoresRef); \
+		opt.name##_x4[size](fenc, pix2, pix2 + 1, pix2 + 2 * stride2, pix2 + 3, stride2, scoresOpt); \
+		ok = !memcmp(scoresRef, scoresOpt, sizeof(scoresRef)); \
+	})
+	CHECK_X(sad);
+	CHECK_X(satd);
+#undef CHECK_X
+
+	CHECK_SIZES(ads, 7, {
+		int encDC[4];
+		uint16_t sums[80];
+		uint16_t costMvx[64];
+		int16_t mvsRef[64], mvsOpt[64];
+		for (int i = 0;i < 4;++i) {
+			encDC[i] = rand() & 0x3fff;
+		}
+		for (int i = 0;i < 80;++i) {
+			sums[i] = rand() & 0x3fff;
+		}
+		for (int i = 0;i < 64;++i) {
+			costMvx[i] = rand() & 0x3ff;
+		}
+		const int width = 1 + rand() % 48;
+		const int thresh = rand() & 0x7fff;
+		const int nRef = ref.ads[size](encDC, sums, 16, costMvx, mvsRef, width, thresh);
+		const int nOpt = opt.ads[size](encDC, sums, 16, costMvx, mvsOpt, width, thresh);
+		ok = nRef == nOpt && !memcmp(mvsRef, mvsOpt, nRef * sizeof(int16_t));
+	});
+#undef CHECK_SIZES
+
+#define CHECK_ONE(name, ...) \
+	if (opt.name != ref.name) { \
+		bool ok = true; \
+		markTested(opt.name); \
+		for (int it = 0;it < kIterations && ok;++it) { \
+			fillBuffers(it % 3); \
+			const intptr_t stride1 = randomStride(); \
+			const intptr_t stride2 = randomStride(); \
+			pixel* pix1 = pbuf1 + randomOffset(); \
+			pixel* pix2 = pbuf2 + randomOffset(); \
+			(void)stride1; \
+			(void)stride2; \
+			(void)pix1; \
+			(void)pix2; \
+			__VA_ARGS__; \
+		} \
+		report(level, #name, ok); \
+	}
+
+	CHECK_ONE(ssd_nv12_core, {
+		uint64_t uRef, vRef, uOpt, vOpt;
+		const int width = 8 * (1 + rand() % 3);
+		const int height = 1 + rand() % 16;
+		ref.ssd_nv12_core(pix1, stride1, pix2, stride2, width, height, &uRef, &vRef);
+		opt.ssd_nv12_core(pix1, stride1, pix2, stride2, width, height, &uOpt, &vOpt);
+		ok = uRef == uOpt && vRef == vOpt;
+	});
+	CHECK_ONE(ssim_4x4x2_core, {
+		int sumsRef[2][4], sumsOpt[2][4];
+		ref.ssim_4x4x2_core(pix1, stride1, pix2, stride2, sumsRef);
+		opt.ssim_4x4x2_core(pix1, stride1, pix2, stride2, sumsOpt);
+		ok = !memcmp(sumsRef, sumsOpt, sizeof(sumsRef));
+	});
+	CHECK_ONE(ssim_end4, {
+		int sum0[5][4], sum1[5][4];
+		for (int i = 0;i < 5;++i) {
+			ref.ssim_4x4x2_core(pix1 + 8 * i, stride1, pix2 + 8 * i, stride2, (int(*)[4])sum0[i]);
+			ref.ssim_4x4x2_core(pix1 + 8 * i + 4 * stride1, stride1, pix2 + 8 * i + 4 * stride2, stride2, (int(*)[4])sum1[i]);
+		}
+		const int width = 1 + rand() % 4;
+		const float resRef = ref.ssim_end4(sum0, sum1, width);
+		const float resOpt = opt.ssim_end4(sum0, sum1, width);
+		ok = resRef == resOpt;
+	});
+	CHECK_ONE(vsad, {
+		const int height = 2 + rand() % 31;
+		ok = ref.vsad(pix1, stride1 & ~1, height / 2) == opt.vsad(pix1, stride1 & ~1, height / 2)
+		     && ref.vsad(pix1, stride1, height) == opt.vsad(pix1, stride1, height);
+	});
+	CHECK_ONE(asd8, {
+		const int height = 1 + rand() % 16;
+		ok = ref.asd8(pix1, stride1, pix2, stride2, height) == opt.asd8(pix1, stride1, pix2, stride2, height);
+	});
+
+	// The intra_*_x3 functions read the edges around fdec; only the scores are compared,
+	// since the C versions leave the last prediction in fdec
+#define CHECK_INTRA_X3(name, arg) \
+	CHECK_ONE(name, { \
+		pixel* fdec = pix2 + FDEC_STRIDE; \
+		pixel* edge = pix2; \
+		int resRef[3], resOpt[3]; \
+		(void)fdec; \
+		(void)edge; \
+		ref.name(fenc, arg, resRef); \
+		opt.name(fenc, arg, resOpt); \
+		ok = !memcmp(resRef, resOpt, sizeof(resRef)); \
+	})
+	CHECK_INTRA_X3(intra_sad_x3_4x4, fdec);
+	CHECK_INTRA_X3(intra_satd_x3_4x4, fdec);
+	CHECK_INTRA_X3(intra_sad_x3_8x8, edge);
+	CHECK_INTRA_X3(intra_sa8d_x3_8x8, edge);
+	CHECK_INTRA_X3(intra_sad_x3_8x8c, fdec);
+	CHECK_INTRA_X3(intra_satd_x3_8x8c, fdec);
+	CHECK_INTRA_X3(intra_sad_x3_8x16c, fdec);
+	CHECK_INTRA_X3(intra_satd_x3_8x16c, fdec);
+	CHECK_INTRA_X3(intra_sad_x3_16x16, fdec);
+	CHECK_INTRA_X3(intra_satd_x3_16x16, fdec);
+#undef CHECK_INTRA_X3
+#undef CHECK_ONE
+
+	if (!gBench) {
+		return;
+	}
+
+	fillBuffers(0);
+	char label[32];
+	int res[4];
+	pixel* const pix1 = pbuf1 + 8;
+	pixel* const pix2 = pbuf2 + 8;
+	const intptr_t stride = 64;
+#define BENCH_SIZES(name, count, ...) \
+	for (int size = 0;size < (count);++size) { \
+		snprintf(label, sizeof(label), "%s_%s", #name, kPixelNames[size]); \
+		BENCH(label, name[size], __VA_ARGS__); \
+	}
+	BENCH_SIZES(sad, 8, fn(pix1, stride, pix2, stride));
+	BENCH_SIZES(sad_aligned, 8, fn(pbuf1, stride, pbuf2, stride));
+	BENCH_SIZES(ssd, 8, fn(pix1, stride, pix2, stride));
+	BENCH_SIZES(satd, 8, fn(pix1, stride, pix2, stride));
+	BENCH_SIZES(sa8d, 4, fn(pix1, stride, pix2, stride));
+	BENCH_SIZES(hadamard_ac, 4, fn(pix1, stride));
+	BENCH_SIZES(var, 4, fn(pix1, stride));
+	BENCH_SIZES(var2, 4, fn(pix1, stride, pix2, stride, res));
+	BENCH_SIZES(sad_x3, 7, fn(fenc, pix2, pix2 + 1, pix2 + 2 * stride, stride, res));
+	BENCH_SIZES(sad_x4, 7, fn(fenc, pix2, pix2 + 1, pix2 + 2 * stride, pix2 + 3, stride, res));
+	BENCH_SIZES(satd_x3, 7, fn(fenc, pix2, pix2 + 1, pix2 + 2 * stride, stride, res));
+	BENCH_SIZES(satd_x4, 7, fn(fenc, pix2, pix2 + 1, pix2 + 2 * stride, pix2 + 3, stride, res));
+	{
+		// A row of 64 candidates, a quarter of them under the threshold
+		int encDC[4] = {4000, 4100, 3900, 4050};
+		uint16_t sums[80];
+		uint16_t costMvx[64];
+		int16_t mvs[64];
+		for (int i = 0;i < 80;++i) {
+			sums[i] = 3700 + rand() % 800;
+		}
+		for (int i = 0;i < 64;++i) {
+			costMvx[i] = rand() & 0x3f;
+		}
+		BENCH_SIZES(ads, 7, fn(encDC, sums, 16, costMvx, mvs, 64, 600));
+	}
+#undef BENCH_SIZES
+	{
+		uint64_t ssdU, ssdV;
+		int sums[2][4];
+		int sum0[5][4], sum1[5][4];
+		ref.ssim_4x4x2_core(pix1, stride, pix2, stride, (int(*)[4])sum0[0]);
+		ref.ssim_4x4x2_core(pix1 + 4 * stride, stride, pix2 + 4 * stride, stride, (int(*)[4])sum1[0]);
+		for (int i = 1;i < 5;++i) {
+			memcpy(sum0[i], sum0[0], sizeof(sum0[0]));
+			memcpy(sum1[i], sum1[0], sizeof(sum1[0]));
+		}
+		BENCH("ssd_nv12_core", ssd_nv12_core, fn(pix1, stride, pix2, stride, 24, 8, &ssdU, &ssdV));
+		BENCH("ssim_4x4x2_core", ssim_4x4x2_core, fn(pix1, stride, pix2, stride, sums));
+		BENCH("ssim_end4", ssim_end4, fn(sum0, sum1, 4));
+	}
+	BENCH("vsad", vsad, fn(pix1, stride, 16));
+	BENCH("asd8", asd8, fn(pix1, stride, pix2, stride, 16));
+
+	pixel* const fdec = pbuf2 + FDEC_STRIDE + 8;
+	BENCH("intra_sad_x3_4x4", intra_sad_x3_4x4, fn(fenc, fdec, res));
+	BENCH("intra_satd_x3_4x4", intra_satd_x3_4x4, fn(fenc, fdec, res));
+	BENCH("intra_sad_x3_8x8", intra_sad_x3_8x8, fn(fenc, pbuf2, res));
+	BENCH("intra_sa8d_x3_8x8", intra_sa8d_x3_8x8, fn(fenc, pbuf2, res));
+	BENCH("intra_sad_x3_8x8c", intra_sad_x3_8x8c, fn(fenc, fdec, res));
+	BENCH("intra_satd_x3_8x8c", intra_satd_x3_8x8c, fn(fenc, fdec, res));
+	BENCH("intra_sad_x3_8x16c", intra_sad_x3_8x16c, fn(fenc, fdec, res));
+	BENCH("intra_satd_x3_8x16c", intra_satd_x3_8x16c, fn(fenc, fdec, res));
+	BENCH("intra_sad_x3_16x16", intra_sad_x3_16x16, fn(fenc, fdec, res));
+	BENCH("intra_satd_x3_16x16", intra_satd_x3_16x16, fn(fenc, fdec, res));
+}
+
+// Planes for motion compensation: a 128x96 area with the block near the centre
+static const int kMCStride = 128;
+static const int kMCSize = kMCStride * 96;
+static const int kMCOrigin = 40 * kMCStride + 40;
+static pixel mcPlanes[4][kMCSize];
+ALIGNED_16(static pixel mcDstRef[kMCSize]);
+ALIGNED_16(static pixel mcDstOpt[kMCSize]);
+
+static void fillMC(int pattern) {
+	for (int p = 0;p < 4;++p) {
+		for (int i = 0;i < kMCSize;++i) {
+			mcPlanes[p][i] = pattern == 0 ? rand() & 0xff : (pattern == 1 ? (p & 1) * 0xff : ((rand() & 1) ? 0xff : 0));
+		}
+	}
+
+	memset(mcDstRef, 0x55, sizeof(mcDstRef));
+	memset(mcDstOpt, 0x55, sizeof(mcDstOpt));
+}
+
+static void randomWeight(x264_weight_t* w, weight_fn_t* fn) {
+	memset(w, 0, sizeof(*w));
+	if (rand() & 1) {
+		w->i_scale = rand() % 128;
+		w->i_denom = rand() % 8;
+		w->i_offset = rand() % 256 - 128;
+		w->weightfn = fn;
+	}
+}
+
+static bool sameBlock(const pixel* a, intptr_t strideA, const pixel* b, intptr_t strideB, int w, int h) {
+	for (int y = 0;y < h;++y) {
+		if (memcmp(a + y * strideA, b + y * strideB, w * sizeof(pixel))) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void checkMC(const char* level, int cpu) {
+	x264_mc_functions_t ref, opt;
+	x264_mc_init(0, &ref, 0);
+	x264_mc_init(cpu, &opt, 0);
+
+#define CHECK_MC(label, name, ...) \
+	if (opt.name != ref.name) { \
+		bool ok = true; \
+		markTested(opt.name); \
+		for (int it = 0;it < kIterations && ok;++it) { \
+			fillMC(it % 3); \
+			__VA_ARGS__; \
+		} \
+		report(level, label, ok); \
+	}
+
+	CHECK_MC("avg", avg[PIXEL_16x16], {
+		for (int size = 0;size < 12 && ok;++size) {
+			markTested(opt.avg[size]);
+			const int weight = (it & 1) ? 32 : rand() % 193 - 64;
+			const intptr_t stride1 = 16 + rand() % 49, stride2 = 16 + rand() % 49;
+			pixel* src1 = mcPlanes[0] + kMCOrigin + rand() % 16;
+			pixel* src2 = mcPlanes[1] + kMCOrigin + rand() % 16;
+			ref.avg[size](mcDstRef, kMCStride, src1, stride1, src2, stride2, weight);
+			opt.avg[size](mcDstOpt, kMCStride, src1, stride1, src2, stride2, weight);
+			ok = !memcmp(mcDstRef, mcDstOpt, sizeof(mcDstRef));
+		}
+	});
+	CHECK_MC("weight", weight, {
+		for (int i = 0;i < 6 && ok;++i) {
+			x264_weight_t w;
+			randomWeight(&w, opt.weight);
+			w.weightfn = opt.weight;
+			const int height = 1 + rand() % 16;
+			pixel* src = mcPlanes[0] + kMCOrigin + rand() % 16;
+			ref.weight[i](mcDstRef, kMCStride, src, kMCStride, &w, height);
+			opt.weight[i](mcDstOpt, kMCStride, src, kMCStride, &w, height);
+			ok = !memcmp(mcDstRef, mcDstOpt, sizeof(mcDstRef));
+		}
+	});
+	CHECK_MC("mc_luma", mc_luma, {
+		static const int kWidths[] = {4, 8, 12, 16, 20};
+		pixel* src[4] = {mcPlanes[0] + kMCOrigin, mcPlanes[1] + kMCOrigin, mcPlanes[2] + kMCOrigin, mcPlanes[3] + kMCOrigin};
+		const int w = kWidths[rand() % 5], h = 2 << (rand() % 4);
+		const int mvx = rand() % 129 - 64, mvy = rand() % 129 - 64;
+		x264_weight_t weight;
+		randomWeight(&weight, opt.weight);
+		ref.mc_luma(mcDstRef, 32, src, kMCStride, mvx, mvy, w, h, &weight);
+		opt.mc_luma(mcDstOpt, 32, src, kMCStride, mvx, mvy, w, h, &weight);
+		ok = !memcmp(mcDstRef, mcDstOpt, sizeof(mcDstRef));
+	});
+	CHECK_MC("get_ref", get_ref, {
+		static const int kWidths[] = {4, 8, 12, 16, 20};
+		pixel* src[4] = {mcPlanes[0] + kMCOrigin, mcPlanes[1] + kMCOrigin, mcPlanes[2] + kMCOrigin, mcPlanes[3] + kMCOrigin};
+		const int w = kWidths[rand() % 5], h = 2 << (rand() % 4);
+		const int mvx = rand() % 129 - 64, mvy = rand() % 129 - 64;
+		x264_weight_t weight;
+		randomWeight(&weight, opt.weight);
+		intptr_t strideRef = 32, strideOpt = 32;
+		pixel* pRef = ref.get_ref(mcDstRef, &strideRef, src, kMCStride, mvx, mvy, w, h, &weight);
+		pixel* pOpt = opt.get_ref(mcDstOpt, &strideOpt, src, kMCStride, mvx, mvy, w, h, &weight);
+		ok = strideRef == strideOpt && (pRef == mcDstRef) == (pOpt == mcDstOpt)
+		     && sameBlock(pRef, strideRef, pOpt, strideOpt, w, h);
+	});
+	CHECK_MC("mc_chroma", mc_chroma, {
+		const int w = 2 << (rand() % 3), h = 2 << (rand() % 4);
+		const int mvx = rand() % 129 - 64, mvy = rand() % 129 - 64;
+		pixel* src = mcPlanes[0] + kMCOrigin;
+		ref.mc_chroma(mcDstRef, mcDstRef + kMCSize / 2, 16, src, kMCStride, mvx, mvy, w, h);
+		opt.mc_chroma(mcDstOpt, mcDstOpt + kMCSize / 2, 16, src, kMCStride, mvx, mvy, w, h);
+		ok = !memcmp(mcDstRef, mcDstOpt, sizeof(mcDstRef));
+	});
+	CHECK_MC("hpel_filter", hpel_filter, {
+		// three destination planes of 32 rows each, filtered from mcPlanes[0]
+		ALIGNED_16(int16_t buf[kMCStride + 32]);
+		const int width = 1 + rand() % 96;
+		const int height = 1 + rand() % 24;
+		const int offs = 4 * kMCStride + 16;
+		pixel* src = mcPlanes[0] + offs;
+		ref.hpel_filter(mcDstRef + offs, mcDstRef + 32 * kMCStride + offs, mcDstRef + 64 * kMCStride - 8 * kMCStride + offs,
+		                src, kMCStride, width, height, buf);
+		opt.hpel_filter(mcDstOpt + offs, mcDstOpt + 32 * kMCStride + offs, mcDstOpt + 64 * kMCStride - 8 * kMCStride + offs,
+		                src, kMCStride, width, height, buf);
+		ok = !memcmp(mcDstRef, mcDstOpt, sizeof(mcDstRef));
+	});
+#undef CHECK_MC
+
+	if (!gBench) {
+		return;
+	}
+
+	static const char* const kAvgNames[] = {"16x16", "16x8", "8x16", "8x8", "8x4", "4x8", "4x4", "4x16",
+	                                        "4x2", "2x8", "2x4", "2x2"};
+	char label[32];
+	fillMC(0);
+	pixel* src[4] = {mcPlanes[0] + kMCOrigin, mcPlanes[1] + kMCOrigin, mcPlanes[2] + kMCOrigin, mcPlanes[3] + kMCOrigin};
+	for (int size = 0;size < 12;++size) {
+		snprintf(label, sizeof(label), "avg_%s", kAvgNames[size]);
+		BENCH(label, avg[size], fn(mcDstOpt, kMCStride, src[0], kMCStride, src[1], kMCStride, 20));
+	}
+	x264_weight_t w;
+	memset(&w, 0, sizeof(w));
+	w.i_scale = 45;
+	w.i_denom = 5;
+	w.i_offset = -3;
+	// weight[] is indexed by width / 4
+	for (int i = 1;i < 6;++i) {
+		w.weightfn = opt.weight;
+		snprintf(label, sizeof(label), "weight_w%d", i * 4);
+		BENCH(label, weight[i], fn(mcDstOpt, kMCStride, src[0], kMCStride, &w, 16));
+	}
+	const x264_weight_t* noWeight = &x264_weight_none[0];
+	intptr_t refStride = 32;
+	BENCH("mc_luma_16x16_qpel", mc_luma, fn(mcDstOpt, 32, src, kMCStride, 5, 3, 16, 16, noWeight));
+	BENCH("mc_luma_8x8_hpel", mc_luma, fn(mcDstOpt, 32, src, kMCStride, 2, 0, 8, 8, noWeight));
+	BENCH("get_ref_16x16_qpel", get_ref, refStride = 32; fn(mcDstOpt, &refStride, src, kMCStride, 5, 3, 16, 16, noWeight));
+	BENCH("mc_chroma_8x8", mc_chroma, fn(mcDstOpt, mcDstOpt + kMCSize / 2, 16, src[0], kMCStride, 3, 5, 8, 8));
+	BENCH("mc_chroma_4x4", mc_chroma, fn(mcDstOpt, mcDstOpt + kMCSize / 2, 16, src[0], kMCStride, 3, 5, 4, 4));
+	{
+		ALIGNED_16(int16_t buf[kMCStride + 32]);
+		const int offs = 4 * kMCStride + 16;
+		BENCH("hpel_filter_64x16", hpel_filter, fn(mcDstOpt + offs, mcDstOpt + 32 * kMCStride + offs,
+		      mcDstOpt + 56 * kMCStride + offs, src[0] - kMCOrigin + offs, kMCStride, 64, 16, buf));
+	}
+}
+
+// Transforms read fenc (FENC_STRIDE) and fdec (FDEC_STRIDE) blocks
+ALIGNED_16(static pixel fdecRef[FDEC_STRIDE * 16]);
+ALIGNED_16(static pixel fdecOpt[FDEC_STRIDE * 16]);
+ALIGNED_16(static dctcoef dctIn[16][16]);
+ALIGNED_16(static dctcoef dctIn8[4][64]);
+ALIGNED_16(static dctcoef dctRef[16][16]);
+ALIGNED_16(static dctcoef dctOpt[16][16]);
+ALIGNED_16(static dctcoef dctRef8[4][64]);
+ALIGNED_16(static dctcoef dctOpt8[4][64]);
+
+// fenc and fdec from the pixel buffers; with `same` the residual is zero
+static void fillBlocks(int pattern, bool same) {
+	fillBuffers(pattern);
+	for (int y = 0;y < 16;++y) {
+		for (int x = 0;x < 16;++x) {
+			fdecRef[y * FDEC_STRIDE + x] = same ? fenc[y * FENC_STRIDE + x] : pbuf2[y * 16 + x];
+		}
+	}
+
+	memcpy(fdecOpt, fdecRef, sizeof(fdecRef));
+}
+
+static void checkDCT(const char* level, int cpu) {
+	x264_dct_function_t ref, opt;
+	x264_dct_init(0, &ref);
+	x264_dct_init(cpu, &opt);
+
+#define CHECK_DCT(name, ...) \
+	if (opt.name != ref.name) { \
+		bool ok = true; \
+		markTested(opt.name); \
+		for (int it = 0;it < kIterations && ok;++it) { \
+			fillBlocks(it % 3, false); \
+			ref.sub16x16_dct(dctIn, fenc, fdecRef); \
+			ref.sub16x16_dct8(dctIn8, fenc, fdecRef); \
+			memset(dctRef, 0, sizeof(dctRef)); \
+			memset(dctOpt, 0, sizeof(dctOpt)); \
+			memset(dctRef8, 0, sizeof(dctRef8)); \
+			memset(dctOpt8, 0, sizeof(dctOpt8)); \
+			__VA_ARGS__; \
+			ok = ok && !memcmp(dctRef, dctOpt, sizeof(dctRef)) && !memcmp(dctRef8, dctOpt8, sizeof(dctRef8)) \
+			     && !memcmp(fdecRef, fdecOpt, sizeof(fdecRef)); \
+		} \
+		report(level, #name, ok); \
+	}
+
+	CHECK_DCT(sub4x4_dct, {
+		ref.sub4x4_dct(dctRef[0], fenc, fdecRef);
+		opt.sub4x4_dct(dctOpt[0], fenc, fdecOpt);
+	});
+	CHECK_DCT(sub8x8_dct, {
+		ref.sub8x8_dct(dctRef, fenc, fdecRef);
+		opt.sub8x8_dct(dctOpt, fenc, fdecOpt);
+	});
+	CHECK_DCT(sub16x16_dct, {
+		ref.sub16x16_dct(dctRef, fenc, fdecRef);
+		opt.sub16x16_dct(dctOpt, fenc, fdecOpt);
+	});
+	CHECK_DCT(sub8x8_dct_dc, {
+		ref.sub8x8_dct_dc(dctRef[0], fenc, fdecRef);
+		opt.sub8x8_dct_dc(dctOpt[0], fenc, fdecOpt);
+	});
+	CHECK_DCT(sub8x16_dct_dc, {
+		ref.sub8x16_dct_dc(dctRef[0], fenc, fdecRef);
+		opt.sub8x16_dct_dc(dctOpt[0], fenc, fdecOpt);
+	});
+	CHECK_DCT(sub8x8_dct8, {
+		ref.sub8x8_dct8(dctRef8[0], fenc, fdecRef);
+		opt.sub8x8_dct8(dctOpt8[0], fenc, fdecOpt);
+	});
+	CHECK_DCT(sub16x16_dct8, {
+		ref.sub16x16_dct8(dctRef8, fenc, fdecRef);
+		opt.sub16x16_dct8(dctOpt8, fenc, fdecOpt);
+	});
+
+	// The inverse transforms get the forward transform of the residual
+	CHECK_DCT(add4x4_idct, {
+		memcpy(dctRef, dctIn, sizeof(dctIn));
+		memcpy(dctOpt, dctIn, sizeof(dctIn));
+		ref.add4x4_idct(fdecRef, dctRef[0]);
+		opt.add4x4_idct(fdecOpt, dctOpt[0]);
+	});
+	CHECK_DCT(add8x8_idct, {
+		memcpy(dctRef, dctIn, sizeof(dctIn));
+		memcpy(dctOpt, dctIn, sizeof(dctIn));
+		ref.add8x8_idct(fdecRef, dctRef);
+		opt.add8x8_idct(fdecOpt, dctOpt);
+	});
+	CHECK_DCT(add16x16_idct, {
+		memcpy(dctRef, dctIn, sizeof(dctIn));
+		memcpy(dctOpt, dctIn, sizeof(dctIn));
+		ref.add16x16_idct(fdecRef, dctRef);
+		opt.add16x16_idct(fdecOpt, dctOpt);
+	});
+	CHECK_DCT(add8x8_idct_dc, {
+		for (int i = 0;i < 16;++i) {
+			dctRef[0][i] = dctOpt[0][i] = dctIn[i][0];
+		}
+		ref.add8x8_idct_dc(fdecRef, dctRef[0]);
+		opt.add8x8_idct_dc(fdecOpt, dctOpt[0]);
+	});
+	CHECK_DCT(add16x16_idct_dc, {
+		for (int i = 0;i < 16;++i) {
+			dctRef[0][i] = dctOpt[0][i] = dctIn[i][0];
+		}
+		ref.add16x16_idct_dc(fdecRef, dctRef[0]);
+		opt.add16x16_idct_dc(fdecOpt, dctOpt[0]);
+	});
+	// add8x8_idct8 in C leaves its first pass in dct[], so only the pixels count
+	CHECK_DCT(add8x8_idct8, {
+		memcpy(dctRef8, dctIn8, sizeof(dctIn8));
+		memcpy(dctOpt8, dctIn8, sizeof(dctIn8));
+		ref.add8x8_idct8(fdecRef, dctRef8[0]);
+		opt.add8x8_idct8(fdecOpt, dctOpt8[0]);
+		memcpy(dctRef8, dctOpt8, sizeof(dctRef8));
+	});
+	CHECK_DCT(add16x16_idct8, {
+		memcpy(dctRef8, dctIn8, sizeof(dctIn8));
+		memcpy(dctOpt8, dctIn8, sizeof(dctIn8));
+		ref.add16x16_idct8(fdecRef, dctRef8);
+		opt.add16x16_idct8(fdecOpt, dctOpt8);
+		memcpy(dctRef8, dctOpt8, sizeof(dctRef8));
+	});
+	CHECK_DCT(dct4x4dc, {
+		for (int i = 0;i < 16;++i) {
+			dctRef[0][i] = dctOpt[0][i] = dctIn[i][0];
+		}
+		ref.dct4x4dc(dctRef[0]);
+		opt.dct4x4dc(dctOpt[0]);
+	});
+	CHECK_DCT(idct4x4dc, {
+		for (int i = 0;i < 16;++i) {
+			dctRef[0][i] = dctIn[i][0];
+		}
+		ref.dct4x4dc(dctRef[0]);
+		memcpy(dctOpt, dctRef, sizeof(dctRef));
+		ref.idct4x4dc(dctRef[0]);
+		opt.idct4x4dc(dctOpt[0]);
+	});
+#undef CHECK_DCT
+
+	if (!gBench) {
+		return;
+	}
+
+	fillBlocks(0, false);
+	ref.sub16x16_dct(dctIn, fenc, fdecRef);
+	ref.sub16x16_dct8(dctIn8, fenc, fdecRef);
+	BENCH("sub4x4_dct", sub4x4_dct, fn(dctOpt[0], fenc, fdecOpt));
+	BENCH("sub8x8_dct", sub8x8_dct, fn(dctOpt, fenc, fdecOpt));
+	BENCH("sub16x16_dct", sub16x16_dct, fn(dctOpt, fenc, fdecOpt));
+	BENCH("sub8x8_dct_dc", sub8x8_dct_dc, fn(dctOpt[0], fenc, fdecOpt));
+	BENCH("sub8x16_dct_dc", sub8x16_dct_dc, fn(dctOpt[0], fenc, fdecOpt));
+	BENCH("sub8x8_dct8", sub8x8_dct8, fn(dctOpt8[0], fenc, fdecOpt));
+	BENCH("sub16x16_dct8", sub16x16_dct8, fn(dctOpt8, fenc, fdecOpt));
+	BENCH("add4x4_idct", add4x4_idct, fn(fdecOpt, dctIn[0]));
+	BENCH("add8x8_idct", add8x8_idct, fn(fdecOpt, dctIn));
+	BENCH("add16x16_idct", add16x16_idct, fn(fdecOpt, dctIn));
+	BENCH("add8x8_idct_dc", add8x8_idct_dc, fn(fdecOpt, dctIn[0]));
+	BENCH("add16x16_idct_dc", add16x16_idct_dc, fn(fdecOpt, dctIn[0]));
+	BENCH("add8x8_idct8", add8x8_idct8, memcpy(dctOpt8[0], dctIn8[0], sizeof(dctIn8[0])); fn(fdecOpt, dctOpt8[0]));
+	BENCH("add16x16_idct8", add16x16_idct8, memcpy(dctOpt8, dctIn8, sizeof(dctIn8)); fn(fdecOpt, dctOpt8));
+	BENCH("dct4x4dc", dct4x4dc, memcpy(dctOpt[0], dctIn[0], sizeof(dctIn[0])); fn(dctOpt[0]));
+	BENCH("idct4x4dc", idct4x4dc, memcpy(dctOpt[0], dctIn[0], sizeof(dctIn[0])); fn(dctOpt[0]));
+}
+
+static void checkZigzag(const char* level, int cpu, bool interlaced) {
+	x264_zigzag_function_t refFrame, refField, optFrame, optField;
+	x264_zigzag_init(0, &refFrame, &refField);
+	x264_zigzag_init(cpu, &optFrame, &optField);
+	const x264_zigzag_function_t& ref = interlaced ? refField : refFrame;
+	const x264_zigzag_function_t& opt = interlaced ? optField : optFrame;
+	const char* suffix = interlaced ? "_field" : "_frame";
+	char label[32];
+
+#define CHECK_ZIGZAG(name, ...) \
+	if (opt.name != ref.name) { \
+		bool ok = true; \
+		markTested(opt.name); \
+		for (int it = 0;it < kIterations && ok;++it) { \
+			fillBlocks(it % 3, it % 4 == 3); \
+			for (int i = 0;i < 64;++i) { \
+				dctIn8[0][i] = (rand() & 3) ? 0 : rand() % 4096 - 2048; \
+			} \
+			memset(dctRef8, 0x55, sizeof(dctRef8)); \
+			memset(dctOpt8, 0x55, sizeof(dctOpt8)); \
+			__VA_ARGS__; \
+			ok = ok && !memcmp(dctRef8, dctOpt8, sizeof(dctRef8)) && !memcmp(fdecRef, fdecOpt, sizeof(fdecRef)); \
+		} \
+		snprintf(label, sizeof(label), "%s%s", #name, suffix); \
+		report(level, label, ok); \
+	}
+
+	CHECK_ZIGZAG(scan_8x8, {
+		ref.scan_8x8(dctRef8[0], dctIn8[0]);
+		opt.scan_8x8(dctOpt8[0], dctIn8[0]);
+	});
+	CHECK_ZIGZAG(scan_4x4, {
+		ref.scan_4x4(dctRef8[0], dctIn8[0]);
+		opt.scan_4x4(dctOpt8[0], dctIn8[0]);
+	});
+	CHECK_ZIGZAG(sub_8x8, {
+		ok = ref.sub_8x8(dctRef8[0], fenc, fdecRef) == opt.sub_8x8(dctOpt8[0], fenc, fdecOpt);
+	});
+	CHECK_ZIGZAG(sub_4x4, {
+		ok = ref.sub_4x4(dctRef8[0], fenc, fdecRef) == opt.sub_4x4(dctOpt8[0], fenc, fdecOpt);
+	});
+	CHECK_ZIGZAG(sub_4x4ac, {
+		dctcoef dcRef = 1, dcOpt = 2;
+		ok = ref.sub_4x4ac(dctRef8[0], fenc, fdecRef, &dcRef) == opt.sub_4x4ac(dctOpt8[0], fenc, fdecOpt, &dcOpt)
+		     && dcRef == dcOpt;
+	});
+	CHECK_ZIGZAG(interleave_8x8_cavlc, {
+		uint8_t nnzRef[16], nnzOpt[16];
+		memset(nnzRef, 0x55, sizeof(nnzRef));
+		memset(nnzOpt, 0x55, sizeof(nnzOpt));
+		for (int i = 0;i < 4;++i) {
+			if (rand() & 1) {
+				for (int j = 0;j < 16;++j) {
+					dctIn8[0][i + j * 4] = 0;
+				}
+			}
+		}
+		ref.interleave_8x8_cavlc(dctRef8[0], dctIn8[0], nnzRef);
+		opt.interleave_8x8_cavlc(dctOpt8[0], dctIn8[0], nnzOpt);
+		ok = !memcmp(nnzRef, nnzOpt, sizeof(nnzRef));
+	});
+#undef CHECK_ZIGZAG
+
+	if (!gBench) {
+		return;
+	}
+
+	uint8_t nnz[16];
+	dctcoef dc;
+	fillBlocks(0, false);
+	for (int i = 0;i < 64;++i) {
+		dctIn8[0][i] = (rand() & 3) ? 0 : rand() % 4096 - 2048;
+	}
+#define BENCH_ZIGZAG(name, ...) \
+	snprintf(label, sizeof(label), "%s%s", #name, suffix); \
+	BENCH(label, name, __VA_ARGS__)
+	BENCH_ZIGZAG(scan_8x8, fn(dctOpt8[0], dctIn8[0]));
+	BENCH_ZIGZAG(scan_4x4, fn(dctOpt8[0], dctIn8[0]));
+	BENCH_ZIGZAG(sub_8x8, fn(dctOpt8[0], fenc, fdecOpt));
+	BENCH_ZIGZAG(sub_4x4, fn(dctOpt8[0], fenc, fdecOpt));
+	BENCH_ZIGZAG(sub_4x4ac, fn(dctOpt8[0], fenc, fdecOpt, &dc));
+	BENCH_ZIGZAG(interleave_8x8_cavlc, fn(dctOpt8[0], dctIn8[0], nnz));
+#undef BENCH_ZIGZAG
+}
+
+// Quant tables: mf and bias stay below 32768, as (bias + |coef|) * mf must
+// fit in an int for the C version
+ALIGNED_16(static udctcoef quantMf[64]);
+ALIGNED_16(static udctcoef quantBias[64]);
+static int dequantMf[6][64];
+static uint32_t sumRef[64];
+static uint32_t sumOpt[64];
+
+// Pattern 0 is full range, 1 sparse small levels with empty 4x4 blocks,
+// 2 sparse levels in [-1,1] (the decimate case)
+static void fillCoefs(int pattern) {
+	for (int i = 0;i < 4 * 64;++i) {
+		dctcoef* dct = dctIn8[0] + i;
+		switch (pattern) {
+		case 0:
+			*dct = (dctcoef)(rand() & 0xffff);
+			break;
+		case 1:
+			*dct = (rand() & 3) ? 0 : rand() % 7 - 3;
+			break;
+		default:
+			*dct = (rand() & 7) ? 0 : (rand() & 1) * 2 - 1;
+			break;
+		}
+	}
+	if (pattern) {
+		for (int i = 0;i < 16;++i) {
+			if (rand() & 1) {
+				memset(dctIn8[0] + i * 16, 0, 16 * sizeof(dctcoef));
+			}
+		}
+	}
+
+	// Half the time bias * mf < 65536, as in x264's own tables
+	const bool small = rand() & 1;
+	for (int i = 0;i < 64;++i) {
+		quantMf[i] = 1 + rand() % 32767;
+		quantBias[i] = X264_MIN(rand() % (small ? 1 + 65535 / quantMf[i] : 32768), 32767);
+	}
+	for (int i = 0;i < 6;++i) {
+		for (int j = 0;j < 64;++j) {
+			dequantMf[i][j] = 16 + rand() % 6360;
+		}
+	}
+}
+
+// Dequant input whose results fit in a dctcoef; quant never produces
+// larger levels
+static void fillLevels(int qbits) {
+	const int lim = qbits >= 0 ? (32767 >> qbits) / 6376 : ((32767 << -qbits) - (1 << -qbits)) / 6376;
+	for (int i = 0;i < 64;++i) {
+		dctIn8[0][i] = rand() % (2 * lim + 1) - lim;
+	}
+	memcpy(dctRef8, dctIn8, sizeof(dctIn8));
+	memcpy(dctOpt8, dctIn8, sizeof(dctIn8));
+}
+
+static bool sameRunLevel(int totalRef, const x264_run_level_t& a, int totalOpt, const x264_run_level_t& b) {
+	return totalRef == totalOpt && a.last == b.last && a.mask == b.mask
+	       && !memcmp(a.level, b.level, totalRef * sizeof(dctcoef));
+}
+
+static void checkQuant(const char* level, int cpu) {
+	x264_quant_function_t ref, opt;
+	x264_quant_init(NULL, 0, &ref);
+	x264_quant_init(NULL, cpu, &opt);
+	x264_run_level_t runRef, runOpt;
+
+#define CHECK_QUANT(label, name, ...) \
+	if (opt.name != ref.name) { \
+		bool ok = true; \
+		markTested(opt.name); \
+		for (int it = 0;it < kIterations * 4 && ok;++it) { \
+			fillCoefs(it % 3); \
+			memcpy(dctRef8, dctIn8, sizeof(dctIn8)); \
+			memcpy(dctOpt8, dctIn8, sizeof(dctIn8)); \
+			__VA_ARGS__; \
+			ok = ok && !memcmp(dctRef8, dctOpt8, sizeof(dctRef8)); \
+		} \
+		report(level, label, ok); \
+	}
+
+	CHECK_QUANT("quant_4x4", quant_4x4, {
+		ok = ref.quant_4x4(dctRef8[0], quantMf, quantBias) == opt.quant_4x4(dctOpt8[0], quantMf, quantBias);
+	});
+	CHECK_QUANT("quant_8x8", quant_8x8, {
+		ok = ref.quant_8x8(dctRef8[0], quantMf, quantBias) == opt.quant_8x8(dctOpt8[0], quantMf, quantBias);
+	});
+	CHECK_QUANT("quant_4x4x4", quant_4x4x4, {
+		ok = ref.quant_4x4x4((dctcoef(*)[16])dctRef8[0], quantMf, quantBias)
+		     == opt.quant_4x4x4((dctcoef(*)[16])dctOpt8[0], quantMf, quantBias);
+	});
+	CHECK_QUANT("quant_4x4_dc", quant_4x4_dc, {
+		ok = ref.quant_4x4_dc(dctRef8[0], quantMf[0], quantBias[0]) == opt.quant_4x4_dc(dctOpt8[0], quantMf[0], quantBias[0]);
+	});
+	CHECK_QUANT("quant_2x2_dc", quant_2x2_dc, {
+		ok = ref.quant_2x2_dc(dctRef8[0], quantMf[0], quantBias[0]) == opt.quant_2x2_dc(dctOpt8[0], quantMf[0], quantBias[0]);
+	});
+	CHECK_QUANT("dequant_4x4", dequant_4x4, {
+		const int qp = rand() % (QP_MAX_SPEC + 1);
+		fillLevels(qp / 6 - 4);
+		ref.dequant_4x4(dctRef8[0], (int(*)[16])dequantMf, qp);
+		opt.dequant_4x4(dctOpt8[0], (int(*)[16])dequantMf, qp);
+	});
+	CHECK_QUANT("dequant_8x8", dequant_8x8, {
+		const int qp = rand() % (QP_MAX_SPEC + 1);
+		fillLevels(qp / 6 - 6);
+		ref.dequant_8x8(dctRef8[0], dequantMf, qp);
+		opt.dequant_8x8(dctOpt8[0], dequantMf, qp);
+	});
+	CHECK_QUANT("dequant_4x4_dc", dequant_4x4_dc, {
+		const int qp = rand() % (QP_MAX_SPEC + 1);
+		fillLevels(qp / 6 - 6);
+		ref.dequant_4x4_dc(dctRef8[0], (int(*)[16])dequantMf, qp);
+		opt.dequant_4x4_dc(dctOpt8[0], (int(*)[16])dequantMf, qp);
+	});
+	CHECK_QUANT("denoise_dct", denoise_dct, {
+		const int size = (rand() & 1) ? 64 : 16;
+		for (int i = 0;i < 64;++i) {
+			sumRef[i] = sumOpt[i] = rand();
+		}
+		ref.denoise_dct(dctRef8[0], sumRef, quantBias, size);
+		opt.denoise_dct(dctOpt8[0], sumOpt, quantBias, size);
+		ok = !memcmp(sumRef, sumOpt, sizeof(sumRef));
+	});
+	CHECK_QUANT("decimate_score15", decimate_score15, {
+		ok = ref.decimate_score15(dctRef8[0]) == opt.decimate_score15(dctOpt8[0]);
+	});
+	CHECK_QUANT("decimate_score16", decimate_score16, {
+		ok = ref.decimate_score16(dctRef8[0]) == opt.decimate_score16(dctOpt8[0]);
+	});
+	CHECK_QUANT("decimate_score64", decimate_score64, {
+		ok = ref.decimate_score64(dctRef8[0]) == opt.decimate_score64(dctOpt8[0]);
+	});
+	CHECK_QUANT("coeff_last4", coeff_last4, {
+		ok = ref.coeff_last4(dctRef8[0]) == opt.coeff_last4(dctOpt8[0]);
+	});
+	CHECK_QUANT("coeff_last8", coeff_last8, {
+		ok = ref.coeff_last8(dctRef8[0]) == opt.coeff_last8(dctOpt8[0]);
+	});
+	CHECK_QUANT("coeff_last15", coeff_last[DCT_LUMA_AC], {
+		ok = ref.coeff_last[DCT_LUMA_AC](dctRef8[0] + 1) == opt.coeff_last[DCT_LUMA_AC](dctOpt8[0] + 1);
+	});
+	CHECK_QUANT("coeff_last16", coeff_last[DCT_LUMA_4x4], {
+		ok = ref.coeff_last[DCT_LUMA_4x4](dctRef8[0]) == opt.coeff_last[DCT_LUMA_4x4](dctOpt8[0]);
+	});
+	CHECK_QUANT("coeff_last64", coeff_last[DCT_LUMA_8x8], {
+		ok = ref.coeff_last[DCT_LUMA_8x8](dctRef8[0]) == opt.coeff_last[DCT_LUMA_8x8](dctOpt8[0]);
+	});
+
+	// Level-run is only called on blocks with a nonzero coefficient
+#define CHECK_LEVEL_RUN(label, name, offset, count) \
+	CHECK_QUANT(label, name, { \
+		const int i = (offset) + rand() % (count); \
+		dctRef8[0][i] = dctOpt8[0][i] = 1 + (rand() & 1); \
+		const int totalRef = ref.name(dctRef8[0] + (offset), &runRef); \
+		const int totalOpt = opt.name(dctOpt8[0] + (offset), &runOpt); \
+		ok = sameRunLevel(totalRef, runRef, totalOpt, runOpt); \
+	})
+	CHECK_LEVEL_RUN("coeff_level_run4", coeff_level_run4, 0, 4);
+	CHECK_LEVEL_RUN("coeff_level_run8", coeff_level_run8, 0, 8);
+	CHECK_LEVEL_RUN("coeff_level_run15", coeff_level_run[DCT_LUMA_AC], 1, 15);
+	CHECK_LEVEL_RUN("coeff_level_run16", coeff_level_run[DCT_LUMA_4x4], 0, 16);
+#undef CHECK_LEVEL_RUN
+#undef CHECK_QUANT
+
+	if (!gBench) {
+		return;
+	}
+
+	fillCoefs(1);
+	for (int i = 0;i < 64;++i) {
+		quantMf[i] = 1 + rand() % 13107;
+		quantBias[i] = rand() % (1 + 65535 / quantMf[i]);
+	}
+	dctIn8[0][0] = dctIn8[0][1] = 1;
+	BENCH("quant_4x4", quant_4x4, memcpy(dctOpt8[0], dctIn8[0], 32); fn(dctOpt8[0], quantMf, quantBias));
+	BENCH("quant_8x8", quant_8x8, memcpy(dctOpt8[0], dctIn8[0], 128); fn(dctOpt8[0], quantMf, quantBias));
+	BENCH("quant_4x4x4", quant_4x4x4, memcpy(dctOpt8[0], dctIn8[0], 128); fn((dctcoef(*)[16])dctOpt8[0], quantMf, quantBias));
+	BENCH("quant_4x4_dc", quant_4x4_dc, memcpy(dctOpt8[0], dctIn8[0], 32); fn(dctOpt8[0], quantMf[0], quantBias[0]));
+	BENCH("quant_2x2_dc", quant_2x2_dc, memcpy(dctOpt8[0], dctIn8[0], 8); fn(dctOpt8[0], quantMf[0], quantBias[0]));
+	BENCH("dequant_4x4", dequant_4x4, memcpy(dctOpt8[0], dctIn8[0], 32); fn(dctOpt8[0], (int(*)[16])dequantMf, 26));
+	BENCH("dequant_8x8", dequant_8x8, memcpy(dctOpt8[0], dctIn8[0], 128); fn(dctOpt8[0], dequantMf, 26));
+	BENCH("dequant_4x4_dc", dequant_4x4_dc, memcpy(dctOpt8[0], dctIn8[0], 32); fn(dctOpt8[0], (int(*)[16])dequantMf, 26));
+	BENCH("denoise_dct", denoise_dct, memcpy(dctOpt8[0], dctIn8[0], 128); fn(dctOpt8[0], sumOpt, quantBias, 64));
+	BENCH("decimate_score15", decimate_score15, fn(dctIn8[0]));
+	BENCH("decimate_score16", decimate_score16, fn(dctIn8[0]));
+	BENCH("decimate_score64", decimate_score64, fn(dctIn8[0]));
+	BENCH("coeff_last4", coeff_last4, fn(dctIn8[0]));
+	BENCH("coeff_last8", coeff_last8, fn(dctIn8[0]));
+	BENCH("coeff_last15", coeff_last[DCT_LUMA_AC], fn(dctIn8[0] + 1));
+	BENCH("coeff_last16", coeff_last[DCT_LUMA_4x4], fn(dctIn8[0]));
+	BENCH("coeff_last64", coeff_last[DCT_LUMA_8x8], fn(dctIn8[0]));
+	BENCH("coeff_level_run4", coeff_level_run4, fn(dctIn8[0], &runOpt));
+	BENCH("coeff_level_run8", coeff_level_run8, fn(dctIn8[0], &runOpt));
+	BENCH("coeff_level_run15", coeff_level_run[DCT_LUMA_AC], fn(dctIn8[0] + 1, &runOpt));
+	BENCH("coeff_level_run16", coeff_level_run[DCT_LUMA_4x4], fn(dctIn8[0], &runOpt));
+}
+
+// Intra prediction: a block at (16, 8) of an FDEC_STRIDE buffer, so that the
+// left column, the top row and the top right are all inside it
+ALIGNED_16(static pixel predRef[FDEC_STRIDE * 40]);
+ALIGNED_16(static pixel predOpt[FDEC_STRIDE * 40]);
+
+static const char* const kPredict16x16Names[] = {"v", "h", "dc", "p", "dc_left", "dc_top", "dc_128"};
+static const char* const kPredictChromaNames[] = {"dc", "h", "v", "p", "dc_left", "dc_top", "dc_128"};
+static const char* const kPredict4x4Names[] = {"v", "h", "dc", "ddl", "ddr", "vr", "hd", "vl", "hu", "dc_left", "dc_top", "dc_128"};
+
+typedef struct {
+	x264_predict_t p16x16[7];
+	x264_predict_t p8x8c[7];
+	x264_predict_t p8x16c[7];
+	x264_predict_t p4x4[12];
+	x264_predict8x8_t p8x8[12];
+	x264_predict_8x8_filter_t filter;
+} PredictFunctions;
+
+static void initPredict(int cpu, PredictFunctions* pf) {
+	x264_predict_16x16_init(cpu, pf->p16x16);
+	x264_predict_8x8c_init(cpu, pf->p8x8c);
+	x264_predict_8x16c_init(cpu, pf->p8x16c);
+	x264_predict_4x4_init(cpu, pf->p4x4);
+	x264_predict_8x8_init(cpu, pf->p8x8, &pf->filter);
+}
+
+// Pattern 0 is random, 1 a random gradient (so that the plane modes reach both
+// ends of the clip), 2 random 0/255
+static void fillPredict(int pattern) {
+	const int dx = rand() % 33 - 16, dy = rand() % 33 - 16;
+	for (int i = 0;i < FDEC_STRIDE * 40;++i) {
+		switch (pattern) {
+		case 0:
+			predRef[i] = rand() & 0xff;
+			break;
+		case 1:
+			predRef[i] = x264_clip_pixel(128 + (i % FDEC_STRIDE - 16) * dx + (i / FDEC_STRIDE - 16) * dy);
+			break;
+		default:
+			predRef[i] = (rand() & 1) ? 0xff : 0;
+			break;
+		}
+	}
+
+	memcpy(predOpt, predRef, sizeof(predRef));
+}
+
+static void checkPredict(const char* level, int cpu) {
+	PredictFunctions ref, opt;
+	initPredict(0, &ref);
+	initPredict(cpu, &opt);
+	pixel* const srcRef = predRef + 8 * FDEC_STRIDE + 16;
+	pixel* const srcOpt = predOpt + 8 * FDEC_STRIDE + 16;
+	char label[64];
+
+#define CHECK_PREDICT(size, table, count, names, ...) \
+	for (int mode = 0;mode < (count);++mode) { \
+		if (opt.table[mode] == ref.table[mode]) { \
+			continue; \
+		} \
+		markTested(opt.table[mode]); \
+		bool ok = true; \
+		for (int it = 0;it < kIterations && ok;++it) { \
+			fillPredict(it % 3); \
+			__VA_ARGS__; \
+			ok = !memcmp(predRef, predOpt, sizeof(predRef)); \
+		} \
+		snprintf(label, sizeof(label), "predict_%s_%s", size, names[mode]); \
+		report(level, label, ok); \
+	}
+
+	CHECK_PREDICT("16x16", p16x16, 7, kPredict16x16Names, ref.p16x16[mode](srcRef); opt.p16x16[mode](srcOpt));
+	CHECK_PREDICT("8x8c", p8x8c, 7, kPredictChromaNames, ref.p8x8c[mode](srcRef); opt.p8x8c[mode](srcOpt));
+	CHECK_PREDICT("8x16c", p8x16c, 7, kPredictChromaNames, ref.p8x16c[mode](srcRef); opt.p8x16c[mode](srcOpt));
+	CHECK_PREDICT("4x4", p4x4, 12, kPredict4x4Names, ref.p4x4[mode](srcRef); opt.p4x4[mode](srcOpt));
+	ALIGNED_16(pixel edge[36]);
+	CHECK_PREDICT("8x8", p8x8, 12, kPredict4x4Names, {
+		ref.filter(srcRef, edge, MB_LEFT | MB_TOP | MB_TOPRIGHT | MB_TOPLEFT, MB_LEFT | MB_TOP | MB_TOPRIGHT);
+		ref.p8x8[mode](srcRef, edge);
+		opt.p8x8[mode](srcOpt, edge);
+	});
+#undef CHECK_PREDICT
+
+	if (opt.filter != ref.filter) {
+		markTested(opt.filter);
+		ALIGNED_16(pixel edgeRef[36]);
+		ALIGNED_16(pixel edgeOpt[36]);
+		bool ok = true;
+		for (int it = 0;it < kIterations * 4 && ok;++it) {
+			fillPredict(it % 3);
+			const int neighbors = (rand() & 1 ? MB_TOPLEFT : 0) | (rand() & 1 ? MB_TOPRIGHT : 0);
+			const int filters = MB_LEFT * (rand() & 1) | MB_TOP * (rand() & 1) | MB_TOPRIGHT * (rand() & 1);
+			for (int i = 0;i < 36;++i) {
+				edgeRef[i] = edgeOpt[i] = rand() & 0xff;
+			}
+			ref.filter(srcRef, edgeRef, neighbors, filters);
+			opt.filter(srcOpt, edgeOpt, neighbors, filters);
+			ok = !memcmp(edgeRef, edgeOpt, sizeof(edgeRef));
+		}
+		report(level, "predict_8x8_filter", ok);
+	}
+
+	if (!gBench) {
+		return;
+	}
+
+	fillPredict(0);
+	ref.filter(srcRef, edge, MB_LEFT | MB_TOP | MB_TOPRIGHT | MB_TOPLEFT, MB_LEFT | MB_TOP | MB_TOPRIGHT);
+	for (int mode = 0;mode < 7;++mode) {
+		snprintf(label, sizeof(label), "predict_16x16_%s", kPredict16x16Names[mode]);
+		BENCH(label, p16x16[mode], fn(srcOpt));
+	}
+	for (int mode = 0;mode < 7;++mode) {
+		snprintf(label, sizeof(label), "predict_8x8c_%s", kPredictChromaNames[mode]);
+		BENCH(label, p8x8c[mode], fn(srcOpt));
+	}
+	for (int mode = 0;mode < 7;++mode) {
+		snprintf(label, sizeof(label), "predict_8x16c_%s", kPredictChromaNames[mode]);
+		BENCH(label, p8x16c[mode], fn(srcOpt));
+	}
+	for (int mode = 0;mode < 12;++mode) {
+		snprintf(label, sizeof(label), "predict_8x8_%s", kPredict4x4Names[mode]);
+		BENCH(label, p8x8[mode], fn(srcOpt, edge));
+	}
+	for (int mode = 0;mode < 12;++mode) {
+		snprintf(label, sizeof(label), "predict_4x4_%s", kPredict4x4Names[mode]);
+		BENCH(label, p4x4[mode], fn(srcOpt));
+	}
+	BENCH("predict_8x8_filter", filter, fn(srcOpt, edge, MB_LEFT | MB_TOP | MB_TOPRIGHT | MB_TOPLEFT, MB_LEFT | MB_TOP | MB_TOPRIGHT));
+}
+
+// Deblocking input: a smooth random gradient with noise of varying amplitude,
+// so that all of the edge tests are taken both ways
+static const int kDeblockStride = 64;
+ALIGNED_16(static pixel deblockRef[kDeblockStride * 24]);
+ALIGNED_16(static pixel deblockOpt[kDeblockStride * 24]);
+
+static void fillDeblock(int pattern) {
+	const int base = rand() & 0xff;
+	const int noise = pattern == 0 ? 1 + rand() % 8 : pattern == 1 ? 1 + rand() % 48 : 256;
+	for (int i = 0;i < kDeblockStride * 24;++i) {
+		deblockRef[i] = x264_clip_pixel(base + (i & 15) + rand() % noise - noise / 2);
+	}
+
+	memcpy(deblockOpt, deblockRef, sizeof(deblockRef));
+}
+
+static void randomTc(int8_t tc[4]) {
+	for (int i = 0;i < 4;++i) {
+		tc[i] = rand() % 27 - 1;
+	}
+}
+
+static void checkDeblock(const char* level, int cpu) {
+	x264_deblock_function_t ref, opt;
+	x264_deblock_init(0, &ref, 0);
+	x264_deblock_init(cpu, &opt, 0);
+	pixel* const pixRef = deblockRef + 8 * kDeblockStride + 16;
+	pixel* const pixOpt = deblockOpt + 8 * kDeblockStride + 16;
+
+#define CHECK_DEBLOCK(label, name, ...) \
+	if (opt.name != ref.name) { \
+		bool ok = true; \
+		markTested(opt.name); \
+		for (int it = 0;it < kIterations * 4 && ok;++it) { \
+			fillDeblock(it % 3); \
+			const intptr_t stride = 16 * (2 + rand() % 3); \
+			const int alpha = rand() % 256, beta = rand() % 19; \
+			int8_t tc[4]; \
+			randomTc(tc); \
+			(void)tc; \
+			ref.name(pixRef, stride, alpha, beta __VA_ARGS__); \
+			opt.name(pixOpt, stride, alpha, beta __VA_ARGS__); \
+			ok = !memcmp(deblockRef, deblockOpt, sizeof(deblockRef)); \
+		} \
+		report(level, label, ok); \
+	}
+
+	CHECK_DEBLOCK("deblock_v_luma", deblock_luma[1], , tc);
+	CHECK_DEBLOCK("deblock_h_luma", deblock_luma[0], , tc);
+	CHECK_DEBLOCK("deblock_v_chroma", deblock_chroma[1], , tc);
+	CHECK_DEBLOCK("deblock_h_chroma_420", deblock_h_chroma_420, , tc);
+	CHECK_DEBLOCK("deblock_h_chroma_422", deblock_h_chroma_422, , tc);
+	CHECK_DEBLOCK("deblock_v_luma_intra", deblock_luma_intra[1]);
+	CHECK_DEBLOCK("deblock_h_luma_intra", deblock_luma_intra[0]);
+	CHECK_DEBLOCK("deblock_v_chroma_intra", deblock_chroma_intra[1]);
+	CHECK_DEBLOCK("deblock_h_chroma_420_intra", deblock_h_chroma_420_intra);
+	CHECK_DEBLOCK("deblock_h_chroma_422_intra", deblock_h_chroma_422_intra);
+#undef CHECK_DEBLOCK
+
+	ALIGNED_16(uint8_t nnz[X264_SCAN8_SIZE]);
+	ALIGNED_16(int8_t refs[2][X264_SCAN8_LUMA_SIZE]);
+	ALIGNED_16(int16_t mv[2][X264_SCAN8_LUMA_SIZE][2]);
+	ALIGNED_16(uint8_t bsRef[2][8][4]);
+	ALIGNED_16(uint8_t bsOpt[2][8][4]);
+	if (opt.deblock_strength != ref.deblock_strength) {
+		markTested(opt.deblock_strength);
+		bool ok = true;
+		for (int it = 0;it < kIterations * 4 && ok;++it) {
+			const int range = 1 << (it % 4 * 2);
+			for (int i = 0;i < X264_SCAN8_SIZE;++i) {
+				nnz[i] = (rand() % 4) ? 0 : rand() % 17;
+			}
+			for (int l = 0;l < 2;++l) {
+				for (int i = 0;i < X264_SCAN8_LUMA_SIZE;++i) {
+					refs[l][i] = rand() % 3 - 1;
+					mv[l][i][0] = rand() % (2 * range + 1) - range;
+					mv[l][i][1] = rand() % (2 * range + 1) - range;
+				}
+			}
+			const int mvyLimit = (it & 1) ? 2 : 4;
+			const int bframe = (it >> 1) & 1;
+			memset(bsRef, 0xaa, sizeof(bsRef));
+			memset(bsOpt, 0xaa, sizeof(bsOpt));
+			ref.deblock_strength(nnz, refs, mv, bsRef, mvyLimit, bframe);
+			opt.deblock_strength(nnz, refs, mv, bsOpt, mvyLimit, bframe);
+			ok = !memcmp(bsRef, bsOpt, sizeof(bsRef));
+		}
+		report(level, "deblock_strength", ok);
+	}
+
+	if (!gBench) {
+		return;
+	}
+
+	fillDeblock(0);
+	int8_t tc[4] = {0, 1, 2, 3};
+	BENCH("deblock_v_luma", deblock_luma[1], fn(pixOpt, kDeblockStride, 40, 8, tc));
+	BENCH("deblock_h_luma", deblock_luma[0], fn(pixOpt, kDeblockStride, 40, 8, tc));
+	BENCH("deblock_v_chroma", deblock_chroma[1], fn(pixOpt, kDeblockStride, 40, 8, tc));
+	BENCH("deblock_h_chroma_420", deblock_h_chroma_420, fn(pixOpt, kDeblockStride, 40, 8, tc));
+	BENCH("deblock_h_chroma_422", deblock_h_chroma_422, fn(pixOpt, kDeblockStride, 40, 8, tc));
+	BENCH("deblock_v_luma_intra", deblock_luma_intra[1], fn(pixOpt, kDeblockStride, 40, 8));
+	BENCH("deblock_h_luma_intra", deblock_luma_intra[0], fn(pixOpt, kDeblockStride, 40, 8));
+	BENCH("deblock_v_chroma_intra", deblock_chroma_intra[1], fn(pixOpt, kDeblockStride, 40, 8));
+	BENCH("deblock_h_chroma_420_intra", deblock_h_chroma_420_intra, fn(pixOpt, kDeblockStride, 40, 8));
+	BENCH("deblock_h_chroma_422_intra", deblock_h_chroma_422_intra, fn(pixOpt, kDeblockStride, 40, 8));
+	BENCH("deblock_strength", deblock_strength, fn(nnz, refs, mv, bsOpt, 4, 1));
+}
+
+// The encoder's tables as x264_encoder_open fills them at this level, for
+// x264_cpu_kernel_report. Every slot that doesn't resolve to a C function
+// must hold something one of the checks above went through; a kernel
+// added to an init function without a check fails here.
+static void checkCoverage(const char* level, int cpu) {
+	static const int kMaxKernels = 1024;
+	x264_kernel_info_t* info = new x264_kernel_info_t[kMaxKernels];
+	x264_t* h = (x264_t*)calloc(1, sizeof(x264_t));
+	std::set<const void*> missing;
+	for (int interlaced = 0;interlaced < 2;++interlaced) {
+		h->param.cpu = cpu;
+		h->param.b_interlaced = interlaced;
+		x264_predict_16x16_init(cpu, h->predict_16x16);
+		x264_predict_8x8c_init(cpu, h->predict_8x8c);
+		x264_predict_8x16c_init(cpu, h->predict_8x16c);
+		x264_predict_8x8_init(cpu, h->predict_8x8, &h->predict_8x8_filter);
+		x264_predict_4x4_init(cpu, h->predict_4x4);
+		x264_pixel_init(cpu, &h->pixf);
+		x264_dct_init(cpu, &h->dctf);
+		x264_zigzag_init(cpu, &h->zigzagf_progressive, &h->zigzagf_interlaced);
+		h->zigzagf = interlaced ? h->zigzagf_interlaced : h->zigzagf_progressive;
+		x264_mc_init(cpu, &h->mc, 0);
+		x264_quant_init(h, cpu, &h->quantf);
+		x264_deblock_init(cpu, &h->loopf, interlaced);
+
+		const int n = X264_MIN(x264_cpu_kernel_report(h, info, kMaxKernels), kMaxKernels);
+		for (int i = 0;i < n;++i) {
+			if (strcmp(info[i].impl, "c") && strcmp(info[i].impl, "none") && !gTested.count(info[i].fn)
+			    && missing.insert(info[i].fn).second) {
+				fprintf(stderr, "  %s (%s) has no check\n", info[i].name, info[i].impl);
+			}
+		}
+	}
+
+	free(h);
+	delete[] info;
+	report(level, "coverage", missing.empty());
+}
+
+int main(int argc, char** argv) {
+	if (argc > 1 && !strcmp(argv[1], "--bench")) {
+		gBench = true;
+		--argc;
+		++argv;
+	}
+
+	const unsigned seed = argc > 1 ? strtoul(argv[1], NULL, 0) : (unsigned)x264_mdate();
+	srand(seed);
+
+	const uint32_t detected = x264_cpu_detect();
+	printf("seed %u, cpu:", seed);
+	for (int i = 0;x264_cpu_names[i].flags;++i) {
+		if ((detected & x264_cpu_names[i].flags) == x264_cpu_names[i].flags && x264_cpu_names[i].name[0]) {
+			printf(" %s", x264_cpu_names[i].name);
+		}
+	}
+	printf("\n");
+
+	for (size_t i = 0;i < sizeof(kCpuLevels) / sizeof(kCpuLevels[0]);++i) {
+		if ((detected & kCpuLevels[i].flags) != kCpuLevels[i].flags) {
+			printf("%s not supported, skipped\n", kCpuLevels[i].name);
+			continue;
+		}
+
+		checkPixel(kCpuLevels[i].name, kCpuLevels[i].flags);
+		checkMC(kCpuLevels[i].name, kCpuLevels[i].flags);
+		checkDCT(kCpuLevels[i].name, kCpuLevels[i].flags);
+		checkZigzag(kCpuLevels[i].name, kCpuLevels[i].flags, false);
+		checkZigzag(kCpuLevels[i].name, kCpuLevels[i].flags, true);
+		checkQuant(kCpuLevels[i].name, kCpuLevels[i].flags);
+		checkDeblock(kCpuLevels[i].name, kCpuLevels[i].flags);
+		checkPredict(kCpuLevels[i].name, kCpuLevels[i].flags);
+		checkCoverage(kCpuLevels[i].name, kCpuLevels[i].flags);
+	}
+
+	if (gFailures) {
+		printf("%d failures\n", gFailures);
+		return 1;
+	}
+
+	printf("All tests passed\n");
+	return 0;
+}
@@ -0,0 +1,118 @@
+// nacl264 - x264 on Google Native Client
+// 2014.06 Satoshi Ueyama
+// distributed under GPL
+//
+// Colour conversion throughput benchmark.
+// Every available kernel level is checked against the C reference before it is timed.
+//
+//   g++ -O2 -I. tools/colorconv_bench.cc colorconv.cc -o colorconv_bench
+
+#include "colorconv.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+typedef struct {
+	int width;
+	int height;
+} BenchResolution;
+
+static const BenchResolution kResolutions[] = {
+	{ 320,  240},
+	{ 640,  480},
+	{1280,  720},
+	{1920, 1080}
+};
+
+typedef struct {
+	PixelFormat format;
+	const char* name;
+} BenchFormat;
+
+static const BenchFormat kFormats[] = {
+	{kPixelFormatRGB,  "rgb"},
+	{kPixelFormatRGBA, "rgba"},
+	{kPixelFormatBGRA, "bgra"}
+};
+
+static double nowSeconds() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+struct I420Buffer {
+	std::vector<uint8_t> data;
+	uint8_t* planes[3];
+	int strides[3];
+
+	I420Buffer(int w, int h) : data(w*h + (w/2)*(h/2)*2) {
+		planes[0] = &data[0];
+		planes[1] = planes[0] + w*h;
+		planes[2] = planes[1] + (w/2)*(h/2);
+		strides[0] = w;
+		strides[1] = strides[2] = w/2;
+	}
+};
+
+int main(int argc, char** argv) {
+	const double minSeconds = (argc > 1) ? atof(argv[1]) : 0.5;
+	const ColorKernelLevel maxLevel = ColorConverter::detectKernelLevel();
+	int failures = 0;
+
+	printf("%-10s %-5s %-6s %12s %10s %8s\n", "size", "input", "kernel", "Mpixel/s", "fps", "speedup");
+	for (size_t r = 0;r < sizeof(kResolutions) / sizeof(kResolutions[0]);++r) {
+		for (size_t f = 0;f < sizeof(kFormats) / sizeof(kFormats[0]);++f) {
+			const int w = kResolutions[r].width;
+			const int h = kResolutions[r].height;
+			const PixelFormat format = kFormats[f].format;
+			const int stride = w * ColorConverter::bytesPerPixel(format);
+
+			std::vector<uint8_t> rgb(stride * h);
+			srand(r + 1);
+			for (size_t i = 0;i < rgb.size();++i) {
+				rgb[i] = rand() & 0xff;
+			}
+
+			I420Buffer ref(w, h);
+			ColorConverter converter;
+			converter.setKernelLevel(kColorKernelC);
+			converter.convert(format, &rgb[0], stride, w, h, ref.planes, ref.strides);
+
+			double baseFps = 0;
+			for (int level = kColorKernelC;level <= maxLevel;++level) {
+				I420Buffer out(w, h);
+				converter.setKernelLevel((ColorKernelLevel)level);
+				converter.convert(format, &rgb[0], stride, w, h, out.planes, out.strides);
+				const bool exact = (out.data == ref.data);
+				if (!exact) {
+					++failures;
+				}
+
+				int iterations = 0;
+				const double t0 = nowSeconds();
+				double elapsed = 0;
+				do {
+					converter.convert(format, &rgb[0], stride, w, h, out.planes, out.strides);
+					++iterations;
+					elapsed = nowSeconds() - t0;
+				} while (elapsed < minSeconds);
+
+				const double fps = iterations / elapsed;
+				if (level == kColorKernelC) {
+					baseFps = fps;
+				}
+
+				char size[16];
+				snprintf(size, sizeof(size), "%dx%d", w, h);
+				printf("%-10s %-5s %-6s %12.1f %10.1f %7.2fx%s\n", size, kFormats[f].name,
+				       ColorConverter::kernelLevelName((ColorKernelLevel)level),
+				       fps * w * h / 1e6, fps, fps / baseFps, exact ? "" : "  MISMATCH");
+			}
+		}
+	}
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,246 @@
+// nacl264 - x264 on Google Native Client
+// 2014.06 Satoshi Ueyama
+// distributed under GPL
+//
+// Native driver for the encoder core: reads raw frames from a file and
+// encodes them through the same conversion, encode and mux path the module
+// uses, so the encoder can be profiled with ordinary host tools.
+//
+//   make -f host.mk
+//   out/host/nacl264_host -s 640x480 -f rgba -t mp4 -o out.mp4 input.rgba
+
+#include "encodercore.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+typedef struct {
+	FILE* fp;
+	int64_t bytes;
+	int batches;
+} HostOutput;
+
+// Patch bytes are stored back to back in data
+static void writeBatchToFile(const uint8_t* data, size_t size, const OutputPatch* patches, int nPatches, void* user_data) {
+	HostOutput* out = static_cast<HostOutput*>(user_data);
+	for (int i = 0;i < nPatches;++i) {
+		fseeko(out->fp, patches[i].position, SEEK_SET);
+		fwrite(data, 1, patches[i].length, out->fp);
+		data += patches[i].length;
+	}
+
+	out->bytes += size;
+	++out->batches;
+}
+
+static void usage(const char* name) {
+	fprintf(stderr,
+		"usage: %s -s WxH [options] input\n"
+		"  -s WxH     frame size\n"
+		"  -f format  rgb, rgba, bgra, i420 or nv12 (default i420)\n"
+		"  -t type    mkv, mp4, fmp4 or h264 (default mp4)\n"
+		"  -o file    output file (default out.<type>)\n"
+		"  -n frames  stop after this many frames\n"
+		"  -r fps     frame rate (default 30)\n"
+		"  -m matrix  bt601 or bt709 (default bt601)\n"
+		"  -l         low latency mode\n"
+		"  -T threads encoder threads, 0 for auto (default 0)\n"
+		"  -D         deblock on a helper thread\n"
+		"  -c cpu     cpu mask in x264 --asm syntax, e.g. 0, SSE2 or SSSE3 (default auto)\n"
+		"  -K         list the implementation each DSP kernel resolved to\n"
+		"  -R fps     lower the analysis settings as needed to encode this many\n"
+		"             frames a second (default off)\n"
+		"  -x opts    x264 options as key=value:key=value, e.g. me=lowres:subme=4\n", name);
+}
+
+int main(int argc, char** argv) {
+	int width = 0;
+	int height = 0;
+	int fps = 30;
+	int maxFrames = -1;
+	bool lowLatency = false;
+	bool deblockThread = false;
+	bool listKernels = false;
+	const char* cpuMask = NULL;
+	double speedTarget = 0;
+	const char* x264Options = NULL;
+	int threads = X264_THREADS_AUTO;
+	const char* formatName = "i420";
+	const char* typeName = "mp4";
+	const char* outPath = NULL;
+	ColorMatrix matrix = kColorMatrixBT601;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "s:f:t:o:n:r:m:lT:Dc:KR:x:")) != -1) {
+		switch (opt) {
+		case 's':
+			if (sscanf(optarg, "%dx%d", &width, &height) != 2) {
+				width = height = 0;
+			}
+			break;
+		case 'f': formatName = optarg; break;
+		case 't': typeName = optarg; break;
+		case 'o': outPath = optarg; break;
+		case 'n': maxFrames = atoi(optarg); break;
+		case 'r': fps = atoi(optarg); break;
+		case 'm': matrix = strcmp(optarg, "bt709") ? kColorMatrixBT601 : kColorMatrixBT709; break;
+		case 'l': lowLatency = true; break;
+		case 'T': threads = atoi(optarg); break;
+		case 'D': deblockThread = true; break;
+		case 'c': cpuMask = optarg; break;
+		case 'K': listKernels = true; break;
+		case 'R': speedTarget = atof(optarg); break;
+		case 'x': x264Options = optarg; break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	PixelFormat format;
+	ContainerType type;
+	if (optind >= argc || width <= 0 || height <= 0 || (width & 1) || (height & 1) || fps <= 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (!ColorConverter::parsePixelFormat(formatName, &format)) {
+		fprintf(stderr, "Unknown pixel format: %s\n", formatName);
+		return 1;
+	}
+
+	if (!EncoderCore::parseContainerType(typeName, &type)) {
+		fprintf(stderr, "Unknown output type: %s\n", typeName);
+		return 1;
+	}
+
+	FILE* in = fopen(argv[optind], "rb");
+	if (!in) {
+		perror(argv[optind]);
+		return 1;
+	}
+
+	std::string defaultOutPath = std::string("out.") + typeName;
+	HostOutput out = {NULL, 0, 0};
+	out.fp = fopen(outPath ? outPath : defaultOutPath.c_str(), "wb");
+	if (!out.fp) {
+		perror(outPath ? outPath : defaultOutPath.c_str());
+		fclose(in);
+		return 1;
+	}
+
+	x264_param_t params;
+	EncoderCore::setDefaultParams(&params);
+	params.i_width = width;
+	params.i_height = height;
+	params.i_fps_num = fps;
+	params.i_fps_den = 1;
+	params.i_threads = threads;
+	params.b_deblock_thread = deblockThread;
+	if (cpuMask && !EncoderCore::parseCpuMask(&params, cpuMask)) {
+		fprintf(stderr, "Bad cpu mask: %s\n", cpuMask);
+		fclose(out.fp);
+		fclose(in);
+		return 1;
+	}
+
+	if (lowLatency) {
+		EncoderCore::applyLowLatency(&params);
+	}
+
+	// After low latency, so options can override what it sets
+	if (x264Options && !EncoderCore::parseOptions(&params, x264Options)) {
+		fclose(out.fp);
+		fclose(in);
+		return 1;
+	}
+
+	EncoderCore::applyColorSignalling(&params, matrix, kColorRangeLimited);
+
+	EncoderCore core;
+	core.setBatchProc(writeBatchToFile, &out);
+	core.setSpeedTarget(speedTarget);
+	if (!core.open(&params, type, lowLatency)) {
+		fprintf(stderr, "Failed to open the encoder\n");
+		fclose(out.fp);
+		fclose(in);
+		return 1;
+	}
+
+	if (listKernels) {
+		const std::vector<x264_kernel_info_t>& kernels = core.kernelReport();
+		fprintf(stderr, "cpu: %s\n", EncoderCore::describeCpu(core.cpuFlags()).c_str());
+		for (size_t i = 0;i < kernels.size();++i) {
+			fprintf(stderr, "  %-40s %s\n", kernels[i].name, kernels[i].impl);
+		}
+	}
+
+	ColorConverter converter;
+	converter.setMatrix(matrix, kColorRangeLimited);
+
+	const bool packed = ColorConverter::isPacked(format);
+	const size_t frameBytes = packed ? (size_t)width * height * ColorConverter::bytesPerPixel(format)
+	                                 : (size_t)width * height * 3 / 2;
+	std::vector<uint8_t> frame(frameBytes);
+
+	x264_picture_t picture;
+	if (packed) {
+		x264_picture_alloc(&picture, X264_CSP_I420, width, height);
+	} else {
+		x264_picture_init(&picture);
+		picture.img.i_csp = (format == kPixelFormatNV12) ? X264_CSP_NV12 : X264_CSP_I420;
+		picture.img.i_plane = (format == kPixelFormatNV12) ? 2 : 3;
+		picture.img.plane[0] = &frame[0];
+		picture.img.plane[1] = &frame[0] + width * height;
+		picture.img.plane[2] = &frame[0] + width * height * 5 / 4;
+		picture.img.i_stride[0] = width;
+		picture.img.i_stride[1] = (format == kPixelFormatNV12) ? width : width / 2;
+		picture.img.i_stride[2] = width / 2;
+	}
+
+	int nFrames = 0;
+	int64_t convertTime = 0;
+	const int64_t startTime = x264_mdate();
+	while ((maxFrames < 0 || nFrames < maxFrames) && fread(&frame[0], 1, frameBytes, in) == frameBytes) {
+		if (packed) {
+			const int64_t t = x264_mdate();
+			converter.convert(format, &frame[0], width * ColorConverter::bytesPerPixel(format), width, height,
+			                  picture.img.plane, picture.img.i_stride);
+			convertTime += x264_mdate() - t;
+		}
+
+		core.stampFrame(&picture);
+		core.encodeFrame(&picture);
+		++nFrames;
+	}
+
+	core.finish();
+	const double seconds = (x264_mdate() - startTime) / 1000000.0;
+
+	if (packed) {
+		x264_picture_clean(&picture);
+	}
+
+	fclose(out.fp);
+	fclose(in);
+
+	fprintf(stderr, "%d frames in %.3f s (%.2f fps), conversion %.3f s, %lld bytes in %d batches\n",
+	        nFrames, seconds, seconds > 0 ? nFrames / seconds : 0.0, convertTime / 1000000.0,
+	        (long long)out.bytes, out.batches);
+
+	const SpeedGovernor& governor = core.speedGovernor();
+	if (governor.isEnabled()) {
+		fprintf(stderr, "speed governor: %d level changes, max backlog %.1f ms, frames per level:",
+		        governor.levelChanges(), governor.maxBacklogUs() / 1000.0);
+		for (int i = 0;i < SpeedGovernor::levelCount();++i) {
+			fprintf(stderr, " %d", governor.framesAtLevel(i));
+		}
+
+		fprintf(stderr, "\n");
+	}
+
+	return 0;
+}
@@ -0,0 +1,87 @@
+// nacl264 - x264 on Google Native Client
+// 2014.06 Satoshi Ueyama
+// distributed under GPL
+//
+// x264_threadpool dispatch latency benchmark.
+// Measures the round trip of x264_threadpool_run + x264_threadpool_wait with
+// empty jobs, one job at a time and in batches of one job per pool thread
+// (the pattern of sliced threads and lookahead threads).
+//
+//   make -f host.mk
+//   out/host/threadpool_bench [max threads]
+
+extern "C" {
+#include "common/common.h"
+}
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#if HAVE_THREAD
+
+static void* emptyJob(void* arg) {
+	return arg;
+}
+
+// Microseconds per single run/wait round trip
+static double measureSingle(x264_threadpool_t* pool, int iterations) {
+	int token = 0;
+	const int64_t start = x264_mdate();
+	for (int i = 0;i < iterations;++i) {
+		x264_threadpool_run(pool, emptyJob, &token);
+		x264_threadpool_wait(pool, &token);
+	}
+
+	return (double)(x264_mdate() - start) / iterations;
+}
+
+// Microseconds per batch of `threads` jobs
+static double measureBatch(x264_threadpool_t* pool, int threads, int iterations) {
+	std::vector<int> tokens(threads);
+	const int64_t start = x264_mdate();
+	for (int i = 0;i < iterations;++i) {
+		for (int j = 0;j < threads;++j) {
+			x264_threadpool_run(pool, emptyJob, &tokens[j]);
+		}
+
+		for (int j = 0;j < threads;++j) {
+			x264_threadpool_wait(pool, &tokens[j]);
+		}
+	}
+
+	return (double)(x264_mdate() - start) / iterations;
+}
+
+int main(int argc, char** argv) {
+	int maxThreads = argc > 1 ? atoi(argv[1]) : x264_cpu_num_processors();
+	if (maxThreads < 1) {
+		maxThreads = 1;
+	}
+
+	const int iterations = 20000;
+	printf("%d processors, %d iterations\n", x264_cpu_num_processors(), iterations);
+	printf("threads   single (us)   batch (us)   per job (us)\n");
+	for (int threads = 1;threads <= maxThreads;threads *= 2) {
+		x264_threadpool_t* pool = NULL;
+		if (x264_threadpool_init(&pool, threads, NULL, NULL)) {
+			fprintf(stderr, "x264_threadpool_init failed\n");
+			return 1;
+		}
+
+		const double single = measureSingle(pool, iterations);
+		const double batch = measureBatch(pool, threads, iterations);
+		printf("%7d   %11.2f   %10.2f   %12.2f\n", threads, single, batch, batch / threads);
+		x264_threadpool_delete(pool);
+	}
+
+	return 0;
+}
+
+#else
+
+int main() {
+	puts("x264 was built without thread support");
+	return 0;
+}
+
+#endif
@@ -145,6 +145,7 @@ void x264_param_default( x264_param_t *param )
     param->analyse.i_mv_range = -1; // set from level_idc
     param->analyse.i_chroma_qp_offset = 0;
     param->analyse.b_fast_pskip = 1;
+    param->analyse.i_fast_decision = 0;
     param->analyse.b_weighted_bipred = 1;
     param->analyse.i_weighted_pred = X264_WEIGHTP_SMART;
     param->analyse.b_dct_decimate = 1;
@@ -649,6 +650,8 @@ int x264_param_parse( x264_param_t *p, const char *name, const char *value )
     }
     OPT("sliced-threads")
         p->b_sliced_threads = atobool(value);
+    OPT("deblock-thread")
+        p->b_deblock_thread = atobool(value);
     OPT("sync-lookahead")
     {
         if( !strcmp(value, "auto") )
@@ -941,6 +944,8 @@ int x264_param_parse( x264_param_t *p, const char *name, const char *value )
         p->analyse.i_trellis = atoi(value);
     OPT("fast-pskip")
         p->analyse.b_fast_pskip = atobool(value);
+    OPT("fast-decision")
+        p->analyse.i_fast_decision = atoi(value);
     OPT("dct-decimate")
         p->analyse.b_dct_decimate = atobool(value);
     OPT("deadzone-inter")
@@ -1335,10 +1340,14 @@ char *x264_param2string( x264_param_t *p, int b_res )
     s += sprintf( s, " cqm=%d", p->i_cqm_preset );
     s += sprintf( s, " deadzone=%d,%d", p->analyse.i_luma_deadzone[0], p->analyse.i_luma_deadzone[1] );
     s += sprintf( s, " fast_pskip=%d", p->analyse.b_fast_pskip );
+    if( p->analyse.i_fast_decision )
+        s += sprintf( s, " fast_decision=%d", p->analyse.i_fast_decision );
     s += sprintf( s, " chroma_qp_offset=%d", p->analyse.i_chroma_qp_offset );
     s += sprintf( s, " threads=%d", p->i_threads );
     s += sprintf( s, " lookahead_threads=%d", p->i_lookahead_threads );
     s += sprintf( s, " sliced_threads=%d", p->b_sliced_threads );
+    if( p->b_deblock_thread )
+        s += sprintf( s, " deblock_thread=%d", p->b_deblock_thread );
     if( p->i_slice_count )
         s += sprintf( s, " slices=%d", p->i_slice_count );
     if( p->i_slice_count_max )
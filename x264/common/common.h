@@ -36,6 +36,8 @@
 #define X264_MAX3(a,b,c) X264_MAX((a),X264_MAX((b),(c)))
 #define X264_MIN4(a,b,c,d) X264_MIN((a),X264_MIN3((b),(c),(d)))
 #define X264_MAX4(a,b,c,d) X264_MAX((a),X264_MAX3((b),(c),(d)))
+/* esa and tesa, which need integral planes and fullpel mv cost tables */
+#define X264_ME_EXHAUSTIVE(method) ((method) == X264_ME_ESA || (method) == X264_ME_TESA)
 #define XCHG(type,a,b) do{ type t = a; a = b; b = t; } while(0)
 #define IS_DISPOSABLE(type) ( type == X264_TYPE_B )
 #define FIX8(f) ((int)(f*(1<<8)+.5))
@@ -498,8 +500,10 @@ struct x264_t
     int             i_threadslice_start; /* first row in this thread slice */
     int             i_threadslice_end; /* row after the end of this thread slice */
     int             i_threadslice_pass; /* which pass of encoding we are on */
+    int             i_deblock_row; /* mb_y of the deblock job in flight on deblockpool, 0 if none */
     x264_threadpool_t *threadpool;
     x264_threadpool_t *lookaheadpool;
+    x264_threadpool_t *deblockpool;
     x264_pthread_mutex_t mutex;
     x264_pthread_cond_t cv;
 
@@ -616,6 +620,7 @@ struct x264_t
         int64_t i_second_largest_pts;
         int b_have_lowres;  /* Whether 1/2 resolution luma planes are being used */
         int b_have_sub8x8_esa;
+        int b_have_lowres_pyramid; /* Whether 1/4 and 1/8 resolution luma planes are built above lowres (me=pyramid) */
     } frames;
 
     /* current frame being encoded */
@@ -741,6 +746,7 @@ struct x264_t
         uint8_t (*mvd[2])[8][2];            /* absolute value of mb mv difference with predict, clipped to [0,33]. set to 0 if intra. cabac only */
         int8_t   *ref[2];                   /* mb ref. set to -1 if non used (intra or Lx only) */
         int16_t (*mvr[2][X264_REF_MAX*2])[2];/* 16x16 mv for each possible ref */
+        int     *epzs_cost;                 /* fullpel cost of the l0 ref0 16x16 search (me=epzs), COST_MAX if none this frame */
         int8_t  *skipbp;                    /* block pattern for SKIP or DIRECT (sub)mbs. B-frames + cabac only */
         int8_t  *mb_transform_size;         /* transform_size_8x8_flag of each mb */
         uint16_t *slice_table;              /* sh->first_mb of the slice that the indexed mb is part of
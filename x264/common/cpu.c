@@ -47,7 +47,7 @@
 
 const x264_cpu_name_t x264_cpu_names[] =
 {
-#if HAVE_MMX
+#if HAVE_MMX || HAVE_X86_INTRIN
 //  {"MMX",         X264_CPU_MMX},  // we don't support asm on mmx1 cpus anymore
 //  {"CMOV",        X264_CPU_CMOV}, // we require this unconditionally, so don't print it
 #define MMX2 X264_CPU_MMX|X264_CPU_MMX2|X264_CPU_CMOV
@@ -112,10 +112,25 @@ static void sigill_handler( int sig )
 }
 #endif
 
+#if HAVE_MMX || HAVE_X86_INTRIN
 #if HAVE_MMX
 int x264_cpu_cpuid_test( void );
 void x264_cpu_cpuid( uint32_t op, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx );
 void x264_cpu_xgetbv( uint32_t op, uint32_t *eax, uint32_t *edx );
+#else
+/* No cpu-a.asm: query the cpu through the compiler */
+#include <cpuid.h>
+
+static void x264_cpu_cpuid( uint32_t op, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx )
+{
+    __cpuid_count( op, 0, *eax, *ebx, *ecx, *edx );
+}
+
+static void x264_cpu_xgetbv( uint32_t op, uint32_t *eax, uint32_t *edx )
+{
+    __asm__ volatile( "xgetbv" : "=a"(*eax), "=d"(*edx) : "c"(op) );
+}
+#endif
 
 uint32_t x264_cpu_detect( void )
 {
@@ -471,3 +486,220 @@ int x264_cpu_num_processors( void )
     return 1;
 #endif
 }
+
+/****************************************************************************
+ * x264_cpu_kernel_report:
+ ****************************************************************************/
+typedef struct
+{
+    x264_predict_t      predict_16x16[4+3];
+    x264_predict8x8_t   predict_8x8[9+3];
+    x264_predict_t      predict_4x4[9+3];
+    x264_predict_t      predict_8x8c[4+3];
+    x264_predict_t      predict_8x16c[4+3];
+    x264_predict_8x8_filter_t predict_8x8_filter;
+    x264_pixel_function_t pixf;
+    x264_mc_functions_t   mc;
+    x264_dct_function_t   dctf;
+    x264_zigzag_function_t zigzagf_interlaced;
+    x264_zigzag_function_t zigzagf_progressive;
+    x264_quant_function_t quantf;
+    x264_deblock_function_t loopf;
+} x264_kernel_tables_t;
+
+typedef struct
+{
+    const char *name;
+    size_t offset;
+    int count;
+} x264_kernel_slot_t;
+
+#define SLOT( member ) { #member, offsetof( x264_t, member ), sizeof(((x264_t*)0)->member) / sizeof(void*) }
+
+static const x264_kernel_slot_t kernel_slots_pixel[] =
+{
+    SLOT( pixf.sad ), SLOT( pixf.ssd ), SLOT( pixf.satd ), SLOT( pixf.ssim ), SLOT( pixf.sa8d ),
+    SLOT( pixf.mbcmp ), SLOT( pixf.mbcmp_unaligned ), SLOT( pixf.fpelcmp ), SLOT( pixf.fpelcmp_x3 ),
+    SLOT( pixf.fpelcmp_x4 ), SLOT( pixf.sad_aligned ), SLOT( pixf.vsad ), SLOT( pixf.asd8 ),
+    SLOT( pixf.sa8d_satd ), SLOT( pixf.var ), SLOT( pixf.var2 ), SLOT( pixf.hadamard_ac ),
+    SLOT( pixf.ssd_nv12_core ), SLOT( pixf.ssim_4x4x2_core ), SLOT( pixf.ssim_end4 ),
+    SLOT( pixf.sad_x3 ), SLOT( pixf.sad_x4 ), SLOT( pixf.satd_x3 ), SLOT( pixf.satd_x4 ), SLOT( pixf.ads ),
+    SLOT( pixf.intra_mbcmp_x3_16x16 ), SLOT( pixf.intra_satd_x3_16x16 ), SLOT( pixf.intra_sad_x3_16x16 ),
+    SLOT( pixf.intra_mbcmp_x3_4x4 ), SLOT( pixf.intra_satd_x3_4x4 ), SLOT( pixf.intra_sad_x3_4x4 ),
+    SLOT( pixf.intra_mbcmp_x3_chroma ), SLOT( pixf.intra_satd_x3_chroma ), SLOT( pixf.intra_sad_x3_chroma ),
+    SLOT( pixf.intra_mbcmp_x3_8x16c ), SLOT( pixf.intra_satd_x3_8x16c ), SLOT( pixf.intra_sad_x3_8x16c ),
+    SLOT( pixf.intra_mbcmp_x3_8x8c ), SLOT( pixf.intra_satd_x3_8x8c ), SLOT( pixf.intra_sad_x3_8x8c ),
+    SLOT( pixf.intra_mbcmp_x3_8x8 ), SLOT( pixf.intra_sa8d_x3_8x8 ), SLOT( pixf.intra_sad_x3_8x8 ),
+    SLOT( pixf.intra_mbcmp_x9_4x4 ), SLOT( pixf.intra_satd_x9_4x4 ), SLOT( pixf.intra_sad_x9_4x4 ),
+    SLOT( pixf.intra_mbcmp_x9_8x8 ), SLOT( pixf.intra_sa8d_x9_8x8 ), SLOT( pixf.intra_sad_x9_8x8 ),
+    { 0 }
+};
+
+static const x264_kernel_slot_t kernel_slots_mc[] =
+{
+    SLOT( mc.mc_luma ), SLOT( mc.get_ref ), SLOT( mc.mc_chroma ), SLOT( mc.avg ), SLOT( mc.copy ),
+    SLOT( mc.copy_16x16_unaligned ), SLOT( mc.store_interleave_chroma ),
+    SLOT( mc.load_deinterleave_chroma_fenc ), SLOT( mc.load_deinterleave_chroma_fdec ),
+    SLOT( mc.plane_copy ), SLOT( mc.plane_copy_interleave ), SLOT( mc.plane_copy_deinterleave ),
+    SLOT( mc.plane_copy_deinterleave_rgb ), SLOT( mc.plane_copy_deinterleave_v210 ), SLOT( mc.hpel_filter ),
+    SLOT( mc.prefetch_fenc ), SLOT( mc.prefetch_fenc_420 ), SLOT( mc.prefetch_fenc_422 ), SLOT( mc.prefetch_ref ),
+    SLOT( mc.memcpy_aligned ), SLOT( mc.memzero_aligned ), SLOT( mc.integral_init4h ), SLOT( mc.integral_init8h ),
+    SLOT( mc.integral_init4v ), SLOT( mc.integral_init8v ), SLOT( mc.frame_init_lowres_core ),
+    SLOT( mc.weight ), SLOT( mc.offsetadd ), SLOT( mc.offsetsub ), SLOT( mc.weight_cache ),
+    SLOT( mc.mbtree_propagate_cost ), SLOT( mc.mbtree_propagate_list ),
+    { 0 }
+};
+
+static const x264_kernel_slot_t kernel_slots_dct[] =
+{
+    SLOT( dctf.sub4x4_dct ), SLOT( dctf.add4x4_idct ), SLOT( dctf.sub8x8_dct ), SLOT( dctf.sub8x8_dct_dc ),
+    SLOT( dctf.add8x8_idct ), SLOT( dctf.add8x8_idct_dc ), SLOT( dctf.sub8x16_dct_dc ), SLOT( dctf.sub16x16_dct ),
+    SLOT( dctf.add16x16_idct ), SLOT( dctf.add16x16_idct_dc ), SLOT( dctf.sub8x8_dct8 ), SLOT( dctf.add8x8_idct8 ),
+    SLOT( dctf.sub16x16_dct8 ), SLOT( dctf.add16x16_idct8 ), SLOT( dctf.dct4x4dc ), SLOT( dctf.idct4x4dc ),
+    SLOT( dctf.dct2x4dc ),
+    { 0 }
+};
+
+static const x264_kernel_slot_t kernel_slots_zigzag[] =
+{
+    SLOT( zigzagf.scan_8x8 ), SLOT( zigzagf.scan_4x4 ), SLOT( zigzagf.sub_8x8 ), SLOT( zigzagf.sub_4x4 ),
+    SLOT( zigzagf.sub_4x4ac ), SLOT( zigzagf.interleave_8x8_cavlc ),
+    { 0 }
+};
+
+static const x264_kernel_slot_t kernel_slots_quant[] =
+{
+    SLOT( quantf.quant_8x8 ), SLOT( quantf.quant_4x4 ), SLOT( quantf.quant_4x4x4 ), SLOT( quantf.quant_4x4_dc ),
+    SLOT( quantf.quant_2x2_dc ), SLOT( quantf.dequant_8x8 ), SLOT( quantf.dequant_4x4 ), SLOT( quantf.dequant_4x4_dc ),
+    SLOT( quantf.idct_dequant_2x4_dc ), SLOT( quantf.idct_dequant_2x4_dconly ),
+    SLOT( quantf.optimize_chroma_2x2_dc ), SLOT( quantf.optimize_chroma_2x4_dc ), SLOT( quantf.denoise_dct ),
+    SLOT( quantf.decimate_score15 ), SLOT( quantf.decimate_score16 ), SLOT( quantf.decimate_score64 ),
+    SLOT( quantf.coeff_last ), SLOT( quantf.coeff_last4 ), SLOT( quantf.coeff_last8 ),
+    SLOT( quantf.coeff_level_run ), SLOT( quantf.coeff_level_run4 ), SLOT( quantf.coeff_level_run8 ),
+    SLOT( quantf.trellis_cabac_4x4 ), SLOT( quantf.trellis_cabac_8x8 ), SLOT( quantf.trellis_cabac_4x4_psy ),
+    SLOT( quantf.trellis_cabac_8x8_psy ), SLOT( quantf.trellis_cabac_dc ), SLOT( quantf.trellis_cabac_chroma_422_dc ),
+    { 0 }
+};
+
+static const x264_kernel_slot_t kernel_slots_deblock[] =
+{
+    SLOT( loopf.deblock_luma ), SLOT( loopf.deblock_chroma ), SLOT( loopf.deblock_h_chroma_420 ),
+    SLOT( loopf.deblock_h_chroma_422 ), SLOT( loopf.deblock_luma_intra ), SLOT( loopf.deblock_chroma_intra ),
+    SLOT( loopf.deblock_h_chroma_420_intra ), SLOT( loopf.deblock_h_chroma_422_intra ),
+    SLOT( loopf.deblock_luma_mbaff ), SLOT( loopf.deblock_chroma_mbaff ), SLOT( loopf.deblock_chroma_420_mbaff ),
+    SLOT( loopf.deblock_chroma_422_mbaff ), SLOT( loopf.deblock_luma_intra_mbaff ),
+    SLOT( loopf.deblock_chroma_intra_mbaff ), SLOT( loopf.deblock_chroma_420_intra_mbaff ),
+    SLOT( loopf.deblock_chroma_422_intra_mbaff ), SLOT( loopf.deblock_strength ),
+    { 0 }
+};
+
+static const x264_kernel_slot_t kernel_slots_predict[] =
+{
+    SLOT( predict_16x16 ), SLOT( predict_8x8 ), SLOT( predict_4x4 ), SLOT( predict_8x8c ),
+    SLOT( predict_8x16c ), SLOT( predict_8x8_filter ),
+    { 0 }
+};
+
+#undef SLOT
+
+static const struct
+{
+    const char *name;
+    const x264_kernel_slot_t *slots;
+} kernel_report_tables[] =
+{
+    { "pixel",   kernel_slots_pixel },
+    { "mc",      kernel_slots_mc },
+    { "dct",     kernel_slots_dct },
+    { "zigzag",  kernel_slots_zigzag },
+    { "quant",   kernel_slots_quant },
+    { "deblock", kernel_slots_deblock },
+    { "predict", kernel_slots_predict },
+};
+
+/* Each level adds its instruction sets to the ones below it */
+#define KERNEL_ISA_MMX2  (X264_CPU_CMOV|X264_CPU_MMX|X264_CPU_MMX2)
+#define KERNEL_ISA_SSE2  (KERNEL_ISA_MMX2|X264_CPU_SSE|X264_CPU_SSE2)
+#define KERNEL_ISA_SSSE3 (KERNEL_ISA_SSE2|X264_CPU_SSE3|X264_CPU_SSSE3)
+#define KERNEL_ISA_SSE4  (KERNEL_ISA_SSSE3|X264_CPU_SSE4|X264_CPU_SSE42|X264_CPU_LZCNT)
+#define KERNEL_ISA_AVX   (KERNEL_ISA_SSE4|X264_CPU_AVX|X264_CPU_XOP|X264_CPU_FMA4)
+#define KERNEL_ISA_AVX2  (KERNEL_ISA_AVX|X264_CPU_AVX2|X264_CPU_FMA3|X264_CPU_BMI1|X264_CPU_BMI2)
+
+static const x264_cpu_name_t kernel_levels[] =
+{
+    { "c",     0 },
+    { "mmx2",  KERNEL_ISA_MMX2 },
+    { "sse2",  KERNEL_ISA_SSE2 },
+    { "ssse3", KERNEL_ISA_SSSE3 },
+    { "sse4",  KERNEL_ISA_SSE4 },
+    { "avx",   KERNEL_ISA_AVX },
+    { "avx2",  KERNEL_ISA_AVX2 },
+};
+#define KERNEL_LEVELS (sizeof(kernel_levels)/sizeof(kernel_levels[0]))
+
+static void x264_kernel_tables_init( x264_t *h, int cpu, x264_kernel_tables_t *t )
+{
+    x264_predict_16x16_init( cpu, t->predict_16x16 );
+    x264_predict_8x8c_init( cpu, t->predict_8x8c );
+    x264_predict_8x16c_init( cpu, t->predict_8x16c );
+    x264_predict_8x8_init( cpu, t->predict_8x8, &t->predict_8x8_filter );
+    x264_predict_4x4_init( cpu, t->predict_4x4 );
+    x264_pixel_init( cpu, &t->pixf );
+    x264_dct_init( cpu, &t->dctf );
+    x264_zigzag_init( cpu, &t->zigzagf_progressive, &t->zigzagf_interlaced );
+    x264_mc_init( cpu, &t->mc, h->param.b_cpu_independent );
+    x264_quant_init( h, cpu, &t->quantf );
+    x264_deblock_init( cpu, &t->loopf, PARAM_INTERLACED );
+}
+
+/* Lowest level whose tables contain fn anywhere. Slots the encoder fills
+ * by aliasing (mbcmp, the chroma format variants) resolve like the slot
+ * they were copied from. */
+static const char *x264_kernel_origin( x264_kernel_tables_t *levels, void *fn )
+{
+    if( !fn )
+        return "none";
+    for( int i = 0; i < KERNEL_LEVELS; i++ )
+    {
+        void **p = (void**)&levels[i];
+        for( int j = 0; j < sizeof(x264_kernel_tables_t) / sizeof(void*); j++ )
+            if( p[j] == fn )
+                return kernel_levels[i].name;
+    }
+    return "other";
+}
+
+int x264_cpu_kernel_report( x264_t *h, x264_kernel_info_t *info, int i_max )
+{
+    x264_kernel_tables_t *levels = x264_malloc( KERNEL_LEVELS * sizeof(x264_kernel_tables_t) );
+    if( !levels )
+        return -1;
+    memset( levels, 0, KERNEL_LEVELS * sizeof(x264_kernel_tables_t) );
+
+    /* Tuning flags (cacheline size, slow shuffles...) apply at every level */
+    uint32_t tuning = h->param.cpu & ~KERNEL_ISA_AVX2;
+    for( int i = 0; i < KERNEL_LEVELS; i++ )
+        x264_kernel_tables_init( h, (h->param.cpu & kernel_levels[i].flags) | (i ? tuning : 0), &levels[i] );
+
+    int n = 0;
+    for( int t = 0; t < sizeof(kernel_report_tables)/sizeof(kernel_report_tables[0]); t++ )
+        for( const x264_kernel_slot_t *s = kernel_report_tables[t].slots; s->name; s++ )
+        {
+            const char *member = strchr( s->name, '.' ) ? strchr( s->name, '.' ) + 1 : s->name;
+            for( int i = 0; i < s->count; i++, n++ )
+            {
+                if( n >= i_max )
+                    continue;
+                void *fn = ((void**)((uint8_t*)h + s->offset))[i];
+                if( s->count > 1 )
+                    snprintf( info[n].name, sizeof(info[n].name), "%s.%s[%d]", kernel_report_tables[t].name, member, i );
+                else
+                    snprintf( info[n].name, sizeof(info[n].name), "%s.%s", kernel_report_tables[t].name, member );
+                info[n].impl = x264_kernel_origin( levels, fn );
+                info[n].fn = fn;
+            }
+        }
+
+    x264_free( levels );
+    return n;
+}
@@ -71,4 +71,18 @@ typedef struct
 } x264_cpu_name_t;
 extern const x264_cpu_name_t x264_cpu_names[];
 
+typedef struct
+{
+    char name[48];      /* table.member[index], e.g. "pixel.satd[0]" */
+    const char *impl;   /* "c", "sse2", "ssse3", "avx2"...; "none" for unset slots */
+    void *fn;           /* the function pointer itself */
+} x264_kernel_info_t;
+
+/* x264_cpu_kernel_report:
+ *      names the instruction set of the implementation each slot of h's
+ *      pixel, mc, dct, zigzag, quant, deblock and predict tables resolved to.
+ *      writes at most i_max entries and returns the total number of slots,
+ *      or -1 on allocation failure. */
+int x264_cpu_kernel_report( x264_t *h, x264_kernel_info_t *info, int i_max );
+
 #endif
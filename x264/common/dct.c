@@ -35,6 +35,9 @@
 #if ARCH_ARM
 #   include "arm/dct.h"
 #endif
+#if HAVE_X86_INTRIN
+#   include "x86/intrin.h"
+#endif
 
 /* the inverse of the scaling factors introduced by 8x8 fdct */
 /* uint32 is for the asm implementation of trellis. the actual values fit in uint16. */
@@ -746,6 +749,9 @@ void x264_dct_init( int cpu, x264_dct_function_t *dctf )
         dctf->add16x16_idct8= x264_add16x16_idct8_neon;
     }
 #endif
+#if HAVE_X86_INTRIN
+    x264_dct_init_intrin( cpu, dctf );
+#endif
 #endif // HIGH_BIT_DEPTH
 }
 
@@ -1044,4 +1050,7 @@ void x264_zigzag_init( int cpu, x264_zigzag_function_t *pf_progressive, x264_zig
     }
 #endif // HIGH_BIT_DEPTH
 #endif
+#if HAVE_X86_INTRIN && !HIGH_BIT_DEPTH
+    x264_zigzag_init_intrin( cpu, pf_progressive, pf_interlaced );
+#endif
 }
@@ -27,6 +27,9 @@
  *****************************************************************************/
 
 #include "common.h"
+#if HAVE_X86_INTRIN
+#   include "x86/intrin.h"
+#endif
 
 /* Deblocking filter */
 static const uint8_t i_alpha_table[52+12*3] =
@@ -337,42 +340,54 @@ static ALWAYS_INLINE void deblock_edge_intra( x264_t *h, pixel *pix, intptr_t i_
     pf_intra( pix, i_stride, alpha, beta );
 }
 
-static ALWAYS_INLINE void x264_macroblock_cache_load_neighbours_deblock( x264_t *h, int mb_x, int mb_y )
+/* Neighbour state of the mb being deblocked. Kept out of h->mb so that a row
+ * can be deblocked while the next one is being encoded. */
+typedef struct
+{
+    int i_neighbour;
+    int i_mb_xy;
+    int b_interlaced;
+    int i_mb_top_y;
+    int i_mb_top_xy;
+    int i_mb_left_xy[2];
+} x264_deblock_neighbours_t;
+
+static ALWAYS_INLINE void x264_macroblock_cache_load_neighbours_deblock( x264_t *h, x264_deblock_neighbours_t *nb, int mb_x, int mb_y )
 {
     int deblock_on_slice_edges = h->sh.i_disable_deblocking_filter_idc != 2;
 
-    h->mb.i_neighbour = 0;
-    h->mb.i_mb_xy = mb_y * h->mb.i_mb_stride + mb_x;
-    h->mb.b_interlaced = PARAM_INTERLACED && h->mb.field[h->mb.i_mb_xy];
-    h->mb.i_mb_top_y = mb_y - (1 << MB_INTERLACED);
-    h->mb.i_mb_top_xy = mb_x + h->mb.i_mb_stride*h->mb.i_mb_top_y;
-    h->mb.i_mb_left_xy[1] =
-    h->mb.i_mb_left_xy[0] = h->mb.i_mb_xy - 1;
+    nb->i_neighbour = 0;
+    nb->i_mb_xy = mb_y * h->mb.i_mb_stride + mb_x;
+    nb->b_interlaced = PARAM_INTERLACED && h->mb.field[nb->i_mb_xy];
+    nb->i_mb_top_y = mb_y - (1 << nb->b_interlaced);
+    nb->i_mb_top_xy = mb_x + h->mb.i_mb_stride*nb->i_mb_top_y;
+    nb->i_mb_left_xy[1] =
+    nb->i_mb_left_xy[0] = nb->i_mb_xy - 1;
     if( SLICE_MBAFF )
     {
         if( mb_y&1 )
         {
-            if( mb_x && h->mb.field[h->mb.i_mb_xy - 1] != MB_INTERLACED )
-                h->mb.i_mb_left_xy[0] -= h->mb.i_mb_stride;
+            if( mb_x && h->mb.field[nb->i_mb_xy - 1] != nb->b_interlaced )
+                nb->i_mb_left_xy[0] -= h->mb.i_mb_stride;
         }
         else
         {
-            if( h->mb.i_mb_top_xy >= 0 && MB_INTERLACED && !h->mb.field[h->mb.i_mb_top_xy] )
+            if( nb->i_mb_top_xy >= 0 && nb->b_interlaced && !h->mb.field[nb->i_mb_top_xy] )
             {
-                h->mb.i_mb_top_xy += h->mb.i_mb_stride;
-                h->mb.i_mb_top_y++;
+                nb->i_mb_top_xy += h->mb.i_mb_stride;
+                nb->i_mb_top_y++;
             }
-            if( mb_x && h->mb.field[h->mb.i_mb_xy - 1] != MB_INTERLACED )
-                h->mb.i_mb_left_xy[1] += h->mb.i_mb_stride;
+            if( mb_x && h->mb.field[nb->i_mb_xy - 1] != nb->b_interlaced )
+                nb->i_mb_left_xy[1] += h->mb.i_mb_stride;
         }
     }
 
     if( mb_x > 0 && (deblock_on_slice_edges ||
-        h->mb.slice_table[h->mb.i_mb_left_xy[0]] == h->mb.slice_table[h->mb.i_mb_xy]) )
-        h->mb.i_neighbour |= MB_LEFT;
-    if( mb_y > MB_INTERLACED && (deblock_on_slice_edges
-        || h->mb.slice_table[h->mb.i_mb_top_xy] == h->mb.slice_table[h->mb.i_mb_xy]) )
-        h->mb.i_neighbour |= MB_TOP;
+        h->mb.slice_table[nb->i_mb_left_xy[0]] == h->mb.slice_table[nb->i_mb_xy]) )
+        nb->i_neighbour |= MB_LEFT;
+    if( mb_y > nb->b_interlaced && (deblock_on_slice_edges
+        || h->mb.slice_table[nb->i_mb_top_xy] == h->mb.slice_table[nb->i_mb_xy]) )
+        nb->i_neighbour |= MB_TOP;
 }
 
 void x264_frame_deblock_row( x264_t *h, int mb_y )
@@ -386,13 +401,14 @@ void x264_frame_deblock_row( x264_t *h, int mb_y )
     int chroma444 = CHROMA444;
     int chroma_height = 16 >> CHROMA_V_SHIFT;
     intptr_t uvdiff = chroma444 ? h->fdec->plane[2] - h->fdec->plane[1] : 1;
+    x264_deblock_neighbours_t nb;
 
     for( int mb_x = 0; mb_x < h->mb.i_mb_width; mb_x += (~b_interlaced | mb_y)&1, mb_y ^= b_interlaced )
     {
         x264_prefetch_fenc( h, h->fdec, mb_x, mb_y );
-        x264_macroblock_cache_load_neighbours_deblock( h, mb_x, mb_y );
+        x264_macroblock_cache_load_neighbours_deblock( h, &nb, mb_x, mb_y );
 
-        int mb_xy = h->mb.i_mb_xy;
+        int mb_xy = nb.i_mb_xy;
         int transform_8x8 = h->mb.mb_transform_size[mb_xy];
         int intra_cur = IS_INTRA( h->mb.type[mb_xy] );
         uint8_t (*bs)[8][4] = h->deblock_strength[mb_y&1][h->param.b_sliced_threads?mb_xy:mb_x];
@@ -400,14 +416,14 @@ void x264_frame_deblock_row( x264_t *h, int mb_y )
         pixel *pixy = h->fdec->plane[0] + 16*mb_y*stridey  + 16*mb_x;
         pixel *pixuv = h->fdec->plane[1] + chroma_height*mb_y*strideuv + 16*mb_x;
 
-        if( mb_y & MB_INTERLACED )
+        if( mb_y & nb.b_interlaced )
         {
             pixy -= 15*stridey;
             pixuv -= (chroma_height-1)*strideuv;
         }
 
-        int stride2y  = stridey << MB_INTERLACED;
-        int stride2uv = strideuv << MB_INTERLACED;
+        int stride2y  = stridey << nb.b_interlaced;
+        int stride2uv = strideuv << nb.b_interlaced;
         int qp = h->mb.qp[mb_xy];
         int qpc = h->chroma_qp_table[qp];
         int first_edge_only = (h->mb.partition[mb_xy] == D_16x16 && !h->mb.cbp[mb_xy] && !intra_cur) || qp <= qp_thresh;
@@ -444,9 +460,9 @@ void x264_frame_deblock_row( x264_t *h, int mb_y )
             }\
         } while(0)
 
-        if( h->mb.i_neighbour & MB_LEFT )
+        if( nb.i_neighbour & MB_LEFT )
         {
-            if( b_interlaced && h->mb.field[h->mb.i_mb_left_xy[0]] != MB_INTERLACED )
+            if( b_interlaced && h->mb.field[nb.i_mb_left_xy[0]] != nb.b_interlaced )
             {
                 int luma_qp[2];
                 int chroma_qp[2];
@@ -457,10 +473,10 @@ void x264_frame_deblock_row( x264_t *h, int mb_y )
                 x264_deblock_intra_t chroma_intra_deblock = h->loopf.deblock_chroma_intra_mbaff;
                 int c = chroma444 ? 0 : 1;
 
-                left_qp[0] = h->mb.qp[h->mb.i_mb_left_xy[0]];
+                left_qp[0] = h->mb.qp[nb.i_mb_left_xy[0]];
                 luma_qp[0] = (qp + left_qp[0] + 1) >> 1;
                 chroma_qp[0] = (qpc + h->chroma_qp_table[left_qp[0]] + 1) >> 1;
-                if( intra_cur || IS_INTRA( h->mb.type[h->mb.i_mb_left_xy[0]] ) )
+                if( intra_cur || IS_INTRA( h->mb.type[nb.i_mb_left_xy[0]] ) )
                 {
                     deblock_edge_intra( h, pixy,           2*stridey,  bs[0][0], luma_qp[0],   a, b, 0, luma_intra_deblock );
                     deblock_edge_intra( h, pixuv,          2*strideuv, bs[0][0], chroma_qp[0], a, b, c, chroma_intra_deblock );
@@ -475,12 +491,12 @@ void x264_frame_deblock_row( x264_t *h, int mb_y )
                         deblock_edge( h, pixuv + uvdiff, 2*strideuv, bs[0][0], chroma_qp[0], a, b, c, chroma_deblock );
                 }
 
-                int offy = MB_INTERLACED ? 4 : 0;
-                int offuv = MB_INTERLACED ? 4-CHROMA_V_SHIFT : 0;
-                left_qp[1] = h->mb.qp[h->mb.i_mb_left_xy[1]];
+                int offy = nb.b_interlaced ? 4 : 0;
+                int offuv = nb.b_interlaced ? 4-CHROMA_V_SHIFT : 0;
+                left_qp[1] = h->mb.qp[nb.i_mb_left_xy[1]];
                 luma_qp[1] = (qp + left_qp[1] + 1) >> 1;
                 chroma_qp[1] = (qpc + h->chroma_qp_table[left_qp[1]] + 1) >> 1;
-                if( intra_cur || IS_INTRA( h->mb.type[h->mb.i_mb_left_xy[1]] ) )
+                if( intra_cur || IS_INTRA( h->mb.type[nb.i_mb_left_xy[1]] ) )
                 {
                     deblock_edge_intra( h, pixy           + (stridey<<offy),   2*stridey,  bs[0][4], luma_qp[1],   a, b, 0, luma_intra_deblock );
                     deblock_edge_intra( h, pixuv          + (strideuv<<offuv), 2*strideuv, bs[0][4], chroma_qp[1], a, b, c, chroma_intra_deblock );
@@ -497,10 +513,10 @@ void x264_frame_deblock_row( x264_t *h, int mb_y )
             }
             else
             {
-                int qpl = h->mb.qp[h->mb.i_mb_xy-1];
+                int qpl = h->mb.qp[mb_xy-1];
                 int qp_left = (qp + qpl + 1) >> 1;
                 int qpc_left = (qpc + h->chroma_qp_table[qpl] + 1) >> 1;
-                int intra_left = IS_INTRA( h->mb.type[h->mb.i_mb_xy-1] );
+                int intra_left = IS_INTRA( h->mb.type[mb_xy-1] );
                 int intra_deblock = intra_cur || intra_left;
 
                 /* Any MB that was coded, or that analysis decided to skip, has quality commensurate with its QP.
@@ -510,7 +526,7 @@ void x264_frame_deblock_row( x264_t *h, int mb_y )
                 {
 #define RESET_EFFECTIVE_QP(xy) h->fdec->effective_qp[xy] |= 0xff * !!(h->fdec->mb_info[xy] & X264_MBINFO_CONSTANT);
                     RESET_EFFECTIVE_QP(mb_xy);
-                    RESET_EFFECTIVE_QP(h->mb.i_mb_left_xy[0]);
+                    RESET_EFFECTIVE_QP(nb.i_mb_left_xy[0]);
                 }
 
                 if( intra_deblock )
@@ -526,9 +542,9 @@ void x264_frame_deblock_row( x264_t *h, int mb_y )
             FILTER( , 0, 3, qp, qpc );
         }
 
-        if( h->mb.i_neighbour & MB_TOP )
+        if( nb.i_neighbour & MB_TOP )
         {
-            if( b_interlaced && !(mb_y&1) && !MB_INTERLACED && h->mb.field[h->mb.i_mb_top_xy] )
+            if( b_interlaced && !(mb_y&1) && !nb.b_interlaced && h->mb.field[nb.i_mb_top_xy] )
             {
                 int mbn_xy = mb_xy - 2 * h->mb.i_mb_stride;
 
@@ -554,20 +570,20 @@ void x264_frame_deblock_row( x264_t *h, int mb_y )
             }
             else
             {
-                int qpt = h->mb.qp[h->mb.i_mb_top_xy];
+                int qpt = h->mb.qp[nb.i_mb_top_xy];
                 int qp_top = (qp + qpt + 1) >> 1;
                 int qpc_top = (qpc + h->chroma_qp_table[qpt] + 1) >> 1;
-                int intra_top = IS_INTRA( h->mb.type[h->mb.i_mb_top_xy] );
+                int intra_top = IS_INTRA( h->mb.type[nb.i_mb_top_xy] );
                 int intra_deblock = intra_cur || intra_top;
 
                 /* This edge has been modified, reset effective qp to max. */
                 if( h->fdec->mb_info && M32( bs[1][0] ) )
                 {
                     RESET_EFFECTIVE_QP(mb_xy);
-                    RESET_EFFECTIVE_QP(h->mb.i_mb_top_xy);
+                    RESET_EFFECTIVE_QP(nb.i_mb_top_xy);
                 }
 
-                if( (!b_interlaced || (!MB_INTERLACED && !h->mb.field[h->mb.i_mb_top_xy])) && intra_deblock )
+                if( (!b_interlaced || (!nb.b_interlaced && !h->mb.field[nb.i_mb_top_xy])) && intra_deblock )
                 {
                     FILTER( _intra, 1, 0, qp_top, qpc_top );
                 }
@@ -848,6 +864,9 @@ void x264_deblock_init( int cpu, x264_deblock_function_t *pf, int b_mbaff )
         pf->deblock_strength     = x264_deblock_strength_neon;
    }
 #endif
+#if HAVE_X86_INTRIN
+    x264_deblock_init_intrin( cpu, pf );
+#endif
 #endif // !HIGH_BIT_DEPTH
 
     /* These functions are equivalent, so don't duplicate them. */
@@ -123,6 +123,12 @@ static x264_frame_t *x264_frame_new( x264_t *h, int b_fdec )
     frame->i_width_lowres = frame->i_width[0]/2;
     frame->i_lines_lowres = frame->i_lines[0]/2;
     frame->i_stride_lowres = align_stride( frame->i_width_lowres + 2*PADH, align, disalign<<1 );
+    for( int i = 0; i < 2; i++ )
+    {
+        frame->i_width_pyramid[i] = frame->i_width_lowres >> (i+1);
+        frame->i_lines_pyramid[i] = frame->i_lines_lowres >> (i+1);
+        frame->i_stride_pyramid[i] = align_stride( frame->i_width_pyramid[i] + 2*PADH, align, disalign<<(i+2) );
+    }
 
     for( int i = 0; i < h->param.i_bframe + 2; i++ )
         for( int j = 0; j < h->param.i_bframe + 2; j++ )
@@ -199,7 +205,7 @@ static x264_frame_t *x264_frame_new( x264_t *h, int b_fdec )
         PREALLOC( frame->i_row_bits, i_lines/16 * sizeof(int) );
         PREALLOC( frame->f_row_qp, i_lines/16 * sizeof(float) );
         PREALLOC( frame->f_row_qscale, i_lines/16 * sizeof(float) );
-        if( h->param.analyse.i_me_method >= X264_ME_ESA )
+        if( X264_ME_EXHAUSTIVE( h->param.analyse.i_me_method ) )
             PREALLOC( frame->buffer[3], frame->i_stride[0] * (frame->i_lines[0] + 2*i_padv) * sizeof(uint16_t) << h->frames.b_have_sub8x8_esa );
         if( PARAM_INTERLACED )
             PREALLOC( frame->field, i_mb_count * sizeof(uint8_t) );
@@ -225,6 +231,14 @@ static x264_frame_t *x264_frame_new( x264_t *h, int b_fdec )
                 for( int i = 0; i <= h->param.i_bframe+1; i++ )
                     PREALLOC( frame->lowres_costs[j][i], (i_mb_count+3) * sizeof(uint16_t) );
 
+            if( h->frames.b_have_lowres_pyramid )
+                for( int i = 0; i < 2; i++ )
+                {
+                    int i_blocks = ((h->mb.i_mb_width + (2<<i) - 1) >> (i+1)) * ((h->mb.i_mb_height + (2<<i) - 1) >> (i+1));
+                    PREALLOC( frame->buffer_pyramid[i], frame->i_stride_pyramid[i] * (frame->i_lines_pyramid[i] + 2*PADV) * sizeof(pixel) );
+                    for( int j = 0; j <= !!h->param.i_bframe; j++ )
+                        PREALLOC( frame->pyramid_mvs[j][i], i_blocks * sizeof(*frame->pyramid_mvs[j][i]) );
+                }
         }
         if( h->param.rc.i_aq_mode )
         {
@@ -270,7 +284,7 @@ static x264_frame_t *x264_frame_new( x264_t *h, int b_fdec )
         M32( frame->mv16x16[0] ) = 0;
         frame->mv16x16++;
 
-        if( h->param.analyse.i_me_method >= X264_ME_ESA )
+        if( X264_ME_EXHAUSTIVE( h->param.analyse.i_me_method ) )
             frame->integral = (uint16_t*)frame->buffer[3] + frame->i_stride[0] * i_padv + PADH;
     }
     else
@@ -285,6 +299,10 @@ static x264_frame_t *x264_frame_new( x264_t *h, int b_fdec )
                 for( int i = 0; i <= h->param.i_bframe; i++ )
                     memset( frame->lowres_mvs[j][i], 0, 2*h->mb.i_mb_count*sizeof(int16_t) );
 
+            if( h->frames.b_have_lowres_pyramid )
+                for( int i = 0; i < 2; i++ )
+                    frame->lowres_pyramid[i] = frame->buffer_pyramid[i] + frame->i_stride_pyramid[i] * PADV + PADH;
+
             frame->i_intra_cost = frame->lowres_costs[0][0];
             memset( frame->i_intra_cost, -1, (i_mb_count+3) * sizeof(uint16_t) );
 
@@ -606,6 +624,9 @@ void x264_frame_expand_border_lowres( x264_frame_t *frame )
 {
     for( int i = 0; i < 4; i++ )
         plane_expand_border( frame->lowres[i], frame->i_stride_lowres, frame->i_width_lowres, frame->i_lines_lowres, PADH, PADV, 1, 1, 0 );
+    if( frame->lowres_pyramid[0] )
+        for( int i = 0; i < 2; i++ )
+            plane_expand_border( frame->lowres_pyramid[i], frame->i_stride_pyramid[i], frame->i_width_pyramid[i], frame->i_lines_pyramid[i], PADH, PADV, 1, 1, 0 );
 }
 
 void x264_frame_expand_border_chroma( x264_t *h, x264_frame_t *frame, int plane )
@@ -74,11 +74,15 @@ typedef struct x264_frame
     int     i_stride_lowres;
     int     i_width_lowres;
     int     i_lines_lowres;
+    int     i_stride_pyramid[2];
+    int     i_width_pyramid[2];
+    int     i_lines_pyramid[2];
     pixel *plane[3];
     pixel *plane_fld[3];
     pixel *filtered[3][4]; /* plane[0], H, V, HV */
     pixel *filtered_fld[3][4];
     pixel *lowres[4]; /* half-size copy of input frame: Orig, H, V, HV */
+    pixel *lowres_pyramid[2]; /* quarter and eighth size (1/16 and 1/64 of the area) copies of input frame, for me=pyramid */
     uint16_t *integral;
 
     /* for unrestricted mv we allocate more data than needed
@@ -86,6 +90,7 @@ typedef struct x264_frame
     pixel *buffer[4];
     pixel *buffer_fld[4];
     pixel *buffer_lowres[4];
+    pixel *buffer_pyramid[2];
 
     x264_weight_t weight[X264_REF_MAX][3]; /* [ref_index][plane] */
     pixel *weighted[X264_REF_MAX]; /* plane[0] weighted of the reference frames */
@@ -98,6 +103,7 @@ typedef struct x264_frame
     int16_t (*mv[2])[2];
     int16_t (*mv16x16)[2];
     int16_t (*lowres_mvs[2][X264_BFRAME_MAX+1])[2];
+    int16_t (*pyramid_mvs[2][2])[2]; /* [list][level]: coarse vectors of the last lowres search of each list, per 8x8 block of lowres_pyramid[level] */
     uint8_t *field;
     uint8_t *effective_qp;
 
@@ -262,6 +262,7 @@ int x264_macroblock_cache_allocate( x264_t *h )
     PREALLOC( h->mb.cbp, i_mb_count * sizeof(int16_t) );
     PREALLOC( h->mb.mb_transform_size, i_mb_count * sizeof(int8_t) );
     PREALLOC( h->mb.slice_table, i_mb_count * sizeof(uint16_t) );
+    PREALLOC( h->mb.epzs_cost, i_mb_count * sizeof(int) );
 
     /* 0 -> 3 top(4), 4 -> 6 : left(3) */
     PREALLOC( h->mb.intra4x4_pred_mode, i_mb_count * 8 * sizeof(int8_t) );
@@ -328,6 +329,7 @@ int x264_macroblock_cache_allocate( x264_t *h )
     PREALLOC_END( h->mb.base );
 
     memset( h->mb.slice_table, -1, i_mb_count * sizeof(uint16_t) );
+    memset( h->mb.epzs_cost, 0, i_mb_count * sizeof(int) );
 
     for( int i = 0; i < 2; i++ )
     {
@@ -361,7 +363,9 @@ int x264_macroblock_thread_allocate( x264_t *h, int b_lookahead )
                 CHECKED_MALLOC( h->intra_border_backup[i][j], (h->sps->i_mb_width*16+32) * sizeof(pixel) );
                 h->intra_border_backup[i][j] += 16;
             }
-        for( int i = 0; i <= PARAM_INTERLACED; i++ )
+        /* Interlacing and the deblock thread need the previous row's strengths while
+         * the current row is analysed. */
+        for( int i = 0; i <= (PARAM_INTERLACED || h->param.b_deblock_thread); i++ )
         {
             if( h->param.b_sliced_threads )
             {
@@ -385,7 +389,7 @@ int x264_macroblock_thread_allocate( x264_t *h, int b_lookahead )
         int buf_hpel = (h->thread[0]->fdec->i_width[0]+48+32) * sizeof(int16_t);
         int buf_ssim = h->param.analyse.b_ssim * 8 * (h->param.i_width/4+3) * sizeof(int);
         int me_range = X264_MIN(h->param.analyse.i_me_range, h->param.analyse.i_mv_range);
-        int buf_tesa = (h->param.analyse.i_me_method >= X264_ME_ESA) *
+        int buf_tesa = X264_ME_EXHAUSTIVE( h->param.analyse.i_me_method ) *
             ((me_range*2+24) * sizeof(int16_t) + (me_range+4) * (me_range+1) * 4 * sizeof(mvsad_t));
         scratch_size = X264_MAX3( buf_hpel, buf_ssim, buf_tesa );
     }
@@ -410,7 +414,7 @@ void x264_macroblock_thread_free( x264_t *h, int b_lookahead )
 {
     if( !b_lookahead )
     {
-        for( int i = 0; i <= PARAM_INTERLACED; i++ )
+        for( int i = 0; i <= (h->deblock_strength[1] != h->deblock_strength[0]); i++ )
             if( !h->param.b_sliced_threads || (h == h->thread[0] && !i) )
                 x264_free( h->deblock_strength[i] );
         for( int i = 0; i < (PARAM_INTERLACED ? 5 : 2); i++ )
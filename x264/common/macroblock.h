@@ -344,6 +344,16 @@ int x264_mb_predict_mv_direct16x16( x264_t *h, int *b_changed );
  *      uses all neighbors, even those that didn't end up using this ref.
  *      h->mb. need only valid values from other blocks */
 void x264_mb_predict_mv_ref16x16( x264_t *h, int i_list, int i_ref, int16_t mvc[8][2], int *i_mvc );
+/* x264_mb_predict_mv_lowres:
+ *      the vector the lookahead found for the current macroblock against
+ *      ref i_ref of list i_list, scaled to full resolution qpel.
+ *      returns 0 if the lookahead didn't search that reference. */
+int x264_mb_predict_mv_lowres( x264_t *h, int i_list, int i_ref, int16_t mv[2] );
+/* x264_mb_predict_mv_epzs:
+ *      set mvc with the predictors EPZS adds for any partition: the left, top
+ *      and topright 16x16 mvs, the co-located mv of the last reference and
+ *      its acceleration, and the lowres mv. */
+void x264_mb_predict_mv_epzs( x264_t *h, int i_list, int i_ref, int16_t mvc[6][2], int *i_mvc );
 
 void x264_mb_mc( x264_t *h );
 void x264_mb_mc_8x8( x264_t *h, int i8 );
@@ -35,6 +35,9 @@
 #if ARCH_ARM
 #include "arm/mc.h"
 #endif
+#if HAVE_X86_INTRIN
+#include "x86/intrin.h"
+#endif
 
 
 static inline void pixel_avg( pixel *dst,  intptr_t i_dst_stride,
@@ -430,6 +433,14 @@ static void integral_init8v( uint16_t *sum8, intptr_t stride )
         sum8[x] = sum8[x+8*stride] - sum8[x];
 }
 
+/* 2x2 box average, for the me=pyramid planes above lowres */
+static void frame_init_pyramid_plane( pixel *dst, intptr_t i_dst, pixel *src, intptr_t i_src, int width, int height )
+{
+    for( int y = 0; y < height; y++, dst += i_dst, src += 2*i_src )
+        for( int x = 0; x < width; x++ )
+            dst[x] = (src[2*x] + src[2*x+1] + src[2*x+i_src] + src[2*x+i_src+1] + 2) >> 2;
+}
+
 void x264_frame_init_lowres( x264_t *h, x264_frame_t *frame )
 {
     pixel *src = frame->plane[0];
@@ -443,6 +454,13 @@ void x264_frame_init_lowres( x264_t *h, x264_frame_t *frame )
     memcpy( src+i_stride*i_height, src+i_stride*(i_height-1), (i_width+1) * sizeof(pixel) );
     h->mc.frame_init_lowres_core( src, frame->lowres[0], frame->lowres[1], frame->lowres[2], frame->lowres[3],
                                   i_stride, frame->i_stride_lowres, frame->i_width_lowres, frame->i_lines_lowres );
+    if( frame->lowres_pyramid[0] )
+    {
+        frame_init_pyramid_plane( frame->lowres_pyramid[0], frame->i_stride_pyramid[0], frame->lowres[0], frame->i_stride_lowres,
+                                  frame->i_width_pyramid[0], frame->i_lines_pyramid[0] );
+        frame_init_pyramid_plane( frame->lowres_pyramid[1], frame->i_stride_pyramid[1], frame->lowres_pyramid[0], frame->i_stride_pyramid[0],
+                                  frame->i_width_pyramid[1], frame->i_lines_pyramid[1] );
+    }
     x264_frame_expand_border_lowres( frame );
 
     memset( frame->i_cost_est, -1, sizeof(frame->i_cost_est) );
@@ -634,6 +652,9 @@ void x264_mc_init( int cpu, x264_mc_functions_t *pf, int cpu_independent )
 #if HAVE_MMX
     x264_mc_init_mmx( cpu, pf );
 #endif
+#if HAVE_X86_INTRIN && !HIGH_BIT_DEPTH
+    x264_mc_init_intrin( cpu, pf );
+#endif
 #if HAVE_ALTIVEC
     if( cpu&X264_CPU_ALTIVEC )
         x264_mc_altivec_init( pf );
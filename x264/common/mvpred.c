@@ -515,6 +515,67 @@ int x264_mb_predict_mv_direct16x16( x264_t *h, int *b_changed )
     return b_available;
 }
 
+int x264_mb_predict_mv_lowres( x264_t *h, int i_list, int i_ref, int16_t mv[2] )
+{
+    /* Lowres vectors are frame vectors, and list 1 ones only exist with B-frames */
+    if( !h->frames.b_have_lowres || MB_INTERLACED || (i_list && !h->param.i_bframe) )
+        return 0;
+
+    int idx = i_list ? h->fref[1][i_ref]->i_frame-h->fenc->i_frame-1
+                     : h->fenc->i_frame-h->fref[0][i_ref]->i_frame-1;
+    if( idx < 0 || idx > h->param.i_bframe )
+        return 0;
+
+    int16_t (*lowres_mv)[2] = h->fenc->lowres_mvs[i_list][idx];
+    if( lowres_mv[0][0] == 0x7fff )
+        return 0;
+
+    mv[0] = lowres_mv[h->mb.i_mb_xy][0]*2;
+    mv[1] = lowres_mv[h->mb.i_mb_xy][1]*2;
+    return 1;
+}
+
+void x264_mb_predict_mv_epzs( x264_t *h, int i_list, int i_ref, int16_t mvc[6][2], int *i_mvc )
+{
+    int i = 0;
+
+    if( !SLICE_MBAFF )
+    {
+        int16_t (*mvr)[2] = h->mb.mvr[i_list][i_ref];
+        CP32( mvc[i++], mvr[h->mb.i_mb_left_xy[0]] );
+        CP32( mvc[i++], mvr[h->mb.i_mb_top_xy] );
+        CP32( mvc[i++], mvr[h->mb.i_mb_topright_xy] );
+    }
+
+    /* Motion of the co-located MB in the last reference, and that motion
+     * continued at the rate it changed from the reference before it */
+    x264_frame_t *l0 = h->fref[0][0];
+    if( !i_list && !MB_INTERLACED && l0->i_ref[0] > 0 )
+    {
+        int curpoc = h->fdec->i_poc;
+        int refpoc = h->fref[0][i_ref]->i_poc;
+        int scale = (curpoc - refpoc) * l0->inv_ref_poc[0];
+        int16_t *col = l0->mv16x16[h->mb.i_mb_xy];
+        mvc[i][0] = (col[0]*scale + 128) >> 8;
+        mvc[i][1] = (col[1]*scale + 128) >> 8;
+        i++;
+
+        x264_frame_t *l1 = h->i_ref[0] > 1 ? h->fref[0][1] : NULL;
+        if( l1 && l1->i_ref[0] > 0 && l1->i_poc != l0->i_poc )
+        {
+            int16_t *col2 = l1->mv16x16[h->mb.i_mb_xy];
+            mvc[i][0] = ((2*col[0] - col2[0])*scale + 128) >> 8;
+            mvc[i][1] = ((2*col[1] - col2[1])*scale + 128) >> 8;
+            i++;
+        }
+    }
+
+    if( x264_mb_predict_mv_lowres( h, i_list, i_ref, mvc[i] ) )
+        i++;
+
+    *i_mvc = i;
+}
+
 /* This just improves encoder performance, it's not part of the spec */
 void x264_mb_predict_mv_ref16x16( x264_t *h, int i_list, int i_ref, int16_t mvc[9][2], int *i_mvc )
 {
@@ -41,6 +41,9 @@
 #if ARCH_UltraSPARC
 #   include "sparc/pixel.h"
 #endif
+#if HAVE_X86_INTRIN
+#   include "x86/intrin.h"
+#endif
 
 
 /****************************************************************************
@@ -1416,6 +1419,9 @@ void x264_pixel_init( int cpu, x264_pixel_function_t *pixf )
     INIT4( sad_x3, _vis );
     INIT4( sad_x4, _vis );
 #endif
+#if HAVE_X86_INTRIN
+    x264_pixel_init_intrin( cpu, pixf );
+#endif
 #endif // !HIGH_BIT_DEPTH
 
     pixf->ads[PIXEL_8x16] =
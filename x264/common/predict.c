@@ -40,6 +40,9 @@
 #if ARCH_ARM
 #   include "arm/predict.h"
 #endif
+#if HAVE_X86_INTRIN
+#   include "x86/intrin.h"
+#endif
 
 /****************************************************************************
  * 16x16 prediction for intra luma block
@@ -890,6 +893,9 @@ void x264_predict_16x16_init( int cpu, x264_predict_t pf[7] )
 #if HAVE_MMX
     x264_predict_16x16_init_mmx( cpu, pf );
 #endif
+#if HAVE_X86_INTRIN && !HIGH_BIT_DEPTH
+    x264_predict_16x16_init_intrin( cpu, pf );
+#endif
 
 #if HAVE_ALTIVEC
     if( cpu&X264_CPU_ALTIVEC )
@@ -914,6 +920,9 @@ void x264_predict_8x8c_init( int cpu, x264_predict_t pf[7] )
 #if HAVE_MMX
     x264_predict_8x8c_init_mmx( cpu, pf );
 #endif
+#if HAVE_X86_INTRIN && !HIGH_BIT_DEPTH
+    x264_predict_8x8c_init_intrin( cpu, pf );
+#endif
 
 #if HAVE_ALTIVEC
     if( cpu&X264_CPU_ALTIVEC )
@@ -938,6 +947,9 @@ void x264_predict_8x16c_init( int cpu, x264_predict_t pf[7] )
 #if HAVE_MMX
     x264_predict_8x16c_init_mmx( cpu, pf );
 #endif
+#if HAVE_X86_INTRIN && !HIGH_BIT_DEPTH
+    x264_predict_8x16c_init_intrin( cpu, pf );
+#endif
 }
 
 void x264_predict_8x8_init( int cpu, x264_predict8x8_t pf[12], x264_predict_8x8_filter_t *predict_filter )
@@ -959,6 +971,9 @@ void x264_predict_8x8_init( int cpu, x264_predict8x8_t pf[12], x264_predict_8x8_
 #if HAVE_MMX
     x264_predict_8x8_init_mmx( cpu, pf, predict_filter );
 #endif
+#if HAVE_X86_INTRIN && !HIGH_BIT_DEPTH
+    x264_predict_8x8_init_intrin( cpu, pf, predict_filter );
+#endif
 
 #if HAVE_ARMV6
     x264_predict_8x8_init_arm( cpu, pf, predict_filter );
@@ -983,6 +998,9 @@ void x264_predict_4x4_init( int cpu, x264_predict_t pf[12] )
 #if HAVE_MMX
     x264_predict_4x4_init_mmx( cpu, pf );
 #endif
+#if HAVE_X86_INTRIN && !HIGH_BIT_DEPTH
+    x264_predict_4x4_init_intrin( cpu, pf );
+#endif
 
 #if HAVE_ARMV6
     x264_predict_4x4_init_arm( cpu, pf );
@@ -37,6 +37,9 @@
 #if ARCH_ARM
 #   include "arm/quant.h"
 #endif
+#if HAVE_X86_INTRIN
+#   include "x86/intrin.h"
+#endif
 
 #define QUANT_ONE( coef, mf, f ) \
 { \
@@ -745,6 +748,9 @@ void x264_quant_init( x264_t *h, int cpu, x264_quant_function_t *pf )
         pf->coeff_last[DCT_LUMA_8x8] = x264_coeff_last64_neon;
     }
 #endif
+#if HAVE_X86_INTRIN
+    x264_quant_init_intrin( cpu, pf );
+#endif
 #endif // HIGH_BIT_DEPTH
     pf->coeff_last[DCT_LUMA_DC]     = pf->coeff_last[DCT_CHROMAU_DC]  = pf->coeff_last[DCT_CHROMAV_DC] =
     pf->coeff_last[DCT_CHROMAU_4x4] = pf->coeff_last[DCT_CHROMAV_4x4] = pf->coeff_last[DCT_LUMA_4x4];
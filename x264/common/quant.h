@@ -71,4 +71,7 @@ typedef struct
 
 void x264_quant_init( x264_t *h, int cpu, x264_quant_function_t *pf );
 
+extern const uint8_t x264_decimate_table4[16];
+extern const uint8_t x264_decimate_table8[64];
+
 #endif
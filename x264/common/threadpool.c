@@ -24,14 +24,65 @@
  *****************************************************************************/
 
 #include "common.h"
+#include <sched.h>
+
+/* Work-stealing pool.
+ *
+ * Every worker owns a bounded lock-free ring of queued jobs.  x264_threadpool_run
+ * deals jobs out to the rings in turn; a worker takes from its own ring first and
+ * steals from the others when it runs dry.  Jobs are handed over with atomics
+ * only: the mutex and condition variables are touched just to put idle workers,
+ * a thread blocked in x264_threadpool_wait, or x264_threadpool_run finding every
+ * job still uncollected, to sleep and to wake them again, after they have spun
+ * and then yielded for a while without finding anything to do.  Yielding keeps
+ * an oversubscribed machine from spinning away the time slice of the thread
+ * that would make progress. */
+
+#if defined(__i386__) || defined(__x86_64__)
+#define x264_threadpool_pause() __asm__ volatile( "pause" )
+#else
+#define x264_threadpool_pause()
+#endif
+
+/* polls before an idle thread goes to sleep: busy, then yielding */
+#define THREADPOOL_SPIN  256
+#define THREADPOOL_YIELD 32
+
+enum
+{
+    JOB_FREE = 0,
+    JOB_RESERVED,   /* claimed by x264_threadpool_run, being filled in */
+    JOB_QUEUED,
+    JOB_DONE
+};
 
 typedef struct
 {
     void *(*func)(void *);
     void *arg;
     void *ret;
+    int  state;
 } x264_threadpool_job_t;
 
+typedef struct
+{
+    size_t seq;
+    x264_threadpool_job_t *job;
+} x264_threadpool_cell_t;
+
+/* Bounded MPMC ring; seq tells producers and consumers whose turn a cell is. */
+typedef struct
+{
+    size_t head;
+    uint8_t pad0[64];
+    size_t tail;
+    uint8_t pad1[64];
+    x264_threadpool_cell_t *cells;
+    x264_threadpool_t *pool;
+    int id;
+    uint8_t pad2[64];
+} x264_threadpool_worker_t;
+
 struct x264_threadpool_t
 {
     int            exit;
@@ -40,34 +91,128 @@ struct x264_threadpool_t
     void           (*init_func)(void *);
     void           *init_arg;
 
-    /* requires a synchronized list structure and associated methods,
-       so use what is already implemented for frames */
-    x264_sync_frame_list_t uninit; /* list of jobs that are awaiting use */
-    x264_sync_frame_list_t run;    /* list of jobs that are queued for processing by the pool */
-    x264_sync_frame_list_t done;   /* list of jobs that have finished processing */
+    /* one job per thread, as with the list based pool: x264 never has more
+     * jobs running or waiting to be collected than the pool has threads */
+    x264_threadpool_job_t    *jobs;
+    x264_threadpool_worker_t *workers;
+    size_t         ring_mask;
+    int            next_worker;
+
+    x264_pthread_mutex_t mutex;
+    x264_pthread_cond_t  cv_run;  /* idle workers */
+    x264_pthread_cond_t  cv_done; /* threads in x264_threadpool_wait or waiting for a free job */
+    int            sleeping_workers;
+    int            sleeping_waiters;
+    int            sleeping_runners;
+    int            spin;          /* busy polls, none on a single processor */
 };
 
-static void *x264_threadpool_thread( x264_threadpool_t *pool )
+static void x264_threadpool_backoff( x264_threadpool_t *pool, int spin )
+{
+    if( spin < pool->spin )
+        x264_threadpool_pause();
+    else
+        sched_yield();
+}
+
+static int x264_threadpool_push( x264_threadpool_t *pool, x264_threadpool_worker_t *w, x264_threadpool_job_t *job )
+{
+    size_t pos = __atomic_load_n( &w->tail, __ATOMIC_RELAXED );
+    for( ;; )
+    {
+        x264_threadpool_cell_t *cell = &w->cells[pos & pool->ring_mask];
+        intptr_t dif = (intptr_t)__atomic_load_n( &cell->seq, __ATOMIC_ACQUIRE ) - (intptr_t)pos;
+        if( dif == 0 )
+        {
+            if( __atomic_compare_exchange_n( &w->tail, &pos, pos+1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) )
+            {
+                cell->job = job;
+                __atomic_store_n( &cell->seq, pos+1, __ATOMIC_RELEASE );
+                return 1;
+            }
+        }
+        else if( dif < 0 )
+            return 0; /* full */
+        else
+            pos = __atomic_load_n( &w->tail, __ATOMIC_RELAXED );
+    }
+}
+
+static x264_threadpool_job_t *x264_threadpool_pop( x264_threadpool_t *pool, x264_threadpool_worker_t *w )
+{
+    size_t pos = __atomic_load_n( &w->head, __ATOMIC_RELAXED );
+    for( ;; )
+    {
+        x264_threadpool_cell_t *cell = &w->cells[pos & pool->ring_mask];
+        intptr_t dif = (intptr_t)__atomic_load_n( &cell->seq, __ATOMIC_ACQUIRE ) - (intptr_t)(pos+1);
+        if( dif == 0 )
+        {
+            if( __atomic_compare_exchange_n( &w->head, &pos, pos+1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) )
+            {
+                x264_threadpool_job_t *job = cell->job;
+                __atomic_store_n( &cell->seq, pos + pool->ring_mask + 1, __ATOMIC_RELEASE );
+                return job;
+            }
+        }
+        else if( dif < 0 )
+            return NULL; /* empty */
+        else
+            pos = __atomic_load_n( &w->head, __ATOMIC_RELAXED );
+    }
+}
+
+/* own ring first, then steal from the others */
+static x264_threadpool_job_t *x264_threadpool_take( x264_threadpool_t *pool, int id )
+{
+    for( int i = 0; i < pool->threads; i++ )
+    {
+        x264_threadpool_job_t *job = x264_threadpool_pop( pool, &pool->workers[(id + i) % pool->threads] );
+        if( job )
+            return job;
+    }
+    return NULL;
+}
+
+static x264_threadpool_job_t *x264_threadpool_sleep( x264_threadpool_t *pool, int id )
+{
+    x264_threadpool_job_t *job = NULL;
+    x264_pthread_mutex_lock( &pool->mutex );
+    __atomic_add_fetch( &pool->sleeping_workers, 1, __ATOMIC_SEQ_CST );
+    __atomic_thread_fence( __ATOMIC_SEQ_CST );
+    while( !__atomic_load_n( &pool->exit, __ATOMIC_ACQUIRE ) && !(job = x264_threadpool_take( pool, id )) )
+        x264_pthread_cond_wait( &pool->cv_run, &pool->mutex );
+    __atomic_sub_fetch( &pool->sleeping_workers, 1, __ATOMIC_SEQ_CST );
+    x264_pthread_mutex_unlock( &pool->mutex );
+    return job;
+}
+
+static void *x264_threadpool_thread( x264_threadpool_worker_t *w )
 {
+    x264_threadpool_t *pool = w->pool;
     if( pool->init_func )
         pool->init_func( pool->init_arg );
 
-    while( !pool->exit )
+    while( !__atomic_load_n( &pool->exit, __ATOMIC_ACQUIRE ) )
     {
         x264_threadpool_job_t *job = NULL;
-        x264_pthread_mutex_lock( &pool->run.mutex );
-        while( !pool->exit && !pool->run.i_size )
-            x264_pthread_cond_wait( &pool->run.cv_fill, &pool->run.mutex );
-        if( pool->run.i_size )
+        for( int spin = 0; !job && spin < pool->spin + THREADPOOL_YIELD && !__atomic_load_n( &pool->exit, __ATOMIC_RELAXED ); spin++ )
         {
-            job = (void*)x264_frame_shift( pool->run.list );
-            pool->run.i_size--;
+            job = x264_threadpool_take( pool, w->id );
+            if( !job )
+                x264_threadpool_backoff( pool, spin );
         }
-        x264_pthread_mutex_unlock( &pool->run.mutex );
-        if( !job )
+        if( !job && !(job = x264_threadpool_sleep( pool, w->id )) )
             continue;
+
         job->ret = (void*)x264_stack_align( job->func, job->arg ); /* execute the function */
-        x264_sync_frame_list_push( &pool->done, (void*)job );
+        __atomic_store_n( &job->state, JOB_DONE, __ATOMIC_RELEASE );
+        __atomic_thread_fence( __ATOMIC_SEQ_CST );
+        if( __atomic_load_n( &pool->sleeping_waiters, __ATOMIC_RELAXED ) )
+        {
+            x264_pthread_mutex_lock( &pool->mutex );
+            x264_pthread_cond_broadcast( &pool->cv_done );
+            x264_pthread_mutex_unlock( &pool->mutex );
+        }
     }
     return NULL;
 }
@@ -85,22 +230,33 @@ int x264_threadpool_init( x264_threadpool_t **p_pool, int threads,
     pool->init_func = init_func;
     pool->init_arg  = init_arg;
     pool->threads   = threads;
+    pool->spin      = x264_cpu_num_processors() > 1 ? THREADPOOL_SPIN : 0;
 
-    CHECKED_MALLOC( pool->thread_handle, pool->threads * sizeof(x264_pthread_t) );
-
-    if( x264_sync_frame_list_init( &pool->uninit, pool->threads ) ||
-        x264_sync_frame_list_init( &pool->run, pool->threads ) ||
-        x264_sync_frame_list_init( &pool->done, pool->threads ) )
-        goto fail;
+    size_t ring_size = 1;
+    while( ring_size < threads )
+        ring_size <<= 1;
+    pool->ring_mask = ring_size - 1;
 
+    CHECKED_MALLOC( pool->thread_handle, pool->threads * sizeof(x264_pthread_t) );
+    CHECKED_MALLOCZERO( pool->jobs, pool->threads * sizeof(x264_threadpool_job_t) );
+    CHECKED_MALLOCZERO( pool->workers, pool->threads * sizeof(x264_threadpool_worker_t) );
     for( int i = 0; i < pool->threads; i++ )
     {
-       x264_threadpool_job_t *job;
-       CHECKED_MALLOC( job, sizeof(x264_threadpool_job_t) );
-       x264_sync_frame_list_push( &pool->uninit, (void*)job );
+        x264_threadpool_worker_t *w = &pool->workers[i];
+        CHECKED_MALLOC( w->cells, ring_size * sizeof(x264_threadpool_cell_t) );
+        for( size_t j = 0; j < ring_size; j++ )
+            w->cells[j].seq = j;
+        w->pool = pool;
+        w->id = i;
     }
+
+    if( x264_pthread_mutex_init( &pool->mutex, NULL ) ||
+        x264_pthread_cond_init( &pool->cv_run, NULL ) ||
+        x264_pthread_cond_init( &pool->cv_done, NULL ) )
+        goto fail;
+
     for( int i = 0; i < pool->threads; i++ )
-        if( x264_pthread_create( pool->thread_handle+i, NULL, (void*)x264_threadpool_thread, pool ) )
+        if( x264_pthread_create( pool->thread_handle+i, NULL, (void*)x264_threadpool_thread, &pool->workers[i] ) )
             goto fail;
 
     return 0;
@@ -108,62 +264,115 @@ fail:
     return -1;
 }
 
+static x264_threadpool_job_t *x264_threadpool_claim( x264_threadpool_t *pool )
+{
+    for( int i = 0; i < pool->threads; i++ )
+    {
+        int expected = JOB_FREE;
+        if( __atomic_compare_exchange_n( &pool->jobs[i].state, &expected, JOB_RESERVED, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED ) )
+            return &pool->jobs[i];
+    }
+    return NULL;
+}
+
 void x264_threadpool_run( x264_threadpool_t *pool, void *(*func)(void *), void *arg )
 {
-    x264_threadpool_job_t *job = (void*)x264_sync_frame_list_pop( &pool->uninit );
+    /* A free job always exists while callers collect every job they run; when
+     * all of them are still waiting to be collected on another thread, back off
+     * and then sleep until x264_threadpool_wait frees one. */
+    x264_threadpool_job_t *job = x264_threadpool_claim( pool );
+    for( int spin = 0; !job && spin < pool->spin + THREADPOOL_YIELD; spin++ )
+    {
+        x264_threadpool_backoff( pool, spin );
+        job = x264_threadpool_claim( pool );
+    }
+    if( !job )
+    {
+        x264_pthread_mutex_lock( &pool->mutex );
+        __atomic_add_fetch( &pool->sleeping_runners, 1, __ATOMIC_SEQ_CST );
+        __atomic_thread_fence( __ATOMIC_SEQ_CST );
+        while( !(job = x264_threadpool_claim( pool )) )
+            x264_pthread_cond_wait( &pool->cv_done, &pool->mutex );
+        __atomic_sub_fetch( &pool->sleeping_runners, 1, __ATOMIC_SEQ_CST );
+        x264_pthread_mutex_unlock( &pool->mutex );
+    }
+
     job->func = func;
     job->arg  = arg;
-    x264_sync_frame_list_push( &pool->run, (void*)job );
+    __atomic_store_n( &job->state, JOB_QUEUED, __ATOMIC_RELEASE );
+
+    int first = __atomic_fetch_add( &pool->next_worker, 1, __ATOMIC_RELAXED );
+    for( int i = 0; !x264_threadpool_push( pool, &pool->workers[(first + i) % pool->threads], job ); i++ );
+
+    __atomic_thread_fence( __ATOMIC_SEQ_CST );
+    if( __atomic_load_n( &pool->sleeping_workers, __ATOMIC_RELAXED ) )
+    {
+        x264_pthread_mutex_lock( &pool->mutex );
+        x264_pthread_cond_signal( &pool->cv_run );
+        x264_pthread_mutex_unlock( &pool->mutex );
+    }
+}
+
+static x264_threadpool_job_t *x264_threadpool_find( x264_threadpool_t *pool, void *arg )
+{
+    for( int i = 0; i < pool->threads; i++ )
+    {
+        x264_threadpool_job_t *job = &pool->jobs[i];
+        int state = __atomic_load_n( &job->state, __ATOMIC_ACQUIRE );
+        if( (state == JOB_QUEUED || state == JOB_DONE) && job->arg == arg )
+            return job;
+    }
+    return NULL;
 }
 
 void *x264_threadpool_wait( x264_threadpool_t *pool, void *arg )
 {
-    x264_threadpool_job_t *job = NULL;
+    x264_threadpool_job_t *job = x264_threadpool_find( pool, arg );
+    if( !job )
+        return NULL;
 
-    x264_pthread_mutex_lock( &pool->done.mutex );
-    while( !job )
+    for( int spin = 0; spin < pool->spin + THREADPOOL_YIELD && __atomic_load_n( &job->state, __ATOMIC_ACQUIRE ) != JOB_DONE; spin++ )
+        x264_threadpool_backoff( pool, spin );
+
+    if( __atomic_load_n( &job->state, __ATOMIC_ACQUIRE ) != JOB_DONE )
     {
-        for( int i = 0; i < pool->done.i_size; i++ )
-        {
-            x264_threadpool_job_t *t = (void*)pool->done.list[i];
-            if( t->arg == arg )
-            {
-                job = (void*)x264_frame_shift( pool->done.list+i );
-                pool->done.i_size--;
-            }
-        }
-        if( !job )
-            x264_pthread_cond_wait( &pool->done.cv_fill, &pool->done.mutex );
+        x264_pthread_mutex_lock( &pool->mutex );
+        __atomic_add_fetch( &pool->sleeping_waiters, 1, __ATOMIC_SEQ_CST );
+        __atomic_thread_fence( __ATOMIC_SEQ_CST );
+        while( __atomic_load_n( &job->state, __ATOMIC_ACQUIRE ) != JOB_DONE )
+            x264_pthread_cond_wait( &pool->cv_done, &pool->mutex );
+        __atomic_sub_fetch( &pool->sleeping_waiters, 1, __ATOMIC_SEQ_CST );
+        x264_pthread_mutex_unlock( &pool->mutex );
     }
-    x264_pthread_mutex_unlock( &pool->done.mutex );
 
     void *ret = job->ret;
-    x264_sync_frame_list_push( &pool->uninit, (void*)job );
-    return ret;
-}
-
-static void x264_threadpool_list_delete( x264_sync_frame_list_t *slist )
-{
-    for( int i = 0; slist->list[i]; i++ )
+    __atomic_store_n( &job->state, JOB_FREE, __ATOMIC_RELEASE );
+    __atomic_thread_fence( __ATOMIC_SEQ_CST );
+    if( __atomic_load_n( &pool->sleeping_runners, __ATOMIC_RELAXED ) )
     {
-        x264_free( slist->list[i] );
-        slist->list[i] = NULL;
+        x264_pthread_mutex_lock( &pool->mutex );
+        x264_pthread_cond_broadcast( &pool->cv_done );
+        x264_pthread_mutex_unlock( &pool->mutex );
     }
-    x264_sync_frame_list_delete( slist );
+    return ret;
 }
 
 void x264_threadpool_delete( x264_threadpool_t *pool )
 {
-    x264_pthread_mutex_lock( &pool->run.mutex );
-    pool->exit = 1;
-    x264_pthread_cond_broadcast( &pool->run.cv_fill );
-    x264_pthread_mutex_unlock( &pool->run.mutex );
+    x264_pthread_mutex_lock( &pool->mutex );
+    __atomic_store_n( &pool->exit, 1, __ATOMIC_RELEASE );
+    x264_pthread_cond_broadcast( &pool->cv_run );
+    x264_pthread_mutex_unlock( &pool->mutex );
     for( int i = 0; i < pool->threads; i++ )
         x264_pthread_join( pool->thread_handle[i], NULL );
 
-    x264_threadpool_list_delete( &pool->uninit );
-    x264_threadpool_list_delete( &pool->run );
-    x264_threadpool_list_delete( &pool->done );
+    for( int i = 0; i < pool->threads; i++ )
+        x264_free( pool->workers[i].cells );
+    x264_pthread_mutex_destroy( &pool->mutex );
+    x264_pthread_cond_destroy( &pool->cv_run );
+    x264_pthread_cond_destroy( &pool->cv_done );
+    x264_free( pool->workers );
+    x264_free( pool->jobs );
     x264_free( pool->thread_handle );
     x264_free( pool );
 }
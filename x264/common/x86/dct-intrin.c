@@ -0,0 +1,976 @@
+/*****************************************************************************
+ * dct-intrin.c: x86 transform and zigzag with compiler intrinsics
+ *****************************************************************************
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *****************************************************************************/
+
+#include "common/common.h"
+#include "intrin.h"
+#include <immintrin.h>
+
+#if HAVE_X86_INTRIN && !HIGH_BIT_DEPTH
+
+/* The transforms run in 16 bits like the x264 asm: identical to common/dct.c
+ * for every coefficient a residual or a dequantized block can produce.
+ * Each 2D transform is one 1D pass down the columns of the row registers,
+ * a transpose, and a second pass down the columns, which lands exactly on
+ * the transposed stores of the C version. */
+
+#define LOADU(p)  _mm_loadu_si128( (const __m128i*)(p) )
+#define LOADL(p)  _mm_loadl_epi64( (const __m128i*)(p) )
+#define STOREU(p, v) _mm_storeu_si128( (__m128i*)(p), v )
+#define STOREL(p, v) _mm_storel_epi64( (__m128i*)(p), v )
+#define STOREH(p, v) _mm_storel_epi64( (__m128i*)(p), _mm_srli_si128( v, 8 ) )
+
+/* The 1D transforms and transposes are written once against these names
+ * and expand to SSE2 or AVX2 depending on the definitions in scope. */
+#define DCT4_1D( r0, r1, r2, r3 ) {\
+    VEC s03 = ADD( r0, r3 );\
+    VEC s12 = ADD( r1, r2 );\
+    VEC d03 = SUB( r0, r3 );\
+    VEC d12 = SUB( r1, r2 );\
+    r0 = ADD( s03, s12 );\
+    r1 = ADD( ADD( d03, d03 ), d12 );\
+    r2 = SUB( s03, s12 );\
+    r3 = SUB( d03, ADD( d12, d12 ) );\
+}
+
+#define IDCT4_1D( r0, r1, r2, r3 ) {\
+    VEC s02 = ADD( r0, r2 );\
+    VEC d02 = SUB( r0, r2 );\
+    VEC s13 = ADD( r1, SRA( r3, 1 ) );\
+    VEC d13 = SUB( SRA( r1, 1 ), r3 );\
+    r0 = ADD( s02, s13 );\
+    r1 = ADD( d02, d13 );\
+    r2 = SUB( d02, d13 );\
+    r3 = SUB( s02, s13 );\
+}
+
+#define WHT4_1D( r0, r1, r2, r3 ) {\
+    VEC s01 = ADD( r0, r1 );\
+    VEC d01 = SUB( r0, r1 );\
+    VEC s23 = ADD( r2, r3 );\
+    VEC d23 = SUB( r2, r3 );\
+    r0 = ADD( s01, s23 );\
+    r1 = SUB( s01, s23 );\
+    r2 = SUB( d01, d23 );\
+    r3 = ADD( d01, d23 );\
+}
+
+#define DCT8_1D( r ) {\
+    VEC s07 = ADD( r[0], r[7] );\
+    VEC s16 = ADD( r[1], r[6] );\
+    VEC s25 = ADD( r[2], r[5] );\
+    VEC s34 = ADD( r[3], r[4] );\
+    VEC a0 = ADD( s07, s34 );\
+    VEC a1 = ADD( s16, s25 );\
+    VEC a2 = SUB( s07, s34 );\
+    VEC a3 = SUB( s16, s25 );\
+    VEC d07 = SUB( r[0], r[7] );\
+    VEC d16 = SUB( r[1], r[6] );\
+    VEC d25 = SUB( r[2], r[5] );\
+    VEC d34 = SUB( r[3], r[4] );\
+    VEC a4 = ADD( ADD( d16, d25 ), ADD( d07, SRA( d07, 1 ) ) );\
+    VEC a5 = SUB( SUB( d07, d34 ), ADD( d25, SRA( d25, 1 ) ) );\
+    VEC a6 = SUB( ADD( d07, d34 ), ADD( d16, SRA( d16, 1 ) ) );\
+    VEC a7 = ADD( SUB( d16, d25 ), ADD( d34, SRA( d34, 1 ) ) );\
+    r[0] = ADD( a0, a1 );\
+    r[1] = ADD( a4, SRA( a7, 2 ) );\
+    r[2] = ADD( a2, SRA( a3, 1 ) );\
+    r[3] = ADD( a5, SRA( a6, 2 ) );\
+    r[4] = SUB( a0, a1 );\
+    r[5] = SUB( a6, SRA( a5, 2 ) );\
+    r[6] = SUB( SRA( a2, 1 ), a3 );\
+    r[7] = SUB( SRA( a4, 2 ), a7 );\
+}
+
+#define IDCT8_1D( r ) {\
+    VEC a0 = ADD( r[0], r[4] );\
+    VEC a2 = SUB( r[0], r[4] );\
+    VEC a4 = SUB( SRA( r[2], 1 ), r[6] );\
+    VEC a6 = ADD( SRA( r[6], 1 ), r[2] );\
+    VEC b0 = ADD( a0, a6 );\
+    VEC b2 = ADD( a2, a4 );\
+    VEC b4 = SUB( a2, a4 );\
+    VEC b6 = SUB( a0, a6 );\
+    VEC a1 = SUB( SUB( r[5], r[3] ), ADD( r[7], SRA( r[7], 1 ) ) );\
+    VEC a3 = SUB( ADD( r[1], r[7] ), ADD( r[3], SRA( r[3], 1 ) ) );\
+    VEC a5 = ADD( SUB( r[7], r[1] ), ADD( r[5], SRA( r[5], 1 ) ) );\
+    VEC a7 = ADD( ADD( r[3], r[5] ), ADD( r[1], SRA( r[1], 1 ) ) );\
+    VEC b1 = ADD( SRA( a7, 2 ), a1 );\
+    VEC b3 = ADD( a3, SRA( a5, 2 ) );\
+    VEC b5 = SUB( SRA( a3, 2 ), a5 );\
+    VEC b7 = SUB( a7, SRA( a1, 2 ) );\
+    r[0] = ADD( b0, b7 );\
+    r[1] = ADD( b2, b5 );\
+    r[2] = ADD( b4, b3 );\
+    r[3] = ADD( b6, b1 );\
+    r[4] = SUB( b6, b1 );\
+    r[5] = SUB( b4, b3 );\
+    r[6] = SUB( b2, b5 );\
+    r[7] = SUB( b0, b7 );\
+}
+
+/* two 4x4 blocks side by side in each 128-bit lane */
+#define TRANSPOSE4x4x2( r0, r1, r2, r3 ) {\
+    VEC t0 = UNPACKLO16( r0, r1 );\
+    VEC t1 = UNPACKHI16( r0, r1 );\
+    VEC t2 = UNPACKLO16( r2, r3 );\
+    VEC t3 = UNPACKHI16( r2, r3 );\
+    VEC u0 = UNPACKLO32( t0, t2 );\
+    VEC u1 = UNPACKHI32( t0, t2 );\
+    VEC u2 = UNPACKLO32( t1, t3 );\
+    VEC u3 = UNPACKHI32( t1, t3 );\
+    r0 = UNPACKLO64( u0, u2 );\
+    r1 = UNPACKHI64( u0, u2 );\
+    r2 = UNPACKLO64( u1, u3 );\
+    r3 = UNPACKHI64( u1, u3 );\
+}
+
+/* one 8x8 block in each 128-bit lane */
+#define TRANSPOSE8x8( r ) {\
+    VEC a0 = UNPACKLO16( r[0], r[1] );\
+    VEC a1 = UNPACKHI16( r[0], r[1] );\
+    VEC a2 = UNPACKLO16( r[2], r[3] );\
+    VEC a3 = UNPACKHI16( r[2], r[3] );\
+    VEC a4 = UNPACKLO16( r[4], r[5] );\
+    VEC a5 = UNPACKHI16( r[4], r[5] );\
+    VEC a6 = UNPACKLO16( r[6], r[7] );\
+    VEC a7 = UNPACKHI16( r[6], r[7] );\
+    VEC b0 = UNPACKLO32( a0, a2 );\
+    VEC b1 = UNPACKHI32( a0, a2 );\
+    VEC b2 = UNPACKLO32( a1, a3 );\
+    VEC b3 = UNPACKHI32( a1, a3 );\
+    VEC b4 = UNPACKLO32( a4, a6 );\
+    VEC b5 = UNPACKHI32( a4, a6 );\
+    VEC b6 = UNPACKLO32( a5, a7 );\
+    VEC b7 = UNPACKHI32( a5, a7 );\
+    r[0] = UNPACKLO64( b0, b4 );\
+    r[1] = UNPACKHI64( b0, b4 );\
+    r[2] = UNPACKLO64( b1, b5 );\
+    r[3] = UNPACKHI64( b1, b5 );\
+    r[4] = UNPACKLO64( b2, b6 );\
+    r[5] = UNPACKHI64( b2, b6 );\
+    r[6] = UNPACKLO64( b3, b7 );\
+    r[7] = UNPACKHI64( b3, b7 );\
+}
+
+#define VEC __m128i
+#define ADD _mm_add_epi16
+#define SUB _mm_sub_epi16
+#define SRA _mm_srai_epi16
+#define UNPACKLO16 _mm_unpacklo_epi16
+#define UNPACKHI16 _mm_unpackhi_epi16
+#define UNPACKLO32 _mm_unpacklo_epi32
+#define UNPACKHI32 _mm_unpackhi_epi32
+#define UNPACKLO64 _mm_unpacklo_epi64
+#define UNPACKHI64 _mm_unpackhi_epi64
+
+static ALWAYS_INLINE __m128i load_4_epi16( const pixel *p )
+{
+    return _mm_unpacklo_epi8( _mm_cvtsi32_si128( M32( p ) ), _mm_setzero_si128() );
+}
+
+static ALWAYS_INLINE __m128i load_8_epi16( const pixel *p )
+{
+    return _mm_unpacklo_epi8( LOADL( p ), _mm_setzero_si128() );
+}
+
+/* fenc - fdec for w = 4 or 8 pixels of row y */
+static ALWAYS_INLINE __m128i diff_row( const pixel *pix1, const pixel *pix2, int y, int w )
+{
+    if( w == 4 )
+        return _mm_sub_epi16( load_4_epi16( pix1 + y*FENC_STRIDE ), load_4_epi16( pix2 + y*FDEC_STRIDE ) );
+    return _mm_sub_epi16( load_8_epi16( pix1 + y*FENC_STRIDE ), load_8_epi16( pix2 + y*FDEC_STRIDE ) );
+}
+
+/* dst + w pixels of v, w = 4 or 8 */
+static ALWAYS_INLINE void add_row( pixel *dst, __m128i v, int w )
+{
+    if( w == 4 )
+    {
+        v = _mm_add_epi16( load_4_epi16( dst ), v );
+        M32( dst ) = _mm_cvtsi128_si32( _mm_packus_epi16( v, v ) );
+    }
+    else
+    {
+        v = _mm_add_epi16( load_8_epi16( dst ), v );
+        STOREL( dst, _mm_packus_epi16( v, v ) );
+    }
+}
+
+/****************************************************************************
+ * 4x4 transform
+ ****************************************************************************/
+/* w = 8: dct0 and dct1 side by side, w = 4: dct0 only */
+static ALWAYS_INLINE void sub4x4_dct_wx4( dctcoef *dct0, dctcoef *dct1, pixel *pix1, pixel *pix2, int w )
+{
+    __m128i r0 = diff_row( pix1, pix2, 0, w );
+    __m128i r1 = diff_row( pix1, pix2, 1, w );
+    __m128i r2 = diff_row( pix1, pix2, 2, w );
+    __m128i r3 = diff_row( pix1, pix2, 3, w );
+    DCT4_1D( r0, r1, r2, r3 );
+    TRANSPOSE4x4x2( r0, r1, r2, r3 );
+    DCT4_1D( r0, r1, r2, r3 );
+    STOREU( dct0+0, _mm_unpacklo_epi64( r0, r1 ) );
+    STOREU( dct0+8, _mm_unpacklo_epi64( r2, r3 ) );
+    if( w == 8 )
+    {
+        STOREU( dct1+0, _mm_unpackhi_epi64( r0, r1 ) );
+        STOREU( dct1+8, _mm_unpackhi_epi64( r2, r3 ) );
+    }
+}
+
+static void sub4x4_dct_sse2( dctcoef dct[16], pixel *pix1, pixel *pix2 )
+{
+    sub4x4_dct_wx4( dct, NULL, pix1, pix2, 4 );
+}
+
+static void sub8x8_dct_sse2( dctcoef dct[4][16], pixel *pix1, pixel *pix2 )
+{
+    sub4x4_dct_wx4( dct[0], dct[1], pix1, pix2, 8 );
+    sub4x4_dct_wx4( dct[2], dct[3], pix1+4*FENC_STRIDE, pix2+4*FDEC_STRIDE, 8 );
+}
+
+static void sub16x16_dct_sse2( dctcoef dct[16][16], pixel *pix1, pixel *pix2 )
+{
+    sub8x8_dct_sse2( &dct[ 0], &pix1[0], &pix2[0] );
+    sub8x8_dct_sse2( &dct[ 4], &pix1[8], &pix2[8] );
+    sub8x8_dct_sse2( &dct[ 8], &pix1[8*FENC_STRIDE+0], &pix2[8*FDEC_STRIDE+0] );
+    sub8x8_dct_sse2( &dct[12], &pix1[8*FENC_STRIDE+8], &pix2[8*FDEC_STRIDE+8] );
+}
+
+static ALWAYS_INLINE void add4x4_idct_wx4( pixel *p_dst, dctcoef *dct0, dctcoef *dct1, int w )
+{
+    __m128i r0, r1, r2, r3;
+    if( w == 4 )
+    {
+        r0 = LOADL( dct0+0 );
+        r1 = LOADL( dct0+4 );
+        r2 = LOADL( dct0+8 );
+        r3 = LOADL( dct0+12 );
+    }
+    else
+    {
+        r0 = _mm_unpacklo_epi64( LOADL( dct0+0 ), LOADL( dct1+0 ) );
+        r1 = _mm_unpacklo_epi64( LOADL( dct0+4 ), LOADL( dct1+4 ) );
+        r2 = _mm_unpacklo_epi64( LOADL( dct0+8 ), LOADL( dct1+8 ) );
+        r3 = _mm_unpacklo_epi64( LOADL( dct0+12 ), LOADL( dct1+12 ) );
+    }
+    IDCT4_1D( r0, r1, r2, r3 );
+    TRANSPOSE4x4x2( r0, r1, r2, r3 );
+    IDCT4_1D( r0, r1, r2, r3 );
+    const __m128i rnd = _mm_set1_epi16( 32 );
+    add_row( p_dst+0*FDEC_STRIDE, _mm_srai_epi16( _mm_add_epi16( r0, rnd ), 6 ), w );
+    add_row( p_dst+1*FDEC_STRIDE, _mm_srai_epi16( _mm_add_epi16( r1, rnd ), 6 ), w );
+    add_row( p_dst+2*FDEC_STRIDE, _mm_srai_epi16( _mm_add_epi16( r2, rnd ), 6 ), w );
+    add_row( p_dst+3*FDEC_STRIDE, _mm_srai_epi16( _mm_add_epi16( r3, rnd ), 6 ), w );
+}
+
+static void add4x4_idct_sse2( pixel *p_dst, dctcoef dct[16] )
+{
+    add4x4_idct_wx4( p_dst, dct, NULL, 4 );
+}
+
+static void add8x8_idct_sse2( pixel *p_dst, dctcoef dct[4][16] )
+{
+    add4x4_idct_wx4( p_dst, dct[0], dct[1], 8 );
+    add4x4_idct_wx4( p_dst+4*FDEC_STRIDE, dct[2], dct[3], 8 );
+}
+
+static void add16x16_idct_sse2( pixel *p_dst, dctcoef dct[16][16] )
+{
+    add8x8_idct_sse2( &p_dst[0],               &dct[0] );
+    add8x8_idct_sse2( &p_dst[8],               &dct[4] );
+    add8x8_idct_sse2( &p_dst[8*FDEC_STRIDE+0], &dct[8] );
+    add8x8_idct_sse2( &p_dst[8*FDEC_STRIDE+8], &dct[12] );
+}
+
+/****************************************************************************
+ * DC transforms
+ ****************************************************************************/
+/* sums of the four 4x4 blocks of an 8x8 residual in dct order, as int32 */
+static ALWAYS_INLINE __m128i sub8x8_dc_sums( pixel *pix1, pixel *pix2 )
+{
+    __m128i top = _mm_add_epi16( _mm_add_epi16( diff_row( pix1, pix2, 0, 8 ), diff_row( pix1, pix2, 1, 8 ) ),
+                                 _mm_add_epi16( diff_row( pix1, pix2, 2, 8 ), diff_row( pix1, pix2, 3, 8 ) ) );
+    __m128i bot = _mm_add_epi16( _mm_add_epi16( diff_row( pix1, pix2, 4, 8 ), diff_row( pix1, pix2, 5, 8 ) ),
+                                 _mm_add_epi16( diff_row( pix1, pix2, 6, 8 ), diff_row( pix1, pix2, 7, 8 ) ) );
+    const __m128i one = _mm_set1_epi16( 1 );
+    __m128 t = _mm_castsi128_ps( _mm_madd_epi16( top, one ) );
+    __m128 b = _mm_castsi128_ps( _mm_madd_epi16( bot, one ) );
+    return _mm_add_epi32( _mm_castps_si128( _mm_shuffle_ps( t, b, _MM_SHUFFLE(2,0,2,0) ) ),
+                          _mm_castps_si128( _mm_shuffle_ps( t, b, _MM_SHUFFLE(3,1,3,1) ) ) );
+}
+
+static void sub8x8_dct_dc_sse2( dctcoef dct[4], pixel *pix1, pixel *pix2 )
+{
+    ALIGNED_16( int32_t s[4] );
+    _mm_store_si128( (__m128i*)s, sub8x8_dc_sums( pix1, pix2 ) );
+
+    /* 2x2 DC transform */
+    int d0 = s[0] + s[1];
+    int d1 = s[2] + s[3];
+    int d2 = s[0] - s[1];
+    int d3 = s[2] - s[3];
+    dct[0] = d0 + d1;
+    dct[1] = d0 - d1;
+    dct[2] = d2 + d3;
+    dct[3] = d2 - d3;
+}
+
+static void sub8x16_dct_dc_sse2( dctcoef dct[8], pixel *pix1, pixel *pix2 )
+{
+    ALIGNED_16( int32_t a[8] );
+    _mm_store_si128( (__m128i*)(a+0), sub8x8_dc_sums( pix1, pix2 ) );
+    _mm_store_si128( (__m128i*)(a+4), sub8x8_dc_sums( pix1+8*FENC_STRIDE, pix2+8*FDEC_STRIDE ) );
+
+    /* 2x4 DC transform */
+    int b0 = a[0] + a[1];
+    int b1 = a[2] + a[3];
+    int b2 = a[4] + a[5];
+    int b3 = a[6] + a[7];
+    int b4 = a[0] - a[1];
+    int b5 = a[2] - a[3];
+    int b6 = a[4] - a[5];
+    int b7 = a[6] - a[7];
+    int c0 = b0 + b1;
+    int c1 = b2 + b3;
+    int c2 = b4 + b5;
+    int c3 = b6 + b7;
+    int c4 = b0 - b1;
+    int c5 = b2 - b3;
+    int c6 = b4 - b5;
+    int c7 = b6 - b7;
+    dct[0] = c0 + c1;
+    dct[1] = c2 + c3;
+    dct[2] = c0 - c1;
+    dct[3] = c2 - c3;
+    dct[4] = c4 - c5;
+    dct[5] = c6 - c7;
+    dct[6] = c4 + c5;
+    dct[7] = c6 + c7;
+}
+
+/* dst + dc with saturation, as a positive and a negative byte offset */
+static ALWAYS_INLINE void add_dc_row( pixel *dst, __m128i pos, __m128i neg, int w )
+{
+    if( w == 8 )
+        STOREL( dst, _mm_subs_epu8( _mm_adds_epu8( LOADL( dst ), pos ), neg ) );
+    else
+        STOREU( dst, _mm_subs_epu8( _mm_adds_epu8( LOADU( dst ), pos ), neg ) );
+}
+
+/* dc = ( dc + 32 ) >> 6 for 8 coefficients, each repeated 4 times in bytes */
+static ALWAYS_INLINE void idct_dc_bytes( __m128i dc, __m128i *pos, __m128i *neg )
+{
+    dc = _mm_srai_epi16( _mm_add_epi16( dc, _mm_set1_epi16( 32 ) ), 6 );
+    __m128i p = _mm_packus_epi16( dc, dc );
+    __m128i n = _mm_packus_epi16( _mm_sub_epi16( _mm_setzero_si128(), dc ), _mm_setzero_si128() );
+    p = _mm_unpacklo_epi8( p, p );
+    n = _mm_unpacklo_epi8( n, n );
+    pos[0] = _mm_unpacklo_epi16( p, p );
+    pos[1] = _mm_unpackhi_epi16( p, p );
+    neg[0] = _mm_unpacklo_epi16( n, n );
+    neg[1] = _mm_unpackhi_epi16( n, n );
+}
+
+static void add8x8_idct_dc_sse2( pixel *p_dst, dctcoef dct[4] )
+{
+    __m128i pos[2], neg[2];
+    idct_dc_bytes( LOADL( dct ), pos, neg );
+    __m128i pos1 = _mm_unpackhi_epi64( pos[0], pos[0] );
+    __m128i neg1 = _mm_unpackhi_epi64( neg[0], neg[0] );
+    for( int y = 0; y < 4; y++ )
+    {
+        add_dc_row( p_dst + y*FDEC_STRIDE, pos[0], neg[0], 8 );
+        add_dc_row( p_dst + (y+4)*FDEC_STRIDE, pos1, neg1, 8 );
+    }
+}
+
+static void add16x16_idct_dc_sse2( pixel *p_dst, dctcoef dct[16] )
+{
+    for( int i = 0; i < 2; i++, dct += 8, p_dst += 8*FDEC_STRIDE )
+    {
+        __m128i pos[2], neg[2];
+        idct_dc_bytes( LOADU( dct ), pos, neg );
+        for( int y = 0; y < 4; y++ )
+        {
+            add_dc_row( p_dst + y*FDEC_STRIDE, pos[0], neg[0], 16 );
+            add_dc_row( p_dst + (y+4)*FDEC_STRIDE, pos[1], neg[1], 16 );
+        }
+    }
+}
+
+static void dct4x4dc_sse2( dctcoef d[16] )
+{
+    __m128i r0 = LOADL( d+0 );
+    __m128i r1 = LOADL( d+4 );
+    __m128i r2 = LOADL( d+8 );
+    __m128i r3 = LOADL( d+12 );
+    WHT4_1D( r0, r1, r2, r3 );
+    TRANSPOSE4x4x2( r0, r1, r2, r3 );
+
+    /* the second pass and its rounding need 17 bits */
+    __m128i w0 = _mm_srai_epi32( _mm_unpacklo_epi16( r0, r0 ), 16 );
+    __m128i w1 = _mm_srai_epi32( _mm_unpacklo_epi16( r1, r1 ), 16 );
+    __m128i w2 = _mm_srai_epi32( _mm_unpacklo_epi16( r2, r2 ), 16 );
+    __m128i w3 = _mm_srai_epi32( _mm_unpacklo_epi16( r3, r3 ), 16 );
+    __m128i s01 = _mm_add_epi32( w0, w1 );
+    __m128i d01 = _mm_sub_epi32( w0, w1 );
+    __m128i s23 = _mm_add_epi32( w2, w3 );
+    __m128i d23 = _mm_sub_epi32( w2, w3 );
+    const __m128i one = _mm_set1_epi32( 1 );
+    w0 = _mm_srai_epi32( _mm_add_epi32( _mm_add_epi32( s01, s23 ), one ), 1 );
+    w1 = _mm_srai_epi32( _mm_add_epi32( _mm_sub_epi32( s01, s23 ), one ), 1 );
+    w2 = _mm_srai_epi32( _mm_add_epi32( _mm_sub_epi32( d01, d23 ), one ), 1 );
+    w3 = _mm_srai_epi32( _mm_add_epi32( _mm_add_epi32( d01, d23 ), one ), 1 );
+    STOREU( d+0, _mm_packs_epi32( w0, w1 ) );
+    STOREU( d+8, _mm_packs_epi32( w2, w3 ) );
+}
+
+static void idct4x4dc_sse2( dctcoef d[16] )
+{
+    __m128i r0 = LOADL( d+0 );
+    __m128i r1 = LOADL( d+4 );
+    __m128i r2 = LOADL( d+8 );
+    __m128i r3 = LOADL( d+12 );
+    WHT4_1D( r0, r1, r2, r3 );
+    TRANSPOSE4x4x2( r0, r1, r2, r3 );
+    WHT4_1D( r0, r1, r2, r3 );
+    STOREU( d+0, _mm_unpacklo_epi64( r0, r1 ) );
+    STOREU( d+8, _mm_unpacklo_epi64( r2, r3 ) );
+}
+
+/****************************************************************************
+ * 8x8 transform
+ ****************************************************************************/
+static void sub8x8_dct8_sse2( dctcoef dct[64], pixel *pix1, pixel *pix2 )
+{
+    __m128i r[8];
+    for( int y = 0; y < 8; y++ )
+        r[y] = diff_row( pix1, pix2, y, 8 );
+    DCT8_1D( r );
+    TRANSPOSE8x8( r );
+    DCT8_1D( r );
+    for( int y = 0; y < 8; y++ )
+        STOREU( dct + y*8, r[y] );
+}
+
+static void sub16x16_dct8_sse2( dctcoef dct[4][64], pixel *pix1, pixel *pix2 )
+{
+    sub8x8_dct8_sse2( dct[0], &pix1[0],               &pix2[0] );
+    sub8x8_dct8_sse2( dct[1], &pix1[8],               &pix2[8] );
+    sub8x8_dct8_sse2( dct[2], &pix1[8*FENC_STRIDE+0], &pix2[8*FDEC_STRIDE+0] );
+    sub8x8_dct8_sse2( dct[3], &pix1[8*FENC_STRIDE+8], &pix2[8*FDEC_STRIDE+8] );
+}
+
+/* Unlike the C version, dct[] is left untouched. */
+static void add8x8_idct8_sse2( pixel *dst, dctcoef dct[64] )
+{
+    __m128i r[8];
+    for( int y = 0; y < 8; y++ )
+        r[y] = LOADU( dct + y*8 );
+    r[0] = _mm_add_epi16( r[0], _mm_cvtsi32_si128( 32 ) ); // rounding for the >>6 at the end
+    IDCT8_1D( r );
+    TRANSPOSE8x8( r );
+    IDCT8_1D( r );
+    for( int y = 0; y < 8; y++ )
+        add_row( dst + y*FDEC_STRIDE, _mm_srai_epi16( r[y], 6 ), 8 );
+}
+
+static void add16x16_idct8_sse2( pixel *dst, dctcoef dct[4][64] )
+{
+    add8x8_idct8_sse2( &dst[0],               dct[0] );
+    add8x8_idct8_sse2( &dst[8],               dct[1] );
+    add8x8_idct8_sse2( &dst[8*FDEC_STRIDE+0], dct[2] );
+    add8x8_idct8_sse2( &dst[8*FDEC_STRIDE+8], dct[3] );
+}
+
+/****************************************************************************
+ * AVX2: the 16x16 transforms, one 16-pixel row per register
+ ****************************************************************************/
+#undef VEC
+#undef ADD
+#undef SUB
+#undef SRA
+#undef UNPACKLO16
+#undef UNPACKHI16
+#undef UNPACKLO32
+#undef UNPACKHI32
+#undef UNPACKLO64
+#undef UNPACKHI64
+#define VEC __m256i
+#define ADD _mm256_add_epi16
+#define SUB _mm256_sub_epi16
+#define SRA _mm256_srai_epi16
+#define UNPACKLO16 _mm256_unpacklo_epi16
+#define UNPACKHI16 _mm256_unpackhi_epi16
+#define UNPACKLO32 _mm256_unpacklo_epi32
+#define UNPACKHI32 _mm256_unpackhi_epi32
+#define UNPACKLO64 _mm256_unpacklo_epi64
+#define UNPACKHI64 _mm256_unpackhi_epi64
+
+static X264_TARGET_AVX2 ALWAYS_INLINE __m256i diff_row_avx2( const pixel *pix1, const pixel *pix2, int y )
+{
+    return _mm256_sub_epi16( _mm256_cvtepu8_epi16( LOADU( pix1 + y*FENC_STRIDE ) ),
+                             _mm256_cvtepu8_epi16( LOADU( pix2 + y*FDEC_STRIDE ) ) );
+}
+
+static X264_TARGET_AVX2 ALWAYS_INLINE void add_row_avx2( pixel *dst, __m256i v )
+{
+    v = _mm256_add_epi16( _mm256_cvtepu8_epi16( LOADU( dst ) ), v );
+    STOREU( dst, _mm_packus_epi16( _mm256_castsi256_si128( v ), _mm256_extracti128_si256( v, 1 ) ) );
+}
+
+static X264_TARGET_AVX2 ALWAYS_INLINE __m256i load_2x128( const dctcoef *lo, const dctcoef *hi )
+{
+    return _mm256_inserti128_si256( _mm256_castsi128_si256( LOADU( lo ) ), LOADU( hi ), 1 );
+}
+
+static X264_TARGET_AVX2 ALWAYS_INLINE void store_2x128( dctcoef *lo, dctcoef *hi, __m256i v )
+{
+    STOREU( lo, _mm256_castsi256_si128( v ) );
+    STOREU( hi, _mm256_extracti128_si256( v, 1 ) );
+}
+
+/* Row group h holds the 4x4 blocks dct[b], dct[b+1] of one 8x8 and
+ * dct[b+4], dct[b+5] of its right neighbour. */
+static X264_TARGET_AVX2 void sub16x16_dct_avx2( dctcoef dct[16][16], pixel *pix1, pixel *pix2 )
+{
+    for( int h = 0; h < 4; h++ )
+    {
+        __m256i r0 = diff_row_avx2( pix1, pix2, 4*h+0 );
+        __m256i r1 = diff_row_avx2( pix1, pix2, 4*h+1 );
+        __m256i r2 = diff_row_avx2( pix1, pix2, 4*h+2 );
+        __m256i r3 = diff_row_avx2( pix1, pix2, 4*h+3 );
+        DCT4_1D( r0, r1, r2, r3 );
+        TRANSPOSE4x4x2( r0, r1, r2, r3 );
+        DCT4_1D( r0, r1, r2, r3 );
+        int b = (h>>1)*8 + (h&1)*2;
+        store_2x128( dct[b+0]+0, dct[b+4]+0, _mm256_unpacklo_epi64( r0, r1 ) );
+        store_2x128( dct[b+0]+8, dct[b+4]+8, _mm256_unpacklo_epi64( r2, r3 ) );
+        store_2x128( dct[b+1]+0, dct[b+5]+0, _mm256_unpackhi_epi64( r0, r1 ) );
+        store_2x128( dct[b+1]+8, dct[b+5]+8, _mm256_unpackhi_epi64( r2, r3 ) );
+    }
+}
+
+static X264_TARGET_AVX2 ALWAYS_INLINE __m256i load_idct4_row_avx2( dctcoef dct[16][16], int b, int k )
+{
+    __m128i lo = _mm_unpacklo_epi64( LOADL( dct[b+0]+4*k ), LOADL( dct[b+1]+4*k ) );
+    __m128i hi = _mm_unpacklo_epi64( LOADL( dct[b+4]+4*k ), LOADL( dct[b+5]+4*k ) );
+    return _mm256_inserti128_si256( _mm256_castsi128_si256( lo ), hi, 1 );
+}
+
+static X264_TARGET_AVX2 void add16x16_idct_avx2( pixel *p_dst, dctcoef dct[16][16] )
+{
+    const __m256i rnd = _mm256_set1_epi16( 32 );
+    for( int h = 0; h < 4; h++, p_dst += 4*FDEC_STRIDE )
+    {
+        int b = (h>>1)*8 + (h&1)*2;
+        __m256i r0 = load_idct4_row_avx2( dct, b, 0 );
+        __m256i r1 = load_idct4_row_avx2( dct, b, 1 );
+        __m256i r2 = load_idct4_row_avx2( dct, b, 2 );
+        __m256i r3 = load_idct4_row_avx2( dct, b, 3 );
+        IDCT4_1D( r0, r1, r2, r3 );
+        TRANSPOSE4x4x2( r0, r1, r2, r3 );
+        IDCT4_1D( r0, r1, r2, r3 );
+        add_row_avx2( p_dst+0*FDEC_STRIDE, _mm256_srai_epi16( _mm256_add_epi16( r0, rnd ), 6 ) );
+        add_row_avx2( p_dst+1*FDEC_STRIDE, _mm256_srai_epi16( _mm256_add_epi16( r1, rnd ), 6 ) );
+        add_row_avx2( p_dst+2*FDEC_STRIDE, _mm256_srai_epi16( _mm256_add_epi16( r2, rnd ), 6 ) );
+        add_row_avx2( p_dst+3*FDEC_STRIDE, _mm256_srai_epi16( _mm256_add_epi16( r3, rnd ), 6 ) );
+    }
+}
+
+static X264_TARGET_AVX2 void sub16x16_dct8_avx2( dctcoef dct[4][64], pixel *pix1, pixel *pix2 )
+{
+    for( int h = 0; h < 2; h++ )
+    {
+        __m256i r[8];
+        for( int y = 0; y < 8; y++ )
+            r[y] = diff_row_avx2( pix1, pix2, 8*h+y );
+        DCT8_1D( r );
+        TRANSPOSE8x8( r );
+        DCT8_1D( r );
+        for( int y = 0; y < 8; y++ )
+            store_2x128( dct[2*h] + y*8, dct[2*h+1] + y*8, r[y] );
+    }
+}
+
+static X264_TARGET_AVX2 void add16x16_idct8_avx2( pixel *dst, dctcoef dct[4][64] )
+{
+    const __m256i rnd = _mm256_setr_epi16( 32, 0, 0, 0, 0, 0, 0, 0, 32, 0, 0, 0, 0, 0, 0, 0 );
+    for( int h = 0; h < 2; h++, dst += 8*FDEC_STRIDE )
+    {
+        __m256i r[8];
+        for( int y = 0; y < 8; y++ )
+            r[y] = load_2x128( dct[2*h] + y*8, dct[2*h+1] + y*8 );
+        r[0] = _mm256_add_epi16( r[0], rnd );
+        IDCT8_1D( r );
+        TRANSPOSE8x8( r );
+        IDCT8_1D( r );
+        for( int y = 0; y < 8; y++ )
+            add_row_avx2( dst + y*FDEC_STRIDE, _mm256_srai_epi16( r[y], 6 ) );
+    }
+}
+
+#undef VEC
+#undef ADD
+#undef SUB
+#undef SRA
+#undef UNPACKLO16
+#undef UNPACKHI16
+#undef UNPACKLO32
+#undef UNPACKHI32
+#undef UNPACKLO64
+#undef UNPACKHI64
+
+/****************************************************************************
+ * zigzag
+ ****************************************************************************/
+/* Each output register of 8 coefficients is the OR of pshufb's of the
+ * input registers it draws from: src[i] = { output, input }, generated
+ * from x264_zigzag_scan4/x264_zigzag_scan8. */
+static const uint8_t zigzag_4x4_frame_src[4][2] =
+{
+    {0,0}, {0,1}, {1,0}, {1,1}
+};
+ALIGNED_16( static const int8_t zigzag_4x4_frame_shuf[4][16] ) =
+{
+    { 0, 1, 8, 9, 2, 3, 4, 5,10,11,-1,-1,-1,-1,-1,-1},
+    {-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 0, 1, 8, 9, 2, 3},
+    {12,13, 6, 7,14,15,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1},
+    {-1,-1,-1,-1,-1,-1, 4, 5,10,11,12,13, 6, 7,14,15},
+};
+
+static const uint8_t zigzag_8x8_frame_src[40][2] =
+{
+    {0,0}, {0,1}, {0,2}, {0,3}, {1,0}, {1,1}, {1,2}, {1,3}, {1,4}, {1,5},
+    {2,0}, {2,1}, {2,2}, {2,3}, {2,4}, {3,3}, {3,4}, {3,5}, {3,6}, {3,7},
+    {4,0}, {4,1}, {4,2}, {4,3}, {4,4}, {5,3}, {5,4}, {5,5}, {5,6}, {5,7},
+    {6,2}, {6,3}, {6,4}, {6,5}, {6,6}, {6,7}, {7,4}, {7,5}, {7,6}, {7,7}
+};
+ALIGNED_16( static const int8_t zigzag_8x8_frame_shuf[40][16] ) =
+{
+    { 0, 1,-1,-1, 2, 3, 4, 5,-1,-1,-1,-1,-1,-1,-1,-1},
+    {-1,-1, 0, 1,-1,-1,-1,-1, 2, 3,-1,-1,-1,-1,-1,-1},
+    {-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 0, 1,-1,-1, 2, 3},
+    {-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 0, 1,-1,-1},
+    {-1,-1, 6, 7, 8, 9,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1},
+    { 4, 5,-1,-1,-1,-1, 6, 7,-1,-1,-1,-1,-1,-1,-1,-1},
+    {-1,-1,-1,-1,-1,-1,-1,-1, 4, 5,-1,-1,-1,-1,-1,-1},
+    {-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 2, 3,-1,-1,-1,-1},
+    {-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 0, 1,-1,-1},
+    {-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 0, 1},
+    {-1,-1,-1,-1,-1,-1,-1,-1,10,11,12,13,-1,-1,-1,-1},
+    {-1,-1,-1,-1,-1,-1, 8, 9,-1,-1,-1,-1,10,11,-1,-1},
+    {-1,-1,-1,-1, 6, 7,-1,-1,-1,-1,-1,-1,-1,-1, 8, 9},
+    {-1,-1, 4, 5,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1},
+    { 2, 3,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1},
+    { 6, 7,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1},
+    {-1,-1, 4, 5,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 6, 7},
+    {-1,-1,-1,-1, 2, 3,-1,-1,-1,-1,-1,-1, 4, 5,-1,-1},
+    {-1,-1,-1,-1,-1,-1, 0, 1,-1,-1, 2, 3,-1,-1,-1,-1},
+    {-1,-1,-1,-1,-1,-1,-1,-1, 0, 1,-1,-1,-1,-1,-1,-1},
+    {-1,-1,-1,-1,-1,-1,14,15,-1,-1,-1,-1,-1,-1,-1,-1},
+    {-1,-1,-1,-1,12,13,-1,-1,14,15,-1,-1,-1,-1,-1,-1},
+    {-1,-1,10,11,-1,-1,-1,-1,-1,-1,12,13,-1,-1,-1,-1},
+    { 8, 9,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,10,11,-1,-1},
+    {-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 8, 9},
+    {-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,12,13},
+    {-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,10,11,-1,-1},
+    { 6, 7,-1,-1,-1,-1,-1,-1,-1,-1, 8, 9,-1,-1,-1,-1},
+    {-1,-1, 4, 5,-1,-1,-1,-1, 6, 7,-1,-1,-1,-1,-1,-1},
+    {-1,-1,-1,-1, 2, 3, 4, 5,-1,-1,-1,-1,-1,-1,-1,-1},
+    {14,15,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1},
+    {-1,-1,14,15,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1},
+    {-1,-1,-1,-1,12,13,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1},
+    {-1,-1,-1,-1,-1,-1,10,11,-1,-1,-1,-1,-1,-1,-1,-1},
+    {-1,-1,-1,-1,-1,-1,-1,-1, 8, 9,-1,-1,-1,-1,10,11},
+    {-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 6, 7, 8, 9,-1,-1},
+    {-1,-1,14,15,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1},
+    {12,13,-1,-1,14,15,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1},
+    {-1,-1,-1,-1,-1,-1,12,13,-1,-1,-1,-1,14,15,-1,-1},
+    {-1,-1,-1,-1,-1,-1,-1,-1,10,11,12,13,-1,-1,14,15},
+};
+
+static const uint8_t zigzag_8x8_field_src[26][2] =
+{
+    {0,0}, {0,1}, {1,0}, {1,1}, {1,2}, {1,3}, {2,1}, {2,2}, {2,3}, {2,4},
+    {3,2}, {3,3}, {3,4}, {3,5}, {4,3}, {4,4}, {4,5}, {4,6}, {5,4}, {5,5},
+    {5,6}, {6,5}, {6,6}, {6,7}, {7,6}, {7,7}
+};
+ALIGNED_16( static const int8_t zigzag_8x8_field_shuf[26][16] ) =
+{
+    { 0, 1, 2, 3, 4, 5,-1,-1,-1,-1, 6, 7, 8, 9,-1,-1},
+    {-1,-1,-1,-1,-1,-1, 0, 1, 2, 3,-1,-1,-1,-1, 4, 5},
+    {-1,-1,-1,-1,10,11,12,13,14,15,-1,-1,-1,-1,-1,-1},
+    {-1,-1, 6, 7,-1,-1,-1,-1,-1,-1, 8, 9,-1,-1,-1,-1},
+    { 0, 1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 2, 3,-1,-1},
+    {-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 0, 1},
+    {-1,-1,10,11,12,13,14,15,-1,-1,-1,-1,-1,-1,-1,-1},
+    { 4, 5,-1,-1,-1,-1,-1,-1, 6, 7,-1,-1,-1,-1,-1,-1},
+    {-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 2, 3,-1,-1, 4, 5},
+    {-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 0, 1,-1,-1},
+    { 8, 9,10,11,12,13,14,15,-1,-1,-1,-1,-1,-1,-1,-1},
+    {-1,-1,-1,-1,-1,-1,-1,-1, 6, 7,-1,-1,-1,-1,-1,-1},
+    {-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 2, 3,-1,-1, 4, 5},
+    {-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 0, 1,-1,-1},
+    { 8, 9,10,11,12,13,14,15,-1,-1,-1,-1,-1,-1,-1,-1},
+    {-1,-1,-1,-1,-1,-1,-1,-1, 6, 7,-1,-1,-1,-1,-1,-1},
+    {-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 2, 3,-1,-1, 4, 5},
+    {-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 0, 1,-1,-1},
+    { 8, 9,10,11,12,13,14,15,-1,-1,-1,-1,-1,-1,-1,-1},
+    {-1,-1,-1,-1,-1,-1,-1,-1, 6, 7,-1,-1,-1,-1, 8, 9},
+    {-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 2, 3, 4, 5,-1,-1},
+    {10,11,12,13,14,15,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1},
+    {-1,-1,-1,-1,-1,-1, 6, 7,-1,-1,-1,-1, 8, 9,10,11},
+    {-1,-1,-1,-1,-1,-1,-1,-1, 0, 1, 2, 3,-1,-1,-1,-1},
+    {12,13,14,15,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1},
+    {-1,-1,-1,-1, 4, 5, 6, 7, 8, 9,10,11,12,13,14,15},
+};
+
+/* pixel bytes of a packed 4x4 block (row-major) in scan order */
+ALIGNED_16( static const int8_t zigzag_sub_4x4_frame_shuf[16] ) =
+    { 0, 1, 4, 8, 5, 2, 3, 6, 9,12,13,10, 7,11,14,15 };
+ALIGNED_16( static const int8_t zigzag_sub_4x4_field_shuf[16] ) =
+    { 0, 4, 1, 8,12, 5, 9,13, 2, 6,10,14, 3, 7,11,15 };
+
+/* Fully unrolled, so the table lookups fold into constant masks. */
+static X264_TARGET_SSSE3 ALWAYS_INLINE void zigzag_shuffle( dctcoef *level, const dctcoef *dct,
+                                                            const uint8_t (*src)[2], const int8_t (*shuf)[16], int count )
+{
+    __m128i acc = _mm_setzero_si128();
+#pragma GCC unroll 40
+    for( int i = 0; i < count; i++ )
+    {
+        __m128i v = _mm_shuffle_epi8( LOADU( dct + 8*src[i][1] ), _mm_load_si128( (const __m128i*)shuf[i] ) );
+        acc = _mm_or_si128( acc, v );
+        if( i == count-1 || src[i+1][0] != src[i][0] )
+        {
+            STOREU( level + 8*src[i][0], acc );
+            acc = _mm_setzero_si128();
+        }
+    }
+}
+
+static X264_TARGET_SSSE3 void zigzag_scan_4x4_frame_ssse3( dctcoef level[16], dctcoef dct[16] )
+{
+    zigzag_shuffle( level, dct, zigzag_4x4_frame_src, zigzag_4x4_frame_shuf, 4 );
+}
+
+static X264_TARGET_SSSE3 void zigzag_scan_4x4_field_ssse3( dctcoef level[16], dctcoef dct[16] )
+{
+    /* only coefficients 2..4 move, all within the first register */
+    const __m128i shuf = _mm_setr_epi8( 0, 1, 2, 3, 8, 9, 4, 5, 6, 7, 10, 11, 12, 13, 14, 15 );
+    STOREU( level+0, _mm_shuffle_epi8( LOADU( dct+0 ), shuf ) );
+    STOREU( level+8, LOADU( dct+8 ) );
+}
+
+static X264_TARGET_SSSE3 void zigzag_scan_8x8_frame_ssse3( dctcoef level[64], dctcoef dct[64] )
+{
+    zigzag_shuffle( level, dct, zigzag_8x8_frame_src, zigzag_8x8_frame_shuf, 40 );
+}
+
+static X264_TARGET_SSSE3 void zigzag_scan_8x8_field_ssse3( dctcoef level[64], dctcoef dct[64] )
+{
+    zigzag_shuffle( level, dct, zigzag_8x8_field_src, zigzag_8x8_field_shuf, 26 );
+}
+
+/* The residual is taken in scan order straight from the pixel bytes;
+ * with dc, the first coefficient goes to *dc and counts for nothing. */
+static X264_TARGET_SSSE3 ALWAYS_INLINE int zigzag_sub_4x4( dctcoef level[16], const pixel *p_src, pixel *p_dst,
+                                                           const int8_t *shuf, dctcoef *dc )
+{
+    __m128i s = _mm_unpacklo_epi64( _mm_unpacklo_epi32( _mm_cvtsi32_si128( M32( p_src+0*FENC_STRIDE ) ),
+                                                        _mm_cvtsi32_si128( M32( p_src+1*FENC_STRIDE ) ) ),
+                                    _mm_unpacklo_epi32( _mm_cvtsi32_si128( M32( p_src+2*FENC_STRIDE ) ),
+                                                        _mm_cvtsi32_si128( M32( p_src+3*FENC_STRIDE ) ) ) );
+    __m128i d = _mm_unpacklo_epi64( _mm_unpacklo_epi32( _mm_cvtsi32_si128( M32( p_dst+0*FDEC_STRIDE ) ),
+                                                        _mm_cvtsi32_si128( M32( p_dst+1*FDEC_STRIDE ) ) ),
+                                    _mm_unpacklo_epi32( _mm_cvtsi32_si128( M32( p_dst+2*FDEC_STRIDE ) ),
+                                                        _mm_cvtsi32_si128( M32( p_dst+3*FDEC_STRIDE ) ) ) );
+    for( int y = 0; y < 4; y++ )
+        M32( p_dst+y*FDEC_STRIDE ) = M32( p_src+y*FENC_STRIDE );
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i mask = _mm_load_si128( (const __m128i*)shuf );
+    s = _mm_shuffle_epi8( s, mask );
+    d = _mm_shuffle_epi8( d, mask );
+    __m128i lo = _mm_sub_epi16( _mm_unpacklo_epi8( s, zero ), _mm_unpacklo_epi8( d, zero ) );
+    __m128i hi = _mm_sub_epi16( _mm_unpackhi_epi8( s, zero ), _mm_unpackhi_epi8( d, zero ) );
+    if( dc )
+    {
+        *dc = (int16_t)_mm_cvtsi128_si32( lo );
+        lo = _mm_insert_epi16( lo, 0, 0 );
+    }
+    STOREU( level+0, lo );
+    STOREU( level+8, hi );
+    return _mm_movemask_epi8( _mm_cmpeq_epi16( _mm_or_si128( lo, hi ), zero ) ) != 0xffff;
+}
+
+static X264_TARGET_SSSE3 int zigzag_sub_4x4_frame_ssse3( dctcoef level[16], const pixel *p_src, pixel *p_dst )
+{
+    return zigzag_sub_4x4( level, p_src, p_dst, zigzag_sub_4x4_frame_shuf, NULL );
+}
+
+static X264_TARGET_SSSE3 int zigzag_sub_4x4_field_ssse3( dctcoef level[16], const pixel *p_src, pixel *p_dst )
+{
+    return zigzag_sub_4x4( level, p_src, p_dst, zigzag_sub_4x4_field_shuf, NULL );
+}
+
+static X264_TARGET_SSSE3 int zigzag_sub_4x4ac_frame_ssse3( dctcoef level[16], const pixel *p_src, pixel *p_dst, dctcoef *dc )
+{
+    return zigzag_sub_4x4( level, p_src, p_dst, zigzag_sub_4x4_frame_shuf, dc );
+}
+
+static X264_TARGET_SSSE3 int zigzag_sub_4x4ac_field_ssse3( dctcoef level[16], const pixel *p_src, pixel *p_dst, dctcoef *dc )
+{
+    return zigzag_sub_4x4( level, p_src, p_dst, zigzag_sub_4x4_field_shuf, dc );
+}
+
+/* The residual is transposed into dct layout and then scanned like a dct. */
+#define VEC __m128i
+#define UNPACKLO16 _mm_unpacklo_epi16
+#define UNPACKHI16 _mm_unpackhi_epi16
+#define UNPACKLO32 _mm_unpacklo_epi32
+#define UNPACKHI32 _mm_unpackhi_epi32
+#define UNPACKLO64 _mm_unpacklo_epi64
+#define UNPACKHI64 _mm_unpackhi_epi64
+
+static X264_TARGET_SSSE3 ALWAYS_INLINE int zigzag_sub_8x8( dctcoef level[64], const pixel *p_src, pixel *p_dst,
+                                                           const uint8_t (*src)[2], const int8_t (*shuf)[16], int count )
+{
+    ALIGNED_16( dctcoef tmp[64] );
+    __m128i r[8];
+    __m128i nz = _mm_setzero_si128();
+    for( int y = 0; y < 8; y++ )
+    {
+        __m128i s = LOADL( p_src+y*FENC_STRIDE );
+        r[y] = _mm_sub_epi16( _mm_unpacklo_epi8( s, _mm_setzero_si128() ), load_8_epi16( p_dst+y*FDEC_STRIDE ) );
+        STOREL( p_dst+y*FDEC_STRIDE, s );
+        nz = _mm_or_si128( nz, r[y] );
+    }
+    TRANSPOSE8x8( r );
+    for( int y = 0; y < 8; y++ )
+        _mm_store_si128( (__m128i*)(tmp + y*8), r[y] );
+    zigzag_shuffle( level, tmp, src, shuf, count );
+    return _mm_movemask_epi8( _mm_cmpeq_epi16( nz, _mm_setzero_si128() ) ) != 0xffff;
+}
+
+#undef VEC
+#undef UNPACKLO16
+#undef UNPACKHI16
+#undef UNPACKLO32
+#undef UNPACKHI32
+#undef UNPACKLO64
+#undef UNPACKHI64
+
+static X264_TARGET_SSSE3 int zigzag_sub_8x8_frame_ssse3( dctcoef level[64], const pixel *p_src, pixel *p_dst )
+{
+    return zigzag_sub_8x8( level, p_src, p_dst, zigzag_8x8_frame_src, zigzag_8x8_frame_shuf, 40 );
+}
+
+static X264_TARGET_SSSE3 int zigzag_sub_8x8_field_ssse3( dctcoef level[64], const pixel *p_src, pixel *p_dst )
+{
+    return zigzag_sub_8x8( level, p_src, p_dst, zigzag_8x8_field_src, zigzag_8x8_field_shuf, 26 );
+}
+
+/* dst[i*16+j] = src[i+j*4]: four 4x4 transposes of groups of 4 coefficients */
+static void zigzag_interleave_8x8_cavlc_sse2( dctcoef *dst, dctcoef *src, uint8_t *nnz )
+{
+    __m128i nz01 = _mm_setzero_si128();
+    __m128i nz23 = _mm_setzero_si128();
+    for( int k = 0; k < 4; k++ )
+    {
+        __m128i a = LOADU( src + 16*k );
+        __m128i b = LOADU( src + 16*k + 8 );
+        __m128i u = _mm_unpacklo_epi16( a, b );
+        __m128i v = _mm_unpackhi_epi16( a, b );
+        __m128i w0 = _mm_unpacklo_epi16( u, v );
+        __m128i w1 = _mm_unpackhi_epi16( u, v );
+        STOREL( dst + 0*16 + 4*k, w0 );
+        STOREH( dst + 1*16 + 4*k, w0 );
+        STOREL( dst + 2*16 + 4*k, w1 );
+        STOREH( dst + 3*16 + 4*k, w1 );
+        nz01 = _mm_or_si128( nz01, w0 );
+        nz23 = _mm_or_si128( nz23, w1 );
+    }
+    int zero01 = _mm_movemask_epi8( _mm_cmpeq_epi16( nz01, _mm_setzero_si128() ) );
+    int zero23 = _mm_movemask_epi8( _mm_cmpeq_epi16( nz23, _mm_setzero_si128() ) );
+    nnz[0] = (zero01 & 0x00ff) != 0x00ff;
+    nnz[1] = (zero01 & 0xff00) != 0xff00;
+    nnz[8] = (zero23 & 0x00ff) != 0x00ff;
+    nnz[9] = (zero23 & 0xff00) != 0xff00;
+}
+
+/****************************************************************************
+ * x264_dct_init_intrin:
+ ****************************************************************************/
+void x264_dct_init_intrin( int cpu, x264_dct_function_t *dctf )
+{
+    if( cpu&X264_CPU_SSE2 )
+    {
+        dctf->sub4x4_dct       = sub4x4_dct_sse2;
+        dctf->add4x4_idct      = add4x4_idct_sse2;
+        dctf->sub8x8_dct       = sub8x8_dct_sse2;
+        dctf->sub8x8_dct_dc    = sub8x8_dct_dc_sse2;
+        dctf->add8x8_idct      = add8x8_idct_sse2;
+        dctf->add8x8_idct_dc   = add8x8_idct_dc_sse2;
+        dctf->sub8x16_dct_dc   = sub8x16_dct_dc_sse2;
+        dctf->sub16x16_dct     = sub16x16_dct_sse2;
+        dctf->add16x16_idct    = add16x16_idct_sse2;
+        dctf->add16x16_idct_dc = add16x16_idct_dc_sse2;
+        dctf->sub8x8_dct8      = sub8x8_dct8_sse2;
+        dctf->add8x8_idct8     = add8x8_idct8_sse2;
+        dctf->sub16x16_dct8    = sub16x16_dct8_sse2;
+        dctf->add16x16_idct8   = add16x16_idct8_sse2;
+        dctf->dct4x4dc         = dct4x4dc_sse2;
+        dctf->idct4x4dc        = idct4x4dc_sse2;
+    }
+
+    if( cpu&X264_CPU_AVX2 )
+    {
+        dctf->sub16x16_dct   = sub16x16_dct_avx2;
+        dctf->add16x16_idct  = add16x16_idct_avx2;
+        dctf->sub16x16_dct8  = sub16x16_dct8_avx2;
+        dctf->add16x16_idct8 = add16x16_idct8_avx2;
+    }
+}
+
+void x264_zigzag_init_intrin( int cpu, x264_zigzag_function_t *pf_progressive, x264_zigzag_function_t *pf_interlaced )
+{
+    if( cpu&X264_CPU_SSE2 )
+    {
+        pf_interlaced->interleave_8x8_cavlc =
+        pf_progressive->interleave_8x8_cavlc = zigzag_interleave_8x8_cavlc_sse2;
+    }
+
+    if( cpu&X264_CPU_SSSE3 )
+    {
+        pf_interlaced->scan_8x8   = zigzag_scan_8x8_field_ssse3;
+        pf_progressive->scan_8x8  = zigzag_scan_8x8_frame_ssse3;
+        pf_interlaced->scan_4x4   = zigzag_scan_4x4_field_ssse3;
+        pf_progressive->scan_4x4  = zigzag_scan_4x4_frame_ssse3;
+        pf_interlaced->sub_8x8    = zigzag_sub_8x8_field_ssse3;
+        pf_progressive->sub_8x8   = zigzag_sub_8x8_frame_ssse3;
+        pf_interlaced->sub_4x4    = zigzag_sub_4x4_field_ssse3;
+        pf_progressive->sub_4x4   = zigzag_sub_4x4_frame_ssse3;
+        pf_interlaced->sub_4x4ac  = zigzag_sub_4x4ac_field_ssse3;
+        pf_progressive->sub_4x4ac = zigzag_sub_4x4ac_frame_ssse3;
+    }
+}
+
+#endif // HAVE_X86_INTRIN && !HIGH_BIT_DEPTH
@@ -0,0 +1,480 @@
+/*****************************************************************************
+ * deblock-intrin.c: x86 deblocking with compiler intrinsics
+ *****************************************************************************
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *****************************************************************************/
+
+#include "common/common.h"
+#include "intrin.h"
+#include <immintrin.h>
+
+#if HAVE_X86_INTRIN && !HIGH_BIT_DEPTH
+
+/* Every filter works on 16 pixels along the edge: the edge masks are built
+ * on bytes, the filter arithmetic runs on 16-bit halves, so the results are
+ * those of common/deblock.c. Horizontal edges are loaded as rows; vertical
+ * edges are transposed into the same layout and back. */
+
+#define LOADU(p)  _mm_loadu_si128( (const __m128i*)(p) )
+#define LOADL(p)  _mm_loadl_epi64( (const __m128i*)(p) )
+#define STOREU(p, v) _mm_storeu_si128( (__m128i*)(p), v )
+#define STOREL(p, v) _mm_storel_epi64( (__m128i*)(p), v )
+#define STOREH(p, v) _mm_storel_epi64( (__m128i*)(p), _mm_srli_si128( v, 8 ) )
+
+#define BLEND( m, a, b ) _mm_or_si128( _mm_and_si128( m, a ), _mm_andnot_si128( m, b ) )
+
+/* |a - b| < thresh on unsigned bytes, without wrapping for thresh 0 */
+static ALWAYS_INLINE __m128i diff_lt( __m128i a, __m128i b, __m128i thresh )
+{
+    __m128i ad = _mm_or_si128( _mm_subs_epu8( a, b ), _mm_subs_epu8( b, a ) );
+    return _mm_xor_si128( _mm_cmpeq_epi8( _mm_subs_epu8( thresh, ad ), _mm_setzero_si128() ), _mm_set1_epi8( -1 ) );
+}
+
+static ALWAYS_INLINE __m128i edge_mask( __m128i p1, __m128i p0, __m128i q0, __m128i q1, int alpha, int beta )
+{
+    const __m128i betav = _mm_set1_epi8( beta );
+    return _mm_and_si128( _mm_and_si128( diff_lt( p0, q0, _mm_set1_epi8( alpha ) ), diff_lt( p1, p0, betav ) ),
+                          diff_lt( q1, q0, betav ) );
+}
+
+/* tc0[i] repeated over 4 bytes */
+static ALWAYS_INLINE __m128i expand_tc4( const int8_t *tc0 )
+{
+    __m128i t = _mm_cvtsi32_si128( M32( tc0 ) );
+    t = _mm_unpacklo_epi8( t, t );
+    return _mm_unpacklo_epi16( t, t );
+}
+
+/* tc0[0] and tc0[1] repeated over 8 bytes */
+static ALWAYS_INLINE __m128i expand_tc8( const int8_t *tc0 )
+{
+    __m128i t = _mm_cvtsi32_si128( M16( tc0 ) );
+    t = _mm_unpacklo_epi8( t, t );
+    t = _mm_unpacklo_epi16( t, t );
+    return _mm_unpacklo_epi32( t, t );
+}
+
+#define UNPACK_LO( x ) _mm_unpacklo_epi8( x, zero )
+#define UNPACK_HI( x ) _mm_unpackhi_epi8( x, zero )
+#define MASK_LO( m ) _mm_unpacklo_epi8( m, m )
+#define MASK_HI( m ) _mm_unpackhi_epi8( m, m )
+
+static ALWAYS_INLINE __m128i clip3( __m128i x, __m128i tc )
+{
+    return _mm_min_epi16( _mm_max_epi16( x, _mm_sub_epi16( _mm_setzero_si128(), tc ) ), tc );
+}
+
+/* (((q0 - p0) << 2) + (p1 - q1) + 4) >> 3 clipped to [-tc,tc] */
+static ALWAYS_INLINE __m128i normal_delta( __m128i p1, __m128i p0, __m128i q0, __m128i q1, __m128i tc )
+{
+    __m128i d = _mm_add_epi16( _mm_slli_epi16( _mm_sub_epi16( q0, p0 ), 2 ), _mm_sub_epi16( p1, q1 ) );
+    return clip3( _mm_srai_epi16( _mm_add_epi16( d, _mm_set1_epi16( 4 ) ), 3 ), tc );
+}
+
+/****************************************************************************
+ * luma
+ ****************************************************************************/
+/* tc0 in 16-bit lanes; the masks are 0/-1 words */
+static ALWAYS_INLINE void luma_half( __m128i *p1, __m128i *p0, __m128i *q0, __m128i *q1, __m128i p2, __m128i q2,
+                                     __m128i tc0, __m128i mask, __m128i ap, __m128i aq )
+{
+    __m128i avg = _mm_avg_epu16( *p0, *q0 );
+    __m128i p1n = _mm_add_epi16( *p1, clip3( _mm_sub_epi16( _mm_srai_epi16( _mm_add_epi16( p2, avg ), 1 ), *p1 ), tc0 ) );
+    __m128i q1n = _mm_add_epi16( *q1, clip3( _mm_sub_epi16( _mm_srai_epi16( _mm_add_epi16( q2, avg ), 1 ), *q1 ), tc0 ) );
+    __m128i tc = _mm_sub_epi16( _mm_sub_epi16( tc0, ap ), aq );
+    __m128i delta = _mm_and_si128( normal_delta( *p1, *p0, *q0, *q1, tc ), mask );
+    *p0 = _mm_add_epi16( *p0, delta );
+    *q0 = _mm_sub_epi16( *q0, delta );
+    *p1 = BLEND( ap, p1n, *p1 );
+    *q1 = BLEND( aq, q1n, *q1 );
+}
+
+static ALWAYS_INLINE void deblock_luma_16( __m128i *p2, __m128i *p1, __m128i *p0, __m128i *q0, __m128i *q1, __m128i *q2,
+                                           int alpha, int beta, __m128i tc8 )
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i betav = _mm_set1_epi8( beta );
+    __m128i mask = _mm_and_si128( edge_mask( *p1, *p0, *q0, *q1, alpha, beta ), _mm_cmpgt_epi8( tc8, _mm_set1_epi8( -1 ) ) );
+    __m128i ap = _mm_and_si128( diff_lt( *p2, *p0, betav ), mask );
+    __m128i aq = _mm_and_si128( diff_lt( *q2, *q0, betav ), mask );
+
+    __m128i lp1 = UNPACK_LO( *p1 ), lp0 = UNPACK_LO( *p0 ), lq0 = UNPACK_LO( *q0 ), lq1 = UNPACK_LO( *q1 );
+    __m128i hp1 = UNPACK_HI( *p1 ), hp0 = UNPACK_HI( *p0 ), hq0 = UNPACK_HI( *q0 ), hq1 = UNPACK_HI( *q1 );
+    luma_half( &lp1, &lp0, &lq0, &lq1, UNPACK_LO( *p2 ), UNPACK_LO( *q2 ),
+               _mm_srai_epi16( _mm_unpacklo_epi8( tc8, tc8 ), 8 ), MASK_LO( mask ), MASK_LO( ap ), MASK_LO( aq ) );
+    luma_half( &hp1, &hp0, &hq0, &hq1, UNPACK_HI( *p2 ), UNPACK_HI( *q2 ),
+               _mm_srai_epi16( _mm_unpackhi_epi8( tc8, tc8 ), 8 ), MASK_HI( mask ), MASK_HI( ap ), MASK_HI( aq ) );
+    *p1 = _mm_packus_epi16( lp1, hp1 );
+    *p0 = _mm_packus_epi16( lp0, hp0 );
+    *q0 = _mm_packus_epi16( lq0, hq0 );
+    *q1 = _mm_packus_epi16( lq1, hq1 );
+}
+
+static ALWAYS_INLINE void luma_intra_half( __m128i *p2, __m128i *p1, __m128i *p0, __m128i *q0, __m128i *q1, __m128i *q2,
+                                           __m128i p3, __m128i q3, __m128i mask, __m128i ap, __m128i aq )
+{
+    const __m128i two = _mm_set1_epi16( 2 );
+    const __m128i four = _mm_set1_epi16( 4 );
+    __m128i s = _mm_add_epi16( _mm_add_epi16( *p1, *p0 ), _mm_add_epi16( *q0, *q1 ) );
+
+    /* p0 + q0 + p1 + q1 is shared by the strong filters of both sides */
+    __m128i p0s = _mm_srai_epi16( _mm_add_epi16( _mm_add_epi16( s, s ), _mm_add_epi16( _mm_sub_epi16( *p2, *q1 ), four ) ), 3 );
+    __m128i p1s = _mm_srai_epi16( _mm_add_epi16( _mm_add_epi16( *p2, *p1 ), _mm_add_epi16( _mm_add_epi16( *p0, *q0 ), two ) ), 2 );
+    __m128i p2s = _mm_srai_epi16( _mm_add_epi16( _mm_add_epi16( _mm_slli_epi16( _mm_add_epi16( p3, *p2 ), 1 ), *p2 ),
+                                                 _mm_add_epi16( _mm_add_epi16( *p1, *p0 ), _mm_add_epi16( *q0, four ) ) ), 3 );
+    __m128i p0w = _mm_srai_epi16( _mm_add_epi16( _mm_add_epi16( _mm_add_epi16( *p1, *p1 ), *p0 ), _mm_add_epi16( *q1, two ) ), 2 );
+
+    __m128i q0s = _mm_srai_epi16( _mm_add_epi16( _mm_add_epi16( s, s ), _mm_add_epi16( _mm_sub_epi16( *q2, *p1 ), four ) ), 3 );
+    __m128i q1s = _mm_srai_epi16( _mm_add_epi16( _mm_add_epi16( *q2, *q1 ), _mm_add_epi16( _mm_add_epi16( *q0, *p0 ), two ) ), 2 );
+    __m128i q2s = _mm_srai_epi16( _mm_add_epi16( _mm_add_epi16( _mm_slli_epi16( _mm_add_epi16( q3, *q2 ), 1 ), *q2 ),
+                                                 _mm_add_epi16( _mm_add_epi16( *q1, *q0 ), _mm_add_epi16( *p0, four ) ) ), 3 );
+    __m128i q0w = _mm_srai_epi16( _mm_add_epi16( _mm_add_epi16( _mm_add_epi16( *q1, *q1 ), *q0 ), _mm_add_epi16( *p1, two ) ), 2 );
+
+    *p0 = BLEND( mask, BLEND( ap, p0s, p0w ), *p0 );
+    *p1 = BLEND( ap, p1s, *p1 );
+    *p2 = BLEND( ap, p2s, *p2 );
+    *q0 = BLEND( mask, BLEND( aq, q0s, q0w ), *q0 );
+    *q1 = BLEND( aq, q1s, *q1 );
+    *q2 = BLEND( aq, q2s, *q2 );
+}
+
+static ALWAYS_INLINE void deblock_luma_intra_16( __m128i *p3, __m128i *p2, __m128i *p1, __m128i *p0,
+                                                 __m128i *q0, __m128i *q1, __m128i *q2, __m128i *q3, int alpha, int beta )
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i betav = _mm_set1_epi8( beta );
+    __m128i mask = edge_mask( *p1, *p0, *q0, *q1, alpha, beta );
+    __m128i strong = _mm_and_si128( diff_lt( *p0, *q0, _mm_set1_epi8( (alpha >> 2) + 2 ) ), mask );
+    __m128i ap = _mm_and_si128( diff_lt( *p2, *p0, betav ), strong );
+    __m128i aq = _mm_and_si128( diff_lt( *q2, *q0, betav ), strong );
+
+    __m128i lp2 = UNPACK_LO( *p2 ), lp1 = UNPACK_LO( *p1 ), lp0 = UNPACK_LO( *p0 );
+    __m128i lq0 = UNPACK_LO( *q0 ), lq1 = UNPACK_LO( *q1 ), lq2 = UNPACK_LO( *q2 );
+    __m128i hp2 = UNPACK_HI( *p2 ), hp1 = UNPACK_HI( *p1 ), hp0 = UNPACK_HI( *p0 );
+    __m128i hq0 = UNPACK_HI( *q0 ), hq1 = UNPACK_HI( *q1 ), hq2 = UNPACK_HI( *q2 );
+    luma_intra_half( &lp2, &lp1, &lp0, &lq0, &lq1, &lq2, UNPACK_LO( *p3 ), UNPACK_LO( *q3 ),
+                     MASK_LO( mask ), MASK_LO( ap ), MASK_LO( aq ) );
+    luma_intra_half( &hp2, &hp1, &hp0, &hq0, &hq1, &hq2, UNPACK_HI( *p3 ), UNPACK_HI( *q3 ),
+                     MASK_HI( mask ), MASK_HI( ap ), MASK_HI( aq ) );
+    *p2 = _mm_packus_epi16( lp2, hp2 );
+    *p1 = _mm_packus_epi16( lp1, hp1 );
+    *p0 = _mm_packus_epi16( lp0, hp0 );
+    *q0 = _mm_packus_epi16( lq0, hq0 );
+    *q1 = _mm_packus_epi16( lq1, hq1 );
+    *q2 = _mm_packus_epi16( lq2, hq2 );
+}
+
+/* 16 rows of 8 pixels starting at pix-4 to p3..q3 columns, and back */
+static ALWAYS_INLINE void transpose_load_16x8( pixel *pix, intptr_t stride, __m128i c[8] )
+{
+    __m128i t[2][4];
+    for( int h = 0; h < 2; h++, pix += 8*stride )
+    {
+        __m128i a0 = _mm_unpacklo_epi8( LOADL( pix - 4 + 0*stride ), LOADL( pix - 4 + 1*stride ) );
+        __m128i a1 = _mm_unpacklo_epi8( LOADL( pix - 4 + 2*stride ), LOADL( pix - 4 + 3*stride ) );
+        __m128i a2 = _mm_unpacklo_epi8( LOADL( pix - 4 + 4*stride ), LOADL( pix - 4 + 5*stride ) );
+        __m128i a3 = _mm_unpacklo_epi8( LOADL( pix - 4 + 6*stride ), LOADL( pix - 4 + 7*stride ) );
+        __m128i b0 = _mm_unpacklo_epi16( a0, a1 );
+        __m128i b1 = _mm_unpackhi_epi16( a0, a1 );
+        __m128i b2 = _mm_unpacklo_epi16( a2, a3 );
+        __m128i b3 = _mm_unpackhi_epi16( a2, a3 );
+        t[h][0] = _mm_unpacklo_epi32( b0, b2 );
+        t[h][1] = _mm_unpackhi_epi32( b0, b2 );
+        t[h][2] = _mm_unpacklo_epi32( b1, b3 );
+        t[h][3] = _mm_unpackhi_epi32( b1, b3 );
+    }
+    for( int i = 0; i < 4; i++ )
+    {
+        c[2*i+0] = _mm_unpacklo_epi64( t[0][i], t[1][i] );
+        c[2*i+1] = _mm_unpackhi_epi64( t[0][i], t[1][i] );
+    }
+}
+
+static ALWAYS_INLINE void transpose_store_16x8( pixel *pix, intptr_t stride, __m128i c[8] )
+{
+    for( int h = 0; h < 2; h++, pix += 8*stride )
+    {
+        __m128i a0 = h ? _mm_unpackhi_epi8( c[0], c[1] ) : _mm_unpacklo_epi8( c[0], c[1] );
+        __m128i a1 = h ? _mm_unpackhi_epi8( c[2], c[3] ) : _mm_unpacklo_epi8( c[2], c[3] );
+        __m128i a2 = h ? _mm_unpackhi_epi8( c[4], c[5] ) : _mm_unpacklo_epi8( c[4], c[5] );
+        __m128i a3 = h ? _mm_unpackhi_epi8( c[6], c[7] ) : _mm_unpacklo_epi8( c[6], c[7] );
+        __m128i b0 = _mm_unpacklo_epi16( a0, a1 );
+        __m128i b1 = _mm_unpackhi_epi16( a0, a1 );
+        __m128i b2 = _mm_unpacklo_epi16( a2, a3 );
+        __m128i b3 = _mm_unpackhi_epi16( a2, a3 );
+        __m128i r01 = _mm_unpacklo_epi32( b0, b2 );
+        __m128i r23 = _mm_unpackhi_epi32( b0, b2 );
+        __m128i r45 = _mm_unpacklo_epi32( b1, b3 );
+        __m128i r67 = _mm_unpackhi_epi32( b1, b3 );
+        STOREL( pix - 4 + 0*stride, r01 );
+        STOREH( pix - 4 + 1*stride, r01 );
+        STOREL( pix - 4 + 2*stride, r23 );
+        STOREH( pix - 4 + 3*stride, r23 );
+        STOREL( pix - 4 + 4*stride, r45 );
+        STOREH( pix - 4 + 5*stride, r45 );
+        STOREL( pix - 4 + 6*stride, r67 );
+        STOREH( pix - 4 + 7*stride, r67 );
+    }
+}
+
+static void deblock_v_luma_sse2( pixel *pix, intptr_t stride, int alpha, int beta, int8_t *tc0 )
+{
+    __m128i p2 = LOADU( pix - 3*stride ), p1 = LOADU( pix - 2*stride ), p0 = LOADU( pix - stride );
+    __m128i q0 = LOADU( pix ), q1 = LOADU( pix + stride ), q2 = LOADU( pix + 2*stride );
+    deblock_luma_16( &p2, &p1, &p0, &q0, &q1, &q2, alpha, beta, expand_tc4( tc0 ) );
+    STOREU( pix - 2*stride, p1 );
+    STOREU( pix - stride, p0 );
+    STOREU( pix, q0 );
+    STOREU( pix + stride, q1 );
+}
+
+static void deblock_h_luma_sse2( pixel *pix, intptr_t stride, int alpha, int beta, int8_t *tc0 )
+{
+    __m128i c[8];
+    transpose_load_16x8( pix, stride, c );
+    deblock_luma_16( &c[1], &c[2], &c[3], &c[4], &c[5], &c[6], alpha, beta, expand_tc4( tc0 ) );
+    transpose_store_16x8( pix, stride, c );
+}
+
+static void deblock_v_luma_intra_sse2( pixel *pix, intptr_t stride, int alpha, int beta )
+{
+    __m128i p3 = LOADU( pix - 4*stride ), p2 = LOADU( pix - 3*stride ), p1 = LOADU( pix - 2*stride ), p0 = LOADU( pix - stride );
+    __m128i q0 = LOADU( pix ), q1 = LOADU( pix + stride ), q2 = LOADU( pix + 2*stride ), q3 = LOADU( pix + 3*stride );
+    deblock_luma_intra_16( &p3, &p2, &p1, &p0, &q0, &q1, &q2, &q3, alpha, beta );
+    STOREU( pix - 3*stride, p2 );
+    STOREU( pix - 2*stride, p1 );
+    STOREU( pix - stride, p0 );
+    STOREU( pix, q0 );
+    STOREU( pix + stride, q1 );
+    STOREU( pix + 2*stride, q2 );
+}
+
+static void deblock_h_luma_intra_sse2( pixel *pix, intptr_t stride, int alpha, int beta )
+{
+    __m128i c[8];
+    transpose_load_16x8( pix, stride, c );
+    deblock_luma_intra_16( &c[0], &c[1], &c[2], &c[3], &c[4], &c[5], &c[6], &c[7], alpha, beta );
+    transpose_store_16x8( pix, stride, c );
+}
+
+/****************************************************************************
+ * chroma: 8 interleaved U/V pairs per register
+ ****************************************************************************/
+static ALWAYS_INLINE void deblock_chroma_16( __m128i *p1, __m128i *p0, __m128i *q0, __m128i *q1,
+                                             int alpha, int beta, __m128i tc8 )
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i mask = _mm_and_si128( edge_mask( *p1, *p0, *q0, *q1, alpha, beta ), _mm_cmpgt_epi8( tc8, zero ) );
+    __m128i tcl = _mm_srai_epi16( _mm_unpacklo_epi8( tc8, tc8 ), 8 );
+    __m128i tch = _mm_srai_epi16( _mm_unpackhi_epi8( tc8, tc8 ), 8 );
+    __m128i dl = _mm_and_si128( normal_delta( UNPACK_LO( *p1 ), UNPACK_LO( *p0 ), UNPACK_LO( *q0 ), UNPACK_LO( *q1 ), tcl ), MASK_LO( mask ) );
+    __m128i dh = _mm_and_si128( normal_delta( UNPACK_HI( *p1 ), UNPACK_HI( *p0 ), UNPACK_HI( *q0 ), UNPACK_HI( *q1 ), tch ), MASK_HI( mask ) );
+    *p0 = _mm_packus_epi16( _mm_add_epi16( UNPACK_LO( *p0 ), dl ), _mm_add_epi16( UNPACK_HI( *p0 ), dh ) );
+    *q0 = _mm_packus_epi16( _mm_sub_epi16( UNPACK_LO( *q0 ), dl ), _mm_sub_epi16( UNPACK_HI( *q0 ), dh ) );
+}
+
+/* (2*p1 + p0 + q1 + 2) >> 2 == avg( p1, avg( p0, q1 ) - ((p0 ^ q1) & 1) ) */
+static ALWAYS_INLINE __m128i chroma_intra_avg( __m128i p1, __m128i p0, __m128i q1 )
+{
+    __m128i t = _mm_sub_epi8( _mm_avg_epu8( p0, q1 ), _mm_and_si128( _mm_xor_si128( p0, q1 ), _mm_set1_epi8( 1 ) ) );
+    return _mm_avg_epu8( p1, t );
+}
+
+static ALWAYS_INLINE void deblock_chroma_intra_16( __m128i *p1, __m128i *p0, __m128i *q0, __m128i *q1, int alpha, int beta )
+{
+    __m128i mask = edge_mask( *p1, *p0, *q0, *q1, alpha, beta );
+    __m128i p0n = chroma_intra_avg( *p1, *p0, *q1 );
+    __m128i q0n = chroma_intra_avg( *q1, *q0, *p1 );
+    *p0 = BLEND( mask, p0n, *p0 );
+    *q0 = BLEND( mask, q0n, *q0 );
+}
+
+/* 8 rows of p1 p0 q0 q1 U/V pairs starting at pix-4 to one register per pair */
+static ALWAYS_INLINE void transpose_load_8x4( pixel *pix, intptr_t stride, __m128i c[4] )
+{
+    __m128i a0 = _mm_unpacklo_epi16( LOADL( pix - 4 + 0*stride ), LOADL( pix - 4 + 1*stride ) );
+    __m128i a1 = _mm_unpacklo_epi16( LOADL( pix - 4 + 2*stride ), LOADL( pix - 4 + 3*stride ) );
+    __m128i a2 = _mm_unpacklo_epi16( LOADL( pix - 4 + 4*stride ), LOADL( pix - 4 + 5*stride ) );
+    __m128i a3 = _mm_unpacklo_epi16( LOADL( pix - 4 + 6*stride ), LOADL( pix - 4 + 7*stride ) );
+    __m128i b0 = _mm_unpacklo_epi32( a0, a1 );
+    __m128i b1 = _mm_unpackhi_epi32( a0, a1 );
+    __m128i b2 = _mm_unpacklo_epi32( a2, a3 );
+    __m128i b3 = _mm_unpackhi_epi32( a2, a3 );
+    c[0] = _mm_unpacklo_epi64( b0, b2 );
+    c[1] = _mm_unpackhi_epi64( b0, b2 );
+    c[2] = _mm_unpacklo_epi64( b1, b3 );
+    c[3] = _mm_unpackhi_epi64( b1, b3 );
+}
+
+static ALWAYS_INLINE void transpose_store_8x4( pixel *pix, intptr_t stride, __m128i c[4] )
+{
+    __m128i a0 = _mm_unpacklo_epi16( c[0], c[1] );
+    __m128i a1 = _mm_unpackhi_epi16( c[0], c[1] );
+    __m128i a2 = _mm_unpacklo_epi16( c[2], c[3] );
+    __m128i a3 = _mm_unpackhi_epi16( c[2], c[3] );
+    __m128i r01 = _mm_unpacklo_epi32( a0, a2 );
+    __m128i r23 = _mm_unpackhi_epi32( a0, a2 );
+    __m128i r45 = _mm_unpacklo_epi32( a1, a3 );
+    __m128i r67 = _mm_unpackhi_epi32( a1, a3 );
+    STOREL( pix - 4 + 0*stride, r01 );
+    STOREH( pix - 4 + 1*stride, r01 );
+    STOREL( pix - 4 + 2*stride, r23 );
+    STOREH( pix - 4 + 3*stride, r23 );
+    STOREL( pix - 4 + 4*stride, r45 );
+    STOREH( pix - 4 + 5*stride, r45 );
+    STOREL( pix - 4 + 6*stride, r67 );
+    STOREH( pix - 4 + 7*stride, r67 );
+}
+
+static void deblock_v_chroma_sse2( pixel *pix, intptr_t stride, int alpha, int beta, int8_t *tc0 )
+{
+    __m128i p1 = LOADU( pix - 2*stride ), p0 = LOADU( pix - stride );
+    __m128i q0 = LOADU( pix ), q1 = LOADU( pix + stride );
+    deblock_chroma_16( &p1, &p0, &q0, &q1, alpha, beta, expand_tc4( tc0 ) );
+    STOREU( pix - stride, p0 );
+    STOREU( pix, q0 );
+}
+
+static ALWAYS_INLINE void deblock_h_chroma_8( pixel *pix, intptr_t stride, int alpha, int beta, __m128i tc8 )
+{
+    __m128i c[4];
+    transpose_load_8x4( pix, stride, c );
+    deblock_chroma_16( &c[0], &c[1], &c[2], &c[3], alpha, beta, tc8 );
+    transpose_store_8x4( pix, stride, c );
+}
+
+static void deblock_h_chroma_sse2( pixel *pix, intptr_t stride, int alpha, int beta, int8_t *tc0 )
+{
+    deblock_h_chroma_8( pix, stride, alpha, beta, expand_tc4( tc0 ) );
+}
+
+static void deblock_h_chroma_422_sse2( pixel *pix, intptr_t stride, int alpha, int beta, int8_t *tc0 )
+{
+    deblock_h_chroma_8( pix,            stride, alpha, beta, expand_tc8( tc0 ) );
+    deblock_h_chroma_8( pix + 8*stride, stride, alpha, beta, expand_tc8( tc0+2 ) );
+}
+
+static void deblock_v_chroma_intra_sse2( pixel *pix, intptr_t stride, int alpha, int beta )
+{
+    __m128i p1 = LOADU( pix - 2*stride ), p0 = LOADU( pix - stride );
+    __m128i q0 = LOADU( pix ), q1 = LOADU( pix + stride );
+    deblock_chroma_intra_16( &p1, &p0, &q0, &q1, alpha, beta );
+    STOREU( pix - stride, p0 );
+    STOREU( pix, q0 );
+}
+
+static ALWAYS_INLINE void deblock_h_chroma_intra_8( pixel *pix, intptr_t stride, int alpha, int beta )
+{
+    __m128i c[4];
+    transpose_load_8x4( pix, stride, c );
+    deblock_chroma_intra_16( &c[0], &c[1], &c[2], &c[3], alpha, beta );
+    transpose_store_8x4( pix, stride, c );
+}
+
+static void deblock_h_chroma_intra_sse2( pixel *pix, intptr_t stride, int alpha, int beta )
+{
+    deblock_h_chroma_intra_8( pix, stride, alpha, beta );
+}
+
+static void deblock_h_chroma_422_intra_sse2( pixel *pix, intptr_t stride, int alpha, int beta )
+{
+    deblock_h_chroma_intra_8( pix,            stride, alpha, beta );
+    deblock_h_chroma_intra_8( pix + 8*stride, stride, alpha, beta );
+}
+
+/****************************************************************************
+ * deblock_strength
+ ****************************************************************************/
+/* 4x4 luma blocks of a scan8 array, row-major, from the block at p;
+ * scan8 rows start at any byte, so no M32 here */
+static ALWAYS_INLINE __m128i load_4x4_u8( const uint8_t *p )
+{
+    int32_t r[4];
+    for( int i = 0; i < 4; i++ )
+        memcpy( &r[i], p + 8*i, 4 );
+    return _mm_setr_epi32( r[0], r[1], r[2], r[3] );
+}
+
+/* per block: ref or mv differ enough for bS 1, as 0/-1 bytes */
+static ALWAYS_INLINE __m128i mv_ref_mask( int8_t ref[X264_SCAN8_LUMA_SIZE], int16_t mv[X264_SCAN8_LUMA_SIZE][2],
+                                          int loc, int locn, __m128i mvlim )
+{
+    __m128i ref_ne = _mm_xor_si128( _mm_cmpeq_epi8( load_4x4_u8( (uint8_t*)ref + loc ), load_4x4_u8( (uint8_t*)ref + locn ) ),
+                                    _mm_set1_epi8( -1 ) );
+    __m128i m[4];
+    for( int y = 0; y < 4; y++ )
+    {
+        __m128i d = _mm_sub_epi16( LOADU( mv[loc+8*y] ), LOADU( mv[locn+8*y] ) );
+        d = _mm_max_epi16( d, _mm_sub_epi16( _mm_setzero_si128(), d ) );
+        d = _mm_cmpgt_epi16( d, mvlim );
+        /* x or y over the limit, per block */
+        m[y] = _mm_or_si128( d, _mm_srli_epi32( d, 16 ) );
+        m[y] = _mm_srai_epi32( _mm_slli_epi32( m[y], 16 ), 16 );
+    }
+    __m128i mvm = _mm_packs_epi16( _mm_packs_epi32( m[0], m[1] ), _mm_packs_epi32( m[2], m[3] ) );
+    return _mm_or_si128( ref_ne, mvm );
+}
+
+static ALWAYS_INLINE __m128i strength_4x4( uint8_t nnz[X264_SCAN8_SIZE], int8_t ref[2][X264_SCAN8_LUMA_SIZE],
+                                           int16_t mv[2][X264_SCAN8_LUMA_SIZE][2], int loc, int locn,
+                                           __m128i mvlim, int bframe )
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i nz = _mm_or_si128( load_4x4_u8( nnz + loc ), load_4x4_u8( nnz + locn ) );
+    nz = _mm_xor_si128( _mm_cmpeq_epi8( nz, zero ), _mm_set1_epi8( -1 ) );
+    __m128i mvm = mv_ref_mask( ref[0], mv[0], loc, locn, mvlim );
+    if( bframe )
+        mvm = _mm_or_si128( mvm, mv_ref_mask( ref[1], mv[1], loc, locn, mvlim ) );
+    return _mm_or_si128( _mm_and_si128( nz, _mm_set1_epi8( 2 ) ), _mm_andnot_si128( nz, _mm_and_si128( mvm, _mm_set1_epi8( 1 ) ) ) );
+}
+
+static void deblock_strength_sse2( uint8_t nnz[X264_SCAN8_SIZE], int8_t ref[2][X264_SCAN8_LUMA_SIZE],
+                                   int16_t mv[2][X264_SCAN8_LUMA_SIZE][2], uint8_t bs[2][8][4], int mvy_limit,
+                                   int bframe )
+{
+    const __m128i mvlim = _mm_set1_epi32( (mvy_limit-1) << 16 | 3 );
+
+    /* horizontal edges: edge-major is the row-major block order */
+    STOREU( bs[1], strength_4x4( nnz, ref, mv, X264_SCAN8_0, X264_SCAN8_0 - 8, mvlim, bframe ) );
+
+    /* vertical edges come out row-major and are transposed to edge-major */
+    __m128i v = strength_4x4( nnz, ref, mv, X264_SCAN8_0, X264_SCAN8_0 - 1, mvlim, bframe );
+    v = _mm_unpacklo_epi8( v, _mm_srli_si128( v, 8 ) );
+    v = _mm_unpacklo_epi8( v, _mm_srli_si128( v, 8 ) );
+    STOREU( bs[0], v );
+}
+
+/****************************************************************************
+ * x264_deblock_init_intrin:
+ ****************************************************************************/
+void x264_deblock_init_intrin( int cpu, x264_deblock_function_t *pf )
+{
+    if( cpu&X264_CPU_SSE2 )
+    {
+        pf->deblock_luma[1] = deblock_v_luma_sse2;
+        pf->deblock_luma[0] = deblock_h_luma_sse2;
+        pf->deblock_chroma[1] = deblock_v_chroma_sse2;
+        pf->deblock_h_chroma_420 = deblock_h_chroma_sse2;
+        pf->deblock_h_chroma_422 = deblock_h_chroma_422_sse2;
+        pf->deblock_luma_intra[1] = deblock_v_luma_intra_sse2;
+        pf->deblock_luma_intra[0] = deblock_h_luma_intra_sse2;
+        pf->deblock_chroma_intra[1] = deblock_v_chroma_intra_sse2;
+        pf->deblock_h_chroma_420_intra = deblock_h_chroma_intra_sse2;
+        pf->deblock_h_chroma_422_intra = deblock_h_chroma_422_intra_sse2;
+        pf->deblock_strength = deblock_strength_sse2;
+    }
+}
+
+#endif // HAVE_X86_INTRIN && !HIGH_BIT_DEPTH
@@ -0,0 +1,43 @@
+/*****************************************************************************
+ * intrin.h: x86 compiler intrinsic kernels
+ *****************************************************************************
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *****************************************************************************/
+
+#ifndef X264_X86_INTRIN_H
+#define X264_X86_INTRIN_H
+
+/* Builds without the x264 asm (HAVE_MMX 0) get SSE2, SSSE3 and AVX2
+ * versions of the hot DSP functions written with compiler intrinsics.
+ * SSE2 is part of the x86-64 baseline; SSSE3 and AVX2 functions are compiled
+ * with a target attribute, so the files need no special flags and the init
+ * functions below install each version only when x264_cpu_detect reports it. */
+
+#define X264_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define X264_TARGET_AVX2 __attribute__((target("avx2")))
+
+void x264_pixel_init_intrin( int cpu, x264_pixel_function_t *pixf );
+void x264_mc_init_intrin( int cpu, x264_mc_functions_t *pf );
+void x264_dct_init_intrin( int cpu, x264_dct_function_t *dctf );
+void x264_zigzag_init_intrin( int cpu, x264_zigzag_function_t *pf_progressive, x264_zigzag_function_t *pf_interlaced );
+void x264_quant_init_intrin( int cpu, x264_quant_function_t *pf );
+void x264_deblock_init_intrin( int cpu, x264_deblock_function_t *pf );
+void x264_predict_16x16_init_intrin( int cpu, x264_predict_t pf[7] );
+void x264_predict_8x8c_init_intrin( int cpu, x264_predict_t pf[7] );
+void x264_predict_8x16c_init_intrin( int cpu, x264_predict_t pf[7] );
+void x264_predict_8x8_init_intrin( int cpu, x264_predict8x8_t pf[12], x264_predict_8x8_filter_t *predict_filter );
+void x264_predict_4x4_init_intrin( int cpu, x264_predict_t pf[12] );
+
+#endif
@@ -0,0 +1,582 @@
+/*****************************************************************************
+ * mc-intrin.c: x86 motion compensation with compiler intrinsics
+ *****************************************************************************
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *****************************************************************************/
+
+#include "common/common.h"
+#include "intrin.h"
+#include <immintrin.h>
+
+#if HAVE_X86_INTRIN && !HIGH_BIT_DEPTH
+
+/* Same output as common/mc.c, including which pixels get written. */
+
+#define LOADU(p)  _mm_loadu_si128( (const __m128i*)(p) )
+#define LOADL(p)  _mm_loadl_epi64( (const __m128i*)(p) )
+#define STOREU(p, v) _mm_storeu_si128( (__m128i*)(p), v )
+#define STOREL(p, v) _mm_storel_epi64( (__m128i*)(p), v )
+
+/* 4- and 2-pixel tails: pixel pointers here have no alignment, so go
+ * through memcpy rather than M32/M16 (the compiler emits a plain movd) */
+static ALWAYS_INLINE __m128i load32( const pixel *p )
+{
+    uint32_t v;
+    memcpy( &v, p, 4 );
+    return _mm_cvtsi32_si128( v );
+}
+
+static ALWAYS_INLINE __m128i load16( const pixel *p )
+{
+    uint16_t v;
+    memcpy( &v, p, 2 );
+    return _mm_cvtsi32_si128( v );
+}
+
+static ALWAYS_INLINE void store32( pixel *p, __m128i x )
+{
+    uint32_t v = _mm_cvtsi128_si32( x );
+    memcpy( p, &v, 4 );
+}
+
+static ALWAYS_INLINE void store16( pixel *p, __m128i x )
+{
+    uint16_t v = _mm_cvtsi128_si32( x );
+    memcpy( p, &v, 2 );
+}
+
+/****************************************************************************
+ * pixel_avg
+ ****************************************************************************/
+static ALWAYS_INLINE void avg_row( pixel *dst, pixel *src1, pixel *src2, int width )
+{
+    int x = 0;
+    for( ; x+16 <= width; x += 16 )
+        STOREU( dst+x, _mm_avg_epu8( LOADU( src1+x ), LOADU( src2+x ) ) );
+    if( x+8 <= width )
+    {
+        STOREL( dst+x, _mm_avg_epu8( LOADL( src1+x ), LOADL( src2+x ) ) );
+        x += 8;
+    }
+    if( x+4 <= width )
+    {
+        __m128i a = load32( src1+x );
+        __m128i b = load32( src2+x );
+        store32( dst+x, _mm_avg_epu8( a, b ) );
+        x += 4;
+    }
+    for( ; x < width; x++ )
+        dst[x] = ( src1[x] + src2[x] + 1 ) >> 1;
+}
+
+/* (src1*w1 + src2*w2 + 32) >> 6 with w1+w2 = 64 and w1 in [-64,128]:
+ * every intermediate fits in 16 bits */
+static ALWAYS_INLINE __m128i avg_weight_8( __m128i a, __m128i b, __m128i w1, __m128i w2 )
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i v = _mm_add_epi16( _mm_mullo_epi16( _mm_unpacklo_epi8( a, zero ), w1 ),
+                               _mm_mullo_epi16( _mm_unpacklo_epi8( b, zero ), w2 ) );
+    v = _mm_srai_epi16( _mm_add_epi16( v, _mm_set1_epi16( 32 ) ), 6 );
+    return _mm_packus_epi16( v, v );
+}
+
+static ALWAYS_INLINE void avg_weight_row( pixel *dst, pixel *src1, pixel *src2, int width, __m128i w1, __m128i w2 )
+{
+    int x = 0;
+    for( ; x+8 <= width; x += 8 )
+        STOREL( dst+x, avg_weight_8( LOADL( src1+x ), LOADL( src2+x ), w1, w2 ) );
+    if( x+4 <= width )
+    {
+        __m128i v = avg_weight_8( load32( src1+x ), load32( src2+x ), w1, w2 );
+        store32( dst+x, v );
+        x += 4;
+    }
+    if( x+2 <= width )
+    {
+        __m128i v = avg_weight_8( load16( src1+x ), load16( src2+x ), w1, w2 );
+        store16( dst+x, v );
+    }
+}
+
+static ALWAYS_INLINE void pixel_avg_wxh( pixel *dst,  intptr_t i_dst,
+                                         pixel *src1, intptr_t i_src1,
+                                         pixel *src2, intptr_t i_src2, int width, int height, int weight )
+{
+    if( weight == 32 )
+        for( int y = 0; y < height; y++, dst += i_dst, src1 += i_src1, src2 += i_src2 )
+            avg_row( dst, src1, src2, width );
+    else
+    {
+        __m128i w1 = _mm_set1_epi16( weight );
+        __m128i w2 = _mm_set1_epi16( 64 - weight );
+        for( int y = 0; y < height; y++, dst += i_dst, src1 += i_src1, src2 += i_src2 )
+            avg_weight_row( dst, src1, src2, width, w1, w2 );
+    }
+}
+
+#define PIXEL_AVG_SSE2( w, h ) \
+static void x264_pixel_avg_##w##x##h##_sse2( pixel *pix1, intptr_t i_stride_pix1,\
+                                             pixel *pix2, intptr_t i_stride_pix2,\
+                                             pixel *pix3, intptr_t i_stride_pix3, int weight )\
+{\
+    pixel_avg_wxh( pix1, i_stride_pix1, pix2, i_stride_pix2, pix3, i_stride_pix3, w, h, weight );\
+}
+PIXEL_AVG_SSE2( 16, 16 )
+PIXEL_AVG_SSE2( 16, 8 )
+PIXEL_AVG_SSE2( 8, 16 )
+PIXEL_AVG_SSE2( 8, 8 )
+PIXEL_AVG_SSE2( 8, 4 )
+PIXEL_AVG_SSE2( 4, 16 )
+PIXEL_AVG_SSE2( 4, 8 )
+PIXEL_AVG_SSE2( 4, 4 )
+PIXEL_AVG_SSE2( 4, 2 )
+PIXEL_AVG_SSE2( 2, 8 )
+PIXEL_AVG_SSE2( 2, 4 )
+PIXEL_AVG_SSE2( 2, 2 )
+
+/****************************************************************************
+ * weight
+ ****************************************************************************/
+/* clip( ((src*scale + round) >> denom) + offset ); src*scale fits in 16 bits
+ * for 8-bit pixels and 8-bit scales */
+static ALWAYS_INLINE __m128i weight_8( __m128i src, __m128i scale, __m128i round, __m128i denom, __m128i offset )
+{
+    __m128i v = _mm_mullo_epi16( _mm_unpacklo_epi8( src, _mm_setzero_si128() ), scale );
+    v = _mm_add_epi16( _mm_sra_epi16( _mm_add_epi16( v, round ), denom ), offset );
+    return _mm_packus_epi16( v, v );
+}
+
+static ALWAYS_INLINE void mc_weight_wxh( pixel *dst, intptr_t i_dst_stride, pixel *src, intptr_t i_src_stride,
+                                         const x264_weight_t *weight, int width, int height )
+{
+    __m128i scale  = _mm_set1_epi16( weight->i_scale );
+    __m128i round  = _mm_set1_epi16( weight->i_denom >= 1 ? 1 << (weight->i_denom - 1) : 0 );
+    __m128i denom  = _mm_cvtsi32_si128( weight->i_denom >= 1 ? weight->i_denom : 0 );
+    __m128i offset = _mm_set1_epi16( weight->i_offset * (1 << (BIT_DEPTH-8)) );
+    for( int y = 0; y < height; y++, dst += i_dst_stride, src += i_src_stride )
+    {
+        int x = 0;
+        for( ; x+8 <= width; x += 8 )
+            STOREL( dst+x, weight_8( LOADL( src+x ), scale, round, denom, offset ) );
+        if( x+4 <= width )
+        {
+            store32( dst+x, weight_8( load32( src+x ), scale, round, denom, offset ) );
+            x += 4;
+        }
+        if( x+2 <= width )
+            store16( dst+x, weight_8( load16( src+x ), scale, round, denom, offset ) );
+    }
+}
+
+#define MC_WEIGHT_SSE2( w ) \
+static void mc_weight_w##w##_sse2( pixel *dst, intptr_t i_dst_stride, pixel *src, intptr_t i_src_stride,\
+                                   const x264_weight_t *weight, int height )\
+{\
+    mc_weight_wxh( dst, i_dst_stride, src, i_src_stride, weight, w, height );\
+}
+MC_WEIGHT_SSE2( 20 )
+MC_WEIGHT_SSE2( 16 )
+MC_WEIGHT_SSE2( 12 )
+MC_WEIGHT_SSE2( 8 )
+MC_WEIGHT_SSE2( 4 )
+MC_WEIGHT_SSE2( 2 )
+
+static weight_fn_t mc_weight_wtab_sse2[6] =
+{
+    mc_weight_w2_sse2,
+    mc_weight_w4_sse2,
+    mc_weight_w8_sse2,
+    mc_weight_w12_sse2,
+    mc_weight_w16_sse2,
+    mc_weight_w20_sse2,
+};
+
+/****************************************************************************
+ * mc_luma, get_ref
+ ****************************************************************************/
+static const uint8_t hpel_ref0[16] = {0,1,1,1,0,1,1,1,2,3,3,3,0,1,1,1};
+static const uint8_t hpel_ref1[16] = {0,0,0,0,2,2,3,2,2,2,3,2,2,2,3,2};
+
+static void mc_luma_sse2( pixel *dst,    intptr_t i_dst_stride,
+                          pixel *src[4], intptr_t i_src_stride,
+                          int mvx, int mvy,
+                          int i_width, int i_height, const x264_weight_t *weight )
+{
+    int qpel_idx = ((mvy&3)<<2) + (mvx&3);
+    int offset = (mvy>>2)*i_src_stride + (mvx>>2);
+    pixel *src1 = src[hpel_ref0[qpel_idx]] + offset + ((mvy&3) == 3) * i_src_stride;
+
+    if( qpel_idx & 5 ) /* qpel interpolation needed */
+    {
+        pixel *src2 = src[hpel_ref1[qpel_idx]] + offset + ((mvx&3) == 3);
+        pixel_avg_wxh( dst, i_dst_stride, src1, i_src_stride, src2, i_src_stride, i_width, i_height, 32 );
+        if( weight->weightfn )
+            mc_weight_wxh( dst, i_dst_stride, dst, i_dst_stride, weight, i_width, i_height );
+    }
+    else if( weight->weightfn )
+        mc_weight_wxh( dst, i_dst_stride, src1, i_src_stride, weight, i_width, i_height );
+    else
+        for( int y = 0; y < i_height; y++, src1 += i_src_stride, dst += i_dst_stride )
+            memcpy( dst, src1, i_width * sizeof(pixel) );
+}
+
+static pixel *get_ref_sse2( pixel *dst,   intptr_t *i_dst_stride,
+                            pixel *src[4], intptr_t i_src_stride,
+                            int mvx, int mvy,
+                            int i_width, int i_height, const x264_weight_t *weight )
+{
+    int qpel_idx = ((mvy&3)<<2) + (mvx&3);
+    int offset = (mvy>>2)*i_src_stride + (mvx>>2);
+    pixel *src1 = src[hpel_ref0[qpel_idx]] + offset + ((mvy&3) == 3) * i_src_stride;
+
+    if( qpel_idx & 5 ) /* qpel interpolation needed */
+    {
+        pixel *src2 = src[hpel_ref1[qpel_idx]] + offset + ((mvx&3) == 3);
+        pixel_avg_wxh( dst, *i_dst_stride, src1, i_src_stride, src2, i_src_stride, i_width, i_height, 32 );
+        if( weight->weightfn )
+            mc_weight_wxh( dst, *i_dst_stride, dst, *i_dst_stride, weight, i_width, i_height );
+        return dst;
+    }
+    else if( weight->weightfn )
+    {
+        mc_weight_wxh( dst, *i_dst_stride, src1, i_src_stride, weight, i_width, i_height );
+        return dst;
+    }
+    else
+    {
+        *i_dst_stride = i_src_stride;
+        return src1;
+    }
+}
+
+/****************************************************************************
+ * mc_chroma
+ ****************************************************************************/
+/* One row of interleaved uv: 2*n bytes of src, n = 8, 4 or 2 pairs */
+static ALWAYS_INLINE __m128i chroma_load( pixel *p, int n )
+{
+    const __m128i zero = _mm_setzero_si128();
+    if( n == 8 )
+        return LOADU( p );
+    else if( n == 4 )
+        return _mm_unpacklo_epi64( LOADL( p ), zero );
+    else
+        return load32( p );
+}
+
+static ALWAYS_INLINE void mc_chroma_wxh( pixel *dstu, pixel *dstv, intptr_t i_dst_stride,
+                                         pixel *src, intptr_t i_src_stride,
+                                         int cA, int cB, int cC, int cD, int n, int i_height )
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i mask = _mm_set1_epi32( 0xffff );
+    const __m128i wA = _mm_set1_epi16( cA ), wB = _mm_set1_epi16( cB );
+    const __m128i wC = _mm_set1_epi16( cC ), wD = _mm_set1_epi16( cD );
+    const __m128i r32 = _mm_set1_epi16( 32 );
+    /* the row above, horizontally interpolated, for both halves of 8 pairs */
+    __m128i t0 = chroma_load( src, n ), t1 = chroma_load( src+2, n );
+    __m128i alo = _mm_add_epi16( _mm_mullo_epi16( _mm_unpacklo_epi8( t0, zero ), wA ),
+                                 _mm_mullo_epi16( _mm_unpacklo_epi8( t1, zero ), wB ) );
+    __m128i ahi = _mm_add_epi16( _mm_mullo_epi16( _mm_unpackhi_epi8( t0, zero ), wA ),
+                                 _mm_mullo_epi16( _mm_unpackhi_epi8( t1, zero ), wB ) );
+    for( int y = 0; y < i_height; y++ )
+    {
+        src += i_src_stride;
+        __m128i b0 = chroma_load( src, n ), b1 = chroma_load( src+2, n );
+        __m128i b0lo = _mm_unpacklo_epi8( b0, zero ), b0hi = _mm_unpackhi_epi8( b0, zero );
+        __m128i b1lo = _mm_unpacklo_epi8( b1, zero ), b1hi = _mm_unpackhi_epi8( b1, zero );
+        __m128i lo = _mm_add_epi16( _mm_add_epi16( alo, r32 ),
+                     _mm_add_epi16( _mm_mullo_epi16( b0lo, wC ), _mm_mullo_epi16( b1lo, wD ) ) );
+        __m128i hi = _mm_add_epi16( _mm_add_epi16( ahi, r32 ),
+                     _mm_add_epi16( _mm_mullo_epi16( b0hi, wC ), _mm_mullo_epi16( b1hi, wD ) ) );
+        lo = _mm_srli_epi16( lo, 6 );
+        hi = _mm_srli_epi16( hi, 6 );
+        /* deinterleave: u in the even 16-bit lanes, v in the odd ones */
+        __m128i u = _mm_packs_epi32( _mm_and_si128( lo, mask ), _mm_and_si128( hi, mask ) );
+        __m128i v = _mm_packs_epi32( _mm_srli_epi32( lo, 16 ), _mm_srli_epi32( hi, 16 ) );
+        u = _mm_packus_epi16( u, u );
+        v = _mm_packus_epi16( v, v );
+        if( n == 8 )
+        {
+            STOREL( dstu, u );
+            STOREL( dstv, v );
+        }
+        else if( n == 4 )
+        {
+            store32( dstu, u );
+            store32( dstv, v );
+        }
+        else
+        {
+            store16( dstu, u );
+            store16( dstv, v );
+        }
+        alo = _mm_add_epi16( _mm_mullo_epi16( b0lo, wA ), _mm_mullo_epi16( b1lo, wB ) );
+        ahi = _mm_add_epi16( _mm_mullo_epi16( b0hi, wA ), _mm_mullo_epi16( b1hi, wB ) );
+        dstu += i_dst_stride;
+        dstv += i_dst_stride;
+    }
+}
+
+static void mc_chroma_sse2( pixel *dstu, pixel *dstv, intptr_t i_dst_stride,
+                            pixel *src, intptr_t i_src_stride,
+                            int mvx, int mvy,
+                            int i_width, int i_height )
+{
+    int d8x = mvx&0x07;
+    int d8y = mvy&0x07;
+    int cA = (8-d8x)*(8-d8y);
+    int cB = d8x    *(8-d8y);
+    int cC = (8-d8x)*d8y;
+    int cD = d8x    *d8y;
+
+    src += (mvy >> 3) * i_src_stride + (mvx >> 3)*2;
+
+    int x = 0;
+    for( ; x+8 <= i_width; x += 8 )
+        mc_chroma_wxh( dstu+x, dstv+x, i_dst_stride, src+2*x, i_src_stride, cA, cB, cC, cD, 8, i_height );
+    if( x+4 <= i_width )
+    {
+        mc_chroma_wxh( dstu+x, dstv+x, i_dst_stride, src+2*x, i_src_stride, cA, cB, cC, cD, 4, i_height );
+        x += 4;
+    }
+    if( x+2 <= i_width )
+        mc_chroma_wxh( dstu+x, dstv+x, i_dst_stride, src+2*x, i_src_stride, cA, cB, cC, cD, 2, i_height );
+}
+
+/****************************************************************************
+ * hpel_filter
+ ****************************************************************************/
+/* 6-tap filter a - 5b + 20c + 20d - 5e + f on 16-bit lanes */
+static ALWAYS_INLINE __m128i tap_epi16( __m128i a, __m128i b, __m128i c, __m128i d, __m128i e, __m128i f )
+{
+    __m128i p0 = _mm_add_epi16( a, f );
+    __m128i p1 = _mm_add_epi16( b, e );
+    __m128i p2 = _mm_add_epi16( c, d );
+    /* p0 - 5*p1 + 20*p2 = p0 + 5*(4*p2 - p1) */
+    __m128i t = _mm_sub_epi16( _mm_slli_epi16( p2, 2 ), p1 );
+    return _mm_add_epi16( p0, _mm_add_epi16( t, _mm_slli_epi16( t, 2 ) ) );
+}
+
+static ALWAYS_INLINE __m128i load_8_epi16( const pixel *p )
+{
+    return _mm_unpacklo_epi8( LOADL( p ), _mm_setzero_si128() );
+}
+
+static ALWAYS_INLINE __m128i round_shift5( __m128i v )
+{
+    v = _mm_srai_epi16( _mm_add_epi16( v, _mm_set1_epi16( 16 ) ), 5 );
+    return _mm_packus_epi16( v, v );
+}
+
+/* The second pass runs on the 16-bit vertical sums, whose 6-tap sum needs
+ * 32 bits: pair up the symmetric taps, then one madd for p0 + 20*p2 */
+static ALWAYS_INLINE __m128i tap_c_8( int16_t *b )
+{
+    __m128i p0 = _mm_add_epi16( LOADU( b ),   LOADU( b+5 ) );
+    __m128i p1 = _mm_add_epi16( LOADU( b+1 ), LOADU( b+4 ) );
+    __m128i p2 = _mm_add_epi16( LOADU( b+2 ), LOADU( b+3 ) );
+    const __m128i c1_20 = _mm_setr_epi16( 1, 20, 1, 20, 1, 20, 1, 20 );
+    const __m128i r512 = _mm_set1_epi32( 512 );
+    __m128i lo = _mm_madd_epi16( _mm_unpacklo_epi16( p0, p2 ), c1_20 );
+    __m128i hi = _mm_madd_epi16( _mm_unpackhi_epi16( p0, p2 ), c1_20 );
+    __m128i p1lo = _mm_srai_epi32( _mm_unpacklo_epi16( p1, p1 ), 16 );
+    __m128i p1hi = _mm_srai_epi32( _mm_unpackhi_epi16( p1, p1 ), 16 );
+    lo = _mm_sub_epi32( lo, _mm_add_epi32( p1lo, _mm_slli_epi32( p1lo, 2 ) ) );
+    hi = _mm_sub_epi32( hi, _mm_add_epi32( p1hi, _mm_slli_epi32( p1hi, 2 ) ) );
+    lo = _mm_srai_epi32( _mm_add_epi32( lo, r512 ), 10 );
+    hi = _mm_srai_epi32( _mm_add_epi32( hi, r512 ), 10 );
+    __m128i v = _mm_packs_epi32( lo, hi );
+    return _mm_packus_epi16( v, v );
+}
+
+#define TAPFILTER(pix, d) ((pix)[x-2*d] + (pix)[x+3*d] - 5*((pix)[x-d] + (pix)[x+2*d]) + 20*((pix)[x] + (pix)[x+d]))
+
+/* Each row is filtered vertically, then its centre and horizontal
+ * half-pels are produced right away, while the source row and the 16-bit
+ * sums are still in L1. */
+static void hpel_filter_sse2( pixel *dsth, pixel *dstv, pixel *dstc, pixel *src,
+                              intptr_t stride, int width, int height, int16_t *buf )
+{
+    for( int y = 0; y < height; y++ )
+    {
+        int x = -2;
+        for( ; x+8 <= width+3; x += 8 )
+        {
+            __m128i v = tap_epi16( load_8_epi16( src+x-2*stride ), load_8_epi16( src+x-stride ),
+                                   load_8_epi16( src+x ),          load_8_epi16( src+x+stride ),
+                                   load_8_epi16( src+x+2*stride ), load_8_epi16( src+x+3*stride ) );
+            STOREL( dstv+x, round_shift5( v ) );
+            STOREU( buf+x+2, v );
+        }
+        for( ; x < width+3; x++ )
+        {
+            int v = TAPFILTER(src,stride);
+            dstv[x] = x264_clip_pixel( (v + 16) >> 5 );
+            buf[x+2] = v;
+        }
+
+        x = 0;
+        for( ; x+8 <= width; x += 8 )
+            STOREL( dstc+x, tap_c_8( buf+x ) );
+        for( ; x < width; x++ )
+            dstc[x] = x264_clip_pixel( (TAPFILTER(buf+2,1) + 512) >> 10 );
+
+        x = 0;
+        for( ; x+8 <= width; x += 8 )
+        {
+            __m128i h = tap_epi16( load_8_epi16( src+x-2 ), load_8_epi16( src+x-1 ),
+                                   load_8_epi16( src+x ),   load_8_epi16( src+x+1 ),
+                                   load_8_epi16( src+x+2 ), load_8_epi16( src+x+3 ) );
+            STOREL( dsth+x, round_shift5( h ) );
+        }
+        for( ; x < width; x++ )
+            dsth[x] = x264_clip_pixel( (TAPFILTER(src,1) + 16) >> 5 );
+
+        dsth += stride;
+        dstv += stride;
+        dstc += stride;
+        src += stride;
+    }
+}
+
+/****************************************************************************
+ * AVX2
+ ****************************************************************************/
+static X264_TARGET_AVX2 ALWAYS_INLINE __m256i load_16_epi16_avx2( const pixel *p )
+{
+    return _mm256_cvtepu8_epi16( LOADU( p ) );
+}
+
+static X264_TARGET_AVX2 ALWAYS_INLINE __m256i tap_epi16_avx2( __m256i a, __m256i b, __m256i c, __m256i d, __m256i e, __m256i f )
+{
+    __m256i p0 = _mm256_add_epi16( a, f );
+    __m256i p1 = _mm256_add_epi16( b, e );
+    __m256i p2 = _mm256_add_epi16( c, d );
+    __m256i t = _mm256_sub_epi16( _mm256_slli_epi16( p2, 2 ), p1 );
+    return _mm256_add_epi16( p0, _mm256_add_epi16( t, _mm256_slli_epi16( t, 2 ) ) );
+}
+
+/* 16 pixels, in order */
+static X264_TARGET_AVX2 ALWAYS_INLINE __m128i pack_16_avx2( __m256i v )
+{
+    return _mm_packus_epi16( _mm256_castsi256_si128( v ), _mm256_extracti128_si256( v, 1 ) );
+}
+
+static X264_TARGET_AVX2 ALWAYS_INLINE __m128i round_shift5_avx2( __m256i v )
+{
+    return pack_16_avx2( _mm256_srai_epi16( _mm256_add_epi16( v, _mm256_set1_epi16( 16 ) ), 5 ) );
+}
+
+static X264_TARGET_AVX2 ALWAYS_INLINE __m128i tap_c_16_avx2( int16_t *b )
+{
+    __m256i p0 = _mm256_add_epi16( _mm256_loadu_si256( (__m256i*)b ),     _mm256_loadu_si256( (__m256i*)(b+5) ) );
+    __m256i p1 = _mm256_add_epi16( _mm256_loadu_si256( (__m256i*)(b+1) ), _mm256_loadu_si256( (__m256i*)(b+4) ) );
+    __m256i p2 = _mm256_add_epi16( _mm256_loadu_si256( (__m256i*)(b+2) ), _mm256_loadu_si256( (__m256i*)(b+3) ) );
+    const __m256i c1_20 = _mm256_set1_epi32( (20 << 16) | 1 );
+    const __m256i r512 = _mm256_set1_epi32( 512 );
+    /* unpack works within 128-bit lanes; packs undoes it */
+    __m256i lo = _mm256_madd_epi16( _mm256_unpacklo_epi16( p0, p2 ), c1_20 );
+    __m256i hi = _mm256_madd_epi16( _mm256_unpackhi_epi16( p0, p2 ), c1_20 );
+    __m256i p1lo = _mm256_srai_epi32( _mm256_unpacklo_epi16( p1, p1 ), 16 );
+    __m256i p1hi = _mm256_srai_epi32( _mm256_unpackhi_epi16( p1, p1 ), 16 );
+    lo = _mm256_sub_epi32( lo, _mm256_add_epi32( p1lo, _mm256_slli_epi32( p1lo, 2 ) ) );
+    hi = _mm256_sub_epi32( hi, _mm256_add_epi32( p1hi, _mm256_slli_epi32( p1hi, 2 ) ) );
+    lo = _mm256_srai_epi32( _mm256_add_epi32( lo, r512 ), 10 );
+    hi = _mm256_srai_epi32( _mm256_add_epi32( hi, r512 ), 10 );
+    return pack_16_avx2( _mm256_packs_epi32( lo, hi ) );
+}
+
+static X264_TARGET_AVX2 void hpel_filter_avx2( pixel *dsth, pixel *dstv, pixel *dstc, pixel *src,
+                                               intptr_t stride, int width, int height, int16_t *buf )
+{
+    for( int y = 0; y < height; y++ )
+    {
+        int x = -2;
+        for( ; x+16 <= width+3; x += 16 )
+        {
+            __m256i v = tap_epi16_avx2( load_16_epi16_avx2( src+x-2*stride ), load_16_epi16_avx2( src+x-stride ),
+                                        load_16_epi16_avx2( src+x ),          load_16_epi16_avx2( src+x+stride ),
+                                        load_16_epi16_avx2( src+x+2*stride ), load_16_epi16_avx2( src+x+3*stride ) );
+            STOREU( dstv+x, round_shift5_avx2( v ) );
+            _mm256_storeu_si256( (__m256i*)(buf+x+2), v );
+        }
+        for( ; x < width+3; x++ )
+        {
+            int v = TAPFILTER(src,stride);
+            dstv[x] = x264_clip_pixel( (v + 16) >> 5 );
+            buf[x+2] = v;
+        }
+
+        x = 0;
+        for( ; x+16 <= width; x += 16 )
+            STOREU( dstc+x, tap_c_16_avx2( buf+x ) );
+        for( ; x < width; x++ )
+            dstc[x] = x264_clip_pixel( (TAPFILTER(buf+2,1) + 512) >> 10 );
+
+        x = 0;
+        for( ; x+16 <= width; x += 16 )
+        {
+            __m256i h = tap_epi16_avx2( load_16_epi16_avx2( src+x-2 ), load_16_epi16_avx2( src+x-1 ),
+                                        load_16_epi16_avx2( src+x ),   load_16_epi16_avx2( src+x+1 ),
+                                        load_16_epi16_avx2( src+x+2 ), load_16_epi16_avx2( src+x+3 ) );
+            STOREU( dsth+x, round_shift5_avx2( h ) );
+        }
+        for( ; x < width; x++ )
+            dsth[x] = x264_clip_pixel( (TAPFILTER(src,1) + 16) >> 5 );
+
+        dsth += stride;
+        dstv += stride;
+        dstc += stride;
+        src += stride;
+    }
+}
+
+/****************************************************************************
+ * x264_mc_init_intrin:
+ ****************************************************************************/
+void x264_mc_init_intrin( int cpu, x264_mc_functions_t *pf )
+{
+    if( cpu&X264_CPU_SSE2 )
+    {
+        pf->mc_luma   = mc_luma_sse2;
+        pf->get_ref   = get_ref_sse2;
+        pf->mc_chroma = mc_chroma_sse2;
+
+        pf->avg[PIXEL_16x16] = x264_pixel_avg_16x16_sse2;
+        pf->avg[PIXEL_16x8]  = x264_pixel_avg_16x8_sse2;
+        pf->avg[PIXEL_8x16]  = x264_pixel_avg_8x16_sse2;
+        pf->avg[PIXEL_8x8]   = x264_pixel_avg_8x8_sse2;
+        pf->avg[PIXEL_8x4]   = x264_pixel_avg_8x4_sse2;
+        pf->avg[PIXEL_4x16]  = x264_pixel_avg_4x16_sse2;
+        pf->avg[PIXEL_4x8]   = x264_pixel_avg_4x8_sse2;
+        pf->avg[PIXEL_4x4]   = x264_pixel_avg_4x4_sse2;
+        pf->avg[PIXEL_4x2]   = x264_pixel_avg_4x2_sse2;
+        pf->avg[PIXEL_2x8]   = x264_pixel_avg_2x8_sse2;
+        pf->avg[PIXEL_2x4]   = x264_pixel_avg_2x4_sse2;
+        pf->avg[PIXEL_2x2]   = x264_pixel_avg_2x2_sse2;
+
+        pf->weight    = mc_weight_wtab_sse2;
+        pf->offsetadd = mc_weight_wtab_sse2;
+        pf->offsetsub = mc_weight_wtab_sse2;
+
+        pf->hpel_filter = hpel_filter_sse2;
+    }
+
+    if( cpu&X264_CPU_AVX2 )
+        pf->hpel_filter = hpel_filter_avx2;
+}
+
+#endif // HAVE_X86_INTRIN && !HIGH_BIT_DEPTH
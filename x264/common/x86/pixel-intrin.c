@@ -0,0 +1,1313 @@
+/*****************************************************************************
+ * pixel-intrin.c: x86 pixel metrics with compiler intrinsics
+ *****************************************************************************
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *****************************************************************************/
+
+#include "common/common.h"
+#include "intrin.h"
+#include <immintrin.h>
+
+#if HAVE_X86_INTRIN && !HIGH_BIT_DEPTH
+
+/* Every function returns exactly what its C version in common/pixel.c does;
+ * tools/checkasm compares the two. */
+
+#define LOADU(p)  _mm_loadu_si128( (const __m128i*)(p) )
+#define LOADL(p)  _mm_loadl_epi64( (const __m128i*)(p) )
+
+/****************************************************************************
+ * helpers
+ ****************************************************************************/
+static ALWAYS_INLINE __m128i load_8x2( const pixel *p0, const pixel *p1 )
+{
+    return _mm_unpacklo_epi64( LOADL( p0 ), LOADL( p1 ) );
+}
+
+static ALWAYS_INLINE __m128i load_4x4( const pixel *p, intptr_t stride )
+{
+    return _mm_setr_epi32( M32( p ), M32( p+stride ), M32( p+2*stride ), M32( p+3*stride ) );
+}
+
+/* 8 pixels widened to 16 bits */
+static ALWAYS_INLINE __m128i load_8_epi16( const pixel *p )
+{
+    return _mm_unpacklo_epi8( LOADL( p ), _mm_setzero_si128() );
+}
+
+/* two rows of 4 pixels widened to 16 bits */
+static ALWAYS_INLINE __m128i load_4x2_epi16( const pixel *p0, const pixel *p1 )
+{
+    __m128i v = _mm_unpacklo_epi32( _mm_cvtsi32_si128( M32( p0 ) ), _mm_cvtsi32_si128( M32( p1 ) ) );
+    return _mm_unpacklo_epi8( v, _mm_setzero_si128() );
+}
+
+static ALWAYS_INLINE int hsum_sad( __m128i sum )
+{
+    return _mm_cvtsi128_si32( _mm_add_epi32( sum, _mm_srli_si128( sum, 8 ) ) );
+}
+
+static ALWAYS_INLINE int hsum_epi32( __m128i sum )
+{
+    sum = _mm_add_epi32( sum, _mm_shuffle_epi32( sum, _MM_SHUFFLE(1,0,3,2) ) );
+    sum = _mm_add_epi32( sum, _mm_shuffle_epi32( sum, _MM_SHUFFLE(2,3,0,1) ) );
+    return _mm_cvtsi128_si32( sum );
+}
+
+static ALWAYS_INLINE __m128i abs_epi16( __m128i x )
+{
+    return _mm_max_epi16( x, _mm_sub_epi16( _mm_setzero_si128(), x ) );
+}
+
+/* 2-point butterflies between neighbouring lanes: (a,b) -> (a+b,a-b) */
+static ALWAYS_INLINE __m128i hadamard_pairs( __m128i x )
+{
+    const __m128i odd = _mm_setr_epi16( 0, -1, 0, -1, 0, -1, 0, -1 );
+    __m128i swap = _mm_shufflehi_epi16( _mm_shufflelo_epi16( x, _MM_SHUFFLE(2,3,0,1) ), _MM_SHUFFLE(2,3,0,1) );
+    return _mm_add_epi16( swap, _mm_sub_epi16( _mm_xor_si128( x, odd ), odd ) );
+}
+
+/* butterflies between lane pairs two apart: (a,b,c,d) -> (a+c,b+d,a-c,b-d) */
+static ALWAYS_INLINE __m128i hadamard_quads( __m128i x )
+{
+    const __m128i high = _mm_setr_epi16( 0, 0, -1, -1, 0, 0, -1, -1 );
+    __m128i swap = _mm_shufflehi_epi16( _mm_shufflelo_epi16( x, _MM_SHUFFLE(1,0,3,2) ), _MM_SHUFFLE(1,0,3,2) );
+    return _mm_add_epi16( swap, _mm_sub_epi16( _mm_xor_si128( x, high ), high ) );
+}
+
+#define BUTTERFLY( a, b ) { __m128i t_ = a; a = _mm_add_epi16( t_, b ); b = _mm_sub_epi16( t_, b ); }
+
+/* |a+b| + |a-b| = 2*max(|a|,|b|): the last butterfly of a transform whose
+ * absolute values are summed can be replaced by a max.  Summed over all
+ * lanes, this returns the sum of |coefficients| of the missing stage. */
+static ALWAYS_INLINE __m128i absmax_quads( __m128i x )
+{
+    x = abs_epi16( x );
+    return _mm_max_epi16( x, _mm_shufflehi_epi16( _mm_shufflelo_epi16( x, _MM_SHUFFLE(1,0,3,2) ), _MM_SHUFFLE(1,0,3,2) ) );
+}
+
+static ALWAYS_INLINE __m128i absmax_halves( __m128i x )
+{
+    x = abs_epi16( x );
+    return _mm_max_epi16( x, _mm_shuffle_epi32( x, _MM_SHUFFLE(1,0,3,2) ) );
+}
+
+/****************************************************************************
+ * sad
+ ****************************************************************************/
+static ALWAYS_INLINE int sad_wxh( pixel *pix1, intptr_t i_pix1, pixel *pix2, intptr_t i_pix2, int w, int h )
+{
+    __m128i sum = _mm_setzero_si128();
+    if( w == 16 )
+        for( int y = 0; y < h; y++, pix1 += i_pix1, pix2 += i_pix2 )
+            sum = _mm_add_epi32( sum, _mm_sad_epu8( LOADU( pix1 ), LOADU( pix2 ) ) );
+    else if( w == 8 )
+        for( int y = 0; y < h; y += 2, pix1 += 2*i_pix1, pix2 += 2*i_pix2 )
+            sum = _mm_add_epi32( sum, _mm_sad_epu8( load_8x2( pix1, pix1+i_pix1 ), load_8x2( pix2, pix2+i_pix2 ) ) );
+    else
+        for( int y = 0; y < h; y += 4, pix1 += 4*i_pix1, pix2 += 4*i_pix2 )
+            sum = _mm_add_epi32( sum, _mm_sad_epu8( load_4x4( pix1, i_pix1 ), load_4x4( pix2, i_pix2 ) ) );
+    return hsum_sad( sum );
+}
+
+#define SAD_SSE2( w, h ) \
+static int x264_pixel_sad_##w##x##h##_sse2( pixel *pix1, intptr_t i_pix1, pixel *pix2, intptr_t i_pix2 )\
+{\
+    return sad_wxh( pix1, i_pix1, pix2, i_pix2, w, h );\
+}
+SAD_SSE2( 16, 16 )
+SAD_SSE2( 16, 8 )
+SAD_SSE2( 8, 16 )
+SAD_SSE2( 8, 8 )
+SAD_SSE2( 8, 4 )
+SAD_SSE2( 4, 16 )
+SAD_SSE2( 4, 8 )
+SAD_SSE2( 4, 4 )
+
+/* fenc is loaded once per row for all candidates */
+static ALWAYS_INLINE void sad_xn_wxh( int n, pixel *fenc, pixel *pix0, pixel *pix1, pixel *pix2, pixel *pix3,
+                                      intptr_t i_stride, int *scores, int w, int h )
+{
+    __m128i s0 = _mm_setzero_si128(), s1 = s0, s2 = s0, s3 = s0;
+    for( int y = 0; y < h; )
+    {
+        __m128i e, r0, r1, r2, r3 = _mm_setzero_si128();
+        intptr_t o = y*i_stride;
+        if( w == 16 )
+        {
+            e  = _mm_load_si128( (__m128i*)(fenc + y*FENC_STRIDE) );
+            r0 = LOADU( pix0+o );
+            r1 = LOADU( pix1+o );
+            r2 = LOADU( pix2+o );
+            if( n == 4 )
+                r3 = LOADU( pix3+o );
+            y++;
+        }
+        else if( w == 8 )
+        {
+            e  = load_8x2( fenc + y*FENC_STRIDE, fenc + (y+1)*FENC_STRIDE );
+            r0 = load_8x2( pix0+o, pix0+o+i_stride );
+            r1 = load_8x2( pix1+o, pix1+o+i_stride );
+            r2 = load_8x2( pix2+o, pix2+o+i_stride );
+            if( n == 4 )
+                r3 = load_8x2( pix3+o, pix3+o+i_stride );
+            y += 2;
+        }
+        else
+        {
+            e  = load_4x4( fenc + y*FENC_STRIDE, FENC_STRIDE );
+            r0 = load_4x4( pix0+o, i_stride );
+            r1 = load_4x4( pix1+o, i_stride );
+            r2 = load_4x4( pix2+o, i_stride );
+            if( n == 4 )
+                r3 = load_4x4( pix3+o, i_stride );
+            y += 4;
+        }
+        s0 = _mm_add_epi32( s0, _mm_sad_epu8( e, r0 ) );
+        s1 = _mm_add_epi32( s1, _mm_sad_epu8( e, r1 ) );
+        s2 = _mm_add_epi32( s2, _mm_sad_epu8( e, r2 ) );
+        if( n == 4 )
+            s3 = _mm_add_epi32( s3, _mm_sad_epu8( e, r3 ) );
+    }
+    scores[0] = hsum_sad( s0 );
+    scores[1] = hsum_sad( s1 );
+    scores[2] = hsum_sad( s2 );
+    if( n == 4 )
+        scores[3] = hsum_sad( s3 );
+}
+
+#define SAD_X_SSE2( w, h ) \
+static void x264_pixel_sad_x3_##w##x##h##_sse2( pixel *fenc, pixel *pix0, pixel *pix1, pixel *pix2,\
+                                                intptr_t i_stride, int scores[3] )\
+{\
+    sad_xn_wxh( 3, fenc, pix0, pix1, pix2, NULL, i_stride, scores, w, h );\
+}\
+static void x264_pixel_sad_x4_##w##x##h##_sse2( pixel *fenc, pixel *pix0, pixel *pix1, pixel *pix2, pixel *pix3,\
+                                                intptr_t i_stride, int scores[4] )\
+{\
+    sad_xn_wxh( 4, fenc, pix0, pix1, pix2, pix3, i_stride, scores, w, h );\
+}
+SAD_X_SSE2( 16, 16 )
+SAD_X_SSE2( 16, 8 )
+SAD_X_SSE2( 8, 16 )
+SAD_X_SSE2( 8, 8 )
+SAD_X_SSE2( 8, 4 )
+SAD_X_SSE2( 4, 8 )
+SAD_X_SSE2( 4, 4 )
+
+/****************************************************************************
+ * ssd
+ ****************************************************************************/
+static ALWAYS_INLINE __m128i ssd_epi16( __m128i a, __m128i b )
+{
+    __m128i d = _mm_sub_epi16( a, b );
+    return _mm_madd_epi16( d, d );
+}
+
+static ALWAYS_INLINE int ssd_wxh( pixel *pix1, intptr_t i_pix1, pixel *pix2, intptr_t i_pix2, int w, int h )
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sum = zero;
+    if( w == 16 )
+        for( int y = 0; y < h; y++, pix1 += i_pix1, pix2 += i_pix2 )
+        {
+            __m128i a = LOADU( pix1 );
+            __m128i b = LOADU( pix2 );
+            sum = _mm_add_epi32( sum, ssd_epi16( _mm_unpacklo_epi8( a, zero ), _mm_unpacklo_epi8( b, zero ) ) );
+            sum = _mm_add_epi32( sum, ssd_epi16( _mm_unpackhi_epi8( a, zero ), _mm_unpackhi_epi8( b, zero ) ) );
+        }
+    else if( w == 8 )
+        for( int y = 0; y < h; y++, pix1 += i_pix1, pix2 += i_pix2 )
+            sum = _mm_add_epi32( sum, ssd_epi16( load_8_epi16( pix1 ), load_8_epi16( pix2 ) ) );
+    else
+        for( int y = 0; y < h; y += 2, pix1 += 2*i_pix1, pix2 += 2*i_pix2 )
+            sum = _mm_add_epi32( sum, ssd_epi16( load_4x2_epi16( pix1, pix1+i_pix1 ), load_4x2_epi16( pix2, pix2+i_pix2 ) ) );
+    return hsum_epi32( sum );
+}
+
+#define SSD_SSE2( w, h ) \
+static int x264_pixel_ssd_##w##x##h##_sse2( pixel *pix1, intptr_t i_pix1, pixel *pix2, intptr_t i_pix2 )\
+{\
+    return ssd_wxh( pix1, i_pix1, pix2, i_pix2, w, h );\
+}
+SSD_SSE2( 16, 16 )
+SSD_SSE2( 16, 8 )
+SSD_SSE2( 8, 16 )
+SSD_SSE2( 8, 8 )
+SSD_SSE2( 8, 4 )
+SSD_SSE2( 4, 16 )
+SSD_SSE2( 4, 8 )
+SSD_SSE2( 4, 4 )
+
+static void pixel_ssd_nv12_core_sse2( pixel *pixuv1, intptr_t stride1, pixel *pixuv2, intptr_t stride2,
+                                      int width, int height, uint64_t *ssd_u, uint64_t *ssd_v )
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i mask_u = _mm_setr_epi16( -1, 0, -1, 0, -1, 0, -1, 0 );
+    __m128i sum_u = zero, sum_v = zero; /* 64-bit lanes */
+    for( int y = 0; y < height; y++, pixuv1 += stride1, pixuv2 += stride2 )
+    {
+        __m128i row_u = zero, row_v = zero;
+        for( int x = 0; x < 2*width; x += 16 )
+        {
+            __m128i a = LOADU( pixuv1+x );
+            __m128i b = LOADU( pixuv2+x );
+            __m128i d0 = _mm_sub_epi16( _mm_unpacklo_epi8( a, zero ), _mm_unpacklo_epi8( b, zero ) );
+            __m128i d1 = _mm_sub_epi16( _mm_unpackhi_epi8( a, zero ), _mm_unpackhi_epi8( b, zero ) );
+            row_u = _mm_add_epi32( row_u, _mm_madd_epi16( d0, _mm_and_si128( d0, mask_u ) ) );
+            row_u = _mm_add_epi32( row_u, _mm_madd_epi16( d1, _mm_and_si128( d1, mask_u ) ) );
+            row_v = _mm_add_epi32( row_v, _mm_madd_epi16( d0, _mm_andnot_si128( mask_u, d0 ) ) );
+            row_v = _mm_add_epi32( row_v, _mm_madd_epi16( d1, _mm_andnot_si128( mask_u, d1 ) ) );
+        }
+        sum_u = _mm_add_epi64( sum_u, _mm_add_epi64( _mm_unpacklo_epi32( row_u, zero ), _mm_unpackhi_epi32( row_u, zero ) ) );
+        sum_v = _mm_add_epi64( sum_v, _mm_add_epi64( _mm_unpacklo_epi32( row_v, zero ), _mm_unpackhi_epi32( row_v, zero ) ) );
+    }
+    sum_u = _mm_add_epi64( sum_u, _mm_srli_si128( sum_u, 8 ) );
+    sum_v = _mm_add_epi64( sum_v, _mm_srli_si128( sum_v, 8 ) );
+    *ssd_u = _mm_cvtsi128_si64( sum_u );
+    *ssd_v = _mm_cvtsi128_si64( sum_v );
+}
+
+/****************************************************************************
+ * satd
+ ****************************************************************************/
+/* Two side by side 4x4 blocks of differences, one row per register.
+ * Returns 16-bit lanes that sum to twice their satd. */
+static ALWAYS_INLINE __m128i satd_8x4_core( __m128i d0, __m128i d1, __m128i d2, __m128i d3 )
+{
+    BUTTERFLY( d0, d1 );
+    BUTTERFLY( d2, d3 );
+    BUTTERFLY( d0, d2 );
+    BUTTERFLY( d1, d3 );
+    d0 = absmax_quads( hadamard_pairs( d0 ) );
+    d1 = absmax_quads( hadamard_pairs( d1 ) );
+    d2 = absmax_quads( hadamard_pairs( d2 ) );
+    d3 = absmax_quads( hadamard_pairs( d3 ) );
+    return _mm_add_epi16( _mm_add_epi16( d0, d1 ), _mm_add_epi16( d2, d3 ) );
+}
+
+static ALWAYS_INLINE __m128i satd_8x4( pixel *pix1, intptr_t i_pix1, pixel *pix2, intptr_t i_pix2 )
+{
+    __m128i d0 = _mm_sub_epi16( load_8_epi16( pix1+0*i_pix1 ), load_8_epi16( pix2+0*i_pix2 ) );
+    __m128i d1 = _mm_sub_epi16( load_8_epi16( pix1+1*i_pix1 ), load_8_epi16( pix2+1*i_pix2 ) );
+    __m128i d2 = _mm_sub_epi16( load_8_epi16( pix1+2*i_pix1 ), load_8_epi16( pix2+2*i_pix2 ) );
+    __m128i d3 = _mm_sub_epi16( load_8_epi16( pix1+3*i_pix1 ), load_8_epi16( pix2+3*i_pix2 ) );
+    return _mm_madd_epi16( satd_8x4_core( d0, d1, d2, d3 ), _mm_set1_epi16( 1 ) );
+}
+
+/* The 4x4 blocks at pix and pix+4*stride, side by side */
+static ALWAYS_INLINE __m128i satd_4x8( pixel *pix1, intptr_t i_pix1, pixel *pix2, intptr_t i_pix2 )
+{
+    __m128i d[4];
+    for( int i = 0; i < 4; i++ )
+        d[i] = _mm_sub_epi16( load_4x2_epi16( pix1+i*i_pix1, pix1+(i+4)*i_pix1 ),
+                              load_4x2_epi16( pix2+i*i_pix2, pix2+(i+4)*i_pix2 ) );
+    return _mm_madd_epi16( satd_8x4_core( d[0], d[1], d[2], d[3] ), _mm_set1_epi16( 1 ) );
+}
+
+static int x264_pixel_satd_4x4_sse2( pixel *pix1, intptr_t i_pix1, pixel *pix2, intptr_t i_pix2 )
+{
+    __m128i d[4];
+    for( int i = 0; i < 4; i++ )
+        d[i] = _mm_sub_epi16( _mm_unpacklo_epi8( _mm_cvtsi32_si128( M32( pix1+i*i_pix1 ) ), _mm_setzero_si128() ),
+                              _mm_unpacklo_epi8( _mm_cvtsi32_si128( M32( pix2+i*i_pix2 ) ), _mm_setzero_si128() ) );
+    return hsum_epi32( _mm_madd_epi16( satd_8x4_core( d[0], d[1], d[2], d[3] ), _mm_set1_epi16( 1 ) ) ) >> 1;
+}
+
+static ALWAYS_INLINE int satd_wxh( pixel *pix1, intptr_t i_pix1, pixel *pix2, intptr_t i_pix2, int w, int h )
+{
+    __m128i sum = _mm_setzero_si128();
+    for( int y = 0; y < h; y += (w == 4 ? 8 : 4) )
+        for( int x = 0; x < w; x += 8 )
+        {
+            pixel *p1 = pix1 + y*i_pix1 + x;
+            pixel *p2 = pix2 + y*i_pix2 + x;
+            sum = _mm_add_epi32( sum, w == 4 ? satd_4x8( p1, i_pix1, p2, i_pix2 ) : satd_8x4( p1, i_pix1, p2, i_pix2 ) );
+        }
+    return hsum_epi32( sum ) >> 1;
+}
+
+#define SATD_SSE2( w, h ) \
+static int x264_pixel_satd_##w##x##h##_sse2( pixel *pix1, intptr_t i_pix1, pixel *pix2, intptr_t i_pix2 )\
+{\
+    return satd_wxh( pix1, i_pix1, pix2, i_pix2, w, h );\
+}
+SATD_SSE2( 16, 16 )
+SATD_SSE2( 16, 8 )
+SATD_SSE2( 8, 16 )
+SATD_SSE2( 8, 8 )
+SATD_SSE2( 8, 4 )
+SATD_SSE2( 4, 16 )
+SATD_SSE2( 4, 8 )
+
+#define SATD_X( size, cpu ) \
+static void x264_pixel_satd_x3_##size##cpu( pixel *fenc, pixel *pix0, pixel *pix1, pixel *pix2,\
+                                            intptr_t i_stride, int scores[3] )\
+{\
+    scores[0] = x264_pixel_satd_##size##cpu( fenc, FENC_STRIDE, pix0, i_stride );\
+    scores[1] = x264_pixel_satd_##size##cpu( fenc, FENC_STRIDE, pix1, i_stride );\
+    scores[2] = x264_pixel_satd_##size##cpu( fenc, FENC_STRIDE, pix2, i_stride );\
+}\
+static void x264_pixel_satd_x4_##size##cpu( pixel *fenc, pixel *pix0, pixel *pix1, pixel *pix2, pixel *pix3,\
+                                            intptr_t i_stride, int scores[4] )\
+{\
+    scores[0] = x264_pixel_satd_##size##cpu( fenc, FENC_STRIDE, pix0, i_stride );\
+    scores[1] = x264_pixel_satd_##size##cpu( fenc, FENC_STRIDE, pix1, i_stride );\
+    scores[2] = x264_pixel_satd_##size##cpu( fenc, FENC_STRIDE, pix2, i_stride );\
+    scores[3] = x264_pixel_satd_##size##cpu( fenc, FENC_STRIDE, pix3, i_stride );\
+}
+SATD_X( 16x16, _sse2 )
+SATD_X( 16x8, _sse2 )
+SATD_X( 8x16, _sse2 )
+SATD_X( 8x8, _sse2 )
+SATD_X( 8x4, _sse2 )
+SATD_X( 4x8, _sse2 )
+SATD_X( 4x4, _sse2 )
+
+/****************************************************************************
+ * sa8d
+ ****************************************************************************/
+/* 8x8 Hadamard of eight rows of differences; returns 32-bit lanes summing
+ * to the sum of |coefficients| */
+static ALWAYS_INLINE __m128i sa8d_8x8_core( __m128i d0, __m128i d1, __m128i d2, __m128i d3,
+                                            __m128i d4, __m128i d5, __m128i d6, __m128i d7 )
+{
+    const __m128i one = _mm_set1_epi16( 1 );
+    BUTTERFLY( d0, d1 ); BUTTERFLY( d2, d3 ); BUTTERFLY( d4, d5 ); BUTTERFLY( d6, d7 );
+    BUTTERFLY( d0, d2 ); BUTTERFLY( d1, d3 ); BUTTERFLY( d4, d6 ); BUTTERFLY( d5, d7 );
+    BUTTERFLY( d0, d4 ); BUTTERFLY( d1, d5 ); BUTTERFLY( d2, d6 ); BUTTERFLY( d3, d7 );
+#define SA8D_ROW( d ) absmax_halves( hadamard_quads( hadamard_pairs( d ) ) )
+    __m128i s0 = _mm_madd_epi16( _mm_add_epi16( SA8D_ROW( d0 ), SA8D_ROW( d1 ) ), one );
+    __m128i s1 = _mm_madd_epi16( _mm_add_epi16( SA8D_ROW( d2 ), SA8D_ROW( d3 ) ), one );
+    __m128i s2 = _mm_madd_epi16( _mm_add_epi16( SA8D_ROW( d4 ), SA8D_ROW( d5 ) ), one );
+    __m128i s3 = _mm_madd_epi16( _mm_add_epi16( SA8D_ROW( d6 ), SA8D_ROW( d7 ) ), one );
+#undef SA8D_ROW
+    return _mm_add_epi32( _mm_add_epi32( s0, s1 ), _mm_add_epi32( s2, s3 ) );
+}
+
+static ALWAYS_INLINE __m128i sa8d_8x8( pixel *pix1, intptr_t i_pix1, pixel *pix2, intptr_t i_pix2 )
+{
+    __m128i d[8];
+    for( int i = 0; i < 8; i++ )
+        d[i] = _mm_sub_epi16( load_8_epi16( pix1+i*i_pix1 ), load_8_epi16( pix2+i*i_pix2 ) );
+    return sa8d_8x8_core( d[0], d[1], d[2], d[3], d[4], d[5], d[6], d[7] );
+}
+
+static int x264_pixel_sa8d_8x8_sse2( pixel *pix1, intptr_t i_pix1, pixel *pix2, intptr_t i_pix2 )
+{
+    return (hsum_epi32( sa8d_8x8( pix1, i_pix1, pix2, i_pix2 ) ) + 2) >> 2;
+}
+
+static int x264_pixel_sa8d_16x16_sse2( pixel *pix1, intptr_t i_pix1, pixel *pix2, intptr_t i_pix2 )
+{
+    __m128i sum = _mm_add_epi32( sa8d_8x8( pix1, i_pix1, pix2, i_pix2 ),
+                                 sa8d_8x8( pix1+8, i_pix1, pix2+8, i_pix2 ) );
+    sum = _mm_add_epi32( sum, sa8d_8x8( pix1+8*i_pix1, i_pix1, pix2+8*i_pix2, i_pix2 ) );
+    sum = _mm_add_epi32( sum, sa8d_8x8( pix1+8+8*i_pix1, i_pix1, pix2+8+8*i_pix2, i_pix2 ) );
+    return (hsum_epi32( sum ) + 2) >> 2;
+}
+
+/****************************************************************************
+ * intra_x3
+ ****************************************************************************/
+/* The V, H and DC predictions are constant down columns, along rows and over
+ * whole blocks, so their Hadamard transforms only have coefficients in the
+ * first row, the first column and the corner respectively.  The satd and
+ * sa8d versions transform fenc once and subtract the three predictions in
+ * the transform domain; all versions build the predictions from the edge in
+ * registers and leave fdec as it was. */
+
+static ALWAYS_INLINE void butterfly_4( __m128i d[4] )
+{
+    BUTTERFLY( d[0], d[1] );
+    BUTTERFLY( d[2], d[3] );
+    BUTTERFLY( d[0], d[2] );
+    BUTTERFLY( d[1], d[3] );
+}
+
+static ALWAYS_INLINE void butterfly_8( __m128i d[8] )
+{
+    BUTTERFLY( d[0], d[1] ); BUTTERFLY( d[2], d[3] ); BUTTERFLY( d[4], d[5] ); BUTTERFLY( d[6], d[7] );
+    BUTTERFLY( d[0], d[2] ); BUTTERFLY( d[1], d[3] ); BUTTERFLY( d[4], d[6] ); BUTTERFLY( d[5], d[7] );
+    BUTTERFLY( d[0], d[4] ); BUTTERFLY( d[1], d[5] ); BUTTERFLY( d[2], d[6] ); BUTTERFLY( d[3], d[7] );
+}
+
+/* butterflies between the two halves: (a,b) -> (a+b,a-b) */
+static ALWAYS_INLINE __m128i hadamard_halves( __m128i x )
+{
+    const __m128i high = _mm_setr_epi16( 0, 0, 0, 0, -1, -1, -1, -1 );
+    __m128i swap = _mm_shuffle_epi32( x, _MM_SHUFFLE(1,0,3,2) );
+    return _mm_add_epi16( swap, _mm_sub_epi16( _mm_xor_si128( x, high ), high ) );
+}
+
+/* Coefficients of the H prediction of a row of 4x4 blocks: 4*l in lanes 0
+ * and 4 of each row, then the vertical transform */
+static ALWAYS_INLINE void intra_h_coefs_4( pixel *fdec, __m128i ph[4] )
+{
+    const __m128i mask = _mm_setr_epi16( -1, 0, 0, 0, -1, 0, 0, 0 );
+    for( int i = 0; i < 4; i++ )
+        ph[i] = _mm_and_si128( _mm_set1_epi16( fdec[i*FDEC_STRIDE-1] << 2 ), mask );
+    butterfly_4( ph );
+}
+
+/* Adds twice the V, H and DC satds of the two 4x4 blocks at fenc to sum[0..2].
+ * pv is the only nonzero coefficient row of V, pdc the DC coefficients. */
+static ALWAYS_INLINE void intra_satd_x3_8x4( pixel *fenc, __m128i pv, __m128i ph[4], __m128i pdc, __m128i sum[3] )
+{
+    const __m128i one = _mm_set1_epi16( 1 );
+    __m128i f[4];
+    for( int i = 0; i < 4; i++ )
+        f[i] = load_8_epi16( fenc + i*FENC_STRIDE );
+    butterfly_4( f );
+    for( int i = 0; i < 4; i++ )
+        f[i] = hadamard_quads( hadamard_pairs( f[i] ) );
+
+    __m128i ac = _mm_add_epi16( _mm_add_epi16( abs_epi16( f[1] ), abs_epi16( f[2] ) ), abs_epi16( f[3] ) );
+    __m128i v  = _mm_add_epi16( ac, abs_epi16( _mm_sub_epi16( f[0], pv ) ) );
+    __m128i dc = _mm_add_epi16( ac, abs_epi16( _mm_sub_epi16( f[0], pdc ) ) );
+    __m128i h  = _mm_add_epi16( _mm_add_epi16( abs_epi16( _mm_sub_epi16( f[0], ph[0] ) ), abs_epi16( _mm_sub_epi16( f[1], ph[1] ) ) ),
+                                _mm_add_epi16( abs_epi16( _mm_sub_epi16( f[2], ph[2] ) ), abs_epi16( _mm_sub_epi16( f[3], ph[3] ) ) ) );
+    sum[0] = _mm_add_epi32( sum[0], _mm_madd_epi16( v, one ) );
+    sum[1] = _mm_add_epi32( sum[1], _mm_madd_epi16( h, one ) );
+    sum[2] = _mm_add_epi32( sum[2], _mm_madd_epi16( dc, one ) );
+}
+
+static ALWAYS_INLINE __m128i intra_v_coefs_4( pixel *top )
+{
+    return hadamard_quads( hadamard_pairs( _mm_slli_epi16( load_8_epi16( top ), 2 ) ) );
+}
+
+static void x264_intra_satd_x3_16x16_sse2( pixel *fenc, pixel *fdec, int res[3] )
+{
+    __m128i ph[4], sum[3] = { _mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128() };
+    __m128i pv0 = intra_v_coefs_4( fdec - FDEC_STRIDE );
+    __m128i pv1 = intra_v_coefs_4( fdec - FDEC_STRIDE + 8 );
+    int dc = 16;
+    for( int i = 0; i < 16; i++ )
+        dc += fdec[-1+i*FDEC_STRIDE] + fdec[i-FDEC_STRIDE];
+    dc = (dc >> 5) << 4;
+    __m128i pdc = _mm_setr_epi16( dc, 0, 0, 0, dc, 0, 0, 0 );
+
+    for( int y = 0; y < 16; y += 4 )
+    {
+        intra_h_coefs_4( fdec + y*FDEC_STRIDE, ph );
+        intra_satd_x3_8x4( fenc + y*FENC_STRIDE,     pv0, ph, pdc, sum );
+        intra_satd_x3_8x4( fenc + y*FENC_STRIDE + 8, pv1, ph, pdc, sum );
+    }
+    res[0] = hsum_epi32( sum[0] ) >> 1;
+    res[1] = hsum_epi32( sum[1] ) >> 1;
+    res[2] = hsum_epi32( sum[2] ) >> 1;
+}
+
+/* The left and right DC of each row of 4x4 chroma blocks, as in
+ * x264_predict_8x8c_dc_c and x264_predict_8x16c_dc_c */
+static ALWAYS_INLINE void intra_chroma_dc( pixel *fdec, int dc[4][2], int h )
+{
+    int s0 = 0, s1 = 0;
+    for( int i = 0; i < 4; i++ )
+    {
+        s0 += fdec[i-FDEC_STRIDE];
+        s1 += fdec[i+4-FDEC_STRIDE];
+    }
+    for( int y = 0; y < h; y += 4 )
+    {
+        int s = 0;
+        for( int i = 0; i < 4; i++ )
+            s += fdec[-1+(y+i)*FDEC_STRIDE];
+        dc[y>>2][0] = y ? (s + 2) >> 2 : (s0 + s + 4) >> 3;
+        dc[y>>2][1] = y ? (s1 + s + 4) >> 3 : (s1 + 2) >> 2;
+    }
+}
+
+static ALWAYS_INLINE void intra_satd_x3_8xh( pixel *fenc, pixel *fdec, int res[3], int h )
+{
+    int dc[4][2];
+    __m128i ph[4], sum[3] = { _mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128() };
+    __m128i pv = intra_v_coefs_4( fdec - FDEC_STRIDE );
+    intra_chroma_dc( fdec, dc, h );
+    for( int y = 0; y < h; y += 4 )
+    {
+        __m128i pdc = _mm_setr_epi16( dc[y>>2][0] << 4, 0, 0, 0, dc[y>>2][1] << 4, 0, 0, 0 );
+        intra_h_coefs_4( fdec + y*FDEC_STRIDE, ph );
+        intra_satd_x3_8x4( fenc + y*FENC_STRIDE, pv, ph, pdc, sum );
+    }
+    res[0] = hsum_epi32( sum[2] ) >> 1;
+    res[1] = hsum_epi32( sum[1] ) >> 1;
+    res[2] = hsum_epi32( sum[0] ) >> 1;
+}
+
+static void x264_intra_satd_x3_8x8c_sse2( pixel *fenc, pixel *fdec, int res[3] )
+{
+    intra_satd_x3_8xh( fenc, fdec, res, 8 );
+}
+
+static void x264_intra_satd_x3_8x16c_sse2( pixel *fenc, pixel *fdec, int res[3] )
+{
+    intra_satd_x3_8xh( fenc, fdec, res, 16 );
+}
+
+/* A single block gains little from the transform domain: V and H are
+ * scored side by side in one transform, DC in half of another */
+static void x264_intra_satd_x3_4x4_sse2( pixel *fenc, pixel *fdec, int res[3] )
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi16( 1 );
+    __m128i top = _mm_unpacklo_epi8( _mm_cvtsi32_si128( M32( fdec - FDEC_STRIDE ) ), zero );
+    int dc = 4;
+    for( int i = 0; i < 4; i++ )
+        dc += fdec[-1+i*FDEC_STRIDE] + fdec[i-FDEC_STRIDE];
+    __m128i pdc = _mm_set1_epi16( dc >> 3 );
+    __m128i d[4], e[4];
+    for( int i = 0; i < 4; i++ )
+    {
+        __m128i f = _mm_unpacklo_epi8( _mm_set1_epi32( M32( fenc + i*FENC_STRIDE ) ), zero );
+        d[i] = _mm_sub_epi16( f, _mm_unpacklo_epi64( top, _mm_set1_epi16( fdec[-1+i*FDEC_STRIDE] ) ) );
+        e[i] = _mm_unpacklo_epi64( _mm_sub_epi16( f, pdc ), zero );
+    }
+    __m128i vh = _mm_madd_epi16( satd_8x4_core( d[0], d[1], d[2], d[3] ), one );
+    vh = _mm_add_epi32( vh, _mm_shuffle_epi32( vh, _MM_SHUFFLE(2,3,0,1) ) );
+    res[0] = _mm_cvtsi128_si32( vh ) >> 1;
+    res[1] = _mm_cvtsi128_si32( _mm_srli_si128( vh, 8 ) ) >> 1;
+    res[2] = hsum_epi32( _mm_madd_epi16( satd_8x4_core( e[0], e[1], e[2], e[3] ), one ) ) >> 1;
+}
+
+/* Every |coefficient| of an 8x8 transform of pixels is below 2^14, so two
+ * of them can be summed in 16 bits */
+static void x264_intra_sa8d_x3_8x8_sse2( pixel *fenc, pixel edge[36], int res[3] )
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi16( 1 );
+    __m128i f[8], ph[8];
+    for( int i = 0; i < 8; i++ )
+    {
+        f[i] = load_8_epi16( fenc + i*FENC_STRIDE );
+        ph[i] = _mm_cvtsi32_si128( edge[14-i] << 3 );
+    }
+    butterfly_8( f );
+    butterfly_8( ph );
+    for( int i = 0; i < 8; i++ )
+        f[i] = hadamard_halves( hadamard_quads( hadamard_pairs( f[i] ) ) );
+
+    __m128i top = LOADL( edge+16 );
+    __m128i pv = hadamard_halves( hadamard_quads( hadamard_pairs( _mm_slli_epi16( _mm_unpacklo_epi8( top, zero ), 3 ) ) ) );
+    int dc = (hsum_sad( _mm_sad_epu8( _mm_unpacklo_epi64( LOADL( edge+7 ), top ), zero ) ) + 8) >> 4;
+    __m128i pdc = _mm_cvtsi32_si128( dc << 6 );
+
+    __m128i ac = _mm_madd_epi16( abs_epi16( f[7] ), one );
+    __m128i h  = _mm_madd_epi16( _mm_add_epi16( abs_epi16( _mm_sub_epi16( f[0], ph[0] ) ), abs_epi16( _mm_sub_epi16( f[1], ph[1] ) ) ), one );
+    for( int i = 1; i < 7; i += 2 )
+        ac = _mm_add_epi32( ac, _mm_madd_epi16( _mm_add_epi16( abs_epi16( f[i] ), abs_epi16( f[i+1] ) ), one ) );
+    for( int i = 2; i < 8; i += 2 )
+        h = _mm_add_epi32( h, _mm_madd_epi16( _mm_add_epi16( abs_epi16( _mm_sub_epi16( f[i], ph[i] ) ),
+                                                             abs_epi16( _mm_sub_epi16( f[i+1], ph[i+1] ) ) ), one ) );
+    __m128i v  = _mm_add_epi32( ac, _mm_madd_epi16( abs_epi16( _mm_sub_epi16( f[0], pv ) ), one ) );
+    __m128i dcs = _mm_add_epi32( ac, _mm_madd_epi16( abs_epi16( _mm_sub_epi16( f[0], pdc ) ), one ) );
+    res[0] = (hsum_epi32( v ) + 2) >> 2;
+    res[1] = (hsum_epi32( h ) + 2) >> 2;
+    res[2] = (hsum_epi32( dcs ) + 2) >> 2;
+}
+
+static void x264_intra_sad_x3_16x16_sse2( pixel *fenc, pixel *fdec, int res[3] )
+{
+    __m128i pv = LOADU( fdec - FDEC_STRIDE );
+    __m128i sv = _mm_setzero_si128(), sh = _mm_setzero_si128(), sdc = _mm_setzero_si128();
+    int dc = 16;
+    for( int i = 0; i < 16; i++ )
+        dc += fdec[-1+i*FDEC_STRIDE] + fdec[i-FDEC_STRIDE];
+    __m128i pdc = _mm_set1_epi8( dc >> 5 );
+    for( int y = 0; y < 16; y++ )
+    {
+        __m128i f = LOADU( fenc + y*FENC_STRIDE );
+        sv  = _mm_add_epi32( sv,  _mm_sad_epu8( f, pv ) );
+        sh  = _mm_add_epi32( sh,  _mm_sad_epu8( f, _mm_set1_epi8( fdec[-1+y*FDEC_STRIDE] ) ) );
+        sdc = _mm_add_epi32( sdc, _mm_sad_epu8( f, pdc ) );
+    }
+    res[0] = hsum_sad( sv );
+    res[1] = hsum_sad( sh );
+    res[2] = hsum_sad( sdc );
+}
+
+static ALWAYS_INLINE void intra_sad_x3_8xh( pixel *fenc, pixel *fdec, int res[3], int h )
+{
+    int dc[4][2];
+    __m128i pv = LOADL( fdec - FDEC_STRIDE );
+    __m128i sv = _mm_setzero_si128(), sh = _mm_setzero_si128(), sdc = _mm_setzero_si128();
+    pv = _mm_unpacklo_epi64( pv, pv );
+    intra_chroma_dc( fdec, dc, h );
+    for( int y = 0; y < h; y += 2 )
+    {
+        uint32_t dc0 = PIXEL_SPLAT_X4( dc[y>>2][0] );
+        uint32_t dc1 = PIXEL_SPLAT_X4( dc[y>>2][1] );
+        __m128i f = load_8x2( fenc + y*FENC_STRIDE, fenc + (y+1)*FENC_STRIDE );
+        __m128i ph = _mm_unpacklo_epi64( _mm_set1_epi8( fdec[-1+y*FDEC_STRIDE] ), _mm_set1_epi8( fdec[-1+(y+1)*FDEC_STRIDE] ) );
+        sv  = _mm_add_epi32( sv,  _mm_sad_epu8( f, pv ) );
+        sh  = _mm_add_epi32( sh,  _mm_sad_epu8( f, ph ) );
+        sdc = _mm_add_epi32( sdc, _mm_sad_epu8( f, _mm_set_epi32( dc1, dc0, dc1, dc0 ) ) );
+    }
+    res[0] = hsum_sad( sdc );
+    res[1] = hsum_sad( sh );
+    res[2] = hsum_sad( sv );
+}
+
+static void x264_intra_sad_x3_8x8c_sse2( pixel *fenc, pixel *fdec, int res[3] )
+{
+    intra_sad_x3_8xh( fenc, fdec, res, 8 );
+}
+
+static void x264_intra_sad_x3_8x16c_sse2( pixel *fenc, pixel *fdec, int res[3] )
+{
+    intra_sad_x3_8xh( fenc, fdec, res, 16 );
+}
+
+static void x264_intra_sad_x3_4x4_sse2( pixel *fenc, pixel *fdec, int res[3] )
+{
+    __m128i f = load_4x4( fenc, FENC_STRIDE );
+    __m128i pv = _mm_set1_epi32( M32( fdec - FDEC_STRIDE ) );
+    __m128i ph = _mm_setr_epi32( PIXEL_SPLAT_X4( fdec[-1] ), PIXEL_SPLAT_X4( fdec[-1+FDEC_STRIDE] ),
+                                 PIXEL_SPLAT_X4( fdec[-1+2*FDEC_STRIDE] ), PIXEL_SPLAT_X4( fdec[-1+3*FDEC_STRIDE] ) );
+    int dc = 4;
+    for( int i = 0; i < 4; i++ )
+        dc += fdec[-1+i*FDEC_STRIDE] + fdec[i-FDEC_STRIDE];
+    res[0] = hsum_sad( _mm_sad_epu8( f, pv ) );
+    res[1] = hsum_sad( _mm_sad_epu8( f, ph ) );
+    res[2] = hsum_sad( _mm_sad_epu8( f, _mm_set1_epi8( dc >> 3 ) ) );
+}
+
+static void x264_intra_sad_x3_8x8_sse2( pixel *fenc, pixel edge[36], int res[3] )
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i top = LOADL( edge+16 );
+    __m128i pv = _mm_unpacklo_epi64( top, top );
+    int dc = (hsum_sad( _mm_sad_epu8( _mm_unpacklo_epi64( LOADL( edge+7 ), top ), zero ) ) + 8) >> 4;
+    __m128i pdc = _mm_set1_epi8( dc );
+    __m128i sv = zero, sh = zero, sdc = zero;
+    for( int y = 0; y < 8; y += 2 )
+    {
+        __m128i f = load_8x2( fenc + y*FENC_STRIDE, fenc + (y+1)*FENC_STRIDE );
+        __m128i ph = _mm_unpacklo_epi64( _mm_set1_epi8( edge[14-y] ), _mm_set1_epi8( edge[13-y] ) );
+        sv  = _mm_add_epi32( sv,  _mm_sad_epu8( f, pv ) );
+        sh  = _mm_add_epi32( sh,  _mm_sad_epu8( f, ph ) );
+        sdc = _mm_add_epi32( sdc, _mm_sad_epu8( f, pdc ) );
+    }
+    res[0] = hsum_sad( sv );
+    res[1] = hsum_sad( sh );
+    res[2] = hsum_sad( sdc );
+}
+
+/****************************************************************************
+ * hadamard_ac
+ ****************************************************************************/
+/* Sum of |4x4| (low 32 bits) and |8x8| (high 32 bits) Hadamard AC
+ * coefficients of an 8x8 block */
+static ALWAYS_INLINE uint64_t hadamard_ac_8x8( pixel *pix, intptr_t stride )
+{
+    const __m128i one = _mm_set1_epi16( 1 );
+    __m128i d[8];
+    for( int i = 0; i < 8; i++ )
+        d[i] = load_8_epi16( pix+i*stride );
+    BUTTERFLY( d[0], d[1] ); BUTTERFLY( d[2], d[3] ); BUTTERFLY( d[4], d[5] ); BUTTERFLY( d[6], d[7] );
+    BUTTERFLY( d[0], d[2] ); BUTTERFLY( d[1], d[3] ); BUTTERFLY( d[4], d[6] ); BUTTERFLY( d[5], d[7] );
+    for( int i = 0; i < 8; i++ )
+        d[i] = hadamard_quads( hadamard_pairs( d[i] ) );
+
+    /* the four 4x4 DCs (lanes 0 and 4 of rows 0 and 4) add up to the 8x8 DC */
+    int dc = _mm_extract_epi16( d[0], 0 ) + _mm_extract_epi16( d[0], 4 )
+           + _mm_extract_epi16( d[4], 0 ) + _mm_extract_epi16( d[4], 4 );
+
+    __m128i sum4 = _mm_setzero_si128();
+    for( int i = 0; i < 8; i++ )
+        sum4 = _mm_add_epi32( sum4, _mm_madd_epi16( abs_epi16( d[i] ), one ) );
+
+    __m128i sum8 = _mm_setzero_si128();
+    for( int i = 0; i < 4; i++ )
+    {
+        BUTTERFLY( d[i], d[i+4] );
+        sum8 = _mm_add_epi32( sum8, _mm_madd_epi16( _mm_add_epi16( absmax_halves( d[i] ), absmax_halves( d[i+4] ) ), one ) );
+    }
+    uint32_t s4 = hsum_epi32( sum4 ) - dc;
+    uint32_t s8 = hsum_epi32( sum8 ) - dc;
+    return ((uint64_t)s8 << 32) + s4;
+}
+
+#define HADAMARD_AC_SSE2( w, h ) \
+static uint64_t x264_pixel_hadamard_ac_##w##x##h##_sse2( pixel *pix, intptr_t stride )\
+{\
+    uint64_t sum = hadamard_ac_8x8( pix, stride );\
+    if( w == 16 )\
+        sum += hadamard_ac_8x8( pix+8, stride );\
+    if( h == 16 )\
+        sum += hadamard_ac_8x8( pix+8*stride, stride );\
+    if( w == 16 && h == 16 )\
+        sum += hadamard_ac_8x8( pix+8*stride+8, stride );\
+    return ((sum>>34)<<32) + ((uint32_t)sum>>1);\
+}
+HADAMARD_AC_SSE2( 16, 16 )
+HADAMARD_AC_SSE2( 16, 8 )
+HADAMARD_AC_SSE2( 8, 16 )
+HADAMARD_AC_SSE2( 8, 8 )
+
+/****************************************************************************
+ * var, var2
+ ****************************************************************************/
+static ALWAYS_INLINE uint64_t var_wxh( pixel *pix, intptr_t i_stride, int w, int h )
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sum = zero, sqr = zero;
+    for( int y = 0; y < h; y += (w == 16 ? 1 : 2), pix += (w == 16 ? 1 : 2)*i_stride )
+    {
+        __m128i p = w == 16 ? LOADU( pix ) : load_8x2( pix, pix+i_stride );
+        __m128i lo = _mm_unpacklo_epi8( p, zero );
+        __m128i hi = _mm_unpackhi_epi8( p, zero );
+        sum = _mm_add_epi32( sum, _mm_sad_epu8( p, zero ) );
+        sqr = _mm_add_epi32( sqr, _mm_add_epi32( _mm_madd_epi16( lo, lo ), _mm_madd_epi16( hi, hi ) ) );
+    }
+    return (uint32_t)hsum_sad( sum ) + ((uint64_t)(uint32_t)hsum_epi32( sqr ) << 32);
+}
+
+static uint64_t x264_pixel_var_16x16_sse2( pixel *pix, intptr_t i_stride ) { return var_wxh( pix, i_stride, 16, 16 ); }
+static uint64_t x264_pixel_var_8x16_sse2( pixel *pix, intptr_t i_stride )  { return var_wxh( pix, i_stride, 8, 16 ); }
+static uint64_t x264_pixel_var_8x8_sse2( pixel *pix, intptr_t i_stride )   { return var_wxh( pix, i_stride, 8, 8 ); }
+
+static ALWAYS_INLINE int var2_8xh( pixel *pix1, intptr_t i_stride1, pixel *pix2, intptr_t i_stride2, int *ssd, int h, int shift )
+{
+    __m128i sum = _mm_setzero_si128(), sqr = sum;
+    for( int y = 0; y < h; y++, pix1 += i_stride1, pix2 += i_stride2 )
+    {
+        __m128i d = _mm_sub_epi16( load_8_epi16( pix1 ), load_8_epi16( pix2 ) );
+        sum = _mm_add_epi16( sum, d );
+        sqr = _mm_add_epi32( sqr, _mm_madd_epi16( d, d ) );
+    }
+    uint32_t s = abs( hsum_epi32( _mm_madd_epi16( sum, _mm_set1_epi16( 1 ) ) ) );
+    uint32_t q = hsum_epi32( sqr );
+    *ssd = q;
+    return q - ((uint64_t)s * s >> shift);
+}
+
+static int x264_pixel_var2_8x16_sse2( pixel *pix1, intptr_t i_stride1, pixel *pix2, intptr_t i_stride2, int *ssd )
+{
+    return var2_8xh( pix1, i_stride1, pix2, i_stride2, ssd, 16, 7 );
+}
+
+static int x264_pixel_var2_8x8_sse2( pixel *pix1, intptr_t i_stride1, pixel *pix2, intptr_t i_stride2, int *ssd )
+{
+    return var2_8xh( pix1, i_stride1, pix2, i_stride2, ssd, 8, 6 );
+}
+
+/****************************************************************************
+ * ssim, vsad, asd8
+ ****************************************************************************/
+static void ssim_4x4x2_core_sse2( const pixel *pix1, intptr_t stride1,
+                                  const pixel *pix2, intptr_t stride2,
+                                  int sums[2][4] )
+{
+    const __m128i one = _mm_set1_epi16( 1 );
+    __m128i s1 = _mm_setzero_si128(), s2 = s1, ss = s1, s12 = s1;
+    for( int y = 0; y < 4; y++ )
+    {
+        __m128i a = load_8_epi16( pix1+y*stride1 );
+        __m128i b = load_8_epi16( pix2+y*stride2 );
+        s1  = _mm_add_epi16( s1, a );
+        s2  = _mm_add_epi16( s2, b );
+        ss  = _mm_add_epi32( ss, _mm_add_epi32( _mm_madd_epi16( a, a ), _mm_madd_epi16( b, b ) ) );
+        s12 = _mm_add_epi32( s12, _mm_madd_epi16( a, b ) );
+    }
+    /* 32-bit lanes 0,1 belong to the first block, 2,3 to the second */
+    s1 = _mm_madd_epi16( s1, one );
+    s2 = _mm_madd_epi16( s2, one );
+    __m128i t0 = _mm_unpacklo_epi32( s1, s2 );  /* s1[0] s2[0] s1[1] s2[1] */
+    __m128i t1 = _mm_unpackhi_epi32( s1, s2 );
+    __m128i t2 = _mm_unpacklo_epi32( ss, s12 );
+    __m128i t3 = _mm_unpackhi_epi32( ss, s12 );
+    __m128i z0 = _mm_add_epi32( _mm_unpacklo_epi64( t0, t2 ), _mm_unpackhi_epi64( t0, t2 ) );
+    __m128i z1 = _mm_add_epi32( _mm_unpacklo_epi64( t1, t3 ), _mm_unpackhi_epi64( t1, t3 ) );
+    _mm_storeu_si128( (__m128i*)sums[0], z0 );
+    _mm_storeu_si128( (__m128i*)sums[1], z1 );
+}
+
+static int pixel_vsad_sse2( pixel *src, intptr_t stride, int height )
+{
+    __m128i sum = _mm_setzero_si128();
+    __m128i prev = LOADU( src );
+    for( int i = 1; i < height; i++ )
+    {
+        src += stride;
+        __m128i cur = LOADU( src );
+        sum = _mm_add_epi32( sum, _mm_sad_epu8( prev, cur ) );
+        prev = cur;
+    }
+    return hsum_sad( sum );
+}
+
+static int pixel_asd8_sse2( pixel *pix1, intptr_t stride1, pixel *pix2, intptr_t stride2, int height )
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sum1 = zero, sum2 = zero;
+    for( int y = 0; y < height; y++, pix1 += stride1, pix2 += stride2 )
+    {
+        sum1 = _mm_add_epi32( sum1, _mm_sad_epu8( LOADL( pix1 ), zero ) );
+        sum2 = _mm_add_epi32( sum2, _mm_sad_epu8( LOADL( pix2 ), zero ) );
+    }
+    return abs( _mm_cvtsi128_si32( sum1 ) - _mm_cvtsi128_si32( sum2 ) );
+}
+
+/****************************************************************************
+ * successive elimination
+ ****************************************************************************/
+static ALWAYS_INLINE __m128i load_4_epu16( const uint16_t *p )
+{
+    return _mm_unpacklo_epi16( LOADL( p ), _mm_setzero_si128() );
+}
+
+static ALWAYS_INLINE __m128i abs_epi32( __m128i x )
+{
+    __m128i s = _mm_srai_epi32( x, 31 );
+    return _mm_sub_epi32( _mm_xor_si128( x, s ), s );
+}
+
+static ALWAYS_INLINE int ads_n( int n, int *enc_dc, uint16_t *sums, int delta,
+                                uint16_t *cost_mvx, int16_t *mvs, int width, int thresh )
+{
+    const __m128i dc0 = _mm_set1_epi32( enc_dc[0] );
+    const __m128i dc1 = _mm_set1_epi32( n > 1 ? enc_dc[1] : 0 );
+    const __m128i dc2 = _mm_set1_epi32( n > 2 ? enc_dc[2] : 0 );
+    const __m128i dc3 = _mm_set1_epi32( n > 2 ? enc_dc[3] : 0 );
+    const __m128i th  = _mm_set1_epi32( thresh );
+    int nmv = 0;
+    int i = 0;
+    for( ; i <= width-4; i += 4 )
+    {
+        __m128i ads = abs_epi32( _mm_sub_epi32( dc0, load_4_epu16( sums+i ) ) );
+        if( n == 4 )
+        {
+            ads = _mm_add_epi32( ads, abs_epi32( _mm_sub_epi32( dc1, load_4_epu16( sums+i+8 ) ) ) );
+            ads = _mm_add_epi32( ads, abs_epi32( _mm_sub_epi32( dc2, load_4_epu16( sums+i+delta ) ) ) );
+            ads = _mm_add_epi32( ads, abs_epi32( _mm_sub_epi32( dc3, load_4_epu16( sums+i+delta+8 ) ) ) );
+        }
+        else if( n == 2 )
+            ads = _mm_add_epi32( ads, abs_epi32( _mm_sub_epi32( dc1, load_4_epu16( sums+i+delta ) ) ) );
+        ads = _mm_add_epi32( ads, load_4_epu16( cost_mvx+i ) );
+        int mask = _mm_movemask_ps( _mm_castsi128_ps( _mm_cmplt_epi32( ads, th ) ) );
+        while( mask )
+        {
+            mvs[nmv++] = i + x264_ctz_4bit( mask );
+            mask &= mask - 1;
+        }
+    }
+    for( ; i < width; i++ )
+    {
+        int ads = abs( enc_dc[0] - sums[i] ) + cost_mvx[i];
+        if( n == 4 )
+            ads += abs( enc_dc[1] - sums[i+8] ) + abs( enc_dc[2] - sums[i+delta] ) + abs( enc_dc[3] - sums[i+delta+8] );
+        else if( n == 2 )
+            ads += abs( enc_dc[1] - sums[i+delta] );
+        if( ads < thresh )
+            mvs[nmv++] = i;
+    }
+    return nmv;
+}
+
+static int x264_pixel_ads4_sse2( int enc_dc[4], uint16_t *sums, int delta, uint16_t *cost_mvx, int16_t *mvs, int width, int thresh )
+{
+    return ads_n( 4, enc_dc, sums, delta, cost_mvx, mvs, width, thresh );
+}
+
+static int x264_pixel_ads2_sse2( int enc_dc[2], uint16_t *sums, int delta, uint16_t *cost_mvx, int16_t *mvs, int width, int thresh )
+{
+    return ads_n( 2, enc_dc, sums, delta, cost_mvx, mvs, width, thresh );
+}
+
+static int x264_pixel_ads1_sse2( int enc_dc[1], uint16_t *sums, int delta, uint16_t *cost_mvx, int16_t *mvs, int width, int thresh )
+{
+    return ads_n( 1, enc_dc, sums, delta, cost_mvx, mvs, width, thresh );
+}
+
+/****************************************************************************
+ * AVX2: two rows (or two blocks) per register
+ ****************************************************************************/
+static X264_TARGET_AVX2 ALWAYS_INLINE __m256i load_16x2( const pixel *p0, const pixel *p1 )
+{
+    return _mm256_inserti128_si256( _mm256_castsi128_si256( LOADU( p0 ) ), LOADU( p1 ), 1 );
+}
+
+static X264_TARGET_AVX2 ALWAYS_INLINE int hsum_sad_avx2( __m256i sum )
+{
+    return hsum_sad( _mm_add_epi32( _mm256_castsi256_si128( sum ), _mm256_extracti128_si256( sum, 1 ) ) );
+}
+
+static X264_TARGET_AVX2 ALWAYS_INLINE int hsum_epi32_avx2( __m256i sum )
+{
+    return hsum_epi32( _mm_add_epi32( _mm256_castsi256_si128( sum ), _mm256_extracti128_si256( sum, 1 ) ) );
+}
+
+static X264_TARGET_AVX2 ALWAYS_INLINE int sad_16xh_avx2( pixel *pix1, intptr_t i_pix1, pixel *pix2, intptr_t i_pix2, int h )
+{
+    __m256i sum = _mm256_setzero_si256();
+    for( int y = 0; y < h; y += 2, pix1 += 2*i_pix1, pix2 += 2*i_pix2 )
+        sum = _mm256_add_epi32( sum, _mm256_sad_epu8( load_16x2( pix1, pix1+i_pix1 ), load_16x2( pix2, pix2+i_pix2 ) ) );
+    return hsum_sad_avx2( sum );
+}
+
+static X264_TARGET_AVX2 int x264_pixel_sad_16x16_avx2( pixel *pix1, intptr_t i_pix1, pixel *pix2, intptr_t i_pix2 )
+{
+    return sad_16xh_avx2( pix1, i_pix1, pix2, i_pix2, 16 );
+}
+
+static X264_TARGET_AVX2 int x264_pixel_sad_16x8_avx2( pixel *pix1, intptr_t i_pix1, pixel *pix2, intptr_t i_pix2 )
+{
+    return sad_16xh_avx2( pix1, i_pix1, pix2, i_pix2, 8 );
+}
+
+static X264_TARGET_AVX2 ALWAYS_INLINE void sad_xn_16xh_avx2( int n, pixel *fenc, pixel *pix0, pixel *pix1, pixel *pix2, pixel *pix3,
+                                                             intptr_t i_stride, int *scores, int h )
+{
+    __m256i s0 = _mm256_setzero_si256(), s1 = s0, s2 = s0, s3 = s0;
+    for( int y = 0; y < h; y += 2 )
+    {
+        intptr_t o = y*i_stride;
+        __m256i e = _mm256_loadu_si256( (__m256i*)(fenc + y*FENC_STRIDE) );
+        s0 = _mm256_add_epi32( s0, _mm256_sad_epu8( e, load_16x2( pix0+o, pix0+o+i_stride ) ) );
+        s1 = _mm256_add_epi32( s1, _mm256_sad_epu8( e, load_16x2( pix1+o, pix1+o+i_stride ) ) );
+        s2 = _mm256_add_epi32( s2, _mm256_sad_epu8( e, load_16x2( pix2+o, pix2+o+i_stride ) ) );
+        if( n == 4 )
+            s3 = _mm256_add_epi32( s3, _mm256_sad_epu8( e, load_16x2( pix3+o, pix3+o+i_stride ) ) );
+    }
+    scores[0] = hsum_sad_avx2( s0 );
+    scores[1] = hsum_sad_avx2( s1 );
+    scores[2] = hsum_sad_avx2( s2 );
+    if( n == 4 )
+        scores[3] = hsum_sad_avx2( s3 );
+}
+
+#define SAD_X_AVX2( h ) \
+static X264_TARGET_AVX2 void x264_pixel_sad_x3_16x##h##_avx2( pixel *fenc, pixel *pix0, pixel *pix1, pixel *pix2,\
+                                                              intptr_t i_stride, int scores[3] )\
+{\
+    sad_xn_16xh_avx2( 3, fenc, pix0, pix1, pix2, NULL, i_stride, scores, h );\
+}\
+static X264_TARGET_AVX2 void x264_pixel_sad_x4_16x##h##_avx2( pixel *fenc, pixel *pix0, pixel *pix1, pixel *pix2, pixel *pix3,\
+                                                              intptr_t i_stride, int scores[4] )\
+{\
+    sad_xn_16xh_avx2( 4, fenc, pix0, pix1, pix2, pix3, i_stride, scores, h );\
+}
+SAD_X_AVX2( 16 )
+SAD_X_AVX2( 8 )
+
+static X264_TARGET_AVX2 ALWAYS_INLINE int ssd_16xh_avx2( pixel *pix1, intptr_t i_pix1, pixel *pix2, intptr_t i_pix2, int h )
+{
+    __m256i sum = _mm256_setzero_si256();
+    for( int y = 0; y < h; y++, pix1 += i_pix1, pix2 += i_pix2 )
+    {
+        __m256i d = _mm256_sub_epi16( _mm256_cvtepu8_epi16( LOADU( pix1 ) ), _mm256_cvtepu8_epi16( LOADU( pix2 ) ) );
+        sum = _mm256_add_epi32( sum, _mm256_madd_epi16( d, d ) );
+    }
+    return hsum_epi32_avx2( sum );
+}
+
+static X264_TARGET_AVX2 int x264_pixel_ssd_16x16_avx2( pixel *pix1, intptr_t i_pix1, pixel *pix2, intptr_t i_pix2 )
+{
+    return ssd_16xh_avx2( pix1, i_pix1, pix2, i_pix2, 16 );
+}
+
+static X264_TARGET_AVX2 int x264_pixel_ssd_16x8_avx2( pixel *pix1, intptr_t i_pix1, pixel *pix2, intptr_t i_pix2 )
+{
+    return ssd_16xh_avx2( pix1, i_pix1, pix2, i_pix2, 8 );
+}
+
+#define BUTTERFLY_AVX2( a, b ) { __m256i t_ = a; a = _mm256_add_epi16( t_, b ); b = _mm256_sub_epi16( t_, b ); }
+
+static X264_TARGET_AVX2 ALWAYS_INLINE __m256i hadamard_pairs_avx2( __m256i x )
+{
+    const __m256i sign = _mm256_setr_epi16( 1, -1, 1, -1, 1, -1, 1, -1, 1, -1, 1, -1, 1, -1, 1, -1 );
+    __m256i swap = _mm256_shufflehi_epi16( _mm256_shufflelo_epi16( x, _MM_SHUFFLE(2,3,0,1) ), _MM_SHUFFLE(2,3,0,1) );
+    return _mm256_add_epi16( swap, _mm256_sign_epi16( x, sign ) );
+}
+
+static X264_TARGET_AVX2 ALWAYS_INLINE __m256i hadamard_quads_avx2( __m256i x )
+{
+    const __m256i sign = _mm256_setr_epi16( 1, 1, -1, -1, 1, 1, -1, -1, 1, 1, -1, -1, 1, 1, -1, -1 );
+    __m256i swap = _mm256_shufflehi_epi16( _mm256_shufflelo_epi16( x, _MM_SHUFFLE(1,0,3,2) ), _MM_SHUFFLE(1,0,3,2) );
+    return _mm256_add_epi16( swap, _mm256_sign_epi16( x, sign ) );
+}
+
+static X264_TARGET_AVX2 ALWAYS_INLINE __m256i absmax_quads_avx2( __m256i x )
+{
+    x = _mm256_abs_epi16( x );
+    return _mm256_max_epi16( x, _mm256_shufflehi_epi16( _mm256_shufflelo_epi16( x, _MM_SHUFFLE(1,0,3,2) ), _MM_SHUFFLE(1,0,3,2) ) );
+}
+
+static X264_TARGET_AVX2 ALWAYS_INLINE __m256i absmax_halves_avx2( __m256i x )
+{
+    x = _mm256_abs_epi16( x );
+    return _mm256_max_epi16( x, _mm256_shuffle_epi32( x, _MM_SHUFFLE(1,0,3,2) ) );
+}
+
+/* Four 4x4 blocks of differences, rows d0..d3; 32-bit lanes sum to twice the satd */
+static X264_TARGET_AVX2 ALWAYS_INLINE __m256i satd_16x4_core_avx2( __m256i d0, __m256i d1, __m256i d2, __m256i d3 )
+{
+    BUTTERFLY_AVX2( d0, d1 );
+    BUTTERFLY_AVX2( d2, d3 );
+    BUTTERFLY_AVX2( d0, d2 );
+    BUTTERFLY_AVX2( d1, d3 );
+    d0 = absmax_quads_avx2( hadamard_pairs_avx2( d0 ) );
+    d1 = absmax_quads_avx2( hadamard_pairs_avx2( d1 ) );
+    d2 = absmax_quads_avx2( hadamard_pairs_avx2( d2 ) );
+    d3 = absmax_quads_avx2( hadamard_pairs_avx2( d3 ) );
+    __m256i s = _mm256_add_epi16( _mm256_add_epi16( d0, d1 ), _mm256_add_epi16( d2, d3 ) );
+    return _mm256_madd_epi16( s, _mm256_set1_epi16( 1 ) );
+}
+
+static X264_TARGET_AVX2 ALWAYS_INLINE __m256i diff_16_avx2( const pixel *p1, const pixel *p2 )
+{
+    return _mm256_sub_epi16( _mm256_cvtepu8_epi16( LOADU( p1 ) ), _mm256_cvtepu8_epi16( LOADU( p2 ) ) );
+}
+
+/* 8 pixels of row a next to 8 pixels of row b */
+static X264_TARGET_AVX2 ALWAYS_INLINE __m256i diff_8x2_avx2( const pixel *p1a, const pixel *p1b, const pixel *p2a, const pixel *p2b )
+{
+    return _mm256_sub_epi16( _mm256_cvtepu8_epi16( load_8x2( p1a, p1b ) ), _mm256_cvtepu8_epi16( load_8x2( p2a, p2b ) ) );
+}
+
+static X264_TARGET_AVX2 ALWAYS_INLINE int satd_wxh_avx2( pixel *pix1, intptr_t i_pix1, pixel *pix2, intptr_t i_pix2, int w, int h )
+{
+    __m256i sum = _mm256_setzero_si256();
+    if( w == 16 )
+        for( int y = 0; y < h; y += 4 )
+        {
+            pixel *p1 = pix1 + y*i_pix1;
+            pixel *p2 = pix2 + y*i_pix2;
+            sum = _mm256_add_epi32( sum, satd_16x4_core_avx2( diff_16_avx2( p1,          p2 ),
+                                                              diff_16_avx2( p1+  i_pix1, p2+  i_pix2 ),
+                                                              diff_16_avx2( p1+2*i_pix1, p2+2*i_pix2 ),
+                                                              diff_16_avx2( p1+3*i_pix1, p2+3*i_pix2 ) ) );
+        }
+    else /* w == 8: the 8x4 blocks at rows y and y+4 side by side */
+        for( int y = 0; y < h; y += 8 )
+        {
+            pixel *p1 = pix1 + y*i_pix1;
+            pixel *p2 = pix2 + y*i_pix2;
+            __m256i d[4];
+            for( int i = 0; i < 4; i++ )
+                d[i] = diff_8x2_avx2( p1+i*i_pix1, p1+(i+4)*i_pix1, p2+i*i_pix2, p2+(i+4)*i_pix2 );
+            sum = _mm256_add_epi32( sum, satd_16x4_core_avx2( d[0], d[1], d[2], d[3] ) );
+        }
+    return hsum_epi32_avx2( sum ) >> 1;
+}
+
+#define SATD_AVX2( w, h ) \
+static X264_TARGET_AVX2 int x264_pixel_satd_##w##x##h##_avx2( pixel *pix1, intptr_t i_pix1, pixel *pix2, intptr_t i_pix2 )\
+{\
+    return satd_wxh_avx2( pix1, i_pix1, pix2, i_pix2, w, h );\
+}
+SATD_AVX2( 16, 16 )
+SATD_AVX2( 16, 8 )
+SATD_AVX2( 8, 16 )
+SATD_AVX2( 8, 8 )
+
+#define SATD_X_AVX2( size ) \
+static X264_TARGET_AVX2 void x264_pixel_satd_x3_##size##_avx2( pixel *fenc, pixel *pix0, pixel *pix1, pixel *pix2,\
+                                                               intptr_t i_stride, int scores[3] )\
+{\
+    scores[0] = x264_pixel_satd_##size##_avx2( fenc, FENC_STRIDE, pix0, i_stride );\
+    scores[1] = x264_pixel_satd_##size##_avx2( fenc, FENC_STRIDE, pix1, i_stride );\
+    scores[2] = x264_pixel_satd_##size##_avx2( fenc, FENC_STRIDE, pix2, i_stride );\
+}\
+static X264_TARGET_AVX2 void x264_pixel_satd_x4_##size##_avx2( pixel *fenc, pixel *pix0, pixel *pix1, pixel *pix2, pixel *pix3,\
+                                                               intptr_t i_stride, int scores[4] )\
+{\
+    scores[0] = x264_pixel_satd_##size##_avx2( fenc, FENC_STRIDE, pix0, i_stride );\
+    scores[1] = x264_pixel_satd_##size##_avx2( fenc, FENC_STRIDE, pix1, i_stride );\
+    scores[2] = x264_pixel_satd_##size##_avx2( fenc, FENC_STRIDE, pix2, i_stride );\
+    scores[3] = x264_pixel_satd_##size##_avx2( fenc, FENC_STRIDE, pix3, i_stride );\
+}
+SATD_X_AVX2( 16x16 )
+SATD_X_AVX2( 16x8 )
+SATD_X_AVX2( 8x16 )
+SATD_X_AVX2( 8x8 )
+
+/* Two 8x8 blocks side by side */
+static X264_TARGET_AVX2 ALWAYS_INLINE __m256i sa8d_16x8_avx2( pixel *pix1, intptr_t i_pix1, pixel *pix2, intptr_t i_pix2 )
+{
+    const __m256i one = _mm256_set1_epi16( 1 );
+    __m256i d[8];
+    for( int i = 0; i < 8; i++ )
+        d[i] = diff_16_avx2( pix1+i*i_pix1, pix2+i*i_pix2 );
+    BUTTERFLY_AVX2( d[0], d[1] ); BUTTERFLY_AVX2( d[2], d[3] ); BUTTERFLY_AVX2( d[4], d[5] ); BUTTERFLY_AVX2( d[6], d[7] );
+    BUTTERFLY_AVX2( d[0], d[2] ); BUTTERFLY_AVX2( d[1], d[3] ); BUTTERFLY_AVX2( d[4], d[6] ); BUTTERFLY_AVX2( d[5], d[7] );
+    BUTTERFLY_AVX2( d[0], d[4] ); BUTTERFLY_AVX2( d[1], d[5] ); BUTTERFLY_AVX2( d[2], d[6] ); BUTTERFLY_AVX2( d[3], d[7] );
+    __m256i sum = _mm256_setzero_si256();
+    for( int i = 0; i < 8; i += 2 )
+    {
+        __m256i a = absmax_halves_avx2( hadamard_quads_avx2( hadamard_pairs_avx2( d[i] ) ) );
+        __m256i b = absmax_halves_avx2( hadamard_quads_avx2( hadamard_pairs_avx2( d[i+1] ) ) );
+        sum = _mm256_add_epi32( sum, _mm256_madd_epi16( _mm256_add_epi16( a, b ), one ) );
+    }
+    return sum;
+}
+
+static X264_TARGET_AVX2 int x264_pixel_sa8d_16x16_avx2( pixel *pix1, intptr_t i_pix1, pixel *pix2, intptr_t i_pix2 )
+{
+    __m256i sum = _mm256_add_epi32( sa8d_16x8_avx2( pix1, i_pix1, pix2, i_pix2 ),
+                                    sa8d_16x8_avx2( pix1+8*i_pix1, i_pix1, pix2+8*i_pix2, i_pix2 ) );
+    return (hsum_epi32_avx2( sum ) + 2) >> 2;
+}
+
+static X264_TARGET_AVX2 uint64_t x264_pixel_var_16x16_avx2( pixel *pix, intptr_t i_stride )
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i sum = zero, sqr = zero;
+    for( int y = 0; y < 16; y += 2, pix += 2*i_stride )
+    {
+        __m256i p = load_16x2( pix, pix+i_stride );
+        __m256i lo = _mm256_unpacklo_epi8( p, zero );
+        __m256i hi = _mm256_unpackhi_epi8( p, zero );
+        sum = _mm256_add_epi32( sum, _mm256_sad_epu8( p, zero ) );
+        sqr = _mm256_add_epi32( sqr, _mm256_add_epi32( _mm256_madd_epi16( lo, lo ), _mm256_madd_epi16( hi, hi ) ) );
+    }
+    return (uint32_t)hsum_sad_avx2( sum ) + ((uint64_t)(uint32_t)hsum_epi32_avx2( sqr ) << 32);
+}
+
+/* ssim_end1 on four sets of sums at once.  The integer part needs 32-bit
+ * multiplies (SSE4.1), hence AVX2 only; the float part performs the same
+ * single precision operations in the same order as the C code. */
+static X264_TARGET_AVX2 float ssim_end4_avx2( int sum0[5][4], int sum1[5][4], int width )
+{
+    static const int ssim_c1 = (int)(.01*.01*PIXEL_MAX*PIXEL_MAX*64 + .5);
+    static const int ssim_c2 = (int)(.03*.03*PIXEL_MAX*PIXEL_MAX*64*63 + .5);
+    __m128i s[4];
+    for( int i = 0; i < 4; i++ )
+    {
+        __m128i a = _mm_loadu_si128( (__m128i*)sum0[i] );
+        __m128i b = _mm_loadu_si128( (__m128i*)sum0[i+1] );
+        __m128i c = _mm_loadu_si128( (__m128i*)sum1[i] );
+        __m128i d = _mm_loadu_si128( (__m128i*)sum1[i+1] );
+        s[i] = _mm_add_epi32( _mm_add_epi32( a, b ), _mm_add_epi32( c, d ) );
+    }
+    /* transpose so that each register holds one kind of sum for i = 0..3 */
+    __m128i t0 = _mm_unpacklo_epi32( s[0], s[1] );
+    __m128i t1 = _mm_unpacklo_epi32( s[2], s[3] );
+    __m128i t2 = _mm_unpackhi_epi32( s[0], s[1] );
+    __m128i t3 = _mm_unpackhi_epi32( s[2], s[3] );
+    __m128i s1  = _mm_unpacklo_epi64( t0, t1 );
+    __m128i s2  = _mm_unpackhi_epi64( t0, t1 );
+    __m128i ss  = _mm_unpacklo_epi64( t2, t3 );
+    __m128i s12 = _mm_unpackhi_epi64( t2, t3 );
+
+    const __m128i c1 = _mm_set1_epi32( ssim_c1 );
+    const __m128i c2 = _mm_set1_epi32( ssim_c2 );
+    __m128i s1s1 = _mm_mullo_epi32( s1, s1 );
+    __m128i s2s2 = _mm_mullo_epi32( s2, s2 );
+    __m128i s1s2 = _mm_mullo_epi32( s1, s2 );
+    __m128i vars  = _mm_sub_epi32( _mm_sub_epi32( _mm_slli_epi32( ss, 6 ), s1s1 ), s2s2 );
+    __m128i covar = _mm_sub_epi32( _mm_slli_epi32( s12, 6 ), s1s2 );
+    __m128 num0 = _mm_cvtepi32_ps( _mm_add_epi32( _mm_slli_epi32( s1s2, 1 ), c1 ) );
+    __m128 num1 = _mm_cvtepi32_ps( _mm_add_epi32( _mm_slli_epi32( covar, 1 ), c2 ) );
+    __m128 den0 = _mm_cvtepi32_ps( _mm_add_epi32( _mm_add_epi32( s1s1, s2s2 ), c1 ) );
+    __m128 den1 = _mm_cvtepi32_ps( _mm_add_epi32( vars, c2 ) );
+    ALIGNED_16( float r[4] );
+    _mm_store_ps( r, _mm_div_ps( _mm_mul_ps( num0, num1 ), _mm_mul_ps( den0, den1 ) ) );
+
+    float ssim = 0.0;
+    for( int i = 0; i < width; i++ )
+        ssim += r[i];
+    return ssim;
+}
+
+/****************************************************************************
+ * x264_pixel_init_intrin:
+ ****************************************************************************/
+void x264_pixel_init_intrin( int cpu, x264_pixel_function_t *pixf )
+{
+#define INIT2_NAME( name1, name2, cpu ) \
+    pixf->name1[PIXEL_16x16] = x264_pixel_##name2##_16x16##cpu;\
+    pixf->name1[PIXEL_16x8]  = x264_pixel_##name2##_16x8##cpu;
+#define INIT4_NAME( name1, name2, cpu ) \
+    INIT2_NAME( name1, name2, cpu ) \
+    pixf->name1[PIXEL_8x16]  = x264_pixel_##name2##_8x16##cpu;\
+    pixf->name1[PIXEL_8x8]   = x264_pixel_##name2##_8x8##cpu;
+#define INIT5_NAME( name1, name2, cpu ) \
+    INIT4_NAME( name1, name2, cpu ) \
+    pixf->name1[PIXEL_8x4]   = x264_pixel_##name2##_8x4##cpu;
+#define INIT6_NAME( name1, name2, cpu ) \
+    INIT5_NAME( name1, name2, cpu ) \
+    pixf->name1[PIXEL_4x8]   = x264_pixel_##name2##_4x8##cpu;
+#define INIT7_NAME( name1, name2, cpu ) \
+    INIT6_NAME( name1, name2, cpu ) \
+    pixf->name1[PIXEL_4x4]   = x264_pixel_##name2##_4x4##cpu;
+#define INIT8_NAME( name1, name2, cpu ) \
+    INIT7_NAME( name1, name2, cpu ) \
+    pixf->name1[PIXEL_4x16]  = x264_pixel_##name2##_4x16##cpu;
+#define INIT2( name, cpu ) INIT2_NAME( name, name, cpu )
+#define INIT4( name, cpu ) INIT4_NAME( name, name, cpu )
+#define INIT7( name, cpu ) INIT7_NAME( name, name, cpu )
+#define INIT8( name, cpu ) INIT8_NAME( name, name, cpu )
+
+    if( cpu&X264_CPU_SSE2 )
+    {
+        INIT8( sad, _sse2 );
+        INIT8_NAME( sad_aligned, sad, _sse2 );
+        INIT7( sad_x3, _sse2 );
+        INIT7( sad_x4, _sse2 );
+        INIT8( ssd, _sse2 );
+        INIT7( satd, _sse2 );
+        pixf->satd[PIXEL_4x16] = x264_pixel_satd_4x16_sse2;
+        INIT7( satd_x3, _sse2 );
+        INIT7( satd_x4, _sse2 );
+        INIT4( hadamard_ac, _sse2 );
+        pixf->ads[PIXEL_16x16] = x264_pixel_ads4_sse2;
+        pixf->ads[PIXEL_16x8]  = x264_pixel_ads2_sse2;
+        pixf->ads[PIXEL_8x8]   = x264_pixel_ads1_sse2;
+
+        pixf->sa8d[PIXEL_16x16] = x264_pixel_sa8d_16x16_sse2;
+        pixf->sa8d[PIXEL_8x8]   = x264_pixel_sa8d_8x8_sse2;
+        pixf->var[PIXEL_16x16] = x264_pixel_var_16x16_sse2;
+        pixf->var[PIXEL_8x16]  = x264_pixel_var_8x16_sse2;
+        pixf->var[PIXEL_8x8]   = x264_pixel_var_8x8_sse2;
+        pixf->var2[PIXEL_8x16] = x264_pixel_var2_8x16_sse2;
+        pixf->var2[PIXEL_8x8]  = x264_pixel_var2_8x8_sse2;
+
+        pixf->ssd_nv12_core   = pixel_ssd_nv12_core_sse2;
+        pixf->ssim_4x4x2_core = ssim_4x4x2_core_sse2;
+        pixf->vsad = pixel_vsad_sse2;
+        pixf->asd8 = pixel_asd8_sse2;
+
+        pixf->intra_sad_x3_4x4    = x264_intra_sad_x3_4x4_sse2;
+        pixf->intra_satd_x3_4x4   = x264_intra_satd_x3_4x4_sse2;
+        pixf->intra_sad_x3_8x8    = x264_intra_sad_x3_8x8_sse2;
+        pixf->intra_sa8d_x3_8x8   = x264_intra_sa8d_x3_8x8_sse2;
+        pixf->intra_sad_x3_8x8c   = x264_intra_sad_x3_8x8c_sse2;
+        pixf->intra_satd_x3_8x8c  = x264_intra_satd_x3_8x8c_sse2;
+        pixf->intra_sad_x3_8x16c  = x264_intra_sad_x3_8x16c_sse2;
+        pixf->intra_satd_x3_8x16c = x264_intra_satd_x3_8x16c_sse2;
+        pixf->intra_sad_x3_16x16  = x264_intra_sad_x3_16x16_sse2;
+        pixf->intra_satd_x3_16x16 = x264_intra_satd_x3_16x16_sse2;
+    }
+
+    if( cpu&X264_CPU_AVX2 )
+    {
+        INIT2( sad, _avx2 );
+        INIT2_NAME( sad_aligned, sad, _avx2 );
+        INIT2( sad_x3, _avx2 );
+        INIT2( sad_x4, _avx2 );
+        INIT2( ssd, _avx2 );
+        INIT4( satd, _avx2 );
+        INIT4( satd_x3, _avx2 );
+        INIT4( satd_x4, _avx2 );
+        pixf->sa8d[PIXEL_16x16] = x264_pixel_sa8d_16x16_avx2;
+        pixf->var[PIXEL_16x16] = x264_pixel_var_16x16_avx2;
+        pixf->ssim_end4 = ssim_end4_avx2;
+    }
+}
+
+#endif // HAVE_X86_INTRIN && !HIGH_BIT_DEPTH
@@ -0,0 +1,528 @@
+/*****************************************************************************
+ * predict-intrin.c: x86 intra prediction with compiler intrinsics
+ *****************************************************************************
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *****************************************************************************/
+
+#include "common/common.h"
+#include "intrin.h"
+#include <immintrin.h>
+
+#if HAVE_X86_INTRIN && !HIGH_BIT_DEPTH
+
+/* The directional modes compute every distinct value of the block at once
+ * along the edge and store shifted windows of it.  The three-tap filter is
+ * done on bytes with
+ *     (a + 2*b + c + 2) >> 2 == avg( avg( a, c ) - ((a ^ c) & 1), b )
+ * and the plane modes step 16-bit rows, so all results are those of
+ * common/predict.c. */
+
+#define LOADU(p)  _mm_loadu_si128( (const __m128i*)(p) )
+#define LOADL(p)  _mm_loadl_epi64( (const __m128i*)(p) )
+#define STOREU(p, v) _mm_storeu_si128( (__m128i*)(p), v )
+#define STOREL(p, v) _mm_storel_epi64( (__m128i*)(p), v )
+
+#define SRC(x,y) src[(x)+(y)*FDEC_STRIDE]
+
+/****************************************************************************
+ * helpers
+ ****************************************************************************/
+/* F2( a, b, c ) on each byte */
+static ALWAYS_INLINE __m128i lowpass( __m128i a, __m128i b, __m128i c )
+{
+    __m128i avg = _mm_avg_epu8( a, c );
+    avg = _mm_sub_epi8( avg, _mm_and_si128( _mm_xor_si128( a, c ), _mm_set1_epi8( 1 ) ) );
+    return _mm_avg_epu8( avg, b );
+}
+
+static ALWAYS_INLINE int sum_left( pixel *src, int n )
+{
+    int sum = 0;
+    for( int i = 0; i < n; i++ )
+        sum += SRC(-1,i);
+    return sum;
+}
+
+static ALWAYS_INLINE int sum_8( const pixel *p )
+{
+    return _mm_cvtsi128_si32( _mm_sad_epu8( LOADL( p ), _mm_setzero_si128() ) );
+}
+
+static ALWAYS_INLINE int sum_16( const pixel *p )
+{
+    __m128i sum = _mm_sad_epu8( LOADU( p ), _mm_setzero_si128() );
+    return _mm_cvtsi128_si32( _mm_add_epi32( sum, _mm_srli_si128( sum, 8 ) ) );
+}
+
+/* The sums of p[0..3] and p[4..7] */
+static ALWAYS_INLINE void sum_4x2( const pixel *p, int *s0, int *s1 )
+{
+    __m128i sum = _mm_sad_epu8( _mm_unpacklo_epi32( LOADL( p ), _mm_setzero_si128() ), _mm_setzero_si128() );
+    *s0 = _mm_cvtsi128_si32( sum );
+    *s1 = _mm_extract_epi16( sum, 4 );
+}
+
+static ALWAYS_INLINE void fill_16xh( pixel *src, __m128i v, int h )
+{
+    for( int y = 0; y < h; y++ )
+        STOREU( src + y*FDEC_STRIDE, v );
+}
+
+static ALWAYS_INLINE void fill_8xh( pixel *src, __m128i v, int h )
+{
+    for( int y = 0; y < h; y++ )
+        STOREL( src + y*FDEC_STRIDE, v );
+}
+
+/* Plane prediction: rows of i00 + b*x, stepping by c, clipped after >> 5.
+ * Every intermediate of the 8-bit plane modes fits in 16 bits. */
+static ALWAYS_INLINE void predict_p( pixel *src, int i00, int b, int c, int w, int h )
+{
+    __m128i x0 = _mm_add_epi16( _mm_set1_epi16( i00 ), _mm_mullo_epi16( _mm_set1_epi16( b ), _mm_setr_epi16( 0, 1, 2, 3, 4, 5, 6, 7 ) ) );
+    __m128i x1 = _mm_add_epi16( x0, _mm_set1_epi16( 8*b ) );
+    __m128i step = _mm_set1_epi16( c );
+    for( int y = 0; y < h; y++ )
+    {
+        __m128i row = _mm_packus_epi16( _mm_srai_epi16( x0, 5 ), _mm_srai_epi16( x1, 5 ) );
+        if( w == 16 )
+            STOREU( src, row );
+        else
+            STOREL( src, row );
+        x0 = _mm_add_epi16( x0, step );
+        x1 = _mm_add_epi16( x1, step );
+        src += FDEC_STRIDE;
+    }
+}
+
+/****************************************************************************
+ * 16x16
+ ****************************************************************************/
+static void predict_16x16_v_sse2( pixel *src )
+{
+    fill_16xh( src, LOADU( src - FDEC_STRIDE ), 16 );
+}
+
+static void predict_16x16_h_sse2( pixel *src )
+{
+    for( int y = 0; y < 16; y++ )
+        STOREU( src + y*FDEC_STRIDE, _mm_set1_epi8( SRC(-1,y) ) );
+}
+
+static void predict_16x16_dc_sse2( pixel *src )
+{
+    int dc = sum_16( src - FDEC_STRIDE ) + sum_left( src, 16 );
+    fill_16xh( src, _mm_set1_epi8( (dc + 16) >> 5 ), 16 );
+}
+
+static void predict_16x16_dc_left_sse2( pixel *src )
+{
+    fill_16xh( src, _mm_set1_epi8( (sum_left( src, 16 ) + 8) >> 4 ), 16 );
+}
+
+static void predict_16x16_dc_top_sse2( pixel *src )
+{
+    fill_16xh( src, _mm_set1_epi8( (sum_16( src - FDEC_STRIDE ) + 8) >> 4 ), 16 );
+}
+
+static void predict_16x16_p_sse2( pixel *src )
+{
+    int H = 0, V = 0;
+    for( int i = 0; i <= 7; i++ )
+    {
+        H += ( i + 1 ) * ( SRC(8+i,-1) - SRC(6-i,-1) );
+        V += ( i + 1 ) * ( SRC(-1,8+i) - SRC(-1,6-i) );
+    }
+
+    int a = 16 * ( SRC(-1,15) + SRC(15,-1) );
+    int b = ( 5 * H + 32 ) >> 6;
+    int c = ( 5 * V + 32 ) >> 6;
+    predict_p( src, a - 7*b - 7*c + 16, b, c, 16, 16 );
+}
+
+/****************************************************************************
+ * 8x8 and 8x16 chroma
+ ****************************************************************************/
+static ALWAYS_INLINE __m128i splat_4x2( int a, int b )
+{
+    return _mm_set_epi32( 0, 0, PIXEL_SPLAT_X4( b ), PIXEL_SPLAT_X4( a ) );
+}
+
+static void predict_8x8c_dc_sse2( pixel *src )
+{
+    int s0, s1;
+    sum_4x2( src - FDEC_STRIDE, &s0, &s1 );
+    int s2 = sum_left( src, 4 );
+    int s3 = sum_left( src + 4*FDEC_STRIDE, 4 );
+    fill_8xh( src, splat_4x2( (s0 + s2 + 4) >> 3, (s1 + 2) >> 2 ), 4 );
+    fill_8xh( src + 4*FDEC_STRIDE, splat_4x2( (s3 + 2) >> 2, (s1 + s3 + 4) >> 3 ), 4 );
+}
+
+static void predict_8x16c_dc_sse2( pixel *src )
+{
+    int s0, s1;
+    sum_4x2( src - FDEC_STRIDE, &s0, &s1 );
+    int s2 = sum_left( src, 4 );
+    fill_8xh( src, splat_4x2( (s0 + s2 + 4) >> 3, (s1 + 2) >> 2 ), 4 );
+    for( int y = 4; y < 16; y += 4 )
+    {
+        int s = sum_left( src + y*FDEC_STRIDE, 4 );
+        fill_8xh( src + y*FDEC_STRIDE, splat_4x2( (s + 2) >> 2, (s1 + s + 4) >> 3 ), 4 );
+    }
+}
+
+static void predict_8x8c_dc_left_sse2( pixel *src )
+{
+    fill_8xh( src, _mm_set1_epi8( (sum_left( src, 4 ) + 2) >> 2 ), 4 );
+    fill_8xh( src + 4*FDEC_STRIDE, _mm_set1_epi8( (sum_left( src + 4*FDEC_STRIDE, 4 ) + 2) >> 2 ), 4 );
+}
+
+static void predict_8x8c_dc_top_sse2( pixel *src )
+{
+    int s0, s1;
+    sum_4x2( src - FDEC_STRIDE, &s0, &s1 );
+    fill_8xh( src, splat_4x2( (s0 + 2) >> 2, (s1 + 2) >> 2 ), 8 );
+}
+
+static void predict_8x8c_p_sse2( pixel *src )
+{
+    int H = 0, V = 0;
+    for( int i = 0; i < 4; i++ )
+    {
+        H += ( i + 1 ) * ( SRC(4+i,-1) - SRC(2-i,-1) );
+        V += ( i + 1 ) * ( SRC(-1,4+i) - SRC(-1,2-i) );
+    }
+
+    int a = 16 * ( SRC(-1,7) + SRC(7,-1) );
+    int b = ( 17 * H + 16 ) >> 5;
+    int c = ( 17 * V + 16 ) >> 5;
+    predict_p( src, a - 3*b - 3*c + 16, b, c, 8, 8 );
+}
+
+static void predict_8x16c_p_sse2( pixel *src )
+{
+    int H = 0, V = 0;
+    for( int i = 0; i < 4; i++ )
+        H += ( i + 1 ) * ( SRC(4+i,-1) - SRC(2-i,-1) );
+    for( int i = 0; i < 8; i++ )
+        V += ( i + 1 ) * ( SRC(-1,8+i) - SRC(-1,6-i) );
+
+    int a = 16 * ( SRC(-1,15) + SRC(7,-1) );
+    int b = ( 17 * H + 16 ) >> 5;
+    int c = ( 5 * V + 32 ) >> 6;
+    predict_p( src, a - 3*b - 7*c + 16, b, c, 8, 16 );
+}
+
+/****************************************************************************
+ * 8x8 luma
+ ****************************************************************************/
+/* Same edge layout as x264_predict_8x8_filter_c:
+ * edge[7..14] = l7..l0, edge[15] = lt, edge[16..31] = t0..t15, edge[32] = t15 */
+static void predict_8x8_filter_sse2( pixel *src, pixel edge[36], int i_neighbor, int i_filters )
+{
+    int have_lt = i_neighbor & MB_TOPLEFT;
+    if( i_filters & MB_LEFT )
+    {
+        /* l7 l7 l6 .. l0 lt, filtered into edge[7..14] */
+        __m128i l = _mm_setr_epi8( SRC(-1,7), SRC(-1,7), SRC(-1,6), SRC(-1,5), SRC(-1,4), SRC(-1,3),
+                                   SRC(-1,2), SRC(-1,1), SRC(-1,0), have_lt ? SRC(-1,-1) : SRC(-1,0),
+                                   0, 0, 0, 0, 0, 0 );
+        STOREL( edge+7, lowpass( l, _mm_srli_si128( l, 1 ), _mm_srli_si128( l, 2 ) ) );
+        edge[6] = edge[7];
+        edge[15] = (SRC(0,-1) + 2*SRC(-1,-1) + SRC(-1,0) + 2) >> 2;
+    }
+
+    if( i_filters & MB_TOP )
+    {
+        /* Without the top right, t8..t15 are replaced by t7, which makes
+         * edge[23] F2(t6,t7,t7) and edge[24..32] t7 */
+        __m128i t = LOADU( &SRC(0,-1) );
+        if( !(i_neighbor & MB_TOPRIGHT) )
+            t = _mm_unpacklo_epi64( t, _mm_set1_epi8( SRC(7,-1) ) );
+        __m128i left = _mm_or_si128( _mm_slli_si128( t, 1 ), _mm_cvtsi32_si128( have_lt ? SRC(-1,-1) : SRC(0,-1) ) );
+        __m128i right = _mm_or_si128( _mm_srli_si128( t, 1 ), _mm_slli_si128( _mm_srli_si128( t, 15 ), 15 ) );
+        __m128i f = lowpass( left, t, right );
+        if( i_filters & MB_TOPRIGHT )
+        {
+            STOREU( edge+16, f );
+            edge[32] = edge[31];
+        }
+        else
+            STOREL( edge+16, f );
+    }
+}
+
+static void predict_8x8_dc_sse2( pixel *src, pixel edge[36] )
+{
+    fill_8xh( src, _mm_set1_epi8( (sum_8( edge+7 ) + sum_8( edge+16 ) + 8) >> 4 ), 8 );
+}
+
+/* Four rows y0, y0+dy, ..: v shifted by 0, 2, 4 and 6 bytes */
+#define STORE_PAIRS( y0, dy, v )\
+    STOREL( src + (y0+0*dy)*FDEC_STRIDE, v );\
+    STOREL( src + (y0+1*dy)*FDEC_STRIDE, _mm_srli_si128( v, 2 ) );\
+    STOREL( src + (y0+2*dy)*FDEC_STRIDE, _mm_srli_si128( v, 4 ) );\
+    STOREL( src + (y0+3*dy)*FDEC_STRIDE, _mm_srli_si128( v, 6 ) );
+
+static void predict_8x8_ddl_sse2( pixel *src, pixel edge[36] )
+{
+    /* t0..t15, then the same shifted down with t15 repeated */
+    __m128i t0 = LOADU( edge+16 );
+    __m128i t1 = _mm_or_si128( _mm_srli_si128( t0, 1 ), _mm_slli_si128( _mm_srli_si128( t0, 15 ), 15 ) );
+    __m128i t2 = _mm_or_si128( _mm_srli_si128( t1, 1 ), _mm_slli_si128( _mm_srli_si128( t1, 15 ), 15 ) );
+    __m128i f = lowpass( t0, t1, t2 );
+    STOREL( src + 0*FDEC_STRIDE, f );
+    STOREL( src + 1*FDEC_STRIDE, _mm_srli_si128( f, 1 ) );
+    STOREL( src + 2*FDEC_STRIDE, _mm_srli_si128( f, 2 ) );
+    STOREL( src + 3*FDEC_STRIDE, _mm_srli_si128( f, 3 ) );
+    STOREL( src + 4*FDEC_STRIDE, _mm_srli_si128( f, 4 ) );
+    STOREL( src + 5*FDEC_STRIDE, _mm_srli_si128( f, 5 ) );
+    STOREL( src + 6*FDEC_STRIDE, _mm_srli_si128( f, 6 ) );
+    STOREL( src + 7*FDEC_STRIDE, _mm_srli_si128( f, 7 ) );
+}
+
+/* edge[7..23] is l7..l0 lt t0..t7 in order, so the modes using the left
+ * edge filter it in one pass: g[k] = F2( edge[7+k], edge[8+k], edge[9+k] ) */
+static void predict_8x8_ddr_sse2( pixel *src, pixel edge[36] )
+{
+    __m128i g = lowpass( LOADU( edge+7 ), LOADU( edge+8 ), LOADU( edge+9 ) );
+    STOREL( src + 0*FDEC_STRIDE, _mm_srli_si128( g, 7 ) );
+    STOREL( src + 1*FDEC_STRIDE, _mm_srli_si128( g, 6 ) );
+    STOREL( src + 2*FDEC_STRIDE, _mm_srli_si128( g, 5 ) );
+    STOREL( src + 3*FDEC_STRIDE, _mm_srli_si128( g, 4 ) );
+    STOREL( src + 4*FDEC_STRIDE, _mm_srli_si128( g, 3 ) );
+    STOREL( src + 5*FDEC_STRIDE, _mm_srli_si128( g, 2 ) );
+    STOREL( src + 6*FDEC_STRIDE, _mm_srli_si128( g, 1 ) );
+    STOREL( src + 7*FDEC_STRIDE, g );
+}
+
+static void predict_8x8_vr_sse2( pixel *src, pixel edge[36] )
+{
+    __m128i e0 = LOADU( edge+7 );
+    __m128i e1 = LOADU( edge+8 );
+    __m128i g = lowpass( e0, e1, LOADU( edge+9 ) );
+    __m128i a = _mm_avg_epu8( e0, e1 );
+    /* Each row is the one two above moved right a pixel, with the next of
+     * g[6], g[5] .. g[1] in front; those are fed from the top of l */
+    __m128i r0 = _mm_srli_si128( a, 8 );
+    __m128i r1 = _mm_srli_si128( g, 7 );
+    __m128i l = _mm_slli_si128( g, 9 );
+    STOREL( src + 0*FDEC_STRIDE, r0 );
+    STOREL( src + 1*FDEC_STRIDE, r1 );
+    for( int y = 2; y < 8; y += 2 )
+    {
+        r0 = _mm_or_si128( _mm_slli_si128( r0, 1 ), _mm_srli_si128( l, 15 ) );
+        l = _mm_slli_si128( l, 1 );
+        r1 = _mm_or_si128( _mm_slli_si128( r1, 1 ), _mm_srli_si128( l, 15 ) );
+        l = _mm_slli_si128( l, 1 );
+        STOREL( src + (y+0)*FDEC_STRIDE, r0 );
+        STOREL( src + (y+1)*FDEC_STRIDE, r1 );
+    }
+}
+
+static void predict_8x8_hd_sse2( pixel *src, pixel edge[36] )
+{
+    __m128i e0 = LOADU( edge+7 );
+    __m128i e1 = LOADU( edge+8 );
+    __m128i g = lowpass( e0, e1, LOADU( edge+9 ) );
+    __m128i a = _mm_avg_epu8( e0, e1 );
+    /* Rows from the bottom are (a,g) pairs moving right by one pair,
+     * continued on the top row by g[8..13] */
+    __m128i lo = _mm_unpacklo_epi8( a, g );
+    __m128i hi = _mm_unpacklo_epi64( _mm_srli_si128( lo, 8 ), _mm_srli_si128( g, 8 ) );
+    STORE_PAIRS( 7, -1, lo );
+    STORE_PAIRS( 3, -1, hi );
+}
+
+static void predict_8x8_vl_sse2( pixel *src, pixel edge[36] )
+{
+    __m128i t0 = LOADU( edge+16 );
+    __m128i t1 = LOADU( edge+17 );
+    __m128i a = _mm_avg_epu8( t0, t1 );
+    __m128i f = lowpass( t0, t1, LOADU( edge+18 ) );
+    STOREL( src + 0*FDEC_STRIDE, a );
+    STOREL( src + 1*FDEC_STRIDE, f );
+    STOREL( src + 2*FDEC_STRIDE, _mm_srli_si128( a, 1 ) );
+    STOREL( src + 3*FDEC_STRIDE, _mm_srli_si128( f, 1 ) );
+    STOREL( src + 4*FDEC_STRIDE, _mm_srli_si128( a, 2 ) );
+    STOREL( src + 5*FDEC_STRIDE, _mm_srli_si128( f, 2 ) );
+    STOREL( src + 6*FDEC_STRIDE, _mm_srli_si128( a, 3 ) );
+    STOREL( src + 7*FDEC_STRIDE, _mm_srli_si128( f, 3 ) );
+}
+
+static void predict_8x8_hu_sse2( pixel *src, pixel edge[36] )
+{
+    /* l0..l7 followed by l7 */
+    __m128i l = _mm_unpacklo_epi8( LOADL( edge+7 ), _mm_setzero_si128() );
+    l = _mm_shuffle_epi32( l, _MM_SHUFFLE(1,0,3,2) );
+    l = _mm_shufflehi_epi16( _mm_shufflelo_epi16( l, _MM_SHUFFLE(0,1,2,3) ), _MM_SHUFFLE(0,1,2,3) );
+    l = _mm_packus_epi16( l, _mm_set1_epi16( edge[7] ) );
+    __m128i l1 = _mm_srli_si128( l, 1 );
+    __m128i a = _mm_avg_epu8( l, l1 );
+    __m128i f = lowpass( l, l1, _mm_srli_si128( l, 2 ) );
+    __m128i lo = _mm_unpacklo_epi8( a, f );
+    __m128i hi = _mm_unpacklo_epi64( _mm_srli_si128( lo, 8 ), _mm_unpackhi_epi8( a, f ) );
+    STORE_PAIRS( 0, 1, lo );
+    STORE_PAIRS( 4, 1, hi );
+}
+
+#undef STORE_PAIRS
+
+/****************************************************************************
+ * 4x4
+ ****************************************************************************/
+#define STORE_4x4( r0, r1, r2, r3 )\
+    M32( &SRC(0,0) ) = r0;\
+    M32( &SRC(0,1) ) = r1;\
+    M32( &SRC(0,2) ) = r2;\
+    M32( &SRC(0,3) ) = r3;
+
+#define ROW( v, n ) _mm_cvtsi128_si32( _mm_srli_si128( v, n ) )
+
+/* l3 l2 l1 l0 lt t0 .. t6 */
+static ALWAYS_INLINE __m128i load_4x4_edge( pixel *src )
+{
+    uint32_t left = SRC(-1,3) | SRC(-1,2) << 8 | SRC(-1,1) << 16 | (uint32_t)SRC(-1,0) << 24;
+    return _mm_or_si128( _mm_cvtsi32_si128( left ), _mm_slli_si128( LOADL( &SRC(-1,-1) ), 4 ) );
+}
+
+static void predict_4x4_ddl_sse2( pixel *src )
+{
+    /* t0..t7 t7 */
+    __m128i t = LOADL( &SRC(0,-1) );
+    t = _mm_or_si128( t, _mm_slli_si128( _mm_srli_epi64( t, 56 ), 8 ) );
+    __m128i f = lowpass( t, _mm_srli_si128( t, 1 ), _mm_srli_si128( t, 2 ) );
+    STORE_4x4( ROW( f, 0 ), ROW( f, 1 ), ROW( f, 2 ), ROW( f, 3 ) );
+}
+
+static void predict_4x4_ddr_sse2( pixel *src )
+{
+    __m128i e = load_4x4_edge( src );
+    __m128i f = lowpass( e, _mm_srli_si128( e, 1 ), _mm_srli_si128( e, 2 ) );
+    STORE_4x4( ROW( f, 3 ), ROW( f, 2 ), ROW( f, 1 ), ROW( f, 0 ) );
+}
+
+static void predict_4x4_vr_sse2( pixel *src )
+{
+    __m128i e = load_4x4_edge( src );
+    __m128i e1 = _mm_srli_si128( e, 1 );
+    __m128i a = _mm_avg_epu8( e, e1 );
+    __m128i f = lowpass( e, e1, _mm_srli_si128( e, 2 ) );
+    uint32_t f1 = ROW( f, 1 );
+    uint32_t f2 = ROW( f, 2 );
+    STORE_4x4( ROW( a, 4 ), ROW( f, 3 ),
+               (ROW( a, 3 ) & ~0xff) | (f2 & 0xff),
+               (f2 & ~0xff) | (f1 & 0xff) );
+}
+
+static void predict_4x4_hd_sse2( pixel *src )
+{
+    __m128i e = load_4x4_edge( src );
+    __m128i e1 = _mm_srli_si128( e, 1 );
+    __m128i a = _mm_avg_epu8( e, e1 );
+    __m128i f = lowpass( e, e1, _mm_srli_si128( e, 2 ) );
+    __m128i p = _mm_unpacklo_epi8( a, f );
+    STORE_4x4( (ROW( p, 6 ) & 0xffff) | (uint32_t)ROW( f, 4 ) << 16,
+               ROW( p, 4 ), ROW( p, 2 ), ROW( p, 0 ) );
+}
+
+static void predict_4x4_vl_sse2( pixel *src )
+{
+    __m128i t = LOADL( &SRC(0,-1) );
+    __m128i t1 = _mm_srli_si128( t, 1 );
+    __m128i a = _mm_avg_epu8( t, t1 );
+    __m128i f = lowpass( t, t1, _mm_srli_si128( t, 2 ) );
+    STORE_4x4( ROW( a, 0 ), ROW( f, 0 ), ROW( a, 1 ), ROW( f, 1 ) );
+}
+
+static void predict_4x4_hu_sse2( pixel *src )
+{
+    /* l0 l1 l2 l3 l3 l3 l3 l3 */
+    uint32_t left = SRC(-1,0) | SRC(-1,1) << 8 | SRC(-1,2) << 16 | (uint32_t)SRC(-1,3) << 24;
+    __m128i l = _mm_unpacklo_epi32( _mm_cvtsi32_si128( left ), _mm_set1_epi8( SRC(-1,3) ) );
+    __m128i l1 = _mm_srli_si128( l, 1 );
+    __m128i a = _mm_avg_epu8( l, l1 );
+    __m128i f = lowpass( l, l1, _mm_srli_si128( l, 2 ) );
+    __m128i p = _mm_unpacklo_epi8( a, f );
+    STORE_4x4( ROW( p, 0 ), ROW( p, 2 ), ROW( p, 4 ), ROW( p, 6 ) );
+}
+
+#undef ROW
+#undef STORE_4x4
+
+/****************************************************************************
+ * x264_predict_*_init_intrin:
+ ****************************************************************************/
+void x264_predict_16x16_init_intrin( int cpu, x264_predict_t pf[7] )
+{
+    if( cpu&X264_CPU_SSE2 )
+    {
+        pf[I_PRED_16x16_V]       = predict_16x16_v_sse2;
+        pf[I_PRED_16x16_H]       = predict_16x16_h_sse2;
+        pf[I_PRED_16x16_DC]      = predict_16x16_dc_sse2;
+        pf[I_PRED_16x16_P]       = predict_16x16_p_sse2;
+        pf[I_PRED_16x16_DC_LEFT] = predict_16x16_dc_left_sse2;
+        pf[I_PRED_16x16_DC_TOP]  = predict_16x16_dc_top_sse2;
+    }
+}
+
+void x264_predict_8x8c_init_intrin( int cpu, x264_predict_t pf[7] )
+{
+    if( cpu&X264_CPU_SSE2 )
+    {
+        pf[I_PRED_CHROMA_DC]      = predict_8x8c_dc_sse2;
+        pf[I_PRED_CHROMA_P]       = predict_8x8c_p_sse2;
+        pf[I_PRED_CHROMA_DC_LEFT] = predict_8x8c_dc_left_sse2;
+        pf[I_PRED_CHROMA_DC_TOP]  = predict_8x8c_dc_top_sse2;
+    }
+}
+
+void x264_predict_8x16c_init_intrin( int cpu, x264_predict_t pf[7] )
+{
+    if( cpu&X264_CPU_SSE2 )
+    {
+        pf[I_PRED_CHROMA_DC] = predict_8x16c_dc_sse2;
+        pf[I_PRED_CHROMA_P]  = predict_8x16c_p_sse2;
+    }
+}
+
+void x264_predict_8x8_init_intrin( int cpu, x264_predict8x8_t pf[12], x264_predict_8x8_filter_t *predict_filter )
+{
+    if( cpu&X264_CPU_SSE2 )
+    {
+        pf[I_PRED_8x8_DC]      = predict_8x8_dc_sse2;
+        pf[I_PRED_8x8_DDL]     = predict_8x8_ddl_sse2;
+        pf[I_PRED_8x8_DDR]     = predict_8x8_ddr_sse2;
+        pf[I_PRED_8x8_VR]      = predict_8x8_vr_sse2;
+        pf[I_PRED_8x8_HD]      = predict_8x8_hd_sse2;
+        pf[I_PRED_8x8_VL]      = predict_8x8_vl_sse2;
+        pf[I_PRED_8x8_HU]      = predict_8x8_hu_sse2;
+        *predict_filter        = predict_8x8_filter_sse2;
+    }
+}
+
+void x264_predict_4x4_init_intrin( int cpu, x264_predict_t pf[12] )
+{
+    if( cpu&X264_CPU_SSE2 )
+    {
+        pf[I_PRED_4x4_DDL] = predict_4x4_ddl_sse2;
+        pf[I_PRED_4x4_DDR] = predict_4x4_ddr_sse2;
+        pf[I_PRED_4x4_VR]  = predict_4x4_vr_sse2;
+        pf[I_PRED_4x4_HD]  = predict_4x4_hd_sse2;
+        pf[I_PRED_4x4_VL]  = predict_4x4_vl_sse2;
+        pf[I_PRED_4x4_HU]  = predict_4x4_hu_sse2;
+    }
+}
+
+#endif // HAVE_X86_INTRIN && !HIGH_BIT_DEPTH
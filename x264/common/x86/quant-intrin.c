@@ -0,0 +1,372 @@
+/*****************************************************************************
+ * quant-intrin.c: x86 quantization and level-run with compiler intrinsics
+ *****************************************************************************
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *****************************************************************************/
+
+#include "common/common.h"
+#include "intrin.h"
+#include <immintrin.h>
+
+#if HAVE_X86_INTRIN && !HIGH_BIT_DEPTH
+
+/* Same results as common/quant.c for every input, including coefficients
+ * of -32768 and bias + |coef| above 16 bits. */
+
+#define LOADU(p)  _mm_loadu_si128( (const __m128i*)(p) )
+#define LOADL(p)  _mm_loadl_epi64( (const __m128i*)(p) )
+#define STOREU(p, v) _mm_storeu_si128( (__m128i*)(p), v )
+#define STOREL(p, v) _mm_storel_epi64( (__m128i*)(p), v )
+
+/****************************************************************************
+ * quant
+ ****************************************************************************/
+/* (bias + |coef|) * mf >> 16 with the sign of coef (coef <= 0 negates).
+ * The sum can carry into bit 16; that adds exactly mf to the product's
+ * high half. */
+static ALWAYS_INLINE __m128i quant_8( __m128i coef, __m128i mf, __m128i bias )
+{
+    const __m128i msb = _mm_set1_epi16( 0x8000 );
+    __m128i a = _mm_max_epi16( coef, _mm_sub_epi16( _mm_setzero_si128(), coef ) );
+    __m128i t = _mm_add_epi16( a, bias );
+    __m128i carry = _mm_cmpgt_epi16( _mm_xor_si128( a, msb ), _mm_xor_si128( t, msb ) );
+    __m128i q = _mm_add_epi16( _mm_mulhi_epu16( t, mf ), _mm_and_si128( carry, mf ) );
+    __m128i neg = _mm_cmpgt_epi16( _mm_set1_epi16( 1 ), coef );
+    return _mm_sub_epi16( _mm_xor_si128( q, neg ), neg );
+}
+
+static ALWAYS_INLINE int nonzero_8( __m128i nz )
+{
+    return _mm_movemask_epi8( _mm_cmpeq_epi16( nz, _mm_setzero_si128() ) ) != 0xffff;
+}
+
+static int quant_4x4_sse2( dctcoef dct[16], udctcoef mf[16], udctcoef bias[16] )
+{
+    __m128i q0 = quant_8( LOADU( dct+0 ), LOADU( mf+0 ), LOADU( bias+0 ) );
+    __m128i q1 = quant_8( LOADU( dct+8 ), LOADU( mf+8 ), LOADU( bias+8 ) );
+    STOREU( dct+0, q0 );
+    STOREU( dct+8, q1 );
+    return nonzero_8( _mm_or_si128( q0, q1 ) );
+}
+
+static int quant_8x8_sse2( dctcoef dct[64], udctcoef mf[64], udctcoef bias[64] )
+{
+    __m128i nz = _mm_setzero_si128();
+    for( int i = 0; i < 64; i += 8 )
+    {
+        __m128i q = quant_8( LOADU( dct+i ), LOADU( mf+i ), LOADU( bias+i ) );
+        STOREU( dct+i, q );
+        nz = _mm_or_si128( nz, q );
+    }
+    return nonzero_8( nz );
+}
+
+/* bit j set if block j has a nonzero coefficient left */
+static int quant_4x4x4_sse2( dctcoef dct[4][16], udctcoef mf[16], udctcoef bias[16] )
+{
+    const __m128i mf0 = LOADU( mf+0 ), mf1 = LOADU( mf+8 );
+    const __m128i bias0 = LOADU( bias+0 ), bias1 = LOADU( bias+8 );
+    __m128i zero[4];
+    for( int j = 0; j < 4; j++ )
+    {
+        __m128i q0 = quant_8( LOADU( dct[j]+0 ), mf0, bias0 );
+        __m128i q1 = quant_8( LOADU( dct[j]+8 ), mf1, bias1 );
+        STOREU( dct[j]+0, q0 );
+        STOREU( dct[j]+8, q1 );
+        zero[j] = _mm_cmpeq_epi16( _mm_or_si128( q0, q1 ), _mm_setzero_si128() );
+    }
+    /* one byte per block of the all-zero flags, then one bit per block */
+    __m128i z = _mm_packs_epi16( _mm_packs_epi32( zero[0], zero[1] ), _mm_packs_epi32( zero[2], zero[3] ) );
+    z = _mm_cmpeq_epi32( z, _mm_set1_epi32( -1 ) );
+    return ~_mm_movemask_ps( _mm_castsi128_ps( z ) ) & 0xf;
+}
+
+static int quant_4x4_dc_sse2( dctcoef dct[16], int mf, int bias )
+{
+    const __m128i mfv = _mm_set1_epi16( mf );
+    const __m128i biasv = _mm_set1_epi16( bias );
+    __m128i q0 = quant_8( LOADU( dct+0 ), mfv, biasv );
+    __m128i q1 = quant_8( LOADU( dct+8 ), mfv, biasv );
+    STOREU( dct+0, q0 );
+    STOREU( dct+8, q1 );
+    return nonzero_8( _mm_or_si128( q0, q1 ) );
+}
+
+static int quant_2x2_dc_sse2( dctcoef dct[4], int mf, int bias )
+{
+    __m128i q = quant_8( LOADL( dct ), _mm_set1_epi16( mf ), _mm_set1_epi16( bias ) );
+    STOREL( dct, q );
+    return nonzero_8( _mm_unpacklo_epi64( q, _mm_setzero_si128() ) );
+}
+
+/****************************************************************************
+ * dequant
+ ****************************************************************************/
+static ALWAYS_INLINE __m128i load_mf_8( const int *mf )
+{
+    return _mm_packs_epi32( LOADU( mf+0 ), LOADU( mf+4 ) );
+}
+
+/* ( dct * mf + f ) >> shift as (dct, 1) . (mf, f) in 32 bits */
+static ALWAYS_INLINE __m128i dequant_shr_8( __m128i dct, __m128i mf, __m128i f, int shift )
+{
+    __m128i lo = _mm_madd_epi16( _mm_unpacklo_epi16( dct, _mm_set1_epi16( 1 ) ), _mm_unpacklo_epi16( mf, f ) );
+    __m128i hi = _mm_madd_epi16( _mm_unpackhi_epi16( dct, _mm_set1_epi16( 1 ) ), _mm_unpackhi_epi16( mf, f ) );
+    return _mm_packs_epi32( _mm_srai_epi32( lo, shift ), _mm_srai_epi32( hi, shift ) );
+}
+
+/* only the low 16 bits of dct * mf << qbits survive the store, as in C */
+static ALWAYS_INLINE void dequant_wxh( dctcoef *dct, int *dequant_mf, int i_qbits, int n )
+{
+    if( i_qbits >= 0 )
+    {
+        const __m128i shift = _mm_cvtsi32_si128( i_qbits );
+        for( int i = 0; i < n; i += 8 )
+            STOREU( dct+i, _mm_sll_epi16( _mm_mullo_epi16( LOADU( dct+i ), load_mf_8( dequant_mf+i ) ), shift ) );
+    }
+    else
+    {
+        const __m128i f = _mm_set1_epi16( 1 << (-i_qbits-1) );
+        for( int i = 0; i < n; i += 8 )
+            STOREU( dct+i, dequant_shr_8( LOADU( dct+i ), load_mf_8( dequant_mf+i ), f, -i_qbits ) );
+    }
+}
+
+static void dequant_4x4_sse2( dctcoef dct[16], int dequant_mf[6][16], int i_qp )
+{
+    dequant_wxh( dct, dequant_mf[i_qp%6], i_qp/6 - 4, 16 );
+}
+
+static void dequant_8x8_sse2( dctcoef dct[64], int dequant_mf[6][64], int i_qp )
+{
+    dequant_wxh( dct, dequant_mf[i_qp%6], i_qp/6 - 6, 64 );
+}
+
+static void dequant_4x4_dc_sse2( dctcoef dct[16], int dequant_mf[6][16], int i_qp )
+{
+    const int i_qbits = i_qp/6 - 6;
+
+    if( i_qbits >= 0 )
+    {
+        const __m128i dmf = _mm_set1_epi16( dequant_mf[i_qp%6][0] << i_qbits );
+        STOREU( dct+0, _mm_mullo_epi16( LOADU( dct+0 ), dmf ) );
+        STOREU( dct+8, _mm_mullo_epi16( LOADU( dct+8 ), dmf ) );
+    }
+    else
+    {
+        const __m128i dmf = _mm_set1_epi16( dequant_mf[i_qp%6][0] );
+        const __m128i f = _mm_set1_epi16( 1 << (-i_qbits-1) );
+        STOREU( dct+0, dequant_shr_8( LOADU( dct+0 ), dmf, f, -i_qbits ) );
+        STOREU( dct+8, dequant_shr_8( LOADU( dct+8 ), dmf, f, -i_qbits ) );
+    }
+}
+
+/****************************************************************************
+ * denoise
+ ****************************************************************************/
+static void denoise_dct_sse2( dctcoef *dct, uint32_t *sum, udctcoef *offset, int size )
+{
+    const __m128i zero = _mm_setzero_si128();
+    for( int i = 0; i < size; i += 8 )
+    {
+        __m128i v = LOADU( dct+i );
+        __m128i sign = _mm_srai_epi16( v, 15 );
+        /* |-32768| comes out as 0x8000, which is right as unsigned */
+        __m128i level = _mm_sub_epi16( _mm_xor_si128( v, sign ), sign );
+        STOREU( sum+i+0, _mm_add_epi32( LOADU( sum+i+0 ), _mm_unpacklo_epi16( level, zero ) ) );
+        STOREU( sum+i+4, _mm_add_epi32( LOADU( sum+i+4 ), _mm_unpackhi_epi16( level, zero ) ) );
+        level = _mm_subs_epu16( level, LOADU( offset+i ) );
+        STOREU( dct+i, _mm_sub_epi16( _mm_xor_si128( level, sign ), sign ) );
+    }
+}
+
+/****************************************************************************
+ * decimate, coeff_last and level-run: nonzero bitmasks
+ ****************************************************************************/
+/* bit i set where a[i] (i < 8) or b[i-8] is zero */
+static ALWAYS_INLINE int zero_mask_16( __m128i a, __m128i b )
+{
+    const __m128i zero = _mm_setzero_si128();
+    return _mm_movemask_epi8( _mm_packs_epi16( _mm_cmpeq_epi16( a, zero ), _mm_cmpeq_epi16( b, zero ) ) );
+}
+
+static ALWAYS_INLINE uint32_t nonzero_mask_16( const dctcoef *dct )
+{
+    return ~zero_mask_16( LOADU( dct+0 ), LOADU( dct+8 ) ) & 0xffff;
+}
+
+static ALWAYS_INLINE uint64_t nonzero_mask_64( const dctcoef *dct )
+{
+    uint64_t mask = 0;
+    for( int i = 0; i < 4; i++ )
+        mask |= (uint64_t)nonzero_mask_16( dct + 16*i ) << (16*i);
+    return mask;
+}
+
+/* any coefficient outside [-1,1], ignoring those masked out by keep */
+static ALWAYS_INLINE int any_big_8( __m128i v, __m128i keep )
+{
+    __m128i big = _mm_or_si128( _mm_cmpgt_epi16( v, _mm_set1_epi16( 1 ) ), _mm_cmpgt_epi16( _mm_set1_epi16( -1 ), v ) );
+    return _mm_movemask_epi8( _mm_and_si128( big, keep ) );
+}
+
+/* every nonzero adds ds_table[zeros below it, down to the next nonzero] */
+static ALWAYS_INLINE int decimate_score_mask( uint64_t mask, const uint8_t *ds_table )
+{
+    int i_score = 0;
+    while( mask )
+    {
+        int idx = 63 - __builtin_clzll( mask );
+        mask ^= 1ULL << idx;
+        int below = mask ? 63 - __builtin_clzll( mask ) : -1;
+        i_score += ds_table[idx - below - 1];
+    }
+    return i_score;
+}
+
+static int decimate_score15_sse2( dctcoef *dct )
+{
+    /* dct[0] is the DC and takes no part */
+    __m128i v0 = LOADU( dct+0 ), v1 = LOADU( dct+8 );
+    const __m128i all = _mm_set1_epi16( -1 );
+    if( any_big_8( v0, _mm_insert_epi16( all, 0, 0 ) ) | any_big_8( v1, all ) )
+        return 9;
+    uint32_t mask = ~zero_mask_16( v0, v1 ) & 0xfffe;
+    return decimate_score_mask( mask >> 1, x264_decimate_table4 );
+}
+
+static int decimate_score16_sse2( dctcoef *dct )
+{
+    __m128i v0 = LOADU( dct+0 ), v1 = LOADU( dct+8 );
+    const __m128i all = _mm_set1_epi16( -1 );
+    if( any_big_8( v0, all ) | any_big_8( v1, all ) )
+        return 9;
+    return decimate_score_mask( ~zero_mask_16( v0, v1 ) & 0xffff, x264_decimate_table4 );
+}
+
+static int decimate_score64_sse2( dctcoef *dct )
+{
+    const __m128i all = _mm_set1_epi16( -1 );
+    int big = 0;
+    for( int i = 0; i < 64; i += 8 )
+        big |= any_big_8( LOADU( dct+i ), all );
+    if( big )
+        return 9;
+    return decimate_score_mask( nonzero_mask_64( dct ), x264_decimate_table8 );
+}
+
+static int coeff_last4_sse2( dctcoef *dct )
+{
+    uint32_t mask = ~zero_mask_16( LOADL( dct ), _mm_setzero_si128() ) & 0xf;
+    return mask ? 31 - x264_clz( mask ) : -1;
+}
+
+static int coeff_last8_sse2( dctcoef *dct )
+{
+    uint32_t mask = ~zero_mask_16( LOADU( dct ), _mm_setzero_si128() ) & 0xff;
+    return mask ? 31 - x264_clz( mask ) : -1;
+}
+
+/* The 15-coefficient blocks are AC blocks, so dct[-1] is the DC and can be
+ * read along with them. */
+static int coeff_last15_sse2( dctcoef *dct )
+{
+    uint32_t mask = nonzero_mask_16( dct-1 ) & 0xfffe;
+    return mask ? 30 - x264_clz( mask ) : -1;
+}
+
+static int coeff_last16_sse2( dctcoef *dct )
+{
+    uint32_t mask = nonzero_mask_16( dct );
+    return mask ? 31 - x264_clz( mask ) : -1;
+}
+
+static int coeff_last64_sse2( dctcoef *dct )
+{
+    uint64_t mask = nonzero_mask_64( dct );
+    return mask ? 63 - __builtin_clzll( mask ) : -1;
+}
+
+/* Levels from the last nonzero down; like the C version, only valid for
+ * blocks with at least one nonzero coefficient. */
+static ALWAYS_INLINE int coeff_level_run_mask( dctcoef *dct, x264_run_level_t *runlevel, uint32_t mask )
+{
+    int i_total = 0;
+    runlevel->last = 31 - x264_clz( mask );
+    runlevel->mask = mask;
+    do
+    {
+        int idx = 31 - x264_clz( mask );
+        runlevel->level[i_total++] = dct[idx];
+        mask ^= 1U << idx;
+    } while( mask );
+    return i_total;
+}
+
+static int coeff_level_run4_sse2( dctcoef *dct, x264_run_level_t *runlevel )
+{
+    return coeff_level_run_mask( dct, runlevel, ~zero_mask_16( LOADL( dct ), _mm_setzero_si128() ) & 0xf );
+}
+
+static int coeff_level_run8_sse2( dctcoef *dct, x264_run_level_t *runlevel )
+{
+    return coeff_level_run_mask( dct, runlevel, ~zero_mask_16( LOADU( dct ), _mm_setzero_si128() ) & 0xff );
+}
+
+static int coeff_level_run15_sse2( dctcoef *dct, x264_run_level_t *runlevel )
+{
+    return coeff_level_run_mask( dct, runlevel, nonzero_mask_16( dct-1 ) >> 1 );
+}
+
+static int coeff_level_run16_sse2( dctcoef *dct, x264_run_level_t *runlevel )
+{
+    return coeff_level_run_mask( dct, runlevel, nonzero_mask_16( dct ) );
+}
+
+/****************************************************************************
+ * x264_quant_init_intrin:
+ ****************************************************************************/
+void x264_quant_init_intrin( int cpu, x264_quant_function_t *pf )
+{
+    if( cpu&X264_CPU_SSE2 )
+    {
+        pf->quant_4x4 = quant_4x4_sse2;
+        pf->quant_4x4x4 = quant_4x4x4_sse2;
+        pf->quant_8x8 = quant_8x8_sse2;
+        pf->quant_4x4_dc = quant_4x4_dc_sse2;
+        pf->quant_2x2_dc = quant_2x2_dc_sse2;
+
+        pf->dequant_4x4 = dequant_4x4_sse2;
+        pf->dequant_4x4_dc = dequant_4x4_dc_sse2;
+        pf->dequant_8x8 = dequant_8x8_sse2;
+
+        pf->denoise_dct = denoise_dct_sse2;
+        pf->decimate_score15 = decimate_score15_sse2;
+        pf->decimate_score16 = decimate_score16_sse2;
+        pf->decimate_score64 = decimate_score64_sse2;
+
+        pf->coeff_last4 = coeff_last4_sse2;
+        pf->coeff_last8 = coeff_last8_sse2;
+        pf->coeff_last[  DCT_LUMA_AC] = coeff_last15_sse2;
+        pf->coeff_last[ DCT_LUMA_4x4] = coeff_last16_sse2;
+        pf->coeff_last[ DCT_LUMA_8x8] = coeff_last64_sse2;
+        pf->coeff_level_run4 = coeff_level_run4_sse2;
+        pf->coeff_level_run8 = coeff_level_run8_sse2;
+        pf->coeff_level_run[  DCT_LUMA_AC] = coeff_level_run15_sse2;
+        pf->coeff_level_run[ DCT_LUMA_4x4] = coeff_level_run16_sse2;
+    }
+}
+
+#endif // HAVE_X86_INTRIN && !HIGH_BIT_DEPTH
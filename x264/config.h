@@ -13,18 +13,34 @@
 #define HAVE_ALTIVEC 0
 #define HAVE_ALTIVEC_H 0
 #define HAVE_MMX 0
+// Compiler intrinsic kernels (common/x86/*-intrin.c) in native x86-64
+// builds, picked at runtime from x264_cpu_detect flags
+#if defined(__x86_64__) && !defined(__native_client__)
+#define HAVE_X86_INTRIN 1
+#else
+#define HAVE_X86_INTRIN 0
+#endif
 #define HAVE_ARMV6 0
 #define HAVE_ARMV6T2 0
 #define HAVE_NEON 0
 #define HAVE_BEOSTHREAD 0
-#define HAVE_POSIXTHREAD 0
 #define HAVE_WIN32THREAD 0
+// Threaded encoding (frame/sliced threads, threaded lookahead) in the
+// native Linux build; the NaCl module stays single-threaded
+#if defined(__linux__) && !defined(__native_client__)
+#define SYS_LINUX 1
+#define HAVE_POSIXTHREAD 1
+#define HAVE_THREAD 1
+#define HAVE_CPU_COUNT 1
+#else
+#define HAVE_POSIXTHREAD 0
 #define HAVE_THREAD 0
+#define HAVE_CPU_COUNT 0
+#endif
 #define HAVE_SWSCALE 0
 #define HAVE_LAVF 0
 #define HAVE_FFMS 0
 #define HAVE_GPAC 0
-#define HAVE_CPU_COUNT 0
 #define HAVE_OPENCL 0
 #define HAVE_THP 0
 #define HAVE_LSMASH 0
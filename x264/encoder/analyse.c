@@ -134,6 +134,11 @@ typedef struct
     int b_direct_available;
     int b_early_terminate;
 
+    /* Mode families left out by the fast mode decision (analyse.i_fast_decision) */
+    int b_skip_sub8x8;
+    int b_skip_i4x4;
+    int b_skip_bidir_refine;
+
 } x264_mb_analysis_t;
 
 /* lambda = pow(2,qp/6-2) */
@@ -307,7 +312,7 @@ int x264_analyse_init_costs( x264_t *h, float *logs, int qp )
         for( int j = 0; j < 33; j++ )
             x264_cost_ref[qp][i][j] = X264_MIN( i ? lambda * bs_size_te( i, j ) : 0, (1<<16)-1 );
     x264_pthread_mutex_unlock( &cost_ref_mutex );
-    if( h->param.analyse.i_me_method >= X264_ME_ESA && !h->cost_mv_fpel[qp][0] )
+    if( X264_ME_EXHAUSTIVE( h->param.analyse.i_me_method ) && !h->cost_mv_fpel[qp][0] )
     {
         for( int j = 0; j < 4; j++ )
         {
@@ -412,6 +417,74 @@ static void x264_mb_analyse_init_qp( x264_t *h, x264_mb_analysis_t *a, int qp )
     h->mb.i_chroma_qp = h->chroma_qp_table[qp];
 }
 
+/* Fast mode decision: before any search, decide which families of modes
+ * this MB can do without, from features that cost next to nothing.
+ *  - AC energy of the luma block against lambda2: flat blocks are coded
+ *    as well with i16x16 as with i4x4. (Early termination already keeps
+ *    sub-8x8 off them, so that family goes by neighbours alone, from
+ *    strength 2.)
+ *  - The lookahead's lowres costs of this MB for the frame's references:
+ *    intra far behind inter there rarely wins at full resolution, and
+ *    neither does bidir when the lookahead preferred one list.
+ *  - Neighbour modes: a family a neighbour picked is always tried, whatever
+ *    the features above say. P_8x8 counts as sub-8x8 (the MB type does not
+ *    record the sub-partitions) and I_8x8 as i4x4.
+ * Higher strengths skip on weaker evidence. */
+static void x264_mb_analyse_fast_decision( x264_t *h, x264_mb_analysis_t *a )
+{
+    static const uint8_t intra_ratio[4] = { 0, 24, 20, 16 }; /* lowres intra/inter, in 1/16 */
+    const int strength = h->param.analyse.i_fast_decision;
+    const int neighbours[4] = { h->mb.i_mb_type_left[0], h->mb.i_mb_type_top,
+                                h->mb.i_mb_type_topleft, h->mb.i_mb_type_topright };
+    int b_near_intra = 0, b_near_i4x4 = 0, b_near_p8x8 = 0, b_near_bidir = 0;
+
+    for( int i = 0; i < 4; i++ )
+    {
+        int type = neighbours[i];
+        if( type < 0 )
+            continue;
+        b_near_intra  |= IS_INTRA( type );
+        b_near_i4x4   |= type == I_4x4 || type == I_8x8;
+        b_near_p8x8   |= type == P_8x8;
+        for( int part = 0; part < 2; part++ )
+            b_near_bidir |= x264_mb_type_list_table[type][0][part] && x264_mb_type_list_table[type][1][part];
+    }
+
+    /* Same measure as x264_ac_energy_mb, on the luma already in the fenc cache */
+    uint64_t var = h->pixf.var[PIXEL_16x16]( h->mb.pic.p_fenc[0], FENC_STRIDE );
+    uint32_t sum = (uint32_t)var;
+    uint64_t energy = (var >> 32) - (((uint64_t)sum * sum) >> 8);
+    int b_flat = energy < ((uint64_t)a->i_lambda2 << strength);
+
+    /* The lookahead only fills in edge MBs when it needs per-MB costs */
+    int b_lowres = 0, b_intra_unlikely = 0, b_bidir_unlikely = 0;
+    int b_edge = h->mb.i_mb_x == 0 || h->mb.i_mb_x == h->mb.i_mb_width - 1 ||
+                 h->mb.i_mb_y == 0 || h->mb.i_mb_y == h->mb.i_mb_height - 1;
+    if( h->sh.i_type != SLICE_TYPE_I && h->frames.b_have_lowres && !PARAM_INTERLACED && h->fenc->b_intra_calculated &&
+        (!b_edge || h->param.rc.b_mb_tree || h->param.rc.i_vbv_buffer_size) )
+    {
+        x264_frame_t *fenc = h->fenc;
+        int dist0 = fenc->i_frame - h->fref[0][0]->i_frame;
+        int dist1 = h->sh.i_type == SLICE_TYPE_B ? h->fref[1][0]->i_frame - fenc->i_frame : 0;
+        if( dist0 > 0 && dist0 <= h->param.i_bframe + 1 && dist1 >= 0 && dist1 <= h->param.i_bframe + 1 &&
+            fenc->i_cost_est[dist0][dist1] >= 0 )
+        {
+            int lowres = fenc->lowres_costs[dist0][dist1][h->mb.i_mb_xy];
+            int lowres_cost = lowres & LOWRES_COST_MASK;
+            int lowres_list = lowres >> LOWRES_COST_SHIFT;
+            b_lowres = 1;
+            /* list 0 means intra already won in the lookahead */
+            b_intra_unlikely = lowres_list && fenc->i_intra_cost[h->mb.i_mb_xy] * 16 > lowres_cost * intra_ratio[strength];
+            b_bidir_unlikely = lowres_list != 3;
+        }
+    }
+
+    a->b_skip_sub8x8 = !b_near_p8x8 && strength >= 2;
+    a->b_skip_i4x4 = !a->b_force_intra && !b_near_i4x4 && (b_flat || (b_intra_unlikely && !b_near_intra));
+    if( h->sh.i_type == SLICE_TYPE_B )
+        a->b_skip_bidir_refine = !b_near_bidir && (b_lowres ? b_bidir_unlikely : strength >= 3);
+}
+
 static void x264_mb_analyse_init( x264_t *h, x264_mb_analysis_t *a, int qp )
 {
     int subme = h->param.analyse.i_subpel_refine - (h->sh.i_type == SLICE_TYPE_B);
@@ -595,6 +668,12 @@ static void x264_mb_analyse_init( x264_t *h, x264_mb_analysis_t *a, int qp )
         else
             a->b_force_intra = 0;
     }
+
+    a->b_skip_sub8x8 =
+    a->b_skip_i4x4 =
+    a->b_skip_bidir_refine = 0;
+    if( h->param.analyse.i_fast_decision )
+        x264_mb_analyse_fast_decision( h, a );
 }
 
 /* Prediction modes allowed for various combinations of neighbors. */
@@ -986,7 +1065,7 @@ static void x264_mb_analyse_intra( x264_t *h, x264_mb_analysis_t *a, int i_satd_
     }
 
     /* 4x4 prediction selection */
-    if( flags & X264_ANALYSE_I4x4 )
+    if( (flags & X264_ANALYSE_I4x4) && !a->b_skip_i4x4 )
     {
         int i_cost = lambda * (24+16); /* 24from JVT (SATD0), 16 from base predmode costs */
         int i_satd_thresh = a->b_early_terminate ? X264_MIN3( i_satd_inter, a->i_satd_i16x16, a->i_satd_i8x8 ) : COST_MAX;
@@ -1356,6 +1435,7 @@ static void x264_intra_rd_refine( x264_t *h, x264_mb_analysis_t *a )
     (m)->integral = &h->mb.pic.p_integral[list][ref][(xoff)+(yoff)*(m)->i_stride[0]]; \
     (m)->weight = x264_weight_none; \
     (m)->i_ref = ref; \
+    (m)->i_list = list; \
 }
 
 #define LOAD_WPELS(m, src, list, ref, xoff, yoff) \
@@ -2693,7 +2773,7 @@ static void x264_mb_analyse_p_rd( x264_t *h, x264_mb_analysis_t *a, int i_satd )
     {
         h->mb.i_type = P_8x8;
         h->mb.i_partition = D_8x8;
-        if( h->param.analyse.inter & X264_ANALYSE_PSUB8x8 )
+        if( (h->param.analyse.inter & X264_ANALYSE_PSUB8x8) && !a->b_skip_sub8x8 )
         {
             x264_macroblock_cache_ref( h, 0, 0, 2, 2, 0, a->l0.me8x8[0].i_ref );
             x264_macroblock_cache_ref( h, 2, 0, 2, 2, 0, a->l0.me8x8[1].i_ref );
@@ -3044,6 +3124,9 @@ void x264_macroblock_analyse( x264_t *h )
     if( h->param.analyse.b_mb_info )
         h->fdec->effective_qp[h->mb.i_mb_xy] = h->mb.i_qp; /* Store the real analysis QP. */
     x264_mb_analyse_init( h, &analysis, h->mb.i_qp );
+    /* Until the l0 ref0 16x16 search measures it: intra and skipped MBs
+     * leave no cost for me=epzs to use */
+    h->mb.epzs_cost[h->mb.i_mb_xy] = COST_MAX;
 
     /*--------------------------- Do the analysis ---------------------------*/
     if( h->sh.i_type == SLICE_TYPE_I )
@@ -3180,7 +3263,7 @@ skip_analysis:
                 i_cost = analysis.l0.i_cost8x8;
 
                 /* Do sub 8x8 */
-                if( flags & X264_ANALYSE_PSUB8x8 )
+                if( (flags & X264_ANALYSE_PSUB8x8) && !analysis.b_skip_sub8x8 )
                 {
                     for( int i = 0; i < 4; i++ )
                     {
@@ -3740,7 +3823,7 @@ skip_analysis:
 
             if( analysis.i_mbrd >= 2 && IS_INTRA( i_type ) && i_type != I_PCM )
                 x264_intra_rd_refine( h, &analysis );
-            if( h->mb.i_subpel_refine >= 5 )
+            if( h->mb.i_subpel_refine >= 5 && !analysis.b_skip_bidir_refine )
                 x264_refine_bidir( h, &analysis );
 
             if( analysis.i_mbrd >= 2 && i_type > B_DIRECT && i_type < B_SKIP )
@@ -3760,7 +3843,7 @@ skip_analysis:
                         analysis.l1.me16x16.cost = i_cost;
                         x264_me_refine_qpel_rd( h, &analysis.l1.me16x16, analysis.i_lambda2, 0, 1 );
                     }
-                    else if( i_type == B_BI_BI )
+                    else if( i_type == B_BI_BI && !analysis.b_skip_bidir_refine )
                     {
                         i_biweight = h->mb.bipred_weight[analysis.l0.bi16x16.i_ref][analysis.l1.bi16x16.i_ref];
                         x264_me_refine_bidir_rd( h, &analysis.l0.bi16x16, &analysis.l1.bi16x16, i_biweight, 0, analysis.i_lambda2 );
@@ -3775,7 +3858,7 @@ skip_analysis:
                             x264_me_refine_qpel_rd( h, &analysis.l0.me16x8[i], analysis.i_lambda2, i*8, 0 );
                         else if( analysis.i_mb_partition16x8[i] == D_L1_8x8 )
                             x264_me_refine_qpel_rd( h, &analysis.l1.me16x8[i], analysis.i_lambda2, i*8, 1 );
-                        else if( analysis.i_mb_partition16x8[i] == D_BI_8x8 )
+                        else if( analysis.i_mb_partition16x8[i] == D_BI_8x8 && !analysis.b_skip_bidir_refine )
                         {
                             i_biweight = h->mb.bipred_weight[analysis.l0.me16x8[i].i_ref][analysis.l1.me16x8[i].i_ref];
                             x264_me_refine_bidir_rd( h, &analysis.l0.me16x8[i], &analysis.l1.me16x8[i], i_biweight, i*2, analysis.i_lambda2 );
@@ -3791,7 +3874,7 @@ skip_analysis:
                             x264_me_refine_qpel_rd( h, &analysis.l0.me8x16[i], analysis.i_lambda2, i*4, 0 );
                         else if( analysis.i_mb_partition8x16[i] == D_L1_8x8 )
                             x264_me_refine_qpel_rd( h, &analysis.l1.me8x16[i], analysis.i_lambda2, i*4, 1 );
-                        else if( analysis.i_mb_partition8x16[i] == D_BI_8x8 )
+                        else if( analysis.i_mb_partition8x16[i] == D_BI_8x8 && !analysis.b_skip_bidir_refine )
                         {
                             i_biweight = h->mb.bipred_weight[analysis.l0.me8x16[i].i_ref][analysis.l1.me8x16[i].i_ref];
                             x264_me_refine_bidir_rd( h, &analysis.l0.me8x16[i], &analysis.l1.me8x16[i], i_biweight, i, analysis.i_lambda2 );
@@ -3806,7 +3889,7 @@ skip_analysis:
                             x264_me_refine_qpel_rd( h, &analysis.l0.me8x8[i], analysis.i_lambda2, i*4, 0 );
                         else if( h->mb.i_sub_partition[i] == D_L1_8x8 )
                             x264_me_refine_qpel_rd( h, &analysis.l1.me8x8[i], analysis.i_lambda2, i*4, 1 );
-                        else if( h->mb.i_sub_partition[i] == D_BI_8x8 )
+                        else if( h->mb.i_sub_partition[i] == D_BI_8x8 && !analysis.b_skip_bidir_refine )
                         {
                             i_biweight = h->mb.bipred_weight[analysis.l0.me8x8[i].i_ref][analysis.l1.me8x8[i].i_ref];
                             x264_me_refine_bidir_rd( h, &analysis.l0.me8x8[i], &analysis.l1.me8x8[i], i_biweight, i, analysis.i_lambda2 );
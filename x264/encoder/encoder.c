@@ -442,6 +442,22 @@ static int x264_validate_parameters( x264_t *h, int b_open )
         }
     }
 #endif
+#if HAVE_X86_INTRIN
+    if( b_open )
+    {
+        /* A forced cpu mask (--asm) must not select kernels this cpu can't run.
+         * Only the instruction set flags are checked; the tuning flags are hints. */
+        uint32_t isa = X264_CPU_CMOV|X264_CPU_MMX|X264_CPU_MMX2|X264_CPU_SSE|X264_CPU_SSE2|X264_CPU_SSE3|
+                       X264_CPU_SSSE3|X264_CPU_SSE4|X264_CPU_SSE42|X264_CPU_LZCNT|X264_CPU_AVX|X264_CPU_XOP|
+                       X264_CPU_FMA4|X264_CPU_AVX2|X264_CPU_FMA3|X264_CPU_BMI1|X264_CPU_BMI2;
+        uint32_t unsupported = h->param.cpu & isa & ~x264_cpu_detect();
+        if( unsupported )
+        {
+            x264_log( h, X264_LOG_WARNING, "cpu flags 0x%x are not supported by this cpu, ignored\n", unsupported );
+            h->param.cpu &= ~unsupported;
+        }
+    }
+#endif
 
 #if HAVE_INTERLACED
     h->param.b_interlaced = !!PARAM_INTERLACED;
@@ -907,6 +923,17 @@ static int x264_validate_parameters( x264_t *h, int b_open )
     if( h->param.i_slice_count_max > 0 )
         h->param.i_slice_count_max = X264_MAX( h->param.i_slice_count, h->param.i_slice_count_max );
 
+    /* The helper thread deblocks a row while the next one is encoded, which is only
+     * safe when nothing re-encodes across rows or deblocks across slices: one
+     * progressive slice per frame. Sliced threads already deblock in parallel. */
+    if( h->param.b_deblock_thread &&
+        (!HAVE_THREAD || h->param.b_sliced_threads || PARAM_INTERLACED || !h->param.b_deblocking_filter ||
+         h->param.i_slice_max_size || h->param.i_slice_max_mbs || h->param.i_slice_count > 1) )
+    {
+        x264_log( h, X264_LOG_WARNING, "deblock-thread requires a single progressive slice per frame, disabling\n" );
+        h->param.b_deblock_thread = 0;
+    }
+
     if( h->param.b_bluray_compat )
     {
         h->param.i_bframe_pyramid = X264_MIN( X264_B_PYRAMID_STRICT, h->param.i_bframe_pyramid );
@@ -1019,10 +1046,12 @@ static int x264_validate_parameters( x264_t *h, int b_open )
         h->param.i_cqm_preset = X264_CQM_FLAT;
 
     if( h->param.analyse.i_me_method < X264_ME_DIA ||
-        h->param.analyse.i_me_method > X264_ME_TESA )
+        h->param.analyse.i_me_method > X264_ME_PYRAMID )
         h->param.analyse.i_me_method = X264_ME_HEX;
     h->param.analyse.i_me_range = x264_clip3( h->param.analyse.i_me_range, 4, 1024 );
-    if( h->param.analyse.i_me_range > 16 && h->param.analyse.i_me_method <= X264_ME_HEX )
+    if( h->param.analyse.i_me_range > 16 && (h->param.analyse.i_me_method <= X264_ME_HEX ||
+                                             h->param.analyse.i_me_method == X264_ME_LOWRES ||
+                                             h->param.analyse.i_me_method == X264_ME_PYRAMID) )
         h->param.analyse.i_me_range = 16;
     if( h->param.analyse.i_me_method == X264_ME_TESA &&
         (h->mb.b_lossless || h->param.analyse.i_subpel_refine <= 1) )
@@ -1039,6 +1068,7 @@ static int x264_validate_parameters( x264_t *h, int b_open )
         h->param.analyse.intra &= ~X264_ANALYSE_I8x8;
     }
     h->param.analyse.i_trellis = x264_clip3( h->param.analyse.i_trellis, 0, 2 );
+    h->param.analyse.i_fast_decision = x264_clip3( h->param.analyse.i_fast_decision, 0, 3 );
     h->param.rc.i_aq_mode = x264_clip3( h->param.rc.i_aq_mode, 0, 2 );
     h->param.rc.f_aq_strength = x264_clip3f( h->param.rc.f_aq_strength, 0, 3 );
     if( h->param.rc.f_aq_strength == 0 )
@@ -1165,7 +1195,7 @@ static int x264_validate_parameters( x264_t *h, int b_open )
 
     if( PARAM_INTERLACED )
     {
-        if( h->param.analyse.i_me_method >= X264_ME_ESA )
+        if( X264_ME_EXHAUSTIVE( h->param.analyse.i_me_method ) )
         {
             x264_log( h, X264_LOG_WARNING, "interlace + me=esa is not implemented\n" );
             h->param.analyse.i_me_method = X264_ME_UMH;
@@ -1237,6 +1267,7 @@ static int x264_validate_parameters( x264_t *h, int b_open )
     BOOLIFY( b_deblocking_filter );
     BOOLIFY( b_deterministic );
     BOOLIFY( b_sliced_threads );
+    BOOLIFY( b_deblock_thread );
     BOOLIFY( b_interlaced );
     BOOLIFY( b_intra_refresh );
     BOOLIFY( b_aud );
@@ -1460,6 +1491,7 @@ x264_t *x264_encoder_open( x264_param_t *param )
           || h->param.analyse.i_weighted_pred );
     h->frames.b_have_lowres |= h->param.rc.b_stat_read && h->param.rc.i_vbv_buffer_size > 0;
     h->frames.b_have_sub8x8_esa = !!(h->param.analyse.inter & X264_ANALYSE_PSUB8x8);
+    h->frames.b_have_lowres_pyramid = h->frames.b_have_lowres && h->param.analyse.i_me_method == X264_ME_PYRAMID;
 
     h->frames.i_last_idr =
     h->frames.i_last_keyframe = - h->param.i_keyint_max;
@@ -1574,6 +1606,9 @@ x264_t *x264_encoder_open( x264_param_t *param )
     if( h->param.i_lookahead_threads > 1 &&
         x264_threadpool_init( &h->lookaheadpool, h->param.i_lookahead_threads, NULL, NULL ) )
         goto fail;
+    if( h->param.b_deblock_thread &&
+        x264_threadpool_init( &h->deblockpool, h->i_thread_frames, NULL, NULL ) )
+        goto fail;
 
 #if HAVE_OPENCL
     if( h->param.b_opencl )
@@ -1714,7 +1749,7 @@ static int x264_encoder_try_reconfig( x264_t *h, x264_param_t *param, int *rc_re
     COPY( analyse.intra );
     COPY( analyse.i_direct_mv_pred );
     /* Scratch buffer prevents me_range from being increased for esa/tesa */
-    if( h->param.analyse.i_me_method < X264_ME_ESA || param->analyse.i_me_range < h->param.analyse.i_me_range )
+    if( !X264_ME_EXHAUSTIVE( h->param.analyse.i_me_method ) || param->analyse.i_me_range < h->param.analyse.i_me_range )
         COPY( analyse.i_me_range );
     COPY( analyse.i_noise_reduction );
     /* We can't switch out of subme=0 during encoding. */
@@ -1724,14 +1759,15 @@ static int x264_encoder_try_reconfig( x264_t *h, x264_param_t *param, int *rc_re
     COPY( analyse.b_chroma_me );
     COPY( analyse.b_dct_decimate );
     COPY( analyse.b_fast_pskip );
+    COPY( analyse.i_fast_decision );
     COPY( analyse.b_mixed_references );
     COPY( analyse.f_psy_rd );
     COPY( analyse.f_psy_trellis );
     COPY( crop_rect );
     // can only twiddle these if they were enabled to begin with:
-    if( h->param.analyse.i_me_method >= X264_ME_ESA || param->analyse.i_me_method < X264_ME_ESA )
+    if( X264_ME_EXHAUSTIVE( h->param.analyse.i_me_method ) || !X264_ME_EXHAUSTIVE( param->analyse.i_me_method ) )
         COPY( analyse.i_me_method );
-    if( h->param.analyse.i_me_method >= X264_ME_ESA && !h->frames.b_have_sub8x8_esa )
+    if( X264_ME_EXHAUSTIVE( h->param.analyse.i_me_method ) && !h->frames.b_have_sub8x8_esa )
         h->param.analyse.inter &= ~X264_ANALYSE_PSUB8x8;
     if( h->pps->b_transform_8x8_mode )
         COPY( analyse.b_transform_8x8 );
@@ -1935,7 +1971,7 @@ static int x264_encoder_encapsulate_nals( x264_t *h, int start )
 /****************************************************************************
  * x264_encoder_headers:
  ****************************************************************************/
-int x264_encoder_headers( x264_t *h, x264_nal_t **pp_nal, int *pi_nal )
+static int x264_encoder_write_headers( x264_t *h, x264_nal_t **pp_nal, int *pi_nal )
 {
     int frame_size = 0;
     /* init bitstream context */
@@ -1975,6 +2011,17 @@ int x264_encoder_headers( x264_t *h, x264_nal_t **pp_nal, int *pi_nal )
     return frame_size;
 }
 
+int x264_encoder_headers( x264_t *h, x264_nal_t **pp_nal, int *pi_nal )
+{
+    /* Headers are returned encapsulated even when nalu_process is set;
+     * there is no input frame yet to take the callback's opaque pointer from. */
+    void (*nalu_process)( x264_t *, x264_nal_t *, void * ) = h->param.nalu_process;
+    h->param.nalu_process = NULL;
+    int frame_size = x264_encoder_write_headers( h, pp_nal, pi_nal );
+    h->param.nalu_process = nalu_process;
+    return frame_size;
+}
+
 /* Check to see whether we have chosen a reference list ordering different
  * from the standard's default. */
 static inline void x264_reference_check_reorder( x264_t *h )
@@ -2235,52 +2282,17 @@ static inline void x264_reference_build_list( x264_t *h, int i_poc )
     h->mb.pic.i_fref[1] = h->i_ref[1];
 }
 
-static void x264_fdec_filter_row( x264_t *h, int mb_y, int pass )
+/* Everything after the deblock of the rows above mb_y: the interlaced copy, border
+ * extension, hpel, progress for other frame threads and quality measurement. */
+static void x264_fdec_filter_row_post( x264_t *h, int mb_y, int pass, int b_hpel, int b_measure_quality )
 {
-    /* mb_y is the mb to be encoded next, not the mb to be filtered here */
-    int b_hpel = h->fdec->b_kept_as_ref;
-    int b_deblock = h->sh.i_disable_deblocking_filter_idc != 1;
     int b_end = mb_y == h->i_threadslice_end;
-    int b_measure_quality = 1;
     int min_y = mb_y - (1 << SLICE_MBAFF);
     int b_start = min_y == h->i_threadslice_start;
     /* Even in interlaced mode, deblocking never modifies more than 4 pixels
      * above each MB, as bS=4 doesn't happen for the top of interlaced mbpairs. */
     int minpix_y = min_y*16 - 4 * !b_start;
     int maxpix_y = mb_y*16 - 4 * !b_end;
-    b_deblock &= b_hpel || h->param.b_full_recon || h->param.psz_dump_yuv;
-    if( h->param.b_sliced_threads )
-    {
-        switch( pass )
-        {
-            /* During encode: only do deblock if asked for */
-            default:
-            case 0:
-                b_deblock &= h->param.b_full_recon;
-                b_hpel = 0;
-                break;
-            /* During post-encode pass: do deblock if not done yet, do hpel for all
-             * rows except those between slices. */
-            case 1:
-                b_deblock &= !h->param.b_full_recon;
-                b_hpel &= !(b_start && min_y > 0);
-                b_measure_quality = 0;
-                break;
-            /* Final pass: do the rows between slices in sequence. */
-            case 2:
-                b_deblock = 0;
-                b_measure_quality = 0;
-                break;
-        }
-    }
-    if( mb_y & SLICE_MBAFF )
-        return;
-    if( min_y < h->i_threadslice_start )
-        return;
-
-    if( b_deblock )
-        for( int y = min_y; y < mb_y; y += (1 << SLICE_MBAFF) )
-            x264_frame_deblock_row( h, y );
 
     /* FIXME: Prediction requires different borders for interlaced/progressive mc,
      * but the actual image data is equivalent. For now, maintain this
@@ -2355,6 +2367,84 @@ static void x264_fdec_filter_row( x264_t *h, int mb_y, int pass )
     }
 }
 
+#if HAVE_THREAD
+static void *x264_fdec_deblock_row( x264_t *h )
+{
+    x264_frame_deblock_row( h, h->i_deblock_row - 1 );
+    return NULL;
+}
+#endif
+
+/* Collect the deblock job in flight, if any, and finish filtering its row. */
+static void x264_fdec_deblock_wait( x264_t *h )
+{
+    if( !h->i_deblock_row )
+        return;
+    x264_threadpool_wait( h->deblockpool, h );
+    x264_fdec_filter_row_post( h, h->i_deblock_row, 0, h->fdec->b_kept_as_ref, 1 );
+    h->i_deblock_row = 0;
+}
+
+static void x264_fdec_filter_row( x264_t *h, int mb_y, int pass )
+{
+    /* mb_y is the mb to be encoded next, not the mb to be filtered here */
+    int b_hpel = h->fdec->b_kept_as_ref;
+    int b_deblock = h->sh.i_disable_deblocking_filter_idc != 1;
+    int b_end = mb_y == h->i_threadslice_end;
+    int b_measure_quality = 1;
+    int min_y = mb_y - (1 << SLICE_MBAFF);
+    int b_start = min_y == h->i_threadslice_start;
+    b_deblock &= b_hpel || h->param.b_full_recon || h->param.psz_dump_yuv;
+    if( h->param.b_sliced_threads )
+    {
+        switch( pass )
+        {
+            /* During encode: only do deblock if asked for */
+            default:
+            case 0:
+                b_deblock &= h->param.b_full_recon;
+                b_hpel = 0;
+                break;
+            /* During post-encode pass: do deblock if not done yet, do hpel for all
+             * rows except those between slices. */
+            case 1:
+                b_deblock &= !h->param.b_full_recon;
+                b_hpel &= !(b_start && min_y > 0);
+                b_measure_quality = 0;
+                break;
+            /* Final pass: do the rows between slices in sequence. */
+            case 2:
+                b_deblock = 0;
+                b_measure_quality = 0;
+                break;
+        }
+    }
+    if( mb_y & SLICE_MBAFF )
+        return;
+    if( min_y < h->i_threadslice_start )
+        return;
+
+    /* With a deblock thread, row mb_y-1 is deblocked while row mb_y is encoded:
+     * encoding only reads the unfiltered intra_border_backup and the deblock_strength
+     * half of its own row. The rest of the filtering follows one row later. */
+    if( b_deblock && h->param.b_deblock_thread )
+    {
+        x264_fdec_deblock_wait( h );
+        if( !b_end )
+        {
+            h->i_deblock_row = mb_y;
+            x264_threadpool_run( h->deblockpool, (void*)x264_fdec_deblock_row, h );
+            return;
+        }
+    }
+
+    if( b_deblock )
+        for( int y = min_y; y < mb_y; y += (1 << SLICE_MBAFF) )
+            x264_frame_deblock_row( h, y );
+
+    x264_fdec_filter_row_post( h, mb_y, pass, b_hpel, b_measure_quality );
+}
+
 static inline int x264_reference_update( x264_t *h )
 {
     if( !h->fdec->b_kept_as_ref )
@@ -3021,6 +3111,11 @@ fail:
     /* Tell other threads we're done, so they wouldn't wait for it */
     if( h->param.b_sliced_threads )
         x264_threadslice_cond_broadcast( h, 2 );
+    if( h->i_deblock_row )
+    {
+        x264_threadpool_wait( h->deblockpool, h );
+        h->i_deblock_row = 0;
+    }
     return (void *)-1;
 }
 
@@ -3966,6 +4061,8 @@ void    x264_encoder_close  ( x264_t *h )
         x264_threadpool_delete( h->threadpool );
     if( h->param.i_lookahead_threads > 1 )
         x264_threadpool_delete( h->lookaheadpool );
+    if( h->deblockpool )
+        x264_threadpool_delete( h->deblockpool );
     if( h->i_thread_frames > 1 )
     {
         for( int i = 0; i < h->i_thread_frames; i++ )
@@ -54,6 +54,8 @@ static const uint8_t mod6m1[8] = {5,0,1,2,3,4,5,0};
 /* radius 2 hexagon. repeated entries are to avoid having to compute mod6 every time. */
 static const int8_t hex2[8][2] = {{-1,-2}, {-2,0}, {-1,2}, {1,2}, {2,0}, {1,-2}, {-1,-2}, {-2,0}};
 static const int8_t square1[9][2] = {{0,0}, {0,-1}, {0,1}, {-1,0}, {1,0}, {-1,-1}, {-1,1}, {1,-1}, {1,1}};
+/* log2 of the number of 16x16 blocks' worth of pixels per partition size, for scaling thresholds */
+static const uint8_t x264_pixel_size_shift[7] = { 0, 1, 1, 2, 3, 3, 4 };
 
 static void refine_subpel( x264_t *h, x264_me_t *m, int hpel_iters, int qpel_iters, int *p_halfpel_thresh, int b_refine_qpel );
 
@@ -424,8 +426,6 @@ void x264_me_search_ref( x264_t *h, x264_me_t *m, int16_t (*mvc)[2], int i_mvc,
             /* Uneven-cross Multi-Hexagon-grid Search
              * as in JM, except with different early termination */
 
-            static const uint8_t x264_pixel_size_shift[7] = { 0, 1, 1, 2, 3, 3, 4 };
-
             int ucost1, ucost2;
             int cross_start = 1;
 
@@ -615,6 +615,183 @@ void x264_me_search_ref( x264_t *h, x264_me_t *m, int16_t (*mvc)[2], int i_mvc,
             break;
         }
 
+        case X264_ME_LOWRES:
+        {
+            /* The lookahead already searched this macroblock at half
+             * resolution, so its vector is normally within a pixel or two
+             * of the full resolution one. Try it next to the predictors,
+             * then refine the best of them in a window of +/-2 instead of
+             * searching the whole range. Without a lookahead vector (I
+             * frames, refs the lookahead didn't search, interlaced MBs)
+             * this is a hexagon search. */
+            ALIGNED_4( int16_t mvl[2] );
+            if( !x264_mb_predict_mv_lowres( h, m->i_list, m->i_ref, mvl ) )
+                goto me_hex2;
+            int lmx = x264_clip3( FPEL(mvl[0]), mv_x_min, mv_x_max );
+            int lmy = x264_clip3( FPEL(mvl[1]), mv_y_min, mv_y_max );
+            if( lmx != bmx || lmy != bmy )
+                COST_MV( lmx, lmy );
+
+            /* square refine, twice at most */
+            for( int i = 0; i < 2; i++ )
+            {
+                bcost <<= 4;
+                COST_MV_X4_DIR(  0,-1,  0,1, -1,0, 1,0, costs );
+                COPY1_IF_LT( bcost, (costs[0]<<4)+1 );
+                COPY1_IF_LT( bcost, (costs[1]<<4)+2 );
+                COPY1_IF_LT( bcost, (costs[2]<<4)+3 );
+                COPY1_IF_LT( bcost, (costs[3]<<4)+4 );
+                COST_MV_X4_DIR( -1,-1, -1,1, 1,-1, 1,1, costs );
+                COPY1_IF_LT( bcost, (costs[0]<<4)+5 );
+                COPY1_IF_LT( bcost, (costs[1]<<4)+6 );
+                COPY1_IF_LT( bcost, (costs[2]<<4)+7 );
+                COPY1_IF_LT( bcost, (costs[3]<<4)+8 );
+                int dir = bcost&15;
+                bmx += square1[dir][0];
+                bmy += square1[dir][1];
+                bcost >>= 4;
+                if( !dir || !CHECK_MVRANGE(bmx, bmy) )
+                    break;
+            }
+            break;
+        }
+
+        case X264_ME_PYRAMID:
+        {
+            /* The lookahead seeded its half resolution search with a coarse
+             * to fine search over the 1/8 and 1/4 resolution planes (see
+             * x264_pyramid_search), so its vector follows motion far beyond
+             * the hexagon's range. Try it next to the predictors and run the
+             * hexagon search from the best of them. */
+            ALIGNED_4( int16_t mvl[2] );
+            if( x264_mb_predict_mv_lowres( h, m->i_list, m->i_ref, mvl ) )
+            {
+                int lmx = x264_clip3( FPEL(mvl[0]), mv_x_min, mv_x_max );
+                int lmy = x264_clip3( FPEL(mvl[1]), mv_y_min, mv_y_max );
+                if( lmx != bmx || lmy != bmy )
+                    COST_MV( lmx, lmy );
+            }
+            goto me_hex2;
+        }
+
+        case X264_ME_EPZS:
+        {
+            /* Enhanced Predictive Zonal Search (Tourapis), on top of the median
+             * and the caller's candidates tested above: stop if they already
+             * match well (T1). Otherwise test the spatial, co-located and
+             * accelerator predictors in sad_x4 batches and stop if the best
+             * is within what the neighbouring MBs achieved (T2), else run a
+             * diamond search from it, plus a square refine if it still ends
+             * far above T2. */
+            int shift = x264_pixel_size_shift[i_pixel];
+            int t1 = 256 >> shift;
+            if( bcost >= t1 )
+            {
+                ALIGNED_ARRAY_8( int16_t, epzs_mvc,[6],[2] );
+                int i_epzs_mvc, n = 0;
+                x264_mb_predict_mv_epzs( h, m->i_list, m->i_ref, epzs_mvc, &i_epzs_mvc );
+
+                /* round to fullpel and drop what has been tested already */
+                for( int i = 0; i < i_epzs_mvc; i++ )
+                {
+                    int mx = x264_clip3( FPEL(epzs_mvc[i][0]), mv_x_min, mv_x_max );
+                    int my = x264_clip3( FPEL(epzs_mvc[i][1]), mv_y_min, mv_y_max );
+                    int dup = (mx == bmx && my == bmy) || (mx == pmx && my == pmy) || !(mx|my);
+                    for( int j = 0; j < i_mvc && !dup; j++ )
+                        dup = mx == FPEL(mvc[j][0]) && my == FPEL(mvc[j][1]);
+                    for( int j = 0; j < n && !dup; j++ )
+                        dup = mx == epzs_mvc[j][0] && my == epzs_mvc[j][1];
+                    if( !dup )
+                    {
+                        epzs_mvc[n][0] = mx;
+                        epzs_mvc[n][1] = my;
+                        n++;
+                    }
+                }
+
+                int i = 0;
+                for( ; i + 4 <= n; i += 4 )
+                {
+                    h->pixf.fpelcmp_x4[i_pixel]( p_fenc,
+                        p_fref_w + epzs_mvc[i+0][0] + epzs_mvc[i+0][1]*stride,
+                        p_fref_w + epzs_mvc[i+1][0] + epzs_mvc[i+1][1]*stride,
+                        p_fref_w + epzs_mvc[i+2][0] + epzs_mvc[i+2][1]*stride,
+                        p_fref_w + epzs_mvc[i+3][0] + epzs_mvc[i+3][1]*stride,
+                        stride, costs );
+                    for( int j = 0; j < 4; j++ )
+                    {
+                        int mx = epzs_mvc[i+j][0], my = epzs_mvc[i+j][1];
+                        COPY3_IF_LT( bcost, costs[j] + BITS_MVD( mx, my ), bmx, mx, bmy, my );
+                    }
+                }
+                if( n - i == 3 )
+                {
+                    h->pixf.fpelcmp_x3[i_pixel]( p_fenc,
+                        p_fref_w + epzs_mvc[i+0][0] + epzs_mvc[i+0][1]*stride,
+                        p_fref_w + epzs_mvc[i+1][0] + epzs_mvc[i+1][1]*stride,
+                        p_fref_w + epzs_mvc[i+2][0] + epzs_mvc[i+2][1]*stride,
+                        stride, costs );
+                    for( int j = 0; j < 3; j++ )
+                    {
+                        int mx = epzs_mvc[i+j][0], my = epzs_mvc[i+j][1];
+                        COPY3_IF_LT( bcost, costs[j] + BITS_MVD( mx, my ), bmx, mx, bmy, my );
+                    }
+                }
+                else
+                    for( ; i < n; i++ )
+                        COST_MV( epzs_mvc[i][0], epzs_mvc[i][1] );
+
+                /* T2 follows the cheapest neighbour, which has usually
+                 * found its true motion; only neighbours in this slice, which
+                 * were analysed earlier in this frame */
+                int nb_cost = COST_MAX;
+                if( h->mb.i_neighbour & MB_LEFT )
+                    nb_cost = X264_MIN( nb_cost, h->mb.epzs_cost[h->mb.i_mb_left_xy[0]] );
+                if( h->mb.i_neighbour & MB_TOP )
+                    nb_cost = X264_MIN( nb_cost, h->mb.epzs_cost[h->mb.i_mb_top_xy] );
+                if( h->mb.i_neighbour & MB_TOPRIGHT )
+                    nb_cost = X264_MIN( nb_cost, h->mb.epzs_cost[h->mb.i_mb_topright_xy] );
+                int t2 = nb_cost == COST_MAX ? t1 : X264_MAX( t1, ((nb_cost*5>>2) + 128) >> shift );
+
+                if( bcost >= t2 )
+                {
+                    /* diamond search, radius 1 */
+                    bcost <<= 4;
+                    int iter = i_me_range;
+                    do
+                    {
+                        COST_MV_X4_DIR( 0,-1, 0,1, -1,0, 1,0, costs );
+                        COPY1_IF_LT( bcost, (costs[0]<<4)+1 );
+                        COPY1_IF_LT( bcost, (costs[1]<<4)+3 );
+                        COPY1_IF_LT( bcost, (costs[2]<<4)+4 );
+                        COPY1_IF_LT( bcost, (costs[3]<<4)+12 );
+                        if( !(bcost&15) )
+                            break;
+                        bmx -= (bcost<<28)>>30;
+                        bmy -= (bcost<<30)>>30;
+                        bcost &= ~15;
+                    } while( --iter && CHECK_MVRANGE(bmx, bmy) );
+                    bcost >>= 4;
+
+                    if( bcost >= 2*t2 && CHECK_MVRANGE(bmx, bmy) )
+                    {
+                        bcost <<= 4;
+                        COST_MV_X4_DIR( -1,-1, -1,1, 1,-1, 1,1, costs );
+                        COPY1_IF_LT( bcost, (costs[0]<<4)+5 );
+                        COPY1_IF_LT( bcost, (costs[1]<<4)+6 );
+                        COPY1_IF_LT( bcost, (costs[2]<<4)+7 );
+                        COPY1_IF_LT( bcost, (costs[3]<<4)+8 );
+                        bmx += square1[bcost&15][0];
+                        bmy += square1[bcost&15][1];
+                        bcost >>= 4;
+                    }
+                }
+            }
+            if( i_pixel == PIXEL_16x16 && !m->i_list && !m->i_ref )
+                h->mb.epzs_cost[h->mb.i_mb_xy] = bcost;
+            break;
+        }
+
         case X264_ME_ESA:
         case X264_ME_TESA:
         {
@@ -39,6 +39,7 @@ typedef struct
     uint16_t *p_cost_mv; /* lambda * nbits for each possible mv */
     int      i_ref_cost;
     int      i_ref;
+    int      i_list;
     const x264_weight_t *weight;
 
     pixel *p_fref[12];
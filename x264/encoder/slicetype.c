@@ -498,6 +498,111 @@ void x264_weights_analyse( x264_t *h, x264_frame_t *fenc, x264_frame_t *ref, int
     }
 }
 
+static const int8_t pyramid_square[8][2] = {{0,-1}, {0,1}, {-1,0}, {1,0}, {-1,-1}, {-1,1}, {1,-1}, {1,1}};
+
+/* me=pyramid: coarse-to-fine search of fenc against ref over the 1/8 and 1/4
+ * resolution planes, one vector per 8x8 block of each level. The top level
+ * is searched exhaustively within +/- i_me_range/2, which is +/- 4*i_me_range
+ * at full resolution. A block of the level below tries twice the vectors of
+ * its parent and of the parent's neighbours on its side, then refines the
+ * best. The 1/4 resolution vectors become candidates for the lowres search
+ * of the macroblocks they cover, which is how the main encode sees them.
+ * Costs are SAD plus a small penalty on vector length so that flat areas
+ * stay still; blocks may start up to 8 pixels outside the plane.
+ *
+ * Counting lowres, the levels cover 1/4, 1/16 and 1/64 of the frame area.
+ * Stopping at 1/16 would need twice the exhaustive range over four times
+ * the blocks for the same reach, sixteen times the SADs, so one more level
+ * sits above it.
+ *
+ * Known limits: the search runs serially on the lookahead's own thread,
+ * before the frame is split between lookahead threads, and it compares
+ * against the unweighted planes of ref. Under weightp fades its vectors
+ * are picked without the weights; the lowres search that tries them does
+ * use the weighted reference. */
+static void x264_pyramid_search( x264_t *h, x264_frame_t *fenc, x264_frame_t *ref, int16_t (**mvs)[2] )
+{
+    ALIGNED_ARRAY_16( pixel, pix,[8*FENC_STRIDE] );
+    int i_range = h->param.analyse.i_me_range >> 1;
+    int i_top_bw = (h->mb.i_mb_width + 3) >> 2;
+    int i_top_bh = (h->mb.i_mb_height + 3) >> 2;
+    int costs[4];
+#define PYRAMID_MV_COST( mx, my ) ((abs(mx) + abs(my)) << 2)
+
+    for( int level = 1; level >= 0; level-- )
+    {
+        int i_stride = fenc->i_stride_pyramid[level];
+        int i_bw = (h->mb.i_mb_width + (2<<level) - 1) >> (level+1);
+        int i_bh = (h->mb.i_mb_height + (2<<level) - 1) >> (level+1);
+        for( int by = 0; by < i_bh; by++ )
+            for( int bx = 0; bx < i_bw; bx++ )
+            {
+                int x = 8*bx;
+                int y = 8*by;
+                int mv_min_x = -x - 8;
+                int mv_max_x = fenc->i_width_pyramid[level] - x;
+                int mv_min_y = -y - 8;
+                int mv_max_y = fenc->i_lines_pyramid[level] - y;
+                pixel *fref = &ref->lowres_pyramid[level][x + y*i_stride];
+                int bmx = 0, bmy = 0;
+
+                h->mc.copy[PIXEL_8x8]( pix, FENC_STRIDE, &fenc->lowres_pyramid[level][x + y*i_stride], i_stride, 8 );
+                int bcost = h->pixf.sad[PIXEL_8x8]( pix, FENC_STRIDE, fref, i_stride );
+
+                if( level == 1 )
+                {
+                    int min_x = X264_MAX( -i_range, mv_min_x );
+                    int max_x = X264_MIN( i_range, mv_max_x );
+                    int min_y = X264_MAX( -i_range, mv_min_y );
+                    int max_y = X264_MIN( i_range, mv_max_y );
+                    for( int my = min_y; my <= max_y; my++ )
+                        for( int mx = min_x; mx <= max_x; mx += 4 )
+                        {
+                            pixel *p = fref + mx + my*i_stride;
+                            h->pixf.sad_x4[PIXEL_8x8]( pix, p, p+1, p+2, p+3, i_stride, costs );
+                            for( int i = 0; i < 4 && mx+i <= max_x; i++ )
+                                COPY3_IF_LT( bcost, costs[i] + PYRAMID_MV_COST( mx+i, my ), bmx, mx+i, bmy, my );
+                        }
+                }
+                else
+                {
+                    int pbx = bx >> 1;
+                    int pby = by >> 1;
+                    int nbx = x264_clip3( pbx + (bx&1 ? 1 : -1), 0, i_top_bw-1 );
+                    int nby = x264_clip3( pby + (by&1 ? 1 : -1), 0, i_top_bh-1 );
+                    int16_t *cand[3] = { mvs[1][pbx + pby*i_top_bw], mvs[1][nbx + pby*i_top_bw], mvs[1][pbx + nby*i_top_bw] };
+                    for( int i = 0; i < 3; i++ )
+                    {
+                        int mx = x264_clip3( 2*cand[i][0], mv_min_x, mv_max_x );
+                        int my = x264_clip3( 2*cand[i][1], mv_min_y, mv_max_y );
+                        int cost = h->pixf.sad[PIXEL_8x8]( pix, FENC_STRIDE, fref + mx + my*i_stride, i_stride );
+                        COPY3_IF_LT( bcost, cost + PYRAMID_MV_COST( mx, my ), bmx, mx, bmy, my );
+                    }
+
+                    /* square refine, twice at most */
+                    for( int iter = 0; iter < 2; iter++ )
+                    {
+                        int omx = bmx, omy = bmy;
+                        for( int i = 0; i < 8; i++ )
+                        {
+                            int mx = omx + pyramid_square[i][0];
+                            int my = omy + pyramid_square[i][1];
+                            if( mx < mv_min_x || mx > mv_max_x || my < mv_min_y || my > mv_max_y )
+                                continue;
+                            int cost = h->pixf.sad[PIXEL_8x8]( pix, FENC_STRIDE, fref + mx + my*i_stride, i_stride );
+                            COPY3_IF_LT( bcost, cost + PYRAMID_MV_COST( mx, my ), bmx, mx, bmy, my );
+                        }
+                        if( bmx == omx && bmy == omy )
+                            break;
+                    }
+                }
+                mvs[level][bx + by*i_bw][0] = bmx;
+                mvs[level][bx + by*i_bw][1] = bmy;
+            }
+    }
+#undef PYRAMID_MV_COST
+}
+
 /* Output buffers are separated by 128 bytes to avoid false sharing of cachelines
  * in multithreaded lookahead. */
 #define PAD_SIZE 32
@@ -649,7 +754,7 @@ static void x264_slicetype_mb_cost( x264_t *h, x264_mb_analysis_t *a,
         {
             int i_mvc = 0;
             int16_t (*fenc_mv)[2] = fenc_mvs[l];
-            ALIGNED_4( int16_t mvc[4][2] );
+            ALIGNED_4( int16_t mvc[5][2] );
 
             /* Reverse-order MV prediction. */
             M32( mvc[0] ) = 0;
@@ -671,6 +776,16 @@ static void x264_slicetype_mb_cost( x264_t *h, x264_mb_analysis_t *a,
             else
                 x264_median_mv( m[l].mvp, mvc[0], mvc[1], mvc[2] );
 
+            /* me=pyramid: the coarse-to-fine vector of the 1/4 resolution block
+             * covering this macroblock, from x264_pyramid_search */
+            if( h->frames.b_have_lowres_pyramid )
+            {
+                int16_t *mvp = fenc->pyramid_mvs[l][0][(i_mb_x>>1) + (i_mb_y>>1) * ((h->mb.i_mb_width+1)>>1)];
+                mvc[i_mvc][0] = mvp[0] << 3;
+                mvc[i_mvc][1] = mvp[1] << 3;
+                i_mvc++;
+            }
+
             /* Fast skip for cases of near-zero residual.  Shortcut: don't bother except in the mv0 case,
              * since anything else is likely to have enough residual to not trigger the skip. */
             if( !M32( m[l].mvp ) )
@@ -891,6 +1006,11 @@ static int x264_slicetype_frame_cost( x264_t *h, x264_mb_analysis_t *a,
         else
 #endif
         {
+            if( h->frames.b_have_lowres_pyramid )
+                for( int l = 0; l < 2; l++ )
+                    if( do_search[l] )
+                        x264_pyramid_search( h, fenc, frames[l ? p1 : p0], fenc->pyramid_mvs[l] );
+
             if( h->param.i_lookahead_threads > 1 )
             {
                 x264_slicetype_slice_t s[X264_LOOKAHEAD_THREAD_MAX];
@@ -29,11 +29,7 @@
 
 #include "output.h"
 #include <lsmash.h>
-static lsmash_root_t *lsmash_open_custom( lsmash_file_mode mode );
-
-static mp4CustomWriteFunction s_customWrite = NULL;
-static mp4CustomSeekFunction  s_customSeek  = NULL;
-static void*                  s_customOpaque = NULL;
+static lsmash_root_t *lsmash_open_custom( lsmash_file_mode mode, mp4CustomWriteFunction write_f, mp4CustomSeekFunction seek_f, void* opaque );
 
 #define H264_NALU_LENGTH_SIZE 4
 
@@ -67,6 +63,7 @@ typedef struct
     lsmash_root_t *p_root;
     lsmash_video_summary_t *summary;
     int b_stdout;
+    int b_init_segment;
     uint32_t i_movie_timescale;
     uint32_t i_video_timescale;
     uint32_t i_track;
@@ -188,15 +185,15 @@ static int open_file( char *psz_filename, hnd_t *p_handle, cli_output_opt_t *opt
 
     p_mp4->b_dts_compress = opt->use_dts_compress;
     p_mp4->b_use_recovery = 0; // we don't really support recovery
-    p_mp4->b_fragments    = !b_regular && !b_custom; // When b_custom is set, DO NOT be fragments.
+    p_mp4->b_fragments    = !b_regular && !b_custom; // When b_custom is set, mp4_set_buffer_writer decides.
     p_mp4->b_stdout       = !strcmp( psz_filename, "-" );
 
-    if (b_custom) {
-        p_mp4->p_root = lsmash_open_custom( p_mp4->b_fragments ? LSMASH_FILE_MODE_WRITE_FRAGMENTED : LSMASH_FILE_MODE_WRITE );
-    } else {
+    /* The root of a custom stream is created by mp4_set_buffer_writer. */
+    if( !b_custom )
+    {
         p_mp4->p_root = lsmash_open_movie( psz_filename, p_mp4->b_fragments ? LSMASH_FILE_MODE_WRITE_FRAGMENTED : LSMASH_FILE_MODE_WRITE );
+        MP4_FAIL_IF_ERR_EX( !p_mp4->p_root, "failed to create root.\n" );
     }
-    MP4_FAIL_IF_ERR_EX( !p_mp4->p_root, "failed to create root.\n" );
 
     p_mp4->summary = (lsmash_video_summary_t *)lsmash_create_summary( LSMASH_SUMMARY_TYPE_VIDEO );
     MP4_FAIL_IF_ERR_EX( !p_mp4->summary,
@@ -412,10 +409,11 @@ static int write_frame( hnd_t handle, uint8_t *p_nalu, int i_size, x264_picture_
     p_sample->index = p_mp4->i_sample_entry;
     p_sample->prop.ra_flags = p_picture->b_keyframe ? ISOM_SAMPLE_RANDOM_ACCESS_FLAG_SYNC : ISOM_SAMPLE_RANDOM_ACCESS_FLAG_NONE;
 
-    if( p_mp4->b_fragments && p_mp4->i_numframe && p_sample->prop.ra_flags != ISOM_SAMPLE_RANDOM_ACCESS_FLAG_NONE )
+    if( p_mp4->b_fragments && (p_mp4->i_numframe || p_mp4->b_init_segment) && p_sample->prop.ra_flags != ISOM_SAMPLE_RANDOM_ACCESS_FLAG_NONE )
     {
-        MP4_FAIL_IF_ERR( lsmash_flush_pooled_samples( p_mp4->p_root, p_mp4->i_track, p_sample->dts - p_mp4->i_prev_dts ),
-                         "failed to flush the rest of samples.\n" );
+        if( p_mp4->i_numframe )
+            MP4_FAIL_IF_ERR( lsmash_flush_pooled_samples( p_mp4->p_root, p_mp4->i_track, p_sample->dts - p_mp4->i_prev_dts ),
+                             "failed to flush the rest of samples.\n" );
         MP4_FAIL_IF_ERR( lsmash_create_fragment_movie( p_mp4->p_root ),
                          "failed to create a movie fragment.\n" );
     }
@@ -437,7 +435,10 @@ static int write_frame( hnd_t handle, uint8_t *p_nalu, int i_size, x264_picture_
 static int lsmash_set_custom_param
 (
  int                       open_mode,
- lsmash_file_parameters_t *param
+ lsmash_file_parameters_t *param,
+ mp4CustomWriteFunction    write_f,
+ mp4CustomSeekFunction     seek_f,
+ void                     *opaque
  )
 {
     if( !param )
@@ -465,10 +466,10 @@ static int lsmash_set_custom_param
     
     memset( param, 0, sizeof(lsmash_file_parameters_t) );
     param->mode                = file_mode;
-    param->opaque              = s_customOpaque;
+    param->opaque              = opaque;
     param->read                = NULL;
-    param->write               = s_customWrite;
-    param->seek                = s_customSeek;
+    param->write               = write_f;
+    param->seek                = seek_f;
     param->major_brand         = 0;
     param->brands              = NULL;
     param->brand_count         = 0;
@@ -481,7 +482,7 @@ static int lsmash_set_custom_param
 }
 
 
-static lsmash_root_t *lsmash_open_custom( lsmash_file_mode mode )
+static lsmash_root_t *lsmash_open_custom( lsmash_file_mode mode, mp4CustomWriteFunction write_f, mp4CustomSeekFunction seek_f, void* opaque )
 {
     int open_mode = -1;
     if( mode & LSMASH_FILE_MODE_WRITE )
@@ -496,7 +497,7 @@ static lsmash_root_t *lsmash_open_custom( lsmash_file_mode mode )
     if( !root )
         return NULL;
     lsmash_file_parameters_t param;
-    lsmash_set_custom_param(open_mode, &param);    
+    lsmash_set_custom_param(open_mode, &param, write_f, seek_f, opaque);
     param.mode |= mode;
     lsmash_file_t *file = lsmash_set_file( root, &param );
     if( !file || (open_mode == 1 && lsmash_read_file( file, &param ) < 0) )
@@ -514,10 +515,21 @@ static lsmash_root_t *lsmash_open_custom( lsmash_file_mode mode )
 }
 
 
-void mp4_set_buffer_writer(mp4CustomWriteFunction write_f, mp4CustomSeekFunction seek_f, void* opaque) {
-    s_customWrite = write_f;
-    s_customSeek = seek_f;
-    s_customOpaque = opaque;
+/* Must be called after open_file("+") and before set_param. */
+int mp4_set_buffer_writer( hnd_t handle, mp4CustomWriteFunction write_f, mp4CustomSeekFunction seek_f, void* opaque )
+{
+    mp4_hnd_t *p_mp4 = handle;
+
+    /* A custom stream without a seek function is written as fragments that are never revisited. */
+    const int b_unseekable = !seek_f;
+    p_mp4->b_fragments    = b_unseekable;
+    p_mp4->b_stdout       = b_unseekable;
+    p_mp4->b_init_segment = b_unseekable; /* keep samples out of the initial movie */
+
+    p_mp4->p_root = lsmash_open_custom( p_mp4->b_fragments ? LSMASH_FILE_MODE_WRITE_FRAGMENTED : LSMASH_FILE_MODE_WRITE,
+                                        write_f, seek_f, opaque );
+    MP4_FAIL_IF_ERR( !p_mp4->p_root, "failed to create root.\n" );
+    return 0;
 }
 
 const cli_output_t mp4_output = { open_file, set_param, write_headers, write_frame, close_file };
@@ -50,5 +50,7 @@ extern const cli_output_t flv_output;
 
 typedef int (*mp4CustomWriteFunction) (void *opaque, uint8_t *buf, int size);
 typedef int64_t (*mp4CustomSeekFunction)(void *opaque, int64_t offset, int whence);
+/* A NULL seek function makes the custom stream unseekable: the mp4 output then
+ * writes an init segment followed by moof/mdat fragments, one per keyframe. */
 
 #endif
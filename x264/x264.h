@@ -41,7 +41,7 @@
 
 #include "x264_config.h"
 
-#define X264_BUILD 142
+#define X264_BUILD 143
 
 /* Application developers planning to link against a shared library version of
  * libx264 from a Microsoft Visual Studio or similar development environment
@@ -172,6 +172,9 @@ typedef struct
 #define X264_ME_UMH                  2
 #define X264_ME_ESA                  3
 #define X264_ME_TESA                 4
+#define X264_ME_LOWRES               5
+#define X264_ME_EPZS                 6
+#define X264_ME_PYRAMID              7
 #define X264_CQM_FLAT                0
 #define X264_CQM_JVT                 1
 #define X264_CQM_CUSTOM              2
@@ -195,7 +198,7 @@ typedef struct
 #define X264_KEYINT_MAX_INFINITE     (1<<30)
 
 static const char * const x264_direct_pred_names[] = { "none", "spatial", "temporal", "auto", 0 };
-static const char * const x264_motion_est_names[] = { "dia", "hex", "umh", "esa", "tesa", 0 };
+static const char * const x264_motion_est_names[] = { "dia", "hex", "umh", "esa", "tesa", "lowres", "epzs", "pyramid", 0 };
 static const char * const x264_b_pyramid_names[] = { "none", "strict", "normal", 0 };
 static const char * const x264_overscan_names[] = { "undef", "show", "crop", 0 };
 static const char * const x264_vidformat_names[] = { "component", "pal", "ntsc", "secam", "mac", "undef", 0 };
@@ -271,6 +274,7 @@ typedef struct x264_param_t
     int         i_threads;           /* encode multiple frames in parallel */
     int         i_lookahead_threads; /* multiple threads for lookahead analysis */
     int         b_sliced_threads;  /* Whether to use slice-based threading. */
+    int         b_deblock_thread;  /* Deblock each mb row on a helper thread while the next row is encoded. */
     int         b_deterministic; /* whether to allow non-deterministic optimizations when threaded */
     int         b_cpu_independent; /* force canonical behavior rather than cpu-dependent optimal algorithms */
     int         i_sync_lookahead; /* threaded lookahead buffer */
@@ -373,6 +377,8 @@ typedef struct x264_param_t
         int          b_mixed_references; /* allow each mb partition to have its own reference number */
         int          i_trellis;  /* trellis RD quantization */
         int          b_fast_pskip; /* early SKIP detection on P-frames */
+        int          i_fast_decision; /* skip sub-8x8, i4x4 and bidir refinement when cheap per-MB features say they won't win.
+                                         0 = off, 1-3 = strength */
         int          b_dct_decimate; /* transform coefficient thresholding on P-frames */
         int          i_noise_reduction; /* adaptive pseudo-deadzone */
         float        f_psy_rd; /* Psy RD strength */